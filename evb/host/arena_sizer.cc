@@ -0,0 +1,336 @@
+/**
+ * @file arena_sizer.cc
+ * @author Adam Page (adam.page@ambiq.com)
+ * @brief Host tool that sizes each model's tensor arena and emits src/model_arena.h
+ * @version 1.0
+ * @date 2023-05-02
+ *
+ * @copyright Copyright (c) 2023
+ *
+ * Loads each exported model into a RecordingMicroInterpreter built from the vendored TFLM
+ * sources and records persistent (tail), non-persistent (head) and kernel scratch usage.
+ * Kernel scratch is captured by ScratchRecordingOpResolver (scratch_recorder.cc).
+ *
+ * The firmware links CMSIS-NN kernels, which request scratch the host reference kernels do not
+ * (im2col for CONV_2D, DEPTHWISE_CONV_2D, AVERAGE_POOL_2D). The largest of those requests is added
+ * on top of the host plan. Host pointers are 64-bit, so the TfLiteEvalTensor and NodeAndRegistration
+ * arrays are rescaled to their ILP32 sizes. Other persistent buffers (op data) are left at their
+ * host size, which together with HK_ARENA_HEADROOM keeps the sizes an upper bound.
+ * With HK_CONV1D_ENABLE (constants.h) the firmware and this tool use Conv1dOpResolver, whose
+ * unit-height kernels need no scratch, so only convs it falls back on add CMSIS-NN scratch.
+ *
+ * The streaming segmentation arena (stream_model.cc) is the arena used by StreamModel::Init() for
+ * HK_SEG_STREAM_STEP sample pushes over HK_DATA_LEN samples. It holds no pointers, so the host size
+ * is the target size. With HK_SEG_STREAM_ENABLE it replaces the segmentation arena in the budget.
+ *
+ * With HK_MULTIHEAD_ENABLE the backbone and head models (multihead_model.cc) are sized as well and
+ * replace the standalone models in the budget.
+ *
+ * With HK_ARR_EXIT_ENABLE the early-exit arrhythmia parts (early_exit_model.cc) are sized and replace
+ * the standalone arrhythmia model in the budget. All parts are allocated at once, as any block may
+ * run through every part.
+ *
+ * With HK_CASCADE_ENABLE the small arrhythmia and beat models (cascade_model.cc) are sized as well and
+ * add to the budget, as they run in front of the standalone models.
+ *
+ * With HK_SEG_COARSE_ENABLE the coarse segmentation model (coarse_segmentation.cc) is sized as well
+ * and adds to the budget, as the streamed segmentation model refines its labels.
+ *
+ * Build: make -C evb/host arena
+ */
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <vector>
+
+#include "tensorflow/lite/micro/all_ops_resolver.h"
+#include "tensorflow/lite/micro/micro_error_reporter.h"
+#include "tensorflow/lite/micro/recording_micro_interpreter.h"
+#include "tensorflow/lite/schema/schema_generated.h"
+#include "tensorflow/lite/schema/schema_utils.h"
+
+#include "arrhythmia_model_buffer.h"
+#include "beat_model_buffer.h"
+#include "segmentation_model_buffer.h"
+
+#include "constants.h"
+#include "conv1d_kernels.h"
+#include "custom_ops.h"
+#include "scratch_recorder.h"
+#include "stream_model.h"
+// After constants.h, which enables them
+#ifdef HK_MULTIHEAD_ENABLE
+    #include "mh_arrhythmia_model_buffer.h"
+    #include "mh_backbone_model_buffer.h"
+    #include "mh_beat_model_buffer.h"
+    #include "mh_segmentation_model_buffer.h"
+#endif
+#ifdef HK_ARR_EXIT_ENABLE
+    #include "arr_exit1_model_buffer.h"
+    #include "arr_exit2_model_buffer.h"
+    #include "arr_exit3_model_buffer.h"
+#endif
+#ifdef HK_CASCADE_ENABLE
+    #include "arr_small_model_buffer.h"
+    #include "beat_small_model_buffer.h"
+#endif
+#ifdef HK_SEG_COARSE_ENABLE
+    #include "seg_coarse_model_buffer.h"
+#endif
+
+#define ARENA_MAX_SIZE (1024 * 1024)
+#define ARENA_ALIGN (16)
+// ILP32 (Cortex-M) sizes of structs whose arrays are recorded by RecordingMicroAllocator
+#define TARGET_EVAL_TENSOR_SIZE (12)          // data, dims, type
+#define TARGET_NODE_AND_REGISTRATION_SIZE (32) // 6 pointers + int in TfLiteNode, registration pointer
+#ifndef HK_ARENA_HEADROOM
+    #define HK_ARENA_HEADROOM (1024)
+#endif
+
+typedef struct {
+    const char *name;   // Macro prefix (HK_<name>_ARENA_SIZE)
+    const uint8_t *buf; // Flatbuffer
+    uint32_t len;       // Flatbuffer length
+} model_entry_t;
+
+typedef struct {
+    size_t persistent;    // Tail bytes (structs, quantization, op data)
+    size_t nonPersistent; // Head bytes (planned activations + host scratch)
+    size_t scratch;       // Largest host kernel scratch request
+    size_t targetScratch; // Largest CMSIS-NN scratch request not seen on host
+    size_t arenaSize;     // Aligned size incl. headroom
+} arena_usage_t;
+
+static const model_entry_t models[] = {
+    {"ARR", g_arrhythmia_model, g_arrhythmia_model_len},
+    {"SEG", g_segmentation_model, g_segmentation_model_len},
+    {"BEAT", g_beat_model, g_beat_model_len},
+#ifdef HK_MULTIHEAD_ENABLE
+    {"MH_BACKBONE", g_mh_backbone_model, g_mh_backbone_model_len},
+    {"MH_ARR", g_mh_arrhythmia_model, g_mh_arrhythmia_model_len},
+    {"MH_SEG", g_mh_segmentation_model, g_mh_segmentation_model_len},
+    {"MH_BEAT", g_mh_beat_model, g_mh_beat_model_len},
+#endif
+#ifdef HK_ARR_EXIT_ENABLE
+    {"ARR_EXIT1", g_arr_exit1_model, g_arr_exit1_model_len},
+    {"ARR_EXIT2", g_arr_exit2_model, g_arr_exit2_model_len},
+    {"ARR_EXIT3", g_arr_exit3_model, g_arr_exit3_model_len},
+#endif
+#ifdef HK_CASCADE_ENABLE
+    {"ARR_SMALL", g_arr_small_model, g_arr_small_model_len},
+    {"BEAT_SMALL", g_beat_small_model, g_beat_small_model_len},
+#endif
+#ifdef HK_SEG_COARSE_ENABLE
+    {"SEG_COARSE", g_seg_coarse_model, g_seg_coarse_model_len},
+#endif
+};
+// Standalone models (the first entries)
+#define NUM_STANDALONE_MODELS (3)
+
+//*****************************************************************************
+//*** CMSIS-NN scratch estimate
+static int32_t
+tensor_dim(const tflite::SubGraph *subgraph, int32_t tensorIdx, uint32_t dim) {
+    auto shape = subgraph->tensors()->Get(tensorIdx)->shape();
+    return (shape != nullptr && dim < shape->size()) ? shape->Get(dim) : 1;
+}
+
+static bool
+conv1d_handles(const tflite::SubGraph *subgraph, const tflite::Operator *op, tflite::BuiltinOperator code) {
+    /**
+     * @brief Whether Conv1dOpResolver runs this conv on its 1-D path (see conv1d_supported)
+     */
+#ifdef HK_CONV1D_ENABLE
+    int32_t input = op->inputs()->Get(0);
+    int32_t filter = op->inputs()->Get(1);
+    if (subgraph->tensors()->Get(input)->type() != tflite::TensorType_INT8 || tensor_dim(subgraph, input, 1) != 1 ||
+        tensor_dim(subgraph, filter, 1) != 1 || tensor_dim(subgraph, filter, 3) != tensor_dim(subgraph, input, 3)) {
+        return false;
+    }
+    if (code == tflite::BuiltinOperator_CONV_2D) {
+        auto params = op->builtin_options_as_Conv2DOptions();
+        return params && params->dilation_w_factor() == 1 && params->dilation_h_factor() == 1;
+    }
+    auto params = op->builtin_options_as_DepthwiseConv2DOptions();
+    return params && params->dilation_w_factor() == 1 && params->dilation_h_factor() == 1;
+#else
+    return false;
+#endif
+}
+
+static size_t
+cmsis_nn_scratch(const tflite::Model *model) {
+    /**
+     * @brief Largest scratch buffer the target's CMSIS-NN kernels request (get_buffer_size with DSP extension)
+     * @param model TFLite model
+     * @return Bytes
+     */
+    const tflite::SubGraph *subgraph = model->subgraphs()->Get(0);
+    size_t maxBytes = 0;
+    for (uint32_t i = 0; i < subgraph->operators()->size(); i++) {
+        const tflite::Operator *op = subgraph->operators()->Get(i);
+        tflite::BuiltinOperator code = tflite::GetBuiltinCode(model->operator_codes()->Get(op->opcode_index()));
+        int32_t input = op->inputs()->Get(0);
+        size_t bytes = 0;
+        switch (code) {
+        case tflite::BuiltinOperator_CONV_2D: {
+            if (conv1d_handles(subgraph, op, code)) {
+                break;
+            }
+            // Filter is [out_c, kh, kw, in_c]
+            int32_t filter = op->inputs()->Get(1);
+            bytes = 2 * tensor_dim(subgraph, filter, 1) * tensor_dim(subgraph, filter, 2) * tensor_dim(subgraph, filter, 3) * sizeof(int16_t);
+            break;
+        }
+        case tflite::BuiltinOperator_DEPTHWISE_CONV_2D: {
+            if (conv1d_handles(subgraph, op, code)) {
+                break;
+            }
+            // Filter is [1, kh, kw, out_c]
+            int32_t filter = op->inputs()->Get(1);
+            bytes = tensor_dim(subgraph, input, 3) * tensor_dim(subgraph, filter, 1) * tensor_dim(subgraph, filter, 2) * sizeof(int16_t);
+            break;
+        }
+        case tflite::BuiltinOperator_AVERAGE_POOL_2D:
+            bytes = tensor_dim(subgraph, input, 3) * sizeof(int32_t);
+            break;
+        default:
+            break;
+        }
+        maxBytes = bytes > maxBytes ? bytes : maxBytes;
+    }
+    return maxBytes;
+}
+
+static size_t
+align_up(size_t size, size_t align) {
+    return (size + align - 1) & ~(align - 1);
+}
+
+static int
+size_arena(const model_entry_t *entry, const tflite::MicroOpResolver &resolver, tflite::ErrorReporter *reporter, arena_usage_t *usage) {
+    /**
+     * @brief Allocate and invoke model once in a large arena and record its usage
+     * @param entry Model
+     * @param resolver Op resolver
+     * @param reporter Error reporter
+     * @param usage Output usage
+     * @return 0 on success
+     */
+    // Model arrays in the generated headers are not aligned
+    std::vector<uint64_t> modelBuf((entry->len + sizeof(uint64_t) - 1) / sizeof(uint64_t));
+    memcpy(modelBuf.data(), entry->buf, entry->len);
+    const tflite::Model *model = tflite::GetModel(modelBuf.data());
+    if (model->version() != TFLITE_SCHEMA_VERSION) {
+        fprintf(stderr, "%s: schema mismatch: given=%u != expected=%d\n", entry->name, model->version(), TFLITE_SCHEMA_VERSION);
+        return 1;
+    }
+    std::vector<uint8_t> arena(ARENA_MAX_SIZE + ARENA_ALIGN);
+    uint8_t *arenaStart = (uint8_t *)align_up((uintptr_t)arena.data(), ARENA_ALIGN);
+
+    ScratchRecordingOpResolver::Reset();
+    tflite::RecordingMicroInterpreter interpreter(model, resolver, arenaStart, ARENA_MAX_SIZE, reporter);
+    if (interpreter.AllocateTensors() != kTfLiteOk) {
+        fprintf(stderr, "%s: AllocateTensors() failed\n", entry->name);
+        return 1;
+    }
+    memset(interpreter.input(0)->data.raw, 0, interpreter.input(0)->bytes);
+    if (interpreter.Invoke() != kTfLiteOk) {
+        fprintf(stderr, "%s: Invoke() failed\n", entry->name);
+        return 1;
+    }
+    auto allocator = interpreter.GetMicroAllocator().GetSimpleMemoryAllocator();
+    tflite::RecordedAllocation evalTensors =
+        interpreter.GetMicroAllocator().GetRecordedAllocation(tflite::RecordedAllocationType::kTfLiteEvalTensorData);
+    tflite::RecordedAllocation nodes =
+        interpreter.GetMicroAllocator().GetRecordedAllocation(tflite::RecordedAllocationType::kNodeAndRegistrationArray);
+    usage->persistent = allocator->GetPersistentUsedBytes();
+    usage->persistent -= evalTensors.count * (sizeof(TfLiteEvalTensor) - TARGET_EVAL_TENSOR_SIZE);
+    usage->persistent -= nodes.count * (sizeof(tflite::NodeAndRegistration) - TARGET_NODE_AND_REGISTRATION_SIZE);
+    usage->nonPersistent = allocator->GetNonPersistentUsedBytes();
+    usage->scratch = ScratchRecordingOpResolver::MaxOpScratch();
+    size_t cmsisScratch = cmsis_nn_scratch(model);
+    usage->targetScratch = cmsisScratch > usage->scratch ? cmsisScratch - usage->scratch : 0;
+    // MicroAllocator aligns the arena start, so reserve one alignment unit on top
+    usage->arenaSize = align_up(usage->persistent + usage->nonPersistent + usage->targetScratch + ARENA_ALIGN + HK_ARENA_HEADROOM, ARENA_ALIGN);
+    return 0;
+}
+
+int
+main(int argc, char **argv) {
+    /**
+     * @brief Print generated header to stdout. Optional argv[1] is the total arena budget in bytes.
+     */
+    static tflite::MicroErrorReporter microErrorReporter;
+    static tflite::AllOpsResolver allOpsResolver;
+    add_custom_ops(allOpsResolver);
+#ifdef HK_CONV1D_ENABLE
+    static Conv1dOpResolver conv1dResolver(allOpsResolver);
+    ScratchRecordingOpResolver resolver(conv1dResolver);
+#else
+    ScratchRecordingOpResolver resolver(allOpsResolver);
+#endif
+    const uint32_t numModels = sizeof(models) / sizeof(models[0]);
+    arena_usage_t usage[numModels];
+    size_t total = 0;
+    size_t budget = argc > 1 ? strtoul(argv[1], nullptr, 0) : 0;
+
+    for (uint32_t i = 0; i < numModels; i++) {
+        if (size_arena(&models[i], resolver, &microErrorReporter, &usage[i])) {
+            return 1;
+        }
+        total += usage[i].arenaSize;
+        fprintf(stderr, "%-11s persistent=%6zu nonpersistent=%6zu scratch=%5zu target-scratch=%5zu arena=%6zu\n", models[i].name,
+                usage[i].persistent, usage[i].nonPersistent, usage[i].scratch, usage[i].targetScratch, usage[i].arenaSize);
+    }
+
+    // Streamed segmentation
+    std::vector<uint64_t> segModel((g_segmentation_model_len + sizeof(uint64_t) - 1) / sizeof(uint64_t));
+    memcpy(segModel.data(), g_segmentation_model, g_segmentation_model_len);
+    std::vector<uint8_t> streamArena(ARENA_MAX_SIZE);
+    static StreamModel streamModel;
+    if (streamModel.Init(tflite::GetModel(segModel.data()), streamArena.data(), streamArena.size(), HK_SEG_STREAM_STEP, HK_DATA_LEN) !=
+        kTfLiteOk) {
+        fprintf(stderr, "SEG: streaming plan failed\n");
+        return 1;
+    }
+    const size_t streamArenaSize = (streamModel.ArenaUsed() + ARENA_ALIGN - 1) & ~(size_t)(ARENA_ALIGN - 1);
+    fprintf(stderr, "SEG-STREAM step=%d latency=%d arena=%6zu\n", HK_SEG_STREAM_STEP, (int)streamModel.Latency(), streamArenaSize);
+#ifdef HK_MULTIHEAD_ENABLE
+    for (uint32_t i = 0; i < NUM_STANDALONE_MODELS; i++) {
+        total -= usage[i].arenaSize;
+    }
+#elif defined(HK_SEG_STREAM_ENABLE)
+    total = total - usage[1].arenaSize + streamArenaSize;
+#endif
+#if defined(HK_ARR_EXIT_ENABLE) && !defined(HK_MULTIHEAD_ENABLE)
+    total -= usage[0].arenaSize;
+#endif
+    fprintf(stderr, "total=%zu budget=%zu\n", total, budget);
+    if (budget && total > budget) {
+        fprintf(stderr, "Models need %zu bytes of arena, over budget of %zu bytes\n", total, budget);
+        return 1;
+    }
+
+    printf("/**\n"
+           " * @file model_arena.h\n"
+           " * @brief Tensor arena sizes. GENERATED by host/arena_sizer.cc (make -C host arena), do not edit.\n"
+           " *\n"
+           " * Sizes are persistent (rescaled to 32-bit) + non-persistent usage recorded on host, plus CMSIS-NN scratch,\n"
+           " * aligned to %d bytes with %d bytes headroom.\n"
+           " */\n"
+           "#ifndef __MODEL_ARENA_H\n"
+           "#define __MODEL_ARENA_H\n\n",
+           ARENA_ALIGN, HK_ARENA_HEADROOM);
+    for (uint32_t i = 0; i < numModels; i++) {
+        printf("// persistent=%zu nonpersistent=%zu scratch=%zu target-scratch=%zu\n", usage[i].persistent, usage[i].nonPersistent,
+               usage[i].scratch, usage[i].targetScratch);
+        printf("#define HK_%s_ARENA_SIZE (%zu)\n", models[i].name, usage[i].arenaSize);
+        printf("#define HK_%s_MODEL_LEN (%u)\n\n", models[i].name, models[i].len);
+    }
+    printf("// step=%d latency=%d\n", HK_SEG_STREAM_STEP, (int)streamModel.Latency());
+    printf("#define HK_SEG_STREAM_ARENA_SIZE (%zu)\n\n", streamArenaSize);
+    printf("#endif // __MODEL_ARENA_H\n");
+    return 0;
+}
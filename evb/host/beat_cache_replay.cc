@@ -0,0 +1,137 @@
+/**
+ * @file beat_cache_replay.cc
+ * @author Adam Page (adam.page@ambiq.com)
+ * @brief Host replay of the beat cache over overlapping windows: hit rate and beat invokes saved
+ * @version 1.0
+ * @date 2023-05-02
+ *
+ * @copyright Copyright (c) 2023
+ *
+ * Slides windows of HK_DATA_LEN samples over an hour of synthetic beats (sinus rhythm, PVC
+ * bigeminy and AFIB) at several values of HK_WINDOW_STEP and runs the beat head's loop from
+ * heartkit.cc with ../src/beat_cache.cc in front of a stand-in beat model. Peaks move by up to a
+ * sample between windows, as each window is segmented on its own, and the stand-in model is unsure
+ * (margin under HK_BEAT_CACHE_MARGIN) of a share of the beats, which the cache has to send back to
+ * the model. Every label the head reports must be the one the model would give the beat, the
+ * back-to-back step must never hit, and each step reports the hit rate and the model invokes saved
+ * against running every beat of every window. The default HK_WINDOW_STEP, which turns the cache on
+ * for the EVB, is marked and has to save invokes.
+ *
+ * Build: make -C evb/host beat_cache
+ */
+#include <cstdint>
+#include <cstdio>
+#include <random>
+#include <vector>
+
+#include "beat_cache.h"
+#include "constants.h"
+#include "heartkit.h"
+
+#define REPLAY_SEC (3600)
+// Share of beats the stand-in model is unsure of
+#define UNSURE_RATE (0.1)
+
+typedef struct {
+    uint32_t peak;
+    uint32_t label;
+    float32_t margin;
+} beat_t;
+
+static std::vector<beat_t>
+synthesize(std::mt19937 &rng) {
+    /**
+     * @brief Beats of REPLAY_SEC seconds, changing rhythm every few minutes
+     */
+    std::normal_distribution<float> noise(0.0f, 1.0f);
+    std::uniform_real_distribution<float> unit(0.0f, 1.0f);
+    std::vector<beat_t> beats;
+    float t = 1.0f;
+    uint32_t n = 0;
+    while (t < REPLAY_SEC) {
+        const uint32_t episode = ((uint32_t)t / 300) % 4;
+        const float rr = 60.0f / (episode == 3 ? 100.0f : 65.0f);
+        uint32_t label = HeartBeatNormal;
+        if (episode == 1) {
+            label = n % 2 ? HeartBeatPvc : HeartBeatNormal;
+            t += rr * (n % 2 ? 1.4f : 0.6f);
+        } else if (episode == 3) {
+            t += rr * (1.0f + 0.25f * noise(rng));
+        } else {
+            t += rr * (1.0f + 0.02f * noise(rng));
+        }
+        beats.push_back({(uint32_t)(t * SAMPLE_RATE), label, unit(rng) < UNSURE_RATE ? 0.3f : 0.9f});
+        n++;
+    }
+    return beats;
+}
+
+int
+main(void) {
+    std::mt19937 rng(0x4b48);
+    const std::vector<beat_t> beats = synthesize(rng);
+    std::uniform_int_distribution<int> jitter(-1, 1);
+    const uint32_t steps[] = {HK_DATA_LEN, 3 * HK_DATA_LEN / 4, HK_DATA_LEN / 2, HK_DATA_LEN / 4};
+    const uint32_t total = beats.back().peak;
+    int failures = 0;
+    printf("%zu beats in %d s, %d sample windows\n", beats.size(), REPLAY_SEC, HK_DATA_LEN);
+    for (uint32_t step : steps) {
+        hk_beat_cache_reset();
+        uint32_t invokes = 0, wrong = 0;
+        std::vector<bool> seen(beats.size(), false);
+        size_t first = 0;
+        for (uint32_t start = 0; start + HK_DATA_LEN <= total; start += step) {
+            // Peaks of the window, as segmentation of the window finds them
+            while (beats[first].peak < start) {
+                first++;
+            }
+            std::vector<int32_t> peaks;
+            std::vector<size_t> ids;
+            for (size_t b = first; b < beats.size() && beats[b].peak < start + HK_DATA_LEN; b++) {
+                const int32_t peak = (int32_t)(beats[b].peak - start) + jitter(rng);
+                if (peak >= 0 && peak < HK_DATA_LEN) {
+                    peaks.push_back(peak);
+                    ids.push_back(b);
+                }
+            }
+            if (peaks.size() < 3) {
+                continue;
+            }
+            const uint32_t avgRR = (peaks.back() - peaks.front()) / (peaks.size() - 1);
+            // As beat_head_run() and beat_classify() in heartkit.cc
+            const uint32_t bOffset = HK_BEAT_LEN >> 1;
+            for (size_t i = 1; i + 1 < peaks.size(); i++) {
+                const uint32_t bIdx = peaks[i];
+                const uint32_t bStart = bIdx - bOffset;
+                if (bIdx < bOffset || bStart < avgRR || bStart + avgRR + HK_BEAT_LEN > HK_DATA_LEN) {
+                    continue;
+                }
+                const beat_t &truth = beats[ids[i]];
+                hk_beat_entry_t beat = {start + bIdx, bIdx - peaks[i - 1], peaks[i + 1] - bIdx, avgRR, 0, 0, false};
+                int32_t label = hk_beat_cache_lookup(&beat);
+                if (label == -1) {
+                    label = truth.label;
+                    beat.margin = truth.margin;
+                    beat.label = label;
+                    hk_beat_cache_store(&beat);
+                    invokes++;
+                }
+                wrong += (uint32_t)label != truth.label;
+                seen[ids[i]] = true;
+            }
+        }
+        uint32_t lookups, hits, unique = 0;
+        hk_beat_cache_stats(&lookups, &hits);
+        for (bool s : seen) {
+            unique += s;
+        }
+        printf("step=%5u overlap=%3u%% invokes=%6u of %6u beats (%4.1f%% saved by hits) classified=%5.1f%% of beats%s%s\n", step,
+               100 * (HK_DATA_LEN - step) / HK_DATA_LEN, invokes, lookups, 100.0 * hits / lookups, 100.0 * unique / beats.size(),
+               step == HK_WINDOW_STEP ? " (default)" : "", wrong ? " WRONG LABELS" : "");
+        failures += wrong > 0 || invokes + hits != lookups || invokes < unique || (step == HK_DATA_LEN && hits > 0);
+#ifdef HK_BEAT_CACHE_ENABLE
+        failures += step == HK_WINDOW_STEP && hits == 0;
+#endif
+    }
+    return failures ? 1 : 0;
+}
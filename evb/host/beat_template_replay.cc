@@ -0,0 +1,140 @@
+/**
+ * @file beat_template_replay.cc
+ * @author Adam Page (adam.page@ambiq.com)
+ * @brief Host replay of the beat template screen: beats screened out against PAC/PVC recall
+ * @version 1.0
+ * @date 2023-05-02
+ *
+ * @copyright Copyright (c) 2023
+ *
+ * Synthesizes an hour of ECG with synthetic_ecg.cc: sinus beats, isolated PACs and PVCs, and a
+ * minute of bigeminy every ten. Windows are standardized as hk_preprocess() does, and the beat
+ * head's loop from heartkit.cc screens each beat with ../src/beat_template.cc before a stand-in beat model that
+ * returns the true label. Model-alone recall is then 100%, so any PAC or PVC the screen passes as
+ * normal shows up as lost recall. Sweeping the similarity threshold gives the share of beats that
+ * skip the model against the recall it costs.
+ *
+ * CMSIS-DSP is a prebuilt library for the EVB only, so the few arm_*_f32 functions the template uses
+ * are defined here with their reference behaviour.
+ *
+ * Build: make -C evb/host beat_template
+ */
+#include <cmath>
+#include <cstdint>
+#include <cstdio>
+#include <random>
+#include <vector>
+
+#include "beat_template.h"
+#include "constants.h"
+#include "heartkit.h"
+#include "synthetic_ecg.h"
+
+#define REPLAY_SEC (3600)
+#define PEAK_JITTER (2)
+
+void
+arm_mean_f32(const float32_t *pSrc, uint32_t blockSize, float32_t *pResult) {
+    float32_t sum = 0;
+    for (uint32_t i = 0; i < blockSize; i++) {
+        sum += pSrc[i];
+    }
+    *pResult = sum / blockSize;
+}
+
+void
+arm_offset_f32(const float32_t *pSrc, float32_t offset, float32_t *pDst, uint32_t blockSize) {
+    for (uint32_t i = 0; i < blockSize; i++) {
+        pDst[i] = pSrc[i] + offset;
+    }
+}
+
+void
+arm_scale_f32(const float32_t *pSrc, float32_t scale, float32_t *pDst, uint32_t blockSize) {
+    for (uint32_t i = 0; i < blockSize; i++) {
+        pDst[i] = pSrc[i] * scale;
+    }
+}
+
+void
+arm_add_f32(const float32_t *pSrcA, const float32_t *pSrcB, float32_t *pDst, uint32_t blockSize) {
+    for (uint32_t i = 0; i < blockSize; i++) {
+        pDst[i] = pSrcA[i] + pSrcB[i];
+    }
+}
+
+void
+arm_dot_prod_f32(const float32_t *pSrcA, const float32_t *pSrcB, uint32_t blockSize, float32_t *result) {
+    float32_t sum = 0;
+    for (uint32_t i = 0; i < blockSize; i++) {
+        sum += pSrcA[i] * pSrcB[i];
+    }
+    *result = sum;
+}
+
+int
+main(void) {
+    std::mt19937 rng(0x4b48);
+    std::vector<ecg_beat_t> beats;
+    const std::vector<float> ecg = synthesize_ecg(rng, {REPLAY_SEC, 0.04f, 0.04f, true, false, 0.0f}, beats);
+    std::uniform_int_distribution<int> jitter(-PEAK_JITTER, PEAK_JITTER);
+    const float thresholds[] = {0.8f, 0.85f, HK_TEMPLATE_SIMILARITY, 0.95f, 0.98f};
+    std::vector<float> data(HK_DATA_LEN);
+    int failures = 0;
+    printf("%zu beats in %d s\n", beats.size(), REPLAY_SEC);
+    for (float threshold : thresholds) {
+        hk_template_reset();
+        uint32_t total[3] = {0}, found[3] = {0}, skipped[3] = {0};
+        size_t first = 0;
+        for (uint32_t start = 0; start + HK_DATA_LEN <= ecg.size(); start += HK_DATA_LEN) {
+            ecg_standardize(&ecg[start], data.data(), HK_DATA_LEN);
+            std::vector<int32_t> peaks;
+            std::vector<size_t> ids;
+            while (first < beats.size() && beats[first].peak < start) {
+                first++;
+            }
+            for (size_t b = first; b < beats.size() && beats[b].peak < start + HK_DATA_LEN; b++) {
+                const int32_t peak = (int32_t)(beats[b].peak - start) + jitter(rng);
+                if (peak >= 0 && peak < HK_DATA_LEN) {
+                    peaks.push_back(peak);
+                    ids.push_back(b);
+                }
+            }
+            if (peaks.size() < 3) {
+                continue;
+            }
+            const uint32_t avgRR = (peaks.back() - peaks.front()) / (peaks.size() - 1);
+            // As beat_head_run() and beat_classify() in heartkit.cc
+            const uint32_t bOffset = HK_BEAT_LEN >> 1;
+            uint32_t label = HeartBeatNormal;
+            for (size_t i = 1; i + 1 < peaks.size(); i++) {
+                const uint32_t bIdx = peaks[i];
+                const uint32_t bStart = bIdx - bOffset;
+                if (bIdx < bOffset || bStart < avgRR || bStart + avgRR + HK_BEAT_LEN > HK_DATA_LEN) {
+                    continue;
+                }
+                const uint32_t truth = beats[ids[i]].label;
+                const uint32_t prevRR = peaks[i] - peaks[i - 1];
+                if (hk_template_screen(&data[bStart], prevRR, avgRR, label == HeartBeatNormal, threshold)) {
+                    label = HeartBeatNormal;
+                    skipped[truth]++;
+                } else {
+                    label = truth;
+                }
+                if (label == HeartBeatNormal) {
+                    hk_template_update(&data[bStart], prevRR, avgRR);
+                }
+                total[truth]++;
+                found[truth] += label == truth;
+            }
+        }
+        uint32_t screened, normal;
+        hk_template_stats(&screened, &normal);
+        printf("similarity>=%4.2f screened out=%5.1f%% of %u beats (%5.1f%% of normal beats) | PAC recall %5.1f%% PVC recall %5.1f%%\n",
+               threshold, 100.0 * normal / screened, screened, 100.0 * skipped[HeartBeatNormal] / total[HeartBeatNormal],
+               100.0 * found[HeartBeatPac] / total[HeartBeatPac], 100.0 * found[HeartBeatPvc] / total[HeartBeatPvc]);
+        // At the default threshold the screen has to keep every PVC and PAC of this recording
+        failures += threshold == HK_TEMPLATE_SIMILARITY && (found[HeartBeatPac] < total[HeartBeatPac] || found[HeartBeatPvc] < total[HeartBeatPvc]);
+    }
+    return failures ? 1 : 0;
+}
@@ -0,0 +1,173 @@
+/**
+ * @file cascade_bench.cc
+ * @author Adam Page (adam.page@ambiq.com)
+ * @brief Host check and benchmark of CascadeModel on the arrhythmia model
+ * @version 1.0
+ * @date 2023-05-02
+ *
+ * @copyright Copyright (c) 2023
+ *
+ * There is no trained small model in the tree, so the arrhythmia model stands in for both levels,
+ * each with its own interpreter and arena as on the EVB. Every cascade decision then has to match a
+ * separate reference run of the model, whichever level took it, and the level counters have to add
+ * up to the samples and escalations seen. Sweeping the margin shows the escalation rate on random
+ * blocks and the average cost it implies for a small model of SMALL_COST relative cost.
+ * cascade_margin() is checked against a float softmax.
+ *
+ * Build: make -C evb/host cascade
+ */
+#include <chrono>
+#include <cmath>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <random>
+#include <vector>
+
+#include "tensorflow/lite/micro/all_ops_resolver.h"
+#include "tensorflow/lite/micro/micro_error_reporter.h"
+#include "tensorflow/lite/micro/micro_interpreter.h"
+#include "tensorflow/lite/schema/schema_generated.h"
+
+#include "arrhythmia_model_buffer.h"
+
+#include "cascade_model.h"
+#include "conv1d_kernels.h"
+#include "custom_ops.h"
+
+#define ARENA_SIZE (256 * 1024)
+#define BENCH_INPUTS (64)
+#define MARGIN_CASES (200)
+// Assumed cost of the small model relative to the large one, for the average cost column
+#define SMALL_COST (0.2)
+
+static void
+block_fill(TfLiteTensor *input, const void *ctx) {
+    memcpy(input->data.int8, ctx, input->bytes);
+}
+
+static int
+check_margin(std::mt19937 &rng) {
+    /**
+     * @brief Compare cascade_margin with a float softmax of random int8 logits
+     * @return Cases off by more than 1e-4 or with the wrong label
+     */
+    std::uniform_int_distribution<int> values(-128, 127);
+    std::uniform_int_distribution<int> classCounts(2, 8);
+    std::uniform_real_distribution<float> scales(-6.0f, -1.0f);
+    int failures = 0;
+    float maxDiff = 0;
+    for (int i = 0; i < MARGIN_CASES; i++) {
+        const int classes = classCounts(rng);
+        int dims[3] = {2, 1, classes};
+        int8_t data[8];
+        TfLiteTensor logits = {};
+        logits.type = kTfLiteInt8;
+        logits.dims = (TfLiteIntArray *)dims;
+        logits.data.int8 = data;
+        logits.params.scale = std::exp(scales(rng));
+        logits.params.zero_point = values(rng);
+        for (int c = 0; c < classes; c++) {
+            data[c] = (int8_t)values(rng);
+        }
+        std::vector<double> p(classes);
+        double sum = 0;
+        for (int c = 0; c < classes; c++) {
+            p[c] = std::exp((data[c] - logits.params.zero_point) * (double)logits.params.scale);
+            sum += p[c];
+        }
+        int32_t refLabel = 0;
+        for (int c = 0; c < classes; c++) {
+            refLabel = data[c] > data[refLabel] ? c : refLabel;
+        }
+        double next = 0;
+        for (int c = 0; c < classes; c++) {
+            next = c != refLabel && p[c] > next ? p[c] : next;
+        }
+        int32_t label;
+        const float diff = std::fabs(cascade_margin(&logits, &label) - (float)((p[refLabel] - next) / sum));
+        maxDiff = diff > maxDiff ? diff : maxDiff;
+        failures += diff > 1e-4f || label != refLabel;
+    }
+    printf("margin cases=%d max |dm|=%.2e\n", MARGIN_CASES, maxDiff);
+    return failures;
+}
+
+int
+main(void) {
+    static tflite::MicroErrorReporter microErrorReporter;
+    static tflite::AllOpsResolver allOpsResolver;
+    add_custom_ops(allOpsResolver);
+    static Conv1dOpResolver conv1dResolver(allOpsResolver);
+    std::mt19937 rng(0x4b48);
+    std::uniform_int_distribution<int> dist(-128, 127);
+    int failures = 0;
+
+    // Model arrays in the generated headers are not aligned
+    std::vector<uint64_t> modelBuf((g_arrhythmia_model_len + sizeof(uint64_t) - 1) / sizeof(uint64_t));
+    memcpy(modelBuf.data(), g_arrhythmia_model, g_arrhythmia_model_len);
+    const tflite::Model *model = tflite::GetModel(modelBuf.data());
+    std::vector<uint64_t> refArena(ARENA_SIZE / sizeof(uint64_t));
+    std::vector<uint64_t> smallArena(ARENA_SIZE / sizeof(uint64_t));
+    std::vector<uint64_t> largeArena(ARENA_SIZE / sizeof(uint64_t));
+    tflite::MicroInterpreter ref(model, conv1dResolver, (uint8_t *)refArena.data(), ARENA_SIZE, &microErrorReporter);
+    tflite::MicroInterpreter small(model, conv1dResolver, (uint8_t *)smallArena.data(), ARENA_SIZE, &microErrorReporter);
+    tflite::MicroInterpreter large(model, conv1dResolver, (uint8_t *)largeArena.data(), ARENA_SIZE, &microErrorReporter);
+    if (ref.AllocateTensors() != kTfLiteOk || small.AllocateTensors() != kTfLiteOk || large.AllocateTensors() != kTfLiteOk) {
+        fprintf(stderr, "ARR: init failed\n");
+        return 1;
+    }
+
+    // Reference outputs and margins of random blocks
+    TfLiteTensor *in = ref.input(0);
+    TfLiteTensor *out = ref.output(0);
+    const int32_t classes = out->dims->data[1];
+    std::vector<std::vector<int8_t>> blocks(BENCH_INPUTS, std::vector<int8_t>(in->bytes));
+    std::vector<float> margins(BENCH_INPUTS);
+    std::vector<int32_t> labels(BENCH_INPUTS);
+    std::vector<std::vector<float>> outputs(BENCH_INPUTS, std::vector<float>(classes));
+    auto start = std::chrono::steady_clock::now();
+    for (int i = 0; i < BENCH_INPUTS; i++) {
+        for (int8_t &x : blocks[i]) {
+            x = (int8_t)dist(rng);
+        }
+        memcpy(in->data.int8, blocks[i].data(), in->bytes);
+        ref.Invoke();
+        margins[i] = cascade_margin(out, &labels[i]);
+        for (int32_t c = 0; c < classes; c++) {
+            outputs[i][c] = ((float)out->data.int8[c] - out->params.zero_point) * out->params.scale;
+        }
+    }
+    auto end = std::chrono::steady_clock::now();
+    const double modelUs = std::chrono::duration<double, std::micro>(end - start).count() / BENCH_INPUTS;
+    printf("ARR model=%8.1f us\n", modelUs);
+
+    // Every decision is the model's, and the counters add up
+    static CascadeModel cascade;
+    const float sweep[] = {0.0f, 0.25f, 0.5f, 0.75f, 0.9f, 1.01f};
+    std::vector<float> y(classes);
+    for (float margin : sweep) {
+        if (cascade.Init(&small, &large, margin) != kTfLiteOk) {
+            fprintf(stderr, "ARR: cascade init failed\n");
+            return 1;
+        }
+        int mismatches = 0;
+        uint32_t escalated = 0;
+        for (int i = 0; i < BENCH_INPUTS; i++) {
+            int32_t level = -1;
+            const int32_t label = cascade.Invoke(block_fill, blocks[i].data(), y.data(), &level);
+            mismatches += label != labels[i] || level != (margins[i] < margin ? 1 : 0);
+            for (int32_t c = 0; c < classes; c++) {
+                mismatches += y[c] != outputs[i][c];
+            }
+            escalated += level == 1;
+        }
+        mismatches += cascade.Level(0)->invokes != BENCH_INPUTS || cascade.Level(1)->invokes != escalated;
+        const double rate = (double)escalated / BENCH_INPUTS;
+        printf("margin=%4.2f escalated=%5.1f%% cost=%3.0f%% of the large model (small at %.0f%%) outputs=%s\n", margin, 100.0 * rate,
+               100.0 * (SMALL_COST + rate), 100.0 * SMALL_COST, mismatches ? "MISMATCH" : "identical");
+        failures += mismatches;
+    }
+    failures += check_margin(rng);
+    return failures ? 1 : 0;
+}
@@ -0,0 +1,220 @@
+/**
+ * @file coarse_bench.cc
+ * @author Adam Page (adam.page@ambiq.com)
+ * @brief Host check and benchmark of coarse-to-fine segmentation against dense segmentation
+ * @version 1.0
+ * @date 2023-05-02
+ *
+ * @copyright Copyright (c) 2023
+ *
+ * First checks the decimator of ../src/coarse_segmentation.cc: a slow sine has to come out of it on
+ * every HK_SEG_COARSE_FACTOR-th input sample. Then synthesizes five minutes of ECG with PACs and PVCs
+ * (synthetic_ecg.cc) at several mean heart rates, standardizes back to back HK_DATA_LEN windows as
+ * hk_preprocess() does, and segments each window densely, streaming the whole window as
+ * segmentation_stream() does, and coarse to fine as the segmentation head does with
+ * HK_SEG_COARSE_ENABLE, at several contexts and with all waves or QRS only refined.
+ *
+ * No coarse model is trained yet, so a stand-in takes its place. Its labels are those of the
+ * full-rate model on the decimated window interpolated back to the full rate, taken at every coarse
+ * sample: labels limited to what the decimated signal holds, at the coarse resolution. Its cost is
+ * the full-rate model streamed over the HK_SEG_COARSE_FRAME decimated samples, an upper bound for a
+ * smaller model over the same samples. For each setting the bench reports the share of samples the
+ * full-rate model refines, host time against dense (decimator and coarse stand-in included), and
+ * the P, QRS and T boundaries (onsets and offsets) missed or moved, within 40 ms, against dense
+ * segmentation and against the synthesized waves, as does the upsampled coarse mask alone. At the
+ * default setting the refined mask has to find the true QRS boundaries dense segmentation finds.
+ * Host timings only show the ratio, target cycles come from the SEGMENTATION stage counters.
+ *
+ * CMSIS-DSP is a prebuilt library for the EVB only, so the decimator functions are defined here with
+ * their reference behaviour.
+ *
+ * Build: make -C evb/host coarse
+ */
+#include <chrono>
+#include <cmath>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <random>
+#include <vector>
+
+#include "tensorflow/lite/schema/schema_generated.h"
+
+#include "segmentation_model_buffer.h"
+
+#include "coarse_segmentation.h"
+
+#include "constants.h"
+#include "heartkit.h"
+#include "model_arena.h"
+#include "segment_eval.h"
+#include "stream_model.h"
+#include "synthetic_ecg.h"
+
+#define REPLAY_SEC (300)
+#define BOUNDARY_TOL (40 * SAMPLE_RATE / 1000)
+#define SINE_HZ (5.0f)
+#define SINE_TOL (0.01f)
+
+static const float rates[] = {45.0f, 65.0f, 90.0f};
+static const uint32_t contexts[] = {8, HK_SEG_COARSE_CONTEXT, 32, 64};
+static const uint32_t refines[] = {1 << HeartSegmentQrs, (1 << HeartSegmentPWave) | (1 << HeartSegmentQrs) | (1 << HeartSegmentTWave)};
+
+arm_status
+arm_fir_decimate_init_f32(arm_fir_decimate_instance_f32 *S, uint16_t numTaps, uint8_t M, const float32_t *pCoeffs, float32_t *pState,
+                          uint32_t blockSize) {
+    if (blockSize % M != 0) {
+        return ARM_MATH_LENGTH_ERROR;
+    }
+    S->numTaps = numTaps;
+    S->pCoeffs = pCoeffs;
+    S->M = M;
+    S->pState = pState;
+    memset(pState, 0, (numTaps + blockSize - 1) * sizeof(float32_t));
+    return ARM_MATH_SUCCESS;
+}
+
+void
+arm_fir_decimate_f32(const arm_fir_decimate_instance_f32 *S, const float32_t *pSrc, float32_t *pDst, uint32_t blockSize) {
+    // The state holds the last numTaps - 1 inputs, and output n ends on input n * M
+    float32_t *state = S->pState;
+    memcpy(&state[S->numTaps - 1], pSrc, blockSize * sizeof(float32_t));
+    for (uint32_t n = 0; n < blockSize / S->M; n++) {
+        float32_t acc = 0;
+        for (uint32_t k = 0; k < S->numTaps; k++) {
+            acc += state[n * S->M + k] * S->pCoeffs[k];
+        }
+        pDst[n] = acc;
+    }
+    memmove(state, &state[blockSize], (S->numTaps - 1) * sizeof(float32_t));
+}
+
+static int
+check_decimator(void) {
+    /**
+     * @brief A slow sine has to keep its samples through the decimator, away from the window edges
+     */
+    std::vector<float> x(HK_DATA_LEN), y(HK_SEG_COARSE_LEN);
+    for (uint32_t i = 0; i < HK_DATA_LEN; i++) {
+        x[i] = sinf(2.0f * PI * SINE_HZ * i / SAMPLE_RATE);
+    }
+    hk_coarse_decimate(x.data(), HK_DATA_LEN, y.data());
+    float err = 0;
+    for (uint32_t k = HK_SEG_COARSE_TAPS; k < HK_SEG_COARSE_LEN - HK_SEG_COARSE_TAPS; k++) {
+        err = MAX(err, fabsf(y[k] - x[k * HK_SEG_COARSE_FACTOR]));
+    }
+    printf("Decimator x%d, %d taps: %.0f Hz sine max error %.4f\n", HK_SEG_COARSE_FACTOR, HK_SEG_COARSE_TAPS, SINE_HZ, err);
+    return err > SINE_TOL;
+}
+
+const char *HK_SEGMENT_LABELS[] = {"NONE", "P-WAVE", "QRS", "T-WAVE"};
+
+int
+main(void) {
+    std::vector<uint64_t> modelBuf((g_segmentation_model_len + sizeof(uint64_t) - 1) / sizeof(uint64_t));
+    memcpy(modelBuf.data(), g_segmentation_model, g_segmentation_model_len);
+    const tflite::Model *model = tflite::GetModel(modelBuf.data());
+    std::vector<uint8_t> streamArena(HK_SEG_STREAM_ARENA_SIZE);
+    static StreamModel stream;
+    if (stream.Init(model, streamArena.data(), streamArena.size(), HK_SEG_STREAM_STEP, HK_DATA_LEN) != kTfLiteOk) {
+        fprintf(stderr, "SEG: init failed\n");
+        return 1;
+    }
+    if (hk_coarse_init()) {
+        fprintf(stderr, "Decimator: init failed\n");
+        return 1;
+    }
+    int failures = check_decimator();
+    printf("SEG   stream align=%d latency=%d samples, coarse frame=%d band=%d samples\n", (int)stream.Align(), (int)stream.Latency(),
+           HK_SEG_COARSE_FRAME, HK_SEG_COARSE_BAND);
+    const size_t numCtx = sizeof(contexts) / sizeof(contexts[0]);
+    const size_t numRefines = sizeof(refines) / sizeof(refines[0]);
+    std::vector<float> data(HK_DATA_LEN), coarse(HK_SEG_COARSE_LEN), interp(HK_DATA_LEN);
+    std::vector<uint8_t> dense(HK_DATA_LEN), coarseDense(HK_DATA_LEN), coarseMask(HK_SEG_COARSE_LEN), upMask(HK_DATA_LEN),
+        fineMask(HK_DATA_LEN), scratch(HK_DATA_LEN);
+    hk_roi_t rois[HK_DATA_LEN / HK_SEG_COARSE_FACTOR];
+    for (float bpm : rates) {
+        std::mt19937 rng(0x4b48);
+        std::vector<ecg_beat_t> beats;
+        const std::vector<float> ecg = synthesize_ecg(rng, {REPLAY_SEC, 0.04f, 0.04f, false, false, bpm}, beats);
+        const std::vector<uint8_t> truthMask = ecg_segment_mask(beats, ecg.size());
+        std::vector<std::vector<uint64_t>> fed(numRefines, std::vector<uint64_t>(numCtx, 0));
+        std::vector<std::vector<double>> fineUs(numRefines, std::vector<double>(numCtx, 0));
+        std::vector<std::vector<std::vector<boundary_score_t>>> vsDense(
+            numRefines, std::vector<std::vector<boundary_score_t>>(numCtx, std::vector<boundary_score_t>(4))),
+            vsTruth(numRefines, std::vector<std::vector<boundary_score_t>>(numCtx, std::vector<boundary_score_t>(4)));
+        boundary_score_t denseVsTruth[4] = {}, upVsDense[4] = {}, upVsTruth[4] = {};
+        double denseUs = 0, coarseUs = 0;
+        uint64_t samples = 0;
+        for (uint32_t start = 0; start + HK_DATA_LEN <= ecg.size(); start += HK_DATA_LEN) {
+            ecg_standardize(&ecg[start], data.data(), HK_DATA_LEN);
+            memset(dense.data(), HeartSegmentNormal, HK_DATA_LEN);
+            auto t0 = std::chrono::steady_clock::now();
+            failures += stream_segment(&stream, data.data(), HK_DATA_LEN, dense.data()) != 0;
+            auto t1 = std::chrono::steady_clock::now();
+            // Decimator and the coarse model's cost
+            hk_coarse_decimate(data.data(), HK_DATA_LEN, coarse.data());
+            failures += stream_segment(&stream, coarse.data(), HK_SEG_COARSE_FRAME, scratch.data()) != 0;
+            auto t2 = std::chrono::steady_clock::now();
+            denseUs += std::chrono::duration<double, std::micro>(t1 - t0).count();
+            coarseUs += std::chrono::duration<double, std::micro>(t2 - t1).count();
+            samples += HK_DATA_LEN;
+            // Coarse model stand-in: full-rate labels of the decimated signal, at the coarse samples
+            for (uint32_t i = 0; i < HK_DATA_LEN; i++) {
+                const uint32_t k = MIN(HK_SEG_COARSE_LEN - 2, i / HK_SEG_COARSE_FACTOR);
+                const float frac = (float)(i - k * HK_SEG_COARSE_FACTOR) / HK_SEG_COARSE_FACTOR;
+                interp[i] = coarse[k] + frac * (coarse[k + 1] - coarse[k]);
+            }
+            memset(coarseDense.data(), HeartSegmentNormal, HK_DATA_LEN);
+            failures += stream_segment(&stream, interp.data(), HK_DATA_LEN, coarseDense.data()) != 0;
+            for (uint32_t k = 0; k < HK_SEG_COARSE_FRAME; k++) {
+                coarseMask[k] = coarseDense[k * HK_SEG_COARSE_FACTOR];
+            }
+            hk_coarse_upsample(coarseMask.data(), HK_SEG_COARSE_FRAME, 0, HK_DATA_LEN, upMask.data());
+
+            const std::vector<boundary_t> denseBounds = mask_boundaries(dense.data(), HK_DATA_LEN);
+            const std::vector<boundary_t> truthBounds = mask_boundaries(&truthMask[start], HK_DATA_LEN);
+            const std::vector<boundary_t> upBounds = mask_boundaries(upMask.data(), HK_DATA_LEN);
+            score_boundaries(truthBounds, denseBounds, BOUNDARY_TOL, denseVsTruth);
+            score_boundaries(denseBounds, upBounds, BOUNDARY_TOL, upVsDense);
+            score_boundaries(truthBounds, upBounds, BOUNDARY_TOL, upVsTruth);
+            for (size_t r = 0; r < numRefines; r++) {
+                for (size_t c = 0; c < numCtx; c++) {
+                    // As segmentation_coarse_run() in heartkit.cc
+                    auto t3 = std::chrono::steady_clock::now();
+                    hk_coarse_upsample(coarseMask.data(), HK_SEG_COARSE_FRAME, 0, HK_DATA_LEN, fineMask.data());
+                    const uint32_t numRois = hk_coarse_plan(coarseMask.data(), HK_SEG_COARSE_FRAME, refines[r], contexts[c], stream.Align(),
+                                                            rois, sizeof(rois) / sizeof(rois[0]));
+                    for (uint32_t i = 0; i < numRois; i++) {
+                        failures += stream_segment(&stream, &data[rois[i].start], rois[i].end - rois[i].start, &fineMask[rois[i].start]) != 0;
+                        hk_coarse_upsample(coarseMask.data(), HK_SEG_COARSE_FRAME, rois[i].start, rois[i].labelStart, fineMask.data());
+                        hk_coarse_upsample(coarseMask.data(), HK_SEG_COARSE_FRAME, rois[i].labelEnd, rois[i].end, fineMask.data());
+                        fed[r][c] += rois[i].end - rois[i].start;
+                    }
+                    fineUs[r][c] += std::chrono::duration<double, std::micro>(std::chrono::steady_clock::now() - t3).count();
+                    const std::vector<boundary_t> fineBounds = mask_boundaries(fineMask.data(), HK_DATA_LEN);
+                    score_boundaries(denseBounds, fineBounds, BOUNDARY_TOL, vsDense[r][c].data());
+                    score_boundaries(truthBounds, fineBounds, BOUNDARY_TOL, vsTruth[r][c].data());
+                }
+            }
+        }
+        printf("bpm=%.0f (%zu beats in %d s), dense: %.1f us/window, coarse: %.1f us/window (%.1f%%)\n", bpm, beats.size(), REPLAY_SEC,
+               denseUs / (samples / HK_DATA_LEN), coarseUs / (samples / HK_DATA_LEN), 100.0 * coarseUs / denseUs);
+        print_scores("dense vs truth", denseVsTruth);
+        print_scores("coarse vs dense", upVsDense);
+        print_scores("coarse vs truth", upVsTruth);
+        for (size_t r = 0; r < numRefines; r++) {
+            for (size_t c = 0; c < numCtx; c++) {
+                printf(" refine=0x%x context=%-3u refined=%5.1f%% time=%5.1f%%\n", refines[r], contexts[c], 100.0 * fed[r][c] / samples,
+                       100.0 * (coarseUs + fineUs[r][c]) / denseUs);
+                print_scores("vs dense", vsDense[r][c].data());
+                print_scores("vs truth", vsTruth[r][c].data());
+                // At the default setting the refined mask has to find the true QRS boundaries dense segmentation finds
+                const boundary_score_t &qrs = vsTruth[r][c][HeartSegmentQrs];
+                failures += refines[r] == HK_SEG_COARSE_REFINE && contexts[c] == HK_SEG_COARSE_CONTEXT &&
+                            qrs.matched + qrs.total / 200 < denseVsTruth[HeartSegmentQrs].matched;
+            }
+        }
+    }
+    return failures ? 1 : 0;
+}
@@ -0,0 +1,165 @@
+/**
+ * @file concat_pass.cc
+ * @author Adam Page (adam.page@ambiq.com)
+ * @brief Model fuser pass that folds channel concatenations into the HK_CONCAT_CONV custom op
+ * @version 1.0
+ * @date 2023-05-02
+ *
+ * @copyright Copyright (c) 2023
+ *
+ * Replaces every unit-height stride 1 TRANSPOSE_CONV with HK_CONCAT_CONV (see
+ * src/concat_conv_kernels.cc). A stride 1 transpose conv with left padding P is a conv with the
+ * filter flipped along width and left padding K - 1 - P, so the filter is flipped. When the input
+ * is a CONCATENATION (last axis, unit height, one quantization) the conv reads the concat inputs
+ * directly, with the flipped filter split into one slice per input; otherwise it has one part.
+ * The concat and the SHAPE -> STRIDED_SLICE -> PACK chain computing the transpose conv output
+ * shape are then dead and removed by model_fuser.cc.
+ */
+#include <cstdint>
+#include <cstring>
+#include <string>
+#include <vector>
+
+#include "tensorflow/lite/kernels/padding.h"
+#include "tensorflow/lite/schema/schema_generated.h"
+
+#include "concat_conv_kernels.h"
+#include "model_fuser.h"
+
+// TRANSPOSE_CONV inputs
+enum { kTransposeConvShape = 0, kTransposeConvFilter, kTransposeConvInput, kTransposeConvBias };
+
+static bool
+match_concat(const tflite::ModelT &model, const tflite::SubGraphT &subgraph, int32_t concatIdx) {
+    /**
+     * @brief Check operator at concatIdx is a CONCATENATION the conv reading it can fold
+     */
+    if (concatIdx < 0 || op_code(model, *subgraph.operators[concatIdx]) != tflite::BuiltinOperator_CONCATENATION) {
+        return false;
+    }
+    const tflite::OperatorT &concat = *subgraph.operators[concatIdx];
+    const tflite::ConcatenationOptionsT *concatOpts = concat.builtin_options.AsConcatenationOptions();
+    const tflite::TensorT &concatOut = *subgraph.tensors[concat.outputs[0]];
+    float scale;
+    int32_t zeroPoint;
+    if (concatOpts == nullptr || (concatOpts->axis != 3 && concatOpts->axis != -1) ||
+        concatOpts->fused_activation_function != tflite::ActivationFunctionType_NONE || concat.inputs.size() > HK_CONCAT_CONV_MAX_PARTS ||
+        !is_1d(concatOut) || !tensor_quant(concatOut, &scale, &zeroPoint)) {
+        return false;
+    }
+    for (int32_t t : concat.inputs) {
+        float partScale;
+        int32_t partZeroPoint;
+        if (!is_1d(*subgraph.tensors[t]) || !tensor_quant(*subgraph.tensors[t], &partScale, &partZeroPoint) || partScale != scale ||
+            partZeroPoint != zeroPoint) {
+            return false;
+        }
+    }
+    return true;
+}
+
+static bool
+match_transpose_conv(const tflite::SubGraphT &subgraph, int32_t convIdx, hk_concat_conv_options_t *opts) {
+    /**
+     * @brief Check TRANSPOSE_CONV at convIdx is a unit-height stride 1 conv
+     */
+    const tflite::OperatorT &conv = *subgraph.operators[convIdx];
+    const tflite::TransposeConvOptionsT *convOpts = conv.builtin_options.AsTransposeConvOptions();
+    if (convOpts == nullptr || conv.inputs.size() != 4 || conv.inputs[kTransposeConvBias] < 0 || convOpts->stride_w != 1 ||
+        convOpts->stride_h != 1) {
+        return false;
+    }
+    const tflite::TensorT &input = *subgraph.tensors[conv.inputs[kTransposeConvInput]];
+    const tflite::TensorT &filter = *subgraph.tensors[conv.inputs[kTransposeConvFilter]];
+    const tflite::TensorT &output = *subgraph.tensors[conv.outputs[0]];
+    float scale;
+    int32_t zeroPoint;
+    if (!is_1d(input) || !tensor_quant(input, &scale, &zeroPoint) || filter.type != tflite::TensorType_INT8 || filter.shape.size() != 4 ||
+        filter.shape[1] != 1 || !filter.quantization || filter.quantization->quantized_dimension != 0 || !is_1d(output) ||
+        output.shape[2] != input.shape[2]) {
+        return false;
+    }
+
+    // Transpose conv padding is computed from its output, as transpose_conv.cc
+    const int32_t kLen = filter.shape[2];
+    int outHeight, outWidth;
+    TfLitePaddingValues padding =
+        tflite::ComputePaddingHeightWidth(1, 1, 1, 1, 1, output.shape[2], 1, kLen,
+                                          convOpts->padding == tflite::Padding_SAME ? kTfLitePaddingSame : kTfLitePaddingValid, &outHeight, &outWidth);
+    if (padding.width > kLen - 1) {
+        return false;
+    }
+    memset(opts, 0, sizeof(hk_concat_conv_options_t));
+    opts->version = HK_CONCAT_CONV_OPTIONS_VERSION;
+    opts->stride = 1;
+    opts->padding = kLen - 1 - padding.width;
+    opts->activation = kTfLiteActNone;
+    return true;
+}
+
+static int32_t
+add_filter_slice(tflite::ModelT &model, int32_t filterIdx, int32_t part, int32_t offset, int32_t channels) {
+    /**
+     * @brief Add the width-flipped slice [offset, offset + channels) of a [Cout, 1, K, Cin] filter
+     * @return Tensor index
+     */
+    const tflite::TensorT &filter = *model.subgraphs[0]->tensors[filterIdx];
+    const std::vector<uint8_t> &data = model.buffers[filter.buffer]->data;
+    const int32_t outCh = filter.shape[0], kLen = filter.shape[2], inCh = filter.shape[3];
+    std::vector<uint8_t> slice(outCh * kLen * channels);
+    for (int32_t o = 0; o < outCh; o++) {
+        for (int32_t k = 0; k < kLen; k++) {
+            memcpy(&slice[(o * kLen + k) * channels], &data[(o * kLen + (kLen - 1 - k)) * inCh + offset], channels);
+        }
+    }
+    std::unique_ptr<tflite::QuantizationParametersT> quantization(new tflite::QuantizationParametersT(*filter.quantization));
+    int32_t t = add_const_tensor(model, filter.name + "/hk_part" + std::to_string(part), tflite::TensorType_INT8, {outCh, 1, kLen, channels},
+                                 slice.data(), slice.size());
+    model.subgraphs[0]->tensors[t]->quantization = std::move(quantization);
+    return t;
+}
+
+size_t
+fuse_concat(tflite::ModelT &model) {
+    /**
+     * @brief Rewrite every matching transpose conv, folding the concat it reads when it can
+     * @return Number of transpose convs rewritten
+     */
+    tflite::SubGraphT &subgraph = *model.subgraphs[0];
+    std::vector<int32_t> producers(subgraph.tensors.size(), -1);
+    for (size_t i = 0; i < subgraph.operators.size(); i++) {
+        for (int32_t t : subgraph.operators[i]->outputs) {
+            producers[t] = i;
+        }
+    }
+    std::vector<std::unique_ptr<tflite::OperatorT>> replaced(subgraph.operators.size());
+    std::vector<bool> removed(subgraph.operators.size(), false);
+    size_t rewritten = 0;
+    int32_t opcode = -1;
+    for (size_t i = 0; i < subgraph.operators.size(); i++) {
+        hk_concat_conv_options_t opts;
+        if (op_code(model, *subgraph.operators[i]) != tflite::BuiltinOperator_TRANSPOSE_CONV || !match_transpose_conv(subgraph, i, &opts)) {
+            continue;
+        }
+        const tflite::OperatorT &conv = *subgraph.operators[i];
+        const int32_t input = conv.inputs[kTransposeConvInput];
+        std::vector<int32_t> parts = {input};
+        if (match_concat(model, subgraph, producers[input])) {
+            parts = subgraph.operators[producers[input]]->inputs;
+        }
+        std::vector<int32_t> inputs;
+        int32_t offset = 0;
+        for (size_t p = 0; p < parts.size(); p++) {
+            const int32_t channels = subgraph.tensors[parts[p]]->shape[3];
+            inputs.push_back(parts[p]);
+            inputs.push_back(add_filter_slice(model, conv.inputs[kTransposeConvFilter], p, offset, channels));
+            offset += channels;
+        }
+        inputs.push_back(conv.inputs[kTransposeConvBias]);
+        opcode = opcode < 0 ? custom_opcode(model, HK_CONCAT_CONV_OP_NAME) : opcode;
+        replaced[i] = custom_op(opcode, inputs, conv.outputs, &opts, sizeof(opts));
+        rewritten++;
+    }
+    replace_ops(subgraph, replaced, removed);
+    return rewritten;
+}
@@ -0,0 +1,175 @@
+/**
+ * @file conv1d_bench.cc
+ * @author Adam Page (adam.page@ambiq.com)
+ * @brief Host check and benchmark of the 1-D conv kernels against the TFLM reference kernels
+ * @version 1.0
+ * @date 2023-05-02
+ *
+ * @copyright Copyright (c) 2023
+ *
+ * Runs each exported model with AllOpsResolver and with Conv1dOpResolver on the same random
+ * inputs, checks the outputs are bit-identical and reports the mean Invoke() time of each. Then
+ * checks conv1d_s4 against conv1d_s8 run on the same int4 weights unpacked to int8, over conv
+ * shapes with edge padding, odd channel counts and rows that are not whole nibble groups.
+ * Host timings only show the algorithmic gain over the reference kernels; target cycles vs
+ * CMSIS-NN come from the HK_PROFILE_ENABLE per-operator tables.
+ *
+ * Build: make -C evb/host conv1d
+ */
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <random>
+#include <vector>
+
+#include "tensorflow/lite/micro/all_ops_resolver.h"
+#include "tensorflow/lite/micro/micro_error_reporter.h"
+#include "tensorflow/lite/micro/micro_interpreter.h"
+#include "tensorflow/lite/schema/schema_generated.h"
+
+#include "arrhythmia_model_buffer.h"
+#include "beat_model_buffer.h"
+#include "segmentation_model_buffer.h"
+
+#include "conv1d_kernels.h"
+#include "custom_ops.h"
+
+#define ARENA_SIZE (512 * 1024)
+#define BENCH_INPUTS (8)
+#define BENCH_RUNS (20)
+#define S4_CASES (200)
+
+typedef struct {
+    const char *name;
+    const uint8_t *buf;
+    uint32_t len;
+} model_entry_t;
+
+static const model_entry_t models[] = {
+    {"ARR", g_arrhythmia_model, g_arrhythmia_model_len},
+    {"SEG", g_segmentation_model, g_segmentation_model_len},
+    {"BEAT", g_beat_model, g_beat_model_len},
+};
+
+typedef struct {
+    std::vector<uint64_t> model;
+    std::vector<uint64_t> arena;
+    tflite::MicroInterpreter *interpreter;
+} bench_ctx_t;
+
+static int
+bench_init(bench_ctx_t *ctx, const model_entry_t *entry, const tflite::MicroOpResolver &resolver, tflite::ErrorReporter *reporter) {
+    // Model arrays in the generated headers are only byte aligned on host
+    ctx->model.resize((entry->len + sizeof(uint64_t) - 1) / sizeof(uint64_t));
+    memcpy(ctx->model.data(), entry->buf, entry->len);
+    ctx->arena.resize(ARENA_SIZE / sizeof(uint64_t));
+    ctx->interpreter = new tflite::MicroInterpreter(tflite::GetModel(ctx->model.data()), resolver, (uint8_t *)ctx->arena.data(),
+                                                    ARENA_SIZE, reporter);
+    return ctx->interpreter->AllocateTensors() != kTfLiteOk;
+}
+
+static double
+bench_invoke(bench_ctx_t *ctx, const int8_t *input) {
+    /**
+     * @brief Invoke BENCH_RUNS times on input
+     * @return Mean invoke time in microseconds
+     */
+    TfLiteTensor *in = ctx->interpreter->input(0);
+    auto start = std::chrono::steady_clock::now();
+    for (int r = 0; r < BENCH_RUNS; r++) {
+        memcpy(in->data.int8, input, in->bytes);
+        ctx->interpreter->Invoke();
+    }
+    auto end = std::chrono::steady_clock::now();
+    return std::chrono::duration<double, std::micro>(end - start).count() / BENCH_RUNS;
+}
+
+static int
+check_s4(std::mt19937 &rng) {
+    /**
+     * @brief Compare conv1d_s4 with conv1d_s8 on random shapes
+     * @return Mismatching cases
+     */
+    std::uniform_int_distribution<int> s8(-128, 127), s4(-8, 7), small(1, 12);
+    int mismatches = 0;
+    for (int i = 0; i < S4_CASES; i++) {
+        const int32_t inCh = small(rng), outCh = small(rng), kLen = small(rng) % 7 + 1, stride = small(rng) % 2 + 1;
+        const int32_t inLen = kLen + small(rng) * 3, padding = small(rng) % kLen;
+        const int32_t outLen = (inLen + 2 * padding - kLen) / stride + 1;
+        const int32_t rowLen = kLen * inCh, rowBytes = conv1d_s4_row_bytes(rowLen);
+        std::vector<int8_t> input(inLen * inCh), filter(outCh * rowLen), packed(outCh * rowBytes, 0);
+        std::vector<int8_t> ref(outLen * outCh), out(outLen * outCh);
+        std::vector<int32_t> bias(outCh), multipliers(outCh), shifts(outCh);
+        for (int8_t &v : input) {
+            v = (int8_t)s8(rng);
+        }
+        for (int32_t c = 0; c < outCh; c++) {
+            for (int32_t j = 0; j < rowLen; j++) {
+                const int8_t q = (int8_t)s4(rng);
+                filter[c * rowLen + j] = q;
+                packed[c * rowBytes + (j / 8) * 4 + (j % 4)] |= (j % 8) < 4 ? (q & 0x0F) : (q & 0x0F) << 4;
+            }
+            bias[c] = s8(rng) * 64;
+            multipliers[c] = (1 << 30) + s8(rng) * (1 << 20);
+            shifts[c] = -(small(rng) % 6) - 2;
+        }
+        tflite::OpDataConv data;
+        memset(&data, 0, sizeof(data));
+        data.padding.width = padding;
+        data.input_zero_point = s8(rng);
+        data.output_zero_point = s8(rng) / 4;
+        data.output_activation_min = INT8_MIN;
+        data.output_activation_max = INT8_MAX;
+        data.per_channel_output_multiplier = multipliers.data();
+        data.per_channel_output_shift = shifts.data();
+        conv1d_s8(data, stride, inLen, inCh, kLen, 0, outLen, outCh, input.data(), filter.data(), bias.data(), ref.data());
+        conv1d_s4(data, stride, inLen, inCh, kLen, 0, outLen, outCh, input.data(), packed.data(), bias.data(), out.data());
+        mismatches += ref != out;
+    }
+    return mismatches;
+}
+
+int
+main(void) {
+    static tflite::MicroErrorReporter microErrorReporter;
+    static tflite::AllOpsResolver allOpsResolver;
+    add_custom_ops(allOpsResolver);
+    static Conv1dOpResolver conv1dResolver(allOpsResolver);
+    std::mt19937 rng(0x4b48);
+    std::uniform_int_distribution<int> dist(-128, 127);
+    int failures = 0;
+
+    for (const model_entry_t &entry : models) {
+        bench_ctx_t ref, fast;
+        if (bench_init(&ref, &entry, allOpsResolver, &microErrorReporter) ||
+            bench_init(&fast, &entry, conv1dResolver, &microErrorReporter)) {
+            fprintf(stderr, "%s: AllocateTensors() failed\n", entry.name);
+            return 1;
+        }
+        size_t inBytes = ref.interpreter->input(0)->bytes;
+        size_t outBytes = ref.interpreter->output(0)->bytes;
+        std::vector<int8_t> input(inBytes);
+        double refUs = 0, fastUs = 0;
+        int mismatches = 0;
+        for (int i = 0; i < BENCH_INPUTS; i++) {
+            for (size_t j = 0; j < inBytes; j++) {
+                input[j] = (int8_t)dist(rng);
+            }
+            refUs += bench_invoke(&ref, input.data());
+            fastUs += bench_invoke(&fast, input.data());
+            mismatches += memcmp(ref.interpreter->output(0)->data.raw, fast.interpreter->output(0)->data.raw, outBytes) != 0;
+        }
+        refUs /= BENCH_INPUTS;
+        fastUs /= BENCH_INPUTS;
+        printf("%-5s reference=%9.1f us conv1d=%9.1f us speedup=%.2fx outputs=%s\n", entry.name, refUs, fastUs, refUs / fastUs,
+               mismatches ? "MISMATCH" : "identical");
+        failures += mismatches;
+        delete ref.interpreter;
+        delete fast.interpreter;
+    }
+    int mismatches = check_s4(rng);
+    printf("s4    cases=%d outputs=%s\n", S4_CASES, mismatches ? "MISMATCH" : "identical");
+    failures += mismatches;
+    return failures ? 1 : 0;
+}
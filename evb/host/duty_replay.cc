@@ -0,0 +1,271 @@
+/**
+ * @file duty_replay.cc
+ * @author Adam Page (adam.page@ambiq.com)
+ * @brief Host replay of the duty cycle policy: detection delay against model runs saved
+ * @version 1.0
+ * @date 2023-05-02
+ *
+ * @copyright Copyright (c) 2023
+ *
+ * Replays hours of synthetic 10 s windows through the firmware head registry and duty cycle policy
+ * (head_registry.cc, duty_cycle.cc). Steady sinus rhythm is broken by the events the policy has to
+ * catch: heart rate steps, AFIB episodes with irregular RR and runs of PVC bigeminy. The heads are
+ * oracles that read the ground truth of their window, with the firmware's products and cadence, so
+ * the replay measures what the policy costs, not what the models get wrong. A change is detected at
+ * the first window whose results match the new state: rhythm label, ectopic beats, or heart rate
+ * within RATE_TOL. Energy is counted in model invokes, as the firmware runs them per window:
+ * arrhythmia blocks, segmentation windows and one beat invoke per beat. Capping the backoff from 0
+ * (full rate) to HK_DUTY_MAX_SHIFT gives the delay each bit of saving costs.
+ *
+ * Build: make -C evb/host duty
+ */
+#include <cmath>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <random>
+#include <vector>
+
+#include "constants.h"
+#include "duty_cycle.h"
+#include "head_registry.h"
+
+#define REPLAY_CYCLES (40)
+#define WINDOW_SEC (HK_DATA_LEN / SAMPLE_RATE)
+// Relative heart rate error a rate change counts as detected within
+#define RATE_TOL (0.1f)
+// Model invokes per window of the arrhythmia and segmentation heads (see heartkit.cc)
+#define ARR_INVOKES ((HK_DATA_LEN + HK_ARR_LEN - 1) / HK_ARR_LEN)
+#define SEG_INVOKES ((HK_DATA_LEN - HK_SEG_LEN) / HK_SEG_STEP + 2)
+
+enum Episode { EpisodeSinus, EpisodeAfib, EpisodePvc };
+
+typedef struct {
+    Episode type;
+    float bpm;
+    uint32_t windows;
+} segment_t;
+
+typedef struct {
+    uint32_t arrhythmia;
+    bool ectopic;
+    float bpm;
+    std::vector<int32_t> peaks;
+    uint32_t numEctopic;
+} window_t;
+
+typedef struct {
+    uint32_t window;
+    int kind; // 0 rate, 1 rhythm, 2 ectopic
+} event_t;
+
+static const char *EVENT_LABELS[] = {"RATE", "RHYTHM", "ECTOPIC"};
+
+// Replay state the oracle heads read and count
+static const window_t *replayWindow;
+static uint64_t replayInvokes;
+
+static uint32_t
+seg_run(hk_context_t *) {
+    replayInvokes += SEG_INVOKES;
+    return 0;
+}
+
+static uint32_t
+peaks_run(hk_context_t *ctx) {
+    ctx->numPeaks = MIN(replayWindow->peaks.size(), HK_PEAK_LEN);
+    memcpy(ctx->peaks, replayWindow->peaks.data(), ctx->numPeaks * sizeof(int32_t));
+    return 0;
+}
+
+static uint32_t
+hrv_run(hk_context_t *ctx) {
+    // As hrv_head_run() in heartkit.cc
+    float sum = 0;
+    for (uint32_t i = 1; i < ctx->numPeaks; i++) {
+        ctx->rrIntervals[i] = ctx->peaks[i] - ctx->peaks[i - 1];
+        sum += ctx->rrIntervals[i];
+    }
+    ctx->rrIntervals[0] = ctx->rrIntervals[1];
+    ctx->avgRR = ctx->numPeaks > 1 ? (uint32_t)(sum / (ctx->numPeaks - 1)) : 0;
+    ctx->result->heartRate = ctx->avgRR ? 60 * SAMPLE_RATE / ctx->avgRR : 0;
+    return 0;
+}
+
+static uint32_t
+arr_run(hk_context_t *ctx) {
+    replayInvokes += ARR_INVOKES;
+    ctx->result->arrhythmia = replayWindow->arrhythmia;
+    return 0;
+}
+
+static uint32_t
+beat_run(hk_context_t *ctx) {
+    const uint32_t beats = ctx->numPeaks > 2 ? ctx->numPeaks - 2 : 0;
+    replayInvokes += beats;
+    ctx->result->numPvcBeats = MIN(replayWindow->numEctopic, beats);
+    ctx->result->numPacBeats = 0;
+    ctx->result->numNormBeats = beats - ctx->result->numPvcBeats;
+    return 0;
+}
+
+static const hk_head_t replayHeads[] = {
+    {"ARRHYTHMIA", nullptr, arr_run, HK_ARR_PERIOD, 0, HeartProductRhythm},
+    {"SEGMENTATION", nullptr, seg_run, HK_SEG_PERIOD, 0, HeartProductMask},
+    {"PEAKS", nullptr, peaks_run, HK_HRV_PERIOD, HeartProductMask, HeartProductPeaks},
+    {"HRV", nullptr, hrv_run, HK_HRV_PERIOD, HeartProductPeaks, HeartProductRR},
+    {"BEAT", nullptr, beat_run, HK_BEAT_PERIOD, HeartProductPeaks | HeartProductRR, HeartProductBeats},
+};
+
+static void
+synthesize(std::mt19937 &rng, std::vector<window_t> &windows, std::vector<event_t> &events) {
+    /**
+     * @brief Beat times of REPLAY_CYCLES cycles of sinus rhythm and events, cut into windows
+     */
+    std::normal_distribution<float> noise(0.0f, 1.0f);
+    std::uniform_real_distribution<float> bpms(55.0f, 75.0f);
+    std::uniform_int_distribution<uint32_t> calm(30, 90);
+    std::uniform_int_distribution<uint32_t> episode(6, 30);
+    std::vector<segment_t> script;
+    for (int c = 0; c < REPLAY_CYCLES; c++) {
+        const float bpm = bpms(rng);
+        script.push_back({EpisodeSinus, bpm, calm(rng)});
+        switch (c % 4) {
+        case 0:
+            script.push_back({EpisodeSinus, bpm * 1.4f, episode(rng)});
+            break;
+        case 1:
+            script.push_back({EpisodeAfib, bpm * 1.6f, episode(rng)});
+            break;
+        case 2:
+            script.push_back({EpisodePvc, bpm, episode(rng)});
+            break;
+        default:
+            script.push_back({EpisodeSinus, bpm * 0.75f, episode(rng)});
+            break;
+        }
+    }
+    float t = 0;
+    float phase = 0;
+    uint32_t beat = 0;
+    for (const segment_t &seg : script) {
+        for (uint32_t w = 0; w < seg.windows; w++) {
+            window_t win = {seg.type == EpisodeAfib ? (uint32_t)HeartRhythmAfib : (uint32_t)HeartRhythmNormal,
+                            seg.type == EpisodePvc, seg.bpm, {}, 0};
+            const float start = (float)windows.size() * WINDOW_SEC;
+            t = MAX(t, start);
+            while (t < start + WINDOW_SEC) {
+                win.peaks.push_back((int32_t)((t - start) * SAMPLE_RATE));
+                const float rr = 60.0f / seg.bpm;
+                phase += rr * 2 * (float)M_PI / 4.0f;
+                if (seg.type == EpisodeAfib) {
+                    t += rr * MAX(0.4f, 1.0f + 0.25f * noise(rng));
+                } else if (seg.type == EpisodePvc) {
+                    // Bigeminy: premature beat, then a compensatory pause
+                    win.numEctopic += beat % 2;
+                    t += rr * (beat % 2 ? 1.4f : 0.6f);
+                } else {
+                    // Respiratory sinus arrhythmia and jitter
+                    t += rr * (1.0f + 0.03f * sinf(phase) + 0.01f * noise(rng));
+                }
+                beat++;
+            }
+            windows.push_back(win);
+        }
+    }
+    for (uint32_t w = 1; w < windows.size(); w++) {
+        const window_t &a = windows[w - 1];
+        const window_t &b = windows[w];
+        if (a.arrhythmia != b.arrhythmia) {
+            events.push_back({w, 1});
+        } else if (a.ectopic != b.ectopic) {
+            events.push_back({w, 2});
+        } else if (fabsf(a.bpm - b.bpm) > RATE_TOL * a.bpm) {
+            events.push_back({w, 0});
+        }
+    }
+}
+
+static bool
+detected(const event_t &event, const window_t &truth, const hk_result_t &result) {
+    /**
+     * @brief Results reflect the state the event changed to
+     */
+    switch (event.kind) {
+    case 1:
+        return result.arrhythmia == truth.arrhythmia;
+    case 2:
+        return (result.numPacBeats + result.numPvcBeats > 0) == truth.ectopic;
+    default:
+        return fabsf(result.heartRate - truth.bpm) <= RATE_TOL * truth.bpm;
+    }
+}
+
+int
+main(void) {
+    std::mt19937 rng(0x4b48);
+    std::vector<window_t> windows;
+    std::vector<event_t> events;
+    synthesize(rng, windows, events);
+    for (const hk_head_t &head : replayHeads) {
+        if (hk_head_register(&head) < 0) {
+            fprintf(stderr, "register %s failed\n", head.name);
+            return 1;
+        }
+    }
+    printf("%zu windows (%.1f h), %zu events, max backoff x%d after %d stable observations\n", windows.size(),
+           windows.size() * WINDOW_SEC / 3600.0, events.size(), 1 << HK_DUTY_MAX_SHIFT, HK_DUTY_STABLE_WINDOWS);
+
+    int failures = 0;
+    uint64_t fullInvokes = 0;
+    static int32_t peaks[HK_PEAK_LEN];
+    static int32_t rrIntervals[HK_PEAK_LEN];
+    for (uint32_t cap = 0; cap <= HK_DUTY_MAX_SHIFT; cap++) {
+        hk_heads_reset();
+        hk_duty_reset();
+        replayInvokes = 0;
+        hk_result_t result = {};
+        std::vector<int64_t> found(events.size(), -1);
+        for (uint32_t w = 0; w < windows.size(); w++) {
+            replayWindow = &windows[w];
+            hk_context_t ctx = {nullptr, 0, nullptr, peaks, 0, nullptr, rrIntervals, 0, &result};
+            failures += hk_heads_run(&ctx) != 0;
+            hk_heads_set_backoff(MIN(hk_duty_update(&ctx, hk_heads_made()), cap));
+            for (size_t e = 0; e < events.size(); e++) {
+                const bool open = found[e] < 0 && w >= events[e].window && (e + 1 == events.size() || w < events[e + 1].window);
+                if (open && detected(events[e], windows[w], result)) {
+                    found[e] = w - events[e].window;
+                }
+            }
+        }
+        fullInvokes = cap == 0 ? replayInvokes : fullInvokes;
+        printf("backoff<=x%-2d invokes=%5.1f%% of full rate", 1 << cap, 100.0 * replayInvokes / fullInvokes);
+        for (int kind = 0; kind < 3; kind++) {
+            double sum = 0;
+            int64_t worst = 0;
+            int count = 0, missed = 0;
+            for (size_t e = 0; e < events.size(); e++) {
+                if (events[e].kind != kind) {
+                    continue;
+                }
+                count++;
+                missed += found[e] < 0;
+                sum += found[e] < 0 ? 0 : found[e];
+                worst = MAX(worst, found[e]);
+            }
+            printf(" | %s delay avg %5.1f s max %3lld s", EVENT_LABELS[kind], count ? sum * WINDOW_SEC / (count - missed) : 0.0,
+                   (long long)worst * WINDOW_SEC);
+            if (missed) {
+                printf(" (%d missed)", missed);
+            }
+            // Oracle heads at full rate see every change in its first window
+            failures += cap == 0 && (missed || worst > 0);
+        }
+        // The policy's own shift still climbs past the cap, so snaps only mean something above 0
+        if (cap > 0) {
+            printf(" | snaps=%u", hk_duty_state()->snaps);
+        }
+        printf("\n");
+    }
+    return failures ? 1 : 0;
+}
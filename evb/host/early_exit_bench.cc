@@ -0,0 +1,258 @@
+/**
+ * @file early_exit_bench.cc
+ * @author Adam Page (adam.page@ambiq.com)
+ * @brief Host check and benchmark of EarlyExitModel on the arrhythmia model cut in three
+ * @version 1.0
+ * @date 2023-05-02
+ *
+ * @copyright Copyright (c) 2023
+ *
+ * There is no trained early-exit export in the tree, so the arrhythmia model is cut into three parts
+ * at the tensors closest to a third and two thirds of its ops that are the only live activation.
+ * The parts have no exit classifiers and keep the quantization of the original model, so chaining
+ * them through EarlyExitModel on random blocks has to give exactly the output of the whole model.
+ * The per-part times show what a block exiting after each cut would cost. ee_confidence() is checked
+ * against a float softmax.
+ *
+ * Build: make -C evb/host early_exit
+ */
+#include <chrono>
+#include <cmath>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <memory>
+#include <random>
+#include <vector>
+
+#include "tensorflow/lite/micro/all_ops_resolver.h"
+#include "tensorflow/lite/micro/micro_error_reporter.h"
+#include "tensorflow/lite/micro/micro_interpreter.h"
+#include "tensorflow/lite/schema/schema_generated.h"
+
+#include "arrhythmia_model_buffer.h"
+
+#include "conv1d_kernels.h"
+#include "custom_ops.h"
+#include "early_exit_model.h"
+#include "model_fuser.h"
+#include "model_header.h"
+
+#define ARENA_SIZE (256 * 1024)
+#define NUM_PARTS (3)
+#define BENCH_INPUTS (8)
+#define BENCH_RUNS (20)
+#define CONFIDENCE_CASES (200)
+
+static uint32_t
+host_cycles(void) {
+    /**
+     * @brief Nanoseconds standing in for DWT CYCCNT, wrapping the same way
+     */
+    return (uint32_t)std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+static std::vector<int32_t>
+cut_points(const tflite::ModelT &model, size_t numCuts) {
+    /**
+     * @brief Tensors after which they are the only activation still needed, nearest to even splits of the ops
+     */
+    const tflite::SubGraphT &subgraph = *model.subgraphs[0];
+    const size_t numOps = subgraph.operators.size();
+    // Last op reading each tensor (numOps for graph outputs)
+    std::vector<int32_t> lastUse(subgraph.tensors.size(), -1);
+    for (size_t i = 0; i < numOps; i++) {
+        for (int32_t t : subgraph.operators[i]->inputs) {
+            if (t >= 0) {
+                lastUse[t] = i;
+            }
+        }
+    }
+    for (int32_t t : subgraph.outputs) {
+        lastUse[t] = numOps;
+    }
+    std::vector<int32_t> live(subgraph.inputs);
+    std::vector<int32_t> candidates(numOps, -1);
+    for (size_t i = 0; i < numOps; i++) {
+        std::vector<int32_t> next;
+        for (int32_t t : live) {
+            if (lastUse[t] > (int32_t)i) {
+                next.push_back(t);
+            }
+        }
+        for (int32_t t : subgraph.operators[i]->outputs) {
+            if (t >= 0 && lastUse[t] > (int32_t)i) {
+                next.push_back(t);
+            }
+        }
+        live.swap(next);
+        if (live.size() == 1 && lastUse[live[0]] < (int32_t)numOps) {
+            candidates[i] = live[0];
+        }
+    }
+    std::vector<int32_t> cuts;
+    for (size_t c = 1; c <= numCuts; c++) {
+        const int32_t target = (int32_t)(c * numOps / (numCuts + 1));
+        int32_t best = -1;
+        for (int32_t i = 0; i < (int32_t)numOps; i++) {
+            if (candidates[i] >= 0 && (best < 0 || std::abs(i - target) < std::abs(best - target))) {
+                best = i;
+            }
+        }
+        if (best < 0 || (!cuts.empty() && candidates[best] == cuts.back())) {
+            return {};
+        }
+        cuts.push_back(candidates[best]);
+    }
+    return cuts;
+}
+
+static std::vector<uint64_t>
+aligned_copy(const std::vector<uint8_t> &fb) {
+    std::vector<uint64_t> buf((fb.size() + sizeof(uint64_t) - 1) / sizeof(uint64_t));
+    memcpy(buf.data(), fb.data(), fb.size());
+    return buf;
+}
+
+static int
+check_confidence(std::mt19937 &rng) {
+    /**
+     * @brief Compare ee_confidence with a float softmax of random int8 logits
+     * @return Cases off by more than 1e-4 or with the wrong label
+     */
+    std::uniform_int_distribution<int> values(-128, 127);
+    std::uniform_int_distribution<int> classCounts(2, 8);
+    std::uniform_real_distribution<float> scales(-6.0f, -1.0f);
+    int failures = 0;
+    float maxDiff = 0;
+    for (int i = 0; i < CONFIDENCE_CASES; i++) {
+        const int classes = classCounts(rng);
+        int dims[3] = {2, 1, classes};
+        int8_t data[8];
+        TfLiteTensor logits = {};
+        logits.type = kTfLiteInt8;
+        logits.dims = (TfLiteIntArray *)dims;
+        logits.data.int8 = data;
+        logits.params.scale = std::exp(scales(rng));
+        logits.params.zero_point = values(rng);
+        int32_t refLabel = 0;
+        for (int c = 0; c < classes; c++) {
+            data[c] = (int8_t)values(rng);
+            refLabel = data[c] > data[refLabel] ? c : refLabel;
+        }
+        double sum = 0;
+        for (int c = 0; c < classes; c++) {
+            sum += std::exp(((data[c] - logits.params.zero_point) - (data[refLabel] - logits.params.zero_point)) * (double)logits.params.scale);
+        }
+        int32_t label;
+        const float diff = std::fabs(ee_confidence(&logits, &label) - (float)(1.0 / sum));
+        maxDiff = diff > maxDiff ? diff : maxDiff;
+        failures += diff > 1e-4f || label != refLabel;
+    }
+    printf("confidence cases=%d max |dp|=%.2e\n", CONFIDENCE_CASES, maxDiff);
+    return failures;
+}
+
+int
+main(void) {
+    static tflite::MicroErrorReporter microErrorReporter;
+    static tflite::AllOpsResolver allOpsResolver;
+    add_custom_ops(allOpsResolver);
+    static Conv1dOpResolver conv1dResolver(allOpsResolver);
+    std::mt19937 rng(0x4b48);
+    std::uniform_int_distribution<int> dist(-128, 127);
+    int failures = 0;
+
+    // Cut the arrhythmia model into parts
+    std::unique_ptr<tflite::ModelT> model = unpack_model(g_arrhythmia_model, g_arrhythmia_model_len);
+    const std::vector<int32_t> cuts = cut_points(*model, NUM_PARTS - 1);
+    if (cuts.size() != NUM_PARTS - 1) {
+        fprintf(stderr, "ARR: no cut points\n");
+        return 1;
+    }
+    std::vector<std::vector<int32_t>> bounds = {model->subgraphs[0]->inputs};
+    for (int32_t t : cuts) {
+        bounds.push_back({t});
+    }
+    bounds.push_back(model->subgraphs[0]->outputs);
+    std::vector<std::vector<uint64_t>> partBufs;
+    std::vector<std::vector<uint64_t>> partArenas;
+    std::vector<std::unique_ptr<tflite::MicroInterpreter>> parts;
+    static EarlyExitModel earlyExit;
+    earlyExit.Init(host_cycles);
+    for (int p = 0; p < NUM_PARTS; p++) {
+        std::unique_ptr<tflite::ModelT> partModel = unpack_model(g_arrhythmia_model, g_arrhythmia_model_len);
+        if (!extract_subgraph(*partModel, bounds[p], bounds[p + 1])) {
+            fprintf(stderr, "ARR: part %d extraction failed\n", p + 1);
+            return 1;
+        }
+        const size_t ops = partModel->subgraphs[0]->operators.size();
+        partBufs.push_back(aligned_copy(pack_model(*partModel, g_arrhythmia_model_len)));
+        partArenas.emplace_back(ARENA_SIZE / sizeof(uint64_t));
+        parts.emplace_back(new tflite::MicroInterpreter(tflite::GetModel(partBufs.back().data()), conv1dResolver,
+                                                        (uint8_t *)partArenas.back().data(), ARENA_SIZE, &microErrorReporter));
+        if (parts.back()->AllocateTensors() != kTfLiteOk || earlyExit.AddPart(parts.back().get()) != kTfLiteOk) {
+            fprintf(stderr, "ARR: part %d init failed\n", p + 1);
+            return 1;
+        }
+        printf("ARR part %d: %zu ops, arena %zu bytes\n", p + 1, ops, parts.back()->arena_used_bytes());
+    }
+    std::vector<uint64_t> wholeBuf = aligned_copy(std::vector<uint8_t>(g_arrhythmia_model, g_arrhythmia_model + g_arrhythmia_model_len));
+    std::vector<uint64_t> wholeArena(ARENA_SIZE / sizeof(uint64_t));
+    tflite::MicroInterpreter whole(tflite::GetModel(wholeBuf.data()), conv1dResolver, (uint8_t *)wholeArena.data(), ARENA_SIZE,
+                                   &microErrorReporter);
+    if (whole.AllocateTensors() != kTfLiteOk || earlyExit.NumClasses() != (int32_t)whole.output(0)->dims->data[1]) {
+        fprintf(stderr, "ARR: init failed\n");
+        return 1;
+    }
+
+    // The chained parts are the model
+    TfLiteTensor *in = whole.input(0);
+    TfLiteTensor *out = whole.output(0);
+    std::vector<int8_t> block(in->bytes);
+    std::vector<float> y(earlyExit.NumClasses());
+    double wholeUs = 0;
+    int mismatches = 0;
+    for (int i = 0; i < BENCH_INPUTS; i++) {
+        for (int8_t &x : block) {
+            x = (int8_t)dist(rng);
+        }
+        // The planner reuses input memory once it is consumed, so every invoke needs its input again
+        auto start = std::chrono::steady_clock::now();
+        for (int r = 0; r < BENCH_RUNS; r++) {
+            memcpy(in->data.int8, block.data(), in->bytes);
+            whole.Invoke();
+        }
+        auto end = std::chrono::steady_clock::now();
+        wholeUs += std::chrono::duration<double, std::micro>(end - start).count() / BENCH_RUNS;
+        int32_t label = -1, exitPart = -1;
+        for (int r = 0; r < BENCH_RUNS; r++) {
+            memcpy(earlyExit.Input()->data.int8, block.data(), in->bytes);
+            label = earlyExit.Invoke(0, y.data(), &exitPart);
+        }
+        int32_t refLabel = 0;
+        for (int32_t c = 0; c < earlyExit.NumClasses(); c++) {
+            const float ref = ((float)out->data.int8[c] - out->params.zero_point) * out->params.scale;
+            refLabel = out->data.int8[c] > out->data.int8[refLabel] ? c : refLabel;
+            mismatches += y[c] != ref;
+        }
+        mismatches += label != refLabel || exitPart != NUM_PARTS - 1;
+    }
+    wholeUs /= BENCH_INPUTS;
+    printf("whole=%8.1f us outputs=%s\n", wholeUs, mismatches ? "MISMATCH" : "identical");
+    double chainUs = 0;
+    for (int p = 0; p < NUM_PARTS; p++) {
+        chainUs += earlyExit.Part(p)->cycles / 1000.0 / earlyExit.Part(p)->runs;
+    }
+    double cumUs = 0;
+    for (int p = 0; p < NUM_PARTS; p++) {
+        const ee_part_t *part = earlyExit.Part(p);
+        cumUs += part->cycles / 1000.0 / part->runs;
+        printf("part %d: %8.1f us, exit here costs %3.0f%% of the chain, runs=%u exits=%u\n", p + 1, part->cycles / 1000.0 / part->runs,
+               100.0 * cumUs / chainUs, (unsigned)part->runs, (unsigned)part->exits);
+    }
+    failures += mismatches;
+    failures += earlyExit.Invokes() != BENCH_INPUTS * BENCH_RUNS || earlyExit.AverageCyclesSaved() != 0;
+    failures += check_confidence(rng);
+    return failures ? 1 : 0;
+}
@@ -0,0 +1,252 @@
+/**
+ * @file fiducial_bench.cc
+ * @author Adam Page (adam.page@ambiq.com)
+ * @brief Host check of the run-length fiducial extractor on true and segmented masks
+ * @version 1.0
+ * @date 2023-05-02
+ *
+ * @copyright Copyright (c) 2023
+ *
+ * Synthesizes five minutes of ECG with PACs and PVCs (synthetic_ecg.cc) at several mean heart rates
+ * and standardizes back to back HK_DATA_LEN windows as hk_preprocess() does. On the true wave mask,
+ * ../src/fiducials.cc has to find every beat inside the window with its exact PR, QRS duration and
+ * QT (QTc within 4%), and the same beats once the mask is sprinkled with glitches shorter than HK_FID_MIN_RUN. On the
+ * mask the segmentation model streams over each window (as segmentation_stream()), it reports the
+ * beats found and spurious within 150 ms of a true R peak, the R peak error of the extractor against
+ * the QRS midpoint the old scan used, and the mean absolute error of each interval against the
+ * synthesized waves, failing if fewer than 99% of the beats are found.
+ *
+ * Build: make -C evb/host fiducials
+ */
+#include <cmath>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <random>
+#include <vector>
+
+#include "tensorflow/lite/schema/schema_generated.h"
+
+#include "segmentation_model_buffer.h"
+
+#include "constants.h"
+#include "fiducials.h"
+#include "heartkit.h"
+#include "model_arena.h"
+#include "segment_eval.h"
+#include "stream_model.h"
+#include "synthetic_ecg.h"
+
+#define REPLAY_SEC (300)
+#define MATCH_TOL (150 * SAMPLE_RATE / 1000)
+// Glitches per window and their longest run
+#define GLITCHES (100)
+#define GLITCH_LEN (HK_FID_MIN_RUN - 1)
+
+static const float rates[] = {45.0f, 65.0f, 90.0f};
+static const char *intervalLabels[] = {"PR", "QRS", "QT", "QTc"};
+
+const char *HK_SEGMENT_LABELS[] = {"NONE", "P-WAVE", "QRS", "T-WAVE"};
+
+void
+arm_absmax_f32(const float32_t *pSrc, uint32_t blockSize, float32_t *pResult, uint32_t *pIndex) {
+    *pIndex = 0;
+    *pResult = fabsf(pSrc[0]);
+    for (uint32_t i = 1; i < blockSize; i++) {
+        if (fabsf(pSrc[i]) > *pResult) {
+            *pResult = fabsf(pSrc[i]);
+            *pIndex = i;
+        }
+    }
+}
+
+static void
+truth_intervals(const std::vector<ecg_beat_t> &beats, size_t i, uint32_t start, int32_t *vals) {
+    /**
+     * @brief PR, QRS duration, QT and QTc of a synthesized beat as fiducials.cc measures them on the
+     * true mask of the window at start (-1 if none). Later waves overwrite the ends of the waves they
+     * overlap (ecg_segment_mask()), a wave ends once the next one has lasted HK_FID_MIN_RUN, so
+     * waves not ended that far inside the window are cut, and shorter gaps are part of the wave.
+     */
+    const ecg_beat_t &b = beats[i];
+    const uint32_t end = start + HK_DATA_LEN;
+    const bool hasP = b.pOff > b.pOn;
+    const bool hasT = b.tOff > b.tOn;
+    uint32_t tOff = b.tOff;
+    if (i + 1 < beats.size()) {
+        const ecg_beat_t &next = beats[i + 1];
+        const uint32_t nextOn = next.pOff > next.pOn ? next.pOn : next.qrsOn;
+        // A shorter gap is a glitch the T wave absorbs
+        tOff = nextOn < tOff + HK_FID_MIN_RUN ? nextOn : tOff;
+    }
+    const uint32_t qrsOff = hasT ? MIN(b.qrsOff, b.tOn) : b.qrsOff;
+    const bool whole = b.qrsOn > start && qrsOff + HK_FID_MIN_RUN <= end;
+    vals[0] = whole && hasP && b.pOn > start && b.qrsOn - b.pOn <= HK_FID_PR_MAX ? (int32_t)(b.qrsOn - b.pOn) : -1;
+    vals[1] = whole ? (int32_t)(qrsOff - b.qrsOn) : -1;
+    vals[2] = whole && hasT && tOff + HK_FID_MIN_RUN <= end && tOff - b.qrsOn <= HK_FID_QT_MAX ? (int32_t)(tOff - b.qrsOn) : -1;
+    vals[3] = vals[2] != -1 && i > 0 ? (int32_t)(vals[2] / sqrtf((float)(b.peak - beats[i - 1].peak) / SAMPLE_RATE) + 0.5f) : -1;
+}
+
+static void
+glitch_mask(std::mt19937 &rng, uint8_t *segMask, uint32_t len) {
+    /**
+     * @brief Overwrite short runs with another label, HK_FID_MIN_RUN clear of wave boundaries and the
+     * window edges so a glitch cannot join the wave next to it
+     */
+    std::uniform_int_distribution<uint32_t> pos(0, len - 1), runLen(1, GLITCH_LEN), other(1, 3);
+    for (int g = 0; g < GLITCHES; g++) {
+        const uint32_t start = pos(rng);
+        const uint32_t end = start + runLen(rng);
+        if (start < HK_FID_MIN_RUN || end + HK_FID_MIN_RUN > len) {
+            continue;
+        }
+        const uint32_t lo = start - HK_FID_MIN_RUN;
+        const uint32_t hi = end + HK_FID_MIN_RUN;
+        bool clear = true;
+        for (uint32_t i = lo + 1; i < hi; i++) {
+            clear &= segMask[i] == segMask[lo];
+        }
+        if (clear) {
+            memset(&segMask[start], (segMask[start] + other(rng)) % 4, end - start);
+        }
+    }
+}
+
+static uint32_t
+midpoint_peaks(const uint8_t *segMask, uint32_t len, int32_t *peaks, uint32_t maxPeaks) {
+    /**
+     * @brief QRS midpoints, as find_peaks_from_segments() scanned the mask before fiducials.cc
+     */
+    uint32_t numPeaks = 0, qrsStart = 0;
+    for (uint32_t i = 1; i < len && numPeaks < maxPeaks; i++) {
+        if (segMask[i] == HeartSegmentQrs && segMask[i - 1] != HeartSegmentQrs) {
+            qrsStart = i;
+        }
+        if (segMask[i - 1] == HeartSegmentQrs && segMask[i] != HeartSegmentQrs) {
+            peaks[numPeaks++] = (qrsStart + i - 1) >> 1;
+        }
+    }
+    return numPeaks;
+}
+
+int
+main(void) {
+    std::vector<uint64_t> modelBuf((g_segmentation_model_len + sizeof(uint64_t) - 1) / sizeof(uint64_t));
+    memcpy(modelBuf.data(), g_segmentation_model, g_segmentation_model_len);
+    const tflite::Model *model = tflite::GetModel(modelBuf.data());
+    std::vector<uint8_t> streamArena(HK_SEG_STREAM_ARENA_SIZE);
+    static StreamModel stream;
+    if (stream.Init(model, streamArena.data(), streamArena.size(), HK_SEG_STREAM_STEP, HK_DATA_LEN) != kTfLiteOk) {
+        fprintf(stderr, "SEG: init failed\n");
+        return 1;
+    }
+    printf("FID   min run=%d samples, PR max=%d QT max=%d samples, %d glitches of up to %d samples per window\n", HK_FID_MIN_RUN,
+           HK_FID_PR_MAX, HK_FID_QT_MAX, GLITCHES, GLITCH_LEN);
+    int failures = 0;
+    std::vector<float> data(HK_DATA_LEN);
+    std::vector<uint8_t> segMask(HK_DATA_LEN), glitched(HK_DATA_LEN);
+    hk_fiducial_t fids[HK_PEAK_LEN], glitchFids[HK_PEAK_LEN];
+    int32_t midPeaks[HK_PEAK_LEN];
+    for (float bpm : rates) {
+        std::mt19937 rng(0x4b48);
+        std::vector<ecg_beat_t> beats;
+        const std::vector<float> ecg = synthesize_ecg(rng, {REPLAY_SEC, 0.04f, 0.04f, false, false, bpm}, beats);
+        const std::vector<uint8_t> truthMask = ecg_segment_mask(beats, ecg.size());
+        uint32_t truthBeats = 0, truthMisses = 0, glitchDiffs = 0;
+        uint32_t total = 0, found = 0, spurious = 0, midFound = 0;
+        double rErr = 0, midErr = 0;
+        double ivErr[4] = {}, ivCount[4] = {};
+        uint32_t ivMissed[4] = {}, ivTotal[4] = {};
+        for (uint32_t start = 0; start + HK_DATA_LEN <= ecg.size(); start += HK_DATA_LEN) {
+            const uint32_t end = start + HK_DATA_LEN;
+            ecg_standardize(&ecg[start], data.data(), HK_DATA_LEN);
+            // True mask: every beat inside the window with its exact intervals, glitched or not
+            const uint32_t numTruth = hk_fiducials_extract(data.data(), &truthMask[start], HK_DATA_LEN, fids, HK_PEAK_LEN);
+            memcpy(glitched.data(), &truthMask[start], HK_DATA_LEN);
+            glitch_mask(rng, glitched.data(), HK_DATA_LEN);
+            const uint32_t numGlitched = hk_fiducials_extract(data.data(), glitched.data(), HK_DATA_LEN, glitchFids, HK_PEAK_LEN);
+            glitchDiffs += numGlitched != numTruth || memcmp(fids, glitchFids, numTruth * sizeof(hk_fiducial_t)) != 0;
+            size_t f = 0;
+            for (size_t b = 0; b < beats.size(); b++) {
+                if (beats[b].qrsOn <= start || beats[b].qrsOff >= end) {
+                    continue;
+                }
+                truthBeats++;
+                while (f < numTruth && fids[f].qrsOn + start < beats[b].qrsOn) {
+                    f++;
+                }
+                int32_t vals[4];
+                truth_intervals(beats, b, start, vals);
+                const hk_fiducial_t &fid = fids[f < numTruth ? f : 0];
+                // QTc needs the previous beat inside the window too, and the synthesized R peak of a PVC
+                // is a few samples off its largest absolute sample
+                const bool prevIn = b > 0 && beats[b - 1].qrsOn > start;
+                truthMisses += f >= numTruth || fid.qrsOn + start != beats[b].qrsOn || fid.pr != vals[0] || fid.qrs != vals[1] ||
+                               fid.qt != vals[2] || (prevIn && vals[3] != -1 && abs(fid.qtc - vals[3]) > vals[3] / 25);
+            }
+            // Segmented mask
+            memset(segMask.data(), HeartSegmentNormal, HK_DATA_LEN);
+            failures += stream_segment(&stream, data.data(), HK_DATA_LEN, segMask.data()) != 0;
+            const uint32_t numFids = hk_fiducials_extract(data.data(), segMask.data(), HK_DATA_LEN, fids, HK_PEAK_LEN);
+            const uint32_t numMid = midpoint_peaks(segMask.data(), HK_DATA_LEN, midPeaks, HK_PEAK_LEN);
+            std::vector<bool> used(numFids, false);
+            for (size_t b = 0; b < beats.size(); b++) {
+                const int32_t peak = (int32_t)beats[b].peak - (int32_t)start;
+                if (peak < MATCH_TOL || peak >= HK_DATA_LEN - MATCH_TOL) {
+                    continue;
+                }
+                total++;
+                int32_t best = -1;
+                for (uint32_t i = 0; i < numFids; i++) {
+                    if (!used[i] && abs(fids[i].peak - peak) <= MATCH_TOL && (best == -1 || abs(fids[i].peak - peak) < abs(fids[best].peak - peak))) {
+                        best = i;
+                    }
+                }
+                for (uint32_t i = 0; i < numMid; i++) {
+                    if (abs(midPeaks[i] - peak) <= MATCH_TOL) {
+                        midFound++;
+                        midErr += abs(midPeaks[i] - peak);
+                        break;
+                    }
+                }
+                if (best == -1) {
+                    continue;
+                }
+                used[best] = true;
+                found++;
+                rErr += abs(fids[best].peak - peak);
+                int32_t vals[4];
+                truth_intervals(beats, b, start, vals);
+                const int32_t got[4] = {fids[best].pr, fids[best].qrs, fids[best].qt, fids[best].qtc};
+                for (int j = 0; j < 4; j++) {
+                    if (vals[j] == -1) {
+                        continue;
+                    }
+                    ivTotal[j]++;
+                    if (got[j] == -1) {
+                        ivMissed[j]++;
+                    } else {
+                        ivErr[j] += abs(got[j] - vals[j]);
+                        ivCount[j]++;
+                    }
+                }
+            }
+            for (uint32_t i = 0; i < numFids; i++) {
+                spurious += !used[i] && fids[i].peak >= MATCH_TOL && fids[i].peak < HK_DATA_LEN - MATCH_TOL;
+            }
+        }
+        printf("bpm=%.0f (%zu beats in %d s)\n", bpm, beats.size(), REPLAY_SEC);
+        printf(" true mask: %u of %u beats off their waves or intervals, %u windows changed by glitches\n", truthMisses, truthBeats,
+               glitchDiffs);
+        printf(" segmented: found=%.2f%% spurious=%u R err=%.1f ms (QRS midpoint %.1f ms, found=%.2f%%)\n", 100.0 * found / total,
+               spurious, 1000.0 * rErr / MAX(found, 1) / SAMPLE_RATE, 1000.0 * midErr / MAX(midFound, 1) / SAMPLE_RATE,
+               100.0 * midFound / total);
+        for (int j = 0; j < 4; j++) {
+            printf("  %-4s missed=%5.2f%% err=%5.1f ms\n", intervalLabels[j], 100.0 * ivMissed[j] / MAX(ivTotal[j], 1),
+                   1000.0 * ivErr[j] / MAX(ivCount[j], 1) / SAMPLE_RATE);
+        }
+        failures += truthMisses > 0 || glitchDiffs > 0 || 100 * found < 99 * total;
+    }
+    return failures ? 1 : 0;
+}
@@ -0,0 +1,297 @@
+/**
+ * @file hrv_bench.cc
+ * @author Adam Page (adam.page@ambiq.com)
+ * @brief Host check and benchmark of the streaming HRV engine against batch HRV
+ * @version 1.0
+ * @date 2023-05-02
+ *
+ * @copyright Copyright (c) 2023
+ *
+ * Checks ../src/hrv.cc three ways. A random RR series inside HK_HRV_RR_TOL is pushed beat by beat,
+ * and after every beat the running SDNN, RMSSD and pNN50 have to match a batch recompute over the
+ * last HK_HRV_WINDOW intervals. A tachogram modulated by a 0.1 Hz (LF) and a 0.25 Hz (HF) sine of
+ * known amplitude has to give their powers (A^2 / 2) within 10%. Then half an hour of synthetic ECG
+ * with PACs and PVCs (synthetic_ecg.cc) is fed as hk_run would, the peaks of 10 s windows overlapping
+ * by half, and the metrics have to match feeding each beat once. They are reported against batch
+ * HRV of the normal-to-normal intervals and of every RR, as ectopic beats inflate RMSSD and pNN50
+ * unless dropped, and SDNN and RMSSD have to be within 10% of the normal-to-normal ones. Two windows
+ * with a gap between them (hk_hrv_break) may not pair peaks across it. Host time per push and per
+ * spectrum only shows the cost ratio, target cycles come from the HRV stage counters.
+ *
+ * CMSIS-DSP is a prebuilt library for the EVB only, so arm_rfft_fast_f32 is a reference DFT here. It
+ * packs its output as CMSIS documents it (bins 0 and N / 2 share the first complex slot), but the
+ * CMSIS kernel itself is not run on the host.
+ *
+ * Build: make -C evb/host hrv
+ */
+#include <chrono>
+#include <cmath>
+#include <cstdint>
+#include <cstdio>
+#include <random>
+#include <vector>
+
+#include "arm_math.h"
+
+#include "constants.h"
+#include "heartkit.h"
+#include "hrv.h"
+#include "synthetic_ecg.h"
+
+#define REPLAY_SEC (1800)
+#define RANDOM_BEATS (2000)
+#define WINDOW_STEP (HK_DATA_LEN / 2)
+// LF and HF sines of the modulated tachogram (ms, Hz) around a mean RR (ms)
+#define MOD_RR (800.0)
+#define LF_AMP (30.0)
+#define LF_HZ (0.1)
+#define HF_AMP (20.0)
+#define HF_HZ (0.25)
+
+typedef struct {
+    double sdnn;
+    double rmssd;
+    double pnn50;
+} batch_hrv_t;
+
+arm_status
+arm_rfft_fast_init_f32(arm_rfft_fast_instance_f32 *S, uint16_t fftLen) {
+    S->fftLenRFFT = fftLen;
+    return ARM_MATH_SUCCESS;
+}
+
+void
+arm_rfft_fast_f32(const arm_rfft_fast_instance_f32 *S, float32_t *p, float32_t *pOut, uint8_t) {
+    // Packed as CMSIS: real parts of bins 0 and N / 2 first, then bin k at [2k, 2k + 1]
+    const uint32_t n = S->fftLenRFFT;
+    for (uint32_t k = 0; k <= n / 2; k++) {
+        double re = 0, im = 0;
+        for (uint32_t i = 0; i < n; i++) {
+            re += p[i] * cos(2.0 * M_PI * k * i / n);
+            im -= p[i] * sin(2.0 * M_PI * k * i / n);
+        }
+        if (k == 0) {
+            pOut[0] = (float32_t)re;
+        } else if (k == n / 2) {
+            pOut[1] = (float32_t)re;
+        } else {
+            pOut[2 * k] = (float32_t)re;
+            pOut[2 * k + 1] = (float32_t)im;
+        }
+    }
+}
+
+static batch_hrv_t
+batch_hrv(const std::vector<double> &rr, const std::vector<double> &prev) {
+    /**
+     * @brief SDNN, RMSSD and pNN50 of RR intervals in ms, the successive differences to prev (NAN for none)
+     */
+    batch_hrv_t hrv = {0, 0, 0};
+    double mean = 0, d2 = 0;
+    uint32_t diffs = 0, nn50 = 0;
+    for (double r : rr) {
+        mean += r / rr.size();
+    }
+    for (size_t i = 0; i < rr.size(); i++) {
+        hrv.sdnn += (rr[i] - mean) * (rr[i] - mean) / (rr.size() - 1);
+        if (!std::isnan(prev[i])) {
+            d2 += (rr[i] - prev[i]) * (rr[i] - prev[i]);
+            diffs++;
+            nn50 += fabs(rr[i] - prev[i]) > HK_HRV_NN_MS;
+        }
+    }
+    hrv.sdnn = sqrt(hrv.sdnn);
+    hrv.rmssd = diffs ? sqrt(d2 / diffs) : 0;
+    hrv.pnn50 = diffs ? 100.0 * nn50 / diffs : 0;
+    return hrv;
+}
+
+static int
+check_running(void) {
+    /**
+     * @brief Running metrics against a batch recompute after every beat
+     */
+    std::mt19937 rng(0x4b48);
+    std::uniform_int_distribution<int32_t> jitter(-HK_HRV_RR_TOL * 0.9f * 200, HK_HRV_RR_TOL * 0.9f * 200);
+    std::vector<int32_t> rrs;
+    hk_hrv_reset();
+    uint32_t peak = SAMPLE_RATE;
+    hk_hrv_push(peak);
+    double maxErr = 0;
+    for (int b = 0; b < RANDOM_BEATS; b++) {
+        const int32_t rr = 200 + jitter(rng) / 2;
+        peak += rr;
+        if (!hk_hrv_push(peak)) {
+            fprintf(stderr, "HRV: in-range RR %d dropped\n", (int)rr);
+            return 1;
+        }
+        rrs.push_back(rr);
+        std::vector<double> win, prev;
+        for (size_t i = rrs.size() > HK_HRV_WINDOW ? rrs.size() - HK_HRV_WINDOW : 0; i < rrs.size(); i++) {
+            win.push_back(1000.0 * rrs[i] / SAMPLE_RATE);
+            prev.push_back(i > 0 ? 1000.0 * rrs[i - 1] / SAMPLE_RATE : NAN);
+        }
+        const batch_hrv_t ref = batch_hrv(win, prev);
+        hk_hrv_t hrv;
+        hk_hrv_metrics(&hrv);
+        if (hrv.numRR != MIN(rrs.size(), (size_t)HK_HRV_WINDOW)) {
+            fprintf(stderr, "HRV: %u RR in the window, expected %zu\n", hrv.numRR, MIN(rrs.size(), (size_t)HK_HRV_WINDOW));
+            return 1;
+        }
+        if (rrs.size() > 1) {
+            maxErr = MAX(maxErr, fabs(hrv.sdnn - ref.sdnn) / ref.sdnn);
+            maxErr = MAX(maxErr, fabs(hrv.rmssd - ref.rmssd) / ref.rmssd);
+            maxErr = MAX(maxErr, fabs(hrv.pnn50 - ref.pnn50) / MAX(ref.pnn50, 1.0));
+        }
+    }
+    printf("running vs batch: %d beats, max relative error %.2e\n", RANDOM_BEATS, maxErr);
+    return maxErr > 1e-4;
+}
+
+static int
+check_spectrum(void) {
+    /**
+     * @brief LF and HF power of a tachogram with a sine in each band
+     */
+    hk_hrv_reset();
+    double t = 1.0;
+    hk_hrv_push((uint32_t)lround(t * SAMPLE_RATE));
+    hk_hrv_t hrv = {};
+    for (int b = 0; b < 1000; b++) {
+        t += (MOD_RR + LF_AMP * sin(2 * M_PI * LF_HZ * t) + HF_AMP * sin(2 * M_PI * HF_HZ * t)) / 1000.0;
+        hk_hrv_push((uint32_t)lround(t * SAMPLE_RATE));
+    }
+    hk_hrv_metrics(&hrv);
+    const double lf = LF_AMP * LF_AMP / 2, hf = HF_AMP * HF_AMP / 2;
+    printf("spectrum: LF=%.1f ms^2 (expected %.1f) HF=%.1f ms^2 (expected %.1f) LF/HF=%.2f (expected %.2f)\n", hrv.lfPower, lf,
+           hrv.hfPower, hf, hrv.lfPower / hrv.hfPower, lf / hf);
+    return fabs(hrv.lfPower - lf) > 0.1 * lf || fabs(hrv.hfPower - hf) > 0.1 * hf;
+}
+
+static int
+check_gap(void) {
+    /**
+     * @brief Two windows that are not contiguous (another patient after the display), placed so the
+     * peaks across the gap would make an RR within HK_HRV_RR_TOL. No interval or difference may span it.
+     */
+    const int32_t rrA = SAMPLE_RATE, rrB = SAMPLE_RATE * 4 / 5;
+    std::vector<uint32_t> peaks[2];
+    for (uint32_t peak = 100; peak < HK_DATA_LEN; peak += rrA) {
+        peaks[0].push_back(peak);
+    }
+    // First peak of the next window SAMPLE_RATE * 9 / 10 after the last one of the first
+    for (uint32_t peak = peaks[0].back() + SAMPLE_RATE * 9 / 10; peak < 2 * HK_DATA_LEN; peak += rrB) {
+        peaks[1].push_back(peak);
+    }
+    hk_hrv_reset();
+    for (int w = 0; w < 2; w++) {
+        if (w > 0) {
+            hk_hrv_break();
+        }
+        for (uint32_t peak : peaks[w]) {
+            hk_hrv_push(peak);
+        }
+    }
+    hk_hrv_t hrv;
+    hk_hrv_metrics(&hrv);
+    std::vector<double> rr, prev;
+    for (int w = 0; w < 2; w++) {
+        for (size_t i = 1; i < peaks[w].size(); i++) {
+            prev.push_back(i > 1 ? rr.back() : NAN);
+            rr.push_back(1000.0 * (w ? rrB : rrA) / SAMPLE_RATE);
+        }
+    }
+    const batch_hrv_t ref = batch_hrv(rr, prev);
+    printf("gap: %u RR (expected %zu) SDNN=%.1f (expected %.1f) RMSSD=%.1f (expected %.1f)\n", hrv.numRR, rr.size(), hrv.sdnn,
+           ref.sdnn, hrv.rmssd, ref.rmssd);
+    return hrv.numRR != rr.size() || fabs(hrv.sdnn - ref.sdnn) > 1e-3 * ref.sdnn || fabs(hrv.rmssd - ref.rmssd) > 1e-3;
+}
+
+static int
+check_ecg(void) {
+    /**
+     * @brief Overlapping windows of synthetic ECG peaks against feeding each beat once, and the metrics
+     * against batch HRV of the normal-to-normal and of every RR
+     */
+    std::mt19937 rng(0x4b48);
+    std::vector<ecg_beat_t> beats;
+    const std::vector<float> ecg = synthesize_ecg(rng, {REPLAY_SEC, 0.04f, 0.04f, false, false, 65.0f}, beats);
+    hk_hrv_reset();
+    uint32_t accepted = 0;
+    for (const ecg_beat_t &beat : beats) {
+        accepted += hk_hrv_push(beat.peak);
+    }
+    hk_hrv_t once;
+    hk_hrv_metrics(&once);
+    // As the HRV head feeds every peak of each window
+    hk_hrv_reset();
+    size_t first = 0;
+    for (uint32_t start = 0; start + HK_DATA_LEN <= ecg.size(); start += WINDOW_STEP) {
+        while (first < beats.size() && beats[first].peak < start) {
+            first++;
+        }
+        for (size_t b = first; b < beats.size() && beats[b].peak < start + HK_DATA_LEN; b++) {
+            hk_hrv_push(beats[b].peak);
+        }
+    }
+    hk_hrv_t windowed;
+    hk_hrv_metrics(&windowed);
+    // Batch over the last beats holding as many normal-to-normal intervals as the engine's window
+    auto normal = [&](size_t b) { return beats[b].label == HeartBeatNormal && beats[b - 1].label == HeartBeatNormal; };
+    size_t b0 = beats.size() - 1;
+    for (uint32_t count = 0; b0 > 1 && count < once.numRR; b0--) {
+        count += normal(b0);
+    }
+    std::vector<double> nn, nnPrev, all, allPrev;
+    for (size_t b = b0 + 1; b < beats.size(); b++) {
+        const double rr = 1000.0 * (beats[b].peak - beats[b - 1].peak) / SAMPLE_RATE;
+        const double prevRR = 1000.0 * (beats[b - 1].peak - beats[b - 2].peak) / SAMPLE_RATE;
+        all.push_back(rr);
+        allPrev.push_back(prevRR);
+        if (normal(b)) {
+            nn.push_back(rr);
+            nnPrev.push_back(normal(b - 1) ? prevRR : NAN);
+        }
+    }
+    const batch_hrv_t nnRef = batch_hrv(nn, nnPrev), allRef = batch_hrv(all, allPrev);
+    printf("ECG: %zu beats, %u RR accepted, window %u RR\n", beats.size(), accepted, once.numRR);
+    printf(" engine     SDNN=%6.1f RMSSD=%6.1f pNN50=%5.1f%% LF/HF=%.2f\n", once.sdnn, once.rmssd, once.pnn50,
+           once.hfPower > 0 ? once.lfPower / once.hfPower : 0);
+    printf(" batch NN   SDNN=%6.1f RMSSD=%6.1f pNN50=%5.1f%%\n", nnRef.sdnn, nnRef.rmssd, nnRef.pnn50);
+    printf(" batch RR   SDNN=%6.1f RMSSD=%6.1f pNN50=%5.1f%%\n", allRef.sdnn, allRef.rmssd, allRef.pnn50);
+    const bool same = windowed.numRR == once.numRR && windowed.sdnn == once.sdnn && windowed.rmssd == once.rmssd &&
+                      windowed.pnn50 == once.pnn50 && windowed.lfPower == once.lfPower && windowed.hfPower == once.hfPower;
+    printf(" overlapping windows: %s\n", same ? "same metrics" : "DIFFERENT metrics");
+    return !same || fabs(once.sdnn - nnRef.sdnn) > 0.1 * nnRef.sdnn || fabs(once.rmssd - nnRef.rmssd) > 0.1 * nnRef.rmssd;
+}
+
+static void
+bench(void) {
+    /**
+     * @brief Host time per push, spectra included, and per spectrum
+     */
+    std::vector<uint32_t> peaks;
+    double t = 1.0;
+    for (int b = 0; b < 20000; b++) {
+        t += (MOD_RR + LF_AMP * sin(2 * M_PI * LF_HZ * t)) / 1000.0;
+        peaks.push_back((uint32_t)lround(t * SAMPLE_RATE));
+    }
+    hk_hrv_reset();
+    auto t0 = std::chrono::steady_clock::now();
+    for (uint32_t peak : peaks) {
+        hk_hrv_push(peak);
+    }
+    const double pushUs = std::chrono::duration<double, std::micro>(std::chrono::steady_clock::now() - t0).count() / peaks.size();
+    printf("host: %.2f us per push with a spectrum every %d beats (reference DFT, not the CMSIS FFT)\n", pushUs, HK_HRV_SPECTRUM_BEATS);
+}
+
+int
+main(void) {
+    int failures = hk_hrv_init();
+    failures += check_running();
+    failures += check_spectrum();
+    failures += check_gap();
+    failures += check_ecg();
+    bench();
+    return failures ? 1 : 0;
+}
@@ -0,0 +1,290 @@
+/**
+ * @file int4_pass.cc
+ * @author Adam Page (adam.page@ambiq.com)
+ * @brief Model fuser pass that requantizes weights to packed int4
+ * @version 1.0
+ * @date 2023-05-02
+ *
+ * @copyright Copyright (c) 2023
+ *
+ * Requantizes the int8 weights of unit-height CONV_2D, FULLY_CONNECTED and the HK_MBCONV
+ * projection to int4, symmetric in [-7, 7] with one scale per output channel:
+ *
+ *   scale4[c] = scale8[c] * max|q8[c]| / 7,  q4 = round(q8 * 7 / max|q8[c]|)
+ *
+ * and packs them as conv1d_s4 reads them (src/conv1d_kernels.h). CONV_2D and FULLY_CONNECTED
+ * become HK_CONV_S4 (src/conv_s4_kernels.cc); HK_MBCONV keeps its op with projInt4 set and the
+ * projection part of its requant tensor recomputed. Biases are rescaled to the new filter scales.
+ * Depthwise filters (a few percent of the weights), filters with rows of fewer than 8 values (the
+ * input convs, which are the most sensitive and gain nothing) and the HK_CONCAT_CONV slices,
+ * which StreamModel reads directly, stay int8.
+ *
+ * Unlike the other passes the result is not bit-identical, so model_fuser.cc only runs it on the
+ * models selected with --int4 and reports how far the outputs move instead of checking them.
+ */
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <vector>
+
+#include "tensorflow/lite/kernels/internal/quantization_util.h"
+#include "tensorflow/lite/kernels/padding.h"
+#include "tensorflow/lite/schema/schema_generated.h"
+
+#include "conv1d_kernels.h"
+#include "conv_s4_kernels.h"
+#include "mbconv_kernels.h"
+#include "model_fuser.h"
+
+#define S4_MAX (7)
+
+// HK_MBCONV inputs (mbconv_kernels.cc)
+enum { kMbconvInput = 0, kMbconvRequant = 3, kMbconvProjFilter = 5, kMbconvProjBias = 6 };
+
+typedef struct {
+    std::vector<uint8_t> packed; // [outCh, conv1d_s4_row_bytes(rowLen)]
+    std::vector<float> scales;   // Per output channel
+    std::vector<double> rescale; // Per output channel int8 / int4 scale (bias rescale)
+} s4_filter_t;
+
+static bool
+pack_filter(const tflite::ModelT &model, const tflite::TensorT &filter, int32_t outCh, s4_filter_t *s4) {
+    /**
+     * @brief Requantize an int8 filter of outCh rows (output channel first) to packed int4
+     * @return false if the filter is not a constant int8 filter with per-tensor or per-output-channel scales
+     */
+    const std::vector<uint8_t> &data = model.buffers[filter.buffer]->data;
+    if (filter.type != tflite::TensorType_INT8 || !filter.quantization || filter.quantization->scale.empty() || data.empty() ||
+        data.size() % outCh != 0) {
+        return false;
+    }
+    const std::vector<float> &scales = filter.quantization->scale;
+    if (scales.size() > 1 && (scales.size() != (size_t)outCh || filter.quantization->quantized_dimension != 0)) {
+        return false;
+    }
+    for (int64_t zeroPoint : filter.quantization->zero_point) {
+        if (zeroPoint != 0) {
+            return false;
+        }
+    }
+    // Rows shorter than a nibble group (the input convs) would save at most 3 bytes each
+    const int32_t rowLen = data.size() / outCh;
+    if (rowLen < 8) {
+        return false;
+    }
+    const int32_t rowBytes = conv1d_s4_row_bytes(rowLen);
+    s4->packed.assign(outCh * rowBytes, 0);
+    s4->scales.resize(outCh);
+    s4->rescale.resize(outCh);
+    for (int32_t c = 0; c < outCh; c++) {
+        const int8_t *row = (const int8_t *)&data[c * rowLen];
+        int32_t maxAbs = 0;
+        for (int32_t j = 0; j < rowLen; j++) {
+            maxAbs = std::max(maxAbs, std::abs((int32_t)row[j]));
+        }
+        const float scale = scales.size() > 1 ? scales[c] : scales[0];
+        // An all-zero channel keeps its scale (and its zero weights)
+        maxAbs = maxAbs ? maxAbs : S4_MAX;
+        s4->scales[c] = scale * (float)maxAbs / S4_MAX;
+        s4->rescale[c] = (double)scale / (double)s4->scales[c];
+        for (int32_t j = 0; j < rowLen; j++) {
+            int32_t q = (int32_t)std::lround((double)row[j] * S4_MAX / maxAbs);
+            q = std::min(std::max(q, -S4_MAX), S4_MAX);
+            uint8_t &b = s4->packed[c * rowBytes + (j / 8) * 4 + (j % 4)];
+            b |= (j % 8) < 4 ? (q & 0x0F) : (q & 0x0F) << 4;
+        }
+    }
+    return true;
+}
+
+static int32_t
+add_packed_filter(tflite::ModelT &model, const tflite::TensorT &filter, const s4_filter_t &s4) {
+    /**
+     * @brief Add the packed filter [outCh, 1, 1, rowBytes] with its int4 scales
+     * @return Tensor index
+     */
+    const int32_t outCh = s4.scales.size();
+    const int32_t t = add_const_tensor(model, filter.name + "/hk_s4", tflite::TensorType_INT8, {outCh, 1, 1, (int32_t)s4.packed.size() / outCh},
+                                       s4.packed.data(), s4.packed.size());
+    std::unique_ptr<tflite::QuantizationParametersT> quantization(new tflite::QuantizationParametersT());
+    quantization->scale = s4.scales;
+    quantization->zero_point.assign(outCh, 0);
+    quantization->quantized_dimension = 0;
+    model.subgraphs[0]->tensors[t]->quantization = std::move(quantization);
+    return t;
+}
+
+static int32_t
+add_rescaled_bias(tflite::ModelT &model, const tflite::TensorT &bias, float inScale, const s4_filter_t &s4) {
+    /**
+     * @brief Add bias requantized to input scale * int4 filter scale
+     * @return Tensor index, or -1 if bias is not int32 [outCh]
+     */
+    const std::vector<uint8_t> &data = model.buffers[bias.buffer]->data;
+    const size_t outCh = s4.scales.size();
+    if (bias.type != tflite::TensorType_INT32 || data.size() != outCh * sizeof(int32_t)) {
+        return -1;
+    }
+    std::vector<int32_t> values(outCh);
+    memcpy(values.data(), data.data(), data.size());
+    std::vector<float> scales(outCh);
+    for (size_t c = 0; c < outCh; c++) {
+        values[c] = (int32_t)std::lround(values[c] * s4.rescale[c]);
+        scales[c] = inScale * s4.scales[c];
+    }
+    const int32_t t = add_const_tensor(model, bias.name + "/hk_s4", tflite::TensorType_INT32, {(int32_t)outCh}, values.data(),
+                                       values.size() * sizeof(int32_t));
+    std::unique_ptr<tflite::QuantizationParametersT> quantization(new tflite::QuantizationParametersT());
+    quantization->scale = scales;
+    quantization->zero_point.assign(outCh, 0);
+    model.subgraphs[0]->tensors[t]->quantization = std::move(quantization);
+    return t;
+}
+
+//*****************************************************************************
+//*** Rewrites
+static std::unique_ptr<tflite::OperatorT>
+rewrite_conv(tflite::ModelT &model, const tflite::OperatorT &op, int32_t *opcode) {
+    /**
+     * @brief HK_CONV_S4 for a unit-height CONV_2D or a FULLY_CONNECTED of one row
+     * @return Operator, or null if op does not match
+     */
+    tflite::SubGraphT &subgraph = *model.subgraphs[0];
+    if (op.inputs.size() != 3 || op.inputs[2] < 0) {
+        return nullptr;
+    }
+    const tflite::TensorT &input = *subgraph.tensors[op.inputs[0]];
+    const tflite::TensorT &filter = *subgraph.tensors[op.inputs[1]];
+    const tflite::TensorT &output = *subgraph.tensors[op.outputs[0]];
+    float inScale, outScale;
+    int32_t inZeroPoint, outZeroPoint;
+    if (!tensor_quant(input, &inScale, &inZeroPoint) || !tensor_quant(output, &outScale, &outZeroPoint) || input.shape.empty()) {
+        return nullptr;
+    }
+    hk_conv_s4_options_t opts;
+    memset(&opts, 0, sizeof(opts));
+    opts.version = HK_CONV_S4_OPTIONS_VERSION;
+    if (const tflite::Conv2DOptionsT *convOpts = op.builtin_options.AsConv2DOptions()) {
+        if (!is_1d(input) || !is_1d(output) || filter.shape.size() != 4 || filter.shape[1] != 1 || convOpts->stride_h != 1 ||
+            convOpts->dilation_w_factor != 1 || convOpts->dilation_h_factor != 1 || filter.shape[2] > UINT8_MAX ||
+            !convert_activation(convOpts->fused_activation_function, &opts.activation)) {
+            return nullptr;
+        }
+        int outHeight, outWidth;
+        TfLitePaddingValues padding = tflite::ComputePaddingHeightWidth(
+            1, convOpts->stride_w, 1, 1, 1, input.shape[2], 1, filter.shape[2],
+            convOpts->padding == tflite::Padding_SAME ? kTfLitePaddingSame : kTfLitePaddingValid, &outHeight, &outWidth);
+        if (outWidth != output.shape[2] || padding.width > UINT8_MAX || convOpts->stride_w > UINT8_MAX) {
+            return nullptr;
+        }
+        opts.stride = convOpts->stride_w;
+        opts.padding = padding.width;
+        opts.kLen = filter.shape[2];
+    } else if (const tflite::FullyConnectedOptionsT *fcOpts = op.builtin_options.AsFullyConnectedOptions()) {
+        size_t inLen = 1;
+        for (int32_t dim : input.shape) {
+            inLen *= dim;
+        }
+        // One input row of filter.shape[1] values
+        if (filter.shape.size() != 2 || inLen != (size_t)filter.shape[1] || input.shape.back() != filter.shape[1] ||
+            output.shape.back() != filter.shape[0] || fcOpts->weights_format != tflite::FullyConnectedOptionsWeightsFormat_DEFAULT ||
+            !convert_activation(fcOpts->fused_activation_function, &opts.activation)) {
+            return nullptr;
+        }
+        opts.stride = 1;
+        opts.kLen = 1;
+    } else {
+        return nullptr;
+    }
+    s4_filter_t s4;
+    const int32_t outCh = filter.shape[0];
+    if (!pack_filter(model, filter, outCh, &s4)) {
+        return nullptr;
+    }
+    const int32_t bias = add_rescaled_bias(model, *subgraph.tensors[op.inputs[2]], inScale, s4);
+    if (bias < 0) {
+        return nullptr;
+    }
+    const int32_t packed = add_packed_filter(model, filter, s4);
+    *opcode = *opcode < 0 ? custom_opcode(model, HK_CONV_S4_OP_NAME) : *opcode;
+    return custom_op(*opcode, {op.inputs[0], packed, bias}, op.outputs, &opts, sizeof(opts));
+}
+
+static bool
+rewrite_mbconv(tflite::ModelT &model, tflite::OperatorT &op) {
+    /**
+     * @brief Pack the projection filter of an HK_MBCONV in place
+     * @return false if op was left unchanged
+     */
+    tflite::SubGraphT &subgraph = *model.subgraphs[0];
+    hk_mbconv_options_t opts;
+    memset(&opts, 0, sizeof(opts));
+    if (op.inputs.size() != 7 || op.custom_options.size() < offsetof(hk_mbconv_options_t, projInt4)) {
+        return false;
+    }
+    memcpy(&opts, op.custom_options.data(), std::min(op.custom_options.size(), sizeof(opts)));
+    const tflite::TensorT &filter = *subgraph.tensors[op.inputs[kMbconvProjFilter]];
+    const tflite::TensorT &output = *subgraph.tensors[op.outputs[0]];
+    const int32_t channels = subgraph.tensors[op.inputs[kMbconvInput]]->shape.back();
+    tflite::BufferT &requant = *model.buffers[subgraph.tensors[op.inputs[kMbconvRequant]]->buffer];
+    float outScale;
+    int32_t outZeroPoint;
+    if (opts.projInt4 || filter.shape.size() != 4 || !tensor_quant(output, &outScale, &outZeroPoint)) {
+        return false;
+    }
+    const int32_t outCh = filter.shape[0];
+    s4_filter_t s4;
+    if (requant.data.size() != (size_t)(2 * channels + 2 * outCh) * sizeof(int32_t) || !pack_filter(model, filter, outCh, &s4)) {
+        return false;
+    }
+    const int32_t bias = add_rescaled_bias(model, *subgraph.tensors[op.inputs[kMbconvProjBias]], opts.mulScale, s4);
+    if (bias < 0) {
+        return false;
+    }
+
+    // Projection multipliers then shifts follow the depthwise ones
+    const double projScale = opts.residual ? opts.projScale : outScale;
+    int32_t *proj = (int32_t *)&requant.data[2 * channels * sizeof(int32_t)];
+    for (int32_t c = 0; c < outCh; c++) {
+        int32_t multiplier;
+        int shift;
+        tflite::QuantizeMultiplier((double)opts.mulScale * (double)s4.scales[c] / projScale, &multiplier, &shift);
+        memcpy(&proj[c], &multiplier, sizeof(multiplier));
+        memcpy(&proj[outCh + c], &shift, sizeof(shift));
+    }
+    op.inputs[kMbconvProjFilter] = add_packed_filter(model, filter, s4);
+    op.inputs[kMbconvProjBias] = bias;
+    opts.version = HK_MBCONV_OPTIONS_VERSION;
+    opts.projInt4 = 1;
+    op.custom_options.assign((const uint8_t *)&opts, (const uint8_t *)&opts + sizeof(opts));
+    return true;
+}
+
+size_t
+quantize_int4(tflite::ModelT &model) {
+    /**
+     * @brief Requantize every matching conv, fully connected and MBConv projection to int4
+     * @return Number of operators rewritten
+     */
+    tflite::SubGraphT &subgraph = *model.subgraphs[0];
+    std::vector<std::unique_ptr<tflite::OperatorT>> replaced(subgraph.operators.size());
+    std::vector<bool> removed(subgraph.operators.size(), false);
+    size_t rewritten = 0;
+    int32_t opcode = -1;
+    for (size_t i = 0; i < subgraph.operators.size(); i++) {
+        tflite::OperatorT &op = *subgraph.operators[i];
+        const tflite::BuiltinOperator code = op_code(model, op);
+        if (code == tflite::BuiltinOperator_CONV_2D || code == tflite::BuiltinOperator_FULLY_CONNECTED) {
+            replaced[i] = rewrite_conv(model, op, &opcode);
+            rewritten += replaced[i] != nullptr;
+        } else if (code == tflite::BuiltinOperator_CUSTOM &&
+                   model.operator_codes[op.opcode_index]->custom_code == HK_MBCONV_OP_NAME) {
+            rewritten += rewrite_mbconv(model, op);
+        }
+    }
+    replace_ops(subgraph, replaced, removed);
+    return rewritten;
+}
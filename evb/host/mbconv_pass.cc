@@ -0,0 +1,261 @@
+/**
+ * @file mbconv_pass.cc
+ * @author Adam Page (adam.page@ambiq.com)
+ * @brief Model fuser pass that rewrites MBConv blocks into the HK_MBCONV custom ops
+ * @version 1.0
+ * @date 2023-05-02
+ *
+ * @copyright Copyright (c) 2023
+ *
+ * Matches DEPTHWISE_CONV_2D -> [MAX_POOL_2D] -> {MEAN, MUL} ... MUL -> CONV_2D (1x1) -> [ADD with the
+ * block input] and replaces it with HK_MBCONV_SQUEEZE (at the MEAN) and HK_MBCONV (at the MUL),
+ * leaving the SE layers between them untouched (see src/mbconv_kernels.cc). Quantization of the
+ * tensors that are no longer materialized goes into the custom options, and the per-channel
+ * requantization of both convs into a constant tensor shared by the pair.
+ */
+#include <cstdint>
+#include <cstring>
+#include <string>
+#include <vector>
+
+#include "tensorflow/lite/kernels/internal/quantization_util.h"
+#include "tensorflow/lite/schema/schema_generated.h"
+
+#include "mbconv_kernels.h"
+#include "model_fuser.h"
+
+typedef struct {
+    int32_t squeezeAt; // Operator replaced by HK_MBCONV_SQUEEZE (MEAN)
+    int32_t exciteAt;  // Operator replaced by HK_MBCONV (MUL)
+    std::vector<int32_t> removed;
+    std::vector<int32_t> squeezeInputs;
+    std::vector<int32_t> squeezeOutputs;
+    std::vector<int32_t> exciteInputs;
+    std::vector<int32_t> exciteOutputs;
+    std::vector<int32_t> requant; // Per-channel requantization, see mbconv_kernels.h
+    hk_mbconv_options_t opts;
+} mbconv_match_t;
+
+// Fused op inputs shared by both ops
+enum { kMatchDwFilter = 1, kMatchRequant = 3 };
+
+//*****************************************************************************
+//*** Helpers
+static uint8_t
+convert_padding(tflite::Padding padding) {
+    return padding == tflite::Padding_SAME ? kTfLitePaddingSame : kTfLitePaddingValid;
+}
+
+static bool
+is_mean_axes_1_2(const tflite::ModelT &model, const tflite::SubGraphT &subgraph, const tflite::OperatorT &op) {
+    /**
+     * @brief MEAN over axes 1 and 2 with kept dims (the SE squeeze)
+     */
+    const tflite::ReducerOptionsT *opts = op.builtin_options.AsReducerOptions();
+    if (opts == nullptr || !opts->keep_dims || op.inputs.size() != 2) {
+        return false;
+    }
+    const std::vector<uint8_t> &axis = model.buffers[subgraph.tensors[op.inputs[1]]->buffer]->data;
+    int32_t axes[2];
+    if (axis.size() != sizeof(axes)) {
+        return false;
+    }
+    memcpy(axes, axis.data(), sizeof(axes));
+    return (axes[0] == 1 && axes[1] == 2) || (axes[0] == 2 && axes[1] == 1);
+}
+
+static void
+append_requant(std::vector<int32_t> &requant, float inScale, const tflite::TensorT &filter, int32_t channels, float outScale) {
+    /**
+     * @brief Append per-channel multipliers then shifts, as PopulateConvolutionQuantizationParams
+     */
+    const std::vector<float> &scales = filter.quantization->scale;
+    std::vector<int32_t> shifts(channels);
+    for (int32_t c = 0; c < channels; c++) {
+        const double scale = (double)(scales.size() > 1 ? scales[c] : scales[0]);
+        int32_t multiplier;
+        int shift;
+        tflite::QuantizeMultiplier((double)inScale * scale / (double)outScale, &multiplier, &shift);
+        requant.push_back(multiplier);
+        shifts[c] = shift;
+    }
+    requant.insert(requant.end(), shifts.begin(), shifts.end());
+}
+
+//*****************************************************************************
+//*** Matching
+static bool
+match_block(const tflite::ModelT &model, const tflite::SubGraphT &subgraph, const std::vector<std::vector<int32_t>> &consumers,
+            int32_t dwIdx, mbconv_match_t *match) {
+    /**
+     * @brief Match an MBConv block starting at a depthwise conv
+     * @return true if the block can be fused
+     */
+    const auto &ops = subgraph.operators;
+    const tflite::OperatorT &dw = *ops[dwIdx];
+    const tflite::DepthwiseConv2DOptionsT *dwOpts = dw.builtin_options.AsDepthwiseConv2DOptions();
+    hk_mbconv_options_t &opts = match->opts;
+    memset(&opts, 0, sizeof(opts));
+    opts.version = HK_MBCONV_OPTIONS_VERSION;
+    if (dwOpts == nullptr || dw.inputs.size() != 3 || dw.inputs[2] < 0 || dwOpts->depth_multiplier > 1 || dwOpts->stride_h != 1 ||
+        dwOpts->dilation_w_factor != 1 || dwOpts->dilation_h_factor != 1 || !convert_activation(dwOpts->fused_activation_function, &opts.dwActivation)) {
+        return false;
+    }
+    const int32_t input = dw.inputs[0];
+    const tflite::TensorT &inTensor = *subgraph.tensors[input];
+    const tflite::TensorT &dwFilter = *subgraph.tensors[dw.inputs[1]];
+    // Options are packed, so quantization goes through locals
+    float scale, dwScale, mulScale, projScale;
+    int32_t zeroPoint, dwZeroPoint, mulZeroPoint, projZeroPoint;
+    if (!is_1d(inTensor) || !tensor_quant(inTensor, &scale, &zeroPoint) || dwFilter.shape.size() != 4 || dwFilter.shape[1] != 1 ||
+        dwFilter.shape[3] != inTensor.shape[3] || !tensor_quant(*subgraph.tensors[dw.outputs[0]], &dwScale, &dwZeroPoint)) {
+        return false;
+    }
+    opts.dwScale = dwScale;
+    opts.dwZeroPoint = dwZeroPoint;
+    opts.dwStride = dwOpts->stride_w;
+    opts.dwPadding = convert_padding(dwOpts->padding);
+    match->removed = {dwIdx};
+
+    // Optional max pool (same quantization in and out)
+    int32_t block = dw.outputs[0];
+    if (consumers[block].size() == 1 && op_code(model, *ops[consumers[block][0]]) == tflite::BuiltinOperator_MAX_POOL_2D) {
+        const int32_t poolIdx = consumers[block][0];
+        const tflite::Pool2DOptionsT *poolOpts = ops[poolIdx]->builtin_options.AsPool2DOptions();
+        float poolScale;
+        int32_t poolZeroPoint;
+        if (poolOpts == nullptr || poolOpts->filter_height != 1 || poolOpts->stride_h != 1 ||
+            !convert_activation(poolOpts->fused_activation_function, &opts.poolActivation) ||
+            !tensor_quant(*subgraph.tensors[ops[poolIdx]->outputs[0]], &poolScale, &poolZeroPoint) || poolScale != opts.dwScale ||
+            poolZeroPoint != opts.dwZeroPoint) {
+            return false;
+        }
+        opts.poolSize = poolOpts->filter_width;
+        opts.poolStride = poolOpts->stride_w;
+        opts.poolPadding = convert_padding(poolOpts->padding);
+        match->removed.push_back(poolIdx);
+        block = ops[poolIdx]->outputs[0];
+    }
+
+    // Block output feeds exactly the SE MEAN and MUL
+    if (consumers[block].size() != 2) {
+        return false;
+    }
+    int32_t meanIdx = consumers[block][0], mulIdx = consumers[block][1];
+    if (op_code(model, *ops[meanIdx]) != tflite::BuiltinOperator_MEAN) {
+        std::swap(meanIdx, mulIdx);
+    }
+    if (op_code(model, *ops[meanIdx]) != tflite::BuiltinOperator_MEAN || op_code(model, *ops[mulIdx]) != tflite::BuiltinOperator_MUL ||
+        meanIdx > mulIdx || ops[meanIdx]->inputs[0] != block || !is_mean_axes_1_2(model, subgraph, *ops[meanIdx])) {
+        return false;
+    }
+    const tflite::OperatorT &mul = *ops[mulIdx];
+    const tflite::MulOptionsT *mulOpts = mul.builtin_options.AsMulOptions();
+    const int32_t seScale = mul.inputs[0] == block ? mul.inputs[1] : mul.inputs[0];
+    size_t seLen = 1;
+    for (int32_t dim : subgraph.tensors[seScale]->shape) {
+        seLen *= dim;
+    }
+    if (mulOpts == nullptr || seScale == block || seLen != (size_t)inTensor.shape[3] ||
+        !convert_activation(mulOpts->fused_activation_function, &opts.mulActivation) ||
+        !tensor_quant(*subgraph.tensors[mul.outputs[0]], &mulScale, &mulZeroPoint)) {
+        return false;
+    }
+    opts.mulScale = mulScale;
+    opts.mulZeroPoint = mulZeroPoint;
+
+    // Pointwise projection
+    const int32_t scaled = mul.outputs[0];
+    if (consumers[scaled].size() != 1 || op_code(model, *ops[consumers[scaled][0]]) != tflite::BuiltinOperator_CONV_2D) {
+        return false;
+    }
+    const int32_t projIdx = consumers[scaled][0];
+    const tflite::OperatorT &proj = *ops[projIdx];
+    const tflite::Conv2DOptionsT *projOpts = proj.builtin_options.AsConv2DOptions();
+    const tflite::TensorT &projFilter = *subgraph.tensors[proj.inputs[1]];
+    if (projOpts == nullptr || proj.inputs.size() != 3 || proj.inputs[2] < 0 || proj.inputs[0] != scaled || projOpts->stride_w != 1 ||
+        projOpts->stride_h != 1 || projOpts->dilation_w_factor != 1 || projOpts->dilation_h_factor != 1 || projFilter.shape.size() != 4 ||
+        projFilter.shape[1] != 1 || projFilter.shape[2] != 1 || !convert_activation(projOpts->fused_activation_function, &opts.projActivation)) {
+        return false;
+    }
+    match->removed.push_back(meanIdx);
+    match->removed.push_back(mulIdx);
+    match->removed.push_back(projIdx);
+
+    // Optional residual add of the block input
+    int32_t output = proj.outputs[0];
+    const std::vector<int32_t> &projConsumers = consumers[output];
+    if (projConsumers.size() == 1 && op_code(model, *ops[projConsumers[0]]) == tflite::BuiltinOperator_ADD) {
+        const tflite::OperatorT &add = *ops[projConsumers[0]];
+        const tflite::AddOptionsT *addOpts = add.builtin_options.AsAddOptions();
+        const int32_t other = add.inputs[0] == output ? add.inputs[1] : add.inputs[0];
+        if (other == input && addOpts != nullptr && subgraph.tensors[output]->shape == inTensor.shape &&
+            convert_activation(addOpts->fused_activation_function, &opts.addActivation) &&
+            tensor_quant(*subgraph.tensors[output], &projScale, &projZeroPoint)) {
+            opts.residual = 1;
+            opts.projScale = projScale;
+            opts.projZeroPoint = projZeroPoint;
+            match->removed.push_back(projConsumers[0]);
+            output = add.outputs[0];
+        }
+    }
+    float outScale;
+    int32_t outZeroPoint;
+    if (!tensor_quant(*subgraph.tensors[output], &outScale, &outZeroPoint) || !dwFilter.quantization || !projFilter.quantization ||
+        dwFilter.quantization->scale.empty() || projFilter.quantization->scale.empty()) {
+        return false;
+    }
+    match->requant.clear();
+    append_requant(match->requant, scale, dwFilter, inTensor.shape[3], opts.dwScale);
+    append_requant(match->requant, opts.mulScale, projFilter, projFilter.shape[0], opts.residual ? opts.projScale : outScale);
+    match->squeezeAt = meanIdx;
+    match->exciteAt = mulIdx;
+    // Requant tensor (index 3) is added once matching is done
+    match->squeezeInputs = {input, dw.inputs[1], dw.inputs[2], -1};
+    match->squeezeOutputs = {ops[meanIdx]->outputs[0]};
+    match->exciteInputs = {input, dw.inputs[1], dw.inputs[2], -1, seScale, proj.inputs[1], proj.inputs[2]};
+    match->exciteOutputs = {output};
+    return true;
+}
+
+//*****************************************************************************
+//*** Rewrite
+size_t
+fuse_mbconv(tflite::ModelT &model) {
+    /**
+     * @brief Fuse every matching MBConv block of subgraph 0
+     * @return Number of blocks fused
+     */
+    tflite::SubGraphT &subgraph = *model.subgraphs[0];
+    const std::vector<std::vector<int32_t>> consumers = tensor_consumers(subgraph);
+    std::vector<mbconv_match_t> matches;
+    for (size_t i = 0; i < subgraph.operators.size(); i++) {
+        mbconv_match_t match;
+        if (op_code(model, *subgraph.operators[i]) == tflite::BuiltinOperator_DEPTHWISE_CONV_2D &&
+            match_block(model, subgraph, consumers, i, &match)) {
+            matches.push_back(match);
+        }
+    }
+    if (matches.empty()) {
+        return 0;
+    }
+
+    const int32_t squeezeCode = custom_opcode(model, HK_MBCONV_SQUEEZE_OP_NAME);
+    const int32_t exciteCode = custom_opcode(model, HK_MBCONV_OP_NAME);
+    std::vector<std::unique_ptr<tflite::OperatorT>> replaced(subgraph.operators.size());
+    std::vector<bool> removed(subgraph.operators.size(), false);
+    for (mbconv_match_t &match : matches) {
+        const std::string &name = subgraph.tensors[match.squeezeInputs[kMatchDwFilter]]->name;
+        const int32_t requant = add_const_tensor(model, name + "/hk_requant", tflite::TensorType_INT32, {(int32_t)match.requant.size()},
+                                                 match.requant.data(), match.requant.size() * sizeof(int32_t));
+        match.squeezeInputs[kMatchRequant] = match.exciteInputs[kMatchRequant] = requant;
+        for (int32_t i : match.removed) {
+            removed[i] = true;
+        }
+        replaced[match.squeezeAt] = custom_op(squeezeCode, match.squeezeInputs, match.squeezeOutputs, &match.opts, sizeof(match.opts));
+        replaced[match.exciteAt] = custom_op(exciteCode, match.exciteInputs, match.exciteOutputs, &match.opts, sizeof(match.opts));
+    }
+    replace_ops(subgraph, replaced, removed);
+    return matches.size();
+}
+
@@ -0,0 +1,234 @@
+/**
+ * @file model_fuser.cc
+ * @author Adam Page (adam.page@ambiq.com)
+ * @brief Host tool that rewrites the exported models with the HeartKit custom ops
+ * @version 1.0
+ * @date 2023-05-02
+ *
+ * @copyright Copyright (c) 2023
+ *
+ * Runs each pass of model_fuser.h over every model header: MBConv blocks (mbconv_pass.cc), then
+ * transpose convs as convs over their (possibly concatenated) inputs (concat_pass.cc). Operators whose outputs nothing reads, and
+ * tensors and constant buffers left unused, are then dropped, as is any offline memory plan (its
+ * tensor indices are stale), so run the planner afterwards.
+ *
+ * Each rewritten model is checked bit-exact against the original on random inputs before its
+ * header in src/ is rewritten. Models no pass changes are left untouched.
+ *
+ * Models named with --int4 (header basename, or all) then get their weights requantized to int4
+ * (int4_pass.cc). That is lossy, so instead of the bit-exact check the tool reports the flash size
+ * against the int8 model and how far the outputs move on the same random inputs: how often the
+ * top output channel of each output row agrees, and the mean and max output difference in LSBs.
+ * Random inputs only bound the drift; accuracy on ECG comes from the export report
+ * (int4_weights in the export config). --dry-run reports without writing headers.
+ *
+ * Build: make -C evb/host fuse [HK_INT4_MODELS=...], make -C evb/host int4 (report only)
+ */
+#include <algorithm>
+#include <chrono>
+#include <cstdlib>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <random>
+#include <string>
+#include <vector>
+
+#include "tensorflow/lite/micro/all_ops_resolver.h"
+#include "tensorflow/lite/micro/micro_error_reporter.h"
+#include "tensorflow/lite/micro/recording_micro_interpreter.h"
+#include "tensorflow/lite/schema/schema_generated.h"
+#include "tensorflow/lite/schema/schema_utils.h"
+
+#include "custom_ops.h"
+#include "model_fuser.h"
+#include "model_header.h"
+
+#define ARENA_MAX_SIZE (1024 * 1024)
+#define VERIFY_INPUTS (8)
+#define TIMING_RUNS (20)
+
+typedef struct {
+    size_t arenaBytes; // Arena used (persistent and non-persistent)
+    double invokeUs;   // Mean Invoke() time
+    std::vector<std::vector<int8_t>> outputs;
+} run_result_t;
+
+typedef struct {
+    const char *name;
+    size_t (*run)(tflite::ModelT &model);
+} fuser_pass_t;
+
+static const fuser_pass_t passes[] = {
+    {"mbconv", fuse_mbconv},
+    {"concat", fuse_concat},
+};
+
+//*****************************************************************************
+//*** Verification
+static int
+run_model(const std::vector<uint8_t> &fb, const tflite::MicroOpResolver &resolver, tflite::ErrorReporter *reporter,
+          const std::vector<std::vector<int8_t>> &inputs, run_result_t *result) {
+    /**
+     * @brief Invoke model on each input, keeping outputs, arena usage and mean invoke time
+     * @return 0 on success
+     */
+    std::vector<uint64_t> modelBuf((fb.size() + sizeof(uint64_t) - 1) / sizeof(uint64_t));
+    memcpy(modelBuf.data(), fb.data(), fb.size());
+    std::vector<uint64_t> arena(ARENA_MAX_SIZE / sizeof(uint64_t));
+    tflite::RecordingMicroInterpreter interpreter(tflite::GetModel(modelBuf.data()), resolver, (uint8_t *)arena.data(), ARENA_MAX_SIZE,
+                                                  reporter);
+    if (interpreter.AllocateTensors() != kTfLiteOk) {
+        return 1;
+    }
+    result->arenaBytes = interpreter.arena_used_bytes();
+    result->outputs.clear();
+    double totalUs = 0;
+    for (const auto &input : inputs) {
+        TfLiteTensor *in = interpreter.input(0);
+        auto start = std::chrono::steady_clock::now();
+        for (int run = 0; run < TIMING_RUNS; run++) {
+            memcpy(in->data.int8, input.data(), in->bytes);
+            if (interpreter.Invoke() != kTfLiteOk) {
+                return 1;
+            }
+        }
+        totalUs += std::chrono::duration<double, std::micro>(std::chrono::steady_clock::now() - start).count() / TIMING_RUNS;
+        TfLiteTensor *out = interpreter.output(0);
+        result->outputs.emplace_back(out->data.int8, out->data.int8 + out->bytes);
+    }
+    result->invokeUs = totalUs / inputs.size();
+    return 0;
+}
+
+static void
+report_drift(const run_result_t &ref, const run_result_t &test, int32_t channels) {
+    /**
+     * @brief Print top-1 agreement per output row (channels values) and the output difference in LSBs
+     */
+    size_t rows = 0, agree = 0, diffs = 0;
+    double sumDiff = 0;
+    int32_t maxDiff = 0;
+    for (size_t i = 0; i < ref.outputs.size(); i++) {
+        const std::vector<int8_t> &a = ref.outputs[i], &b = test.outputs[i];
+        for (size_t r = 0; r + channels <= a.size(); r += channels) {
+            agree += std::max_element(&a[r], &a[r] + channels) - &a[r] == std::max_element(&b[r], &b[r] + channels) - &b[r];
+            rows++;
+        }
+        for (size_t j = 0; j < a.size(); j++) {
+            int32_t diff = std::abs(a[j] - b[j]);
+            sumDiff += diff;
+            maxDiff = std::max(maxDiff, diff);
+            diffs++;
+        }
+    }
+    fprintf(stderr, " top-1 agree %5.1f%%, |dy| mean %.2f max %d LSB", 100.0 * agree / rows, sumDiff / diffs, (int)maxDiff);
+}
+
+int
+main(int argc, char **argv) {
+    /**
+     * @brief Run the passes on every model and rewrite its header.
+     * Arguments: [--dry-run] [--int4 <header>|all]... [src directory]
+     */
+    static tflite::MicroErrorReporter microErrorReporter;
+    static tflite::AllOpsResolver resolver;
+    add_custom_ops(resolver);
+    std::string srcDir = "../src";
+    std::vector<std::string> int4Models;
+    bool dryRun = false;
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "--dry-run") == 0) {
+            dryRun = true;
+        } else if (strcmp(argv[i], "--int4") == 0 && i + 1 < argc) {
+            int4Models.push_back(argv[++i]);
+        } else {
+            srcDir = argv[i];
+        }
+    }
+    std::mt19937 rng(0x4b48);
+    std::uniform_int_distribution<int> dist(-128, 127);
+
+    fprintf(stderr, "%-28s", "model");
+    for (const fuser_pass_t &pass : passes) {
+        fprintf(stderr, " %6s", pass.name);
+    }
+    fprintf(stderr, " %6s %7s %9s %9s %10s %10s\n", "int4", "ops", "arena", "fused", "invoke-us", "fused-us");
+    for (size_t m = 0; m < numModels; m++) {
+        const model_entry_t &entry = models[m];
+        std::unique_ptr<tflite::ModelT> model = unpack_model(entry.buf, entry.len);
+        if (model->subgraphs.size() != 1) {
+            fprintf(stderr, "%s: expected 1 subgraph, got %zu\n", entry.name, model->subgraphs.size());
+            return 1;
+        }
+        const size_t numOps = model->subgraphs[0]->operators.size();
+        fprintf(stderr, "%-28s", entry.name);
+        size_t rewrites = 0;
+        for (const fuser_pass_t &pass : passes) {
+            size_t count = pass.run(*model);
+            fprintf(stderr, " %6zu", count);
+            rewrites += count;
+        }
+        std::vector<uint8_t> original(entry.buf, entry.buf + entry.len);
+        std::vector<uint8_t> fused = original;
+        if (rewrites) {
+            cleanup(*model);
+            fused = pack_model(*model, entry.len);
+        }
+        size_t quantized = 0;
+        if (std::find(int4Models.begin(), int4Models.end(), entry.name) != int4Models.end() ||
+            std::find(int4Models.begin(), int4Models.end(), "all") != int4Models.end()) {
+            quantized = quantize_int4(*model);
+        }
+        fprintf(stderr, " %6zu", quantized);
+        if (rewrites == 0 && quantized == 0) {
+            fprintf(stderr, " %7zu (unchanged)\n", numOps);
+            continue;
+        }
+        std::vector<uint8_t> int4;
+        if (quantized) {
+            cleanup(*model);
+            int4 = pack_model(*model, entry.len);
+        }
+
+        std::vector<std::vector<int8_t>> inputs(VERIFY_INPUTS);
+        const auto &inShape = model->subgraphs[0]->tensors[model->subgraphs[0]->inputs[0]]->shape;
+        size_t inLen = 1;
+        for (int32_t dim : inShape) {
+            inLen *= dim;
+        }
+        for (auto &input : inputs) {
+            input.resize(inLen);
+            for (auto &v : input) {
+                v = (int8_t)dist(rng);
+            }
+        }
+        run_result_t before, after, after4;
+        if (run_model(original, resolver, &microErrorReporter, inputs, &before) ||
+            run_model(fused, resolver, &microErrorReporter, inputs, &after) ||
+            (quantized && run_model(int4, resolver, &microErrorReporter, inputs, &after4))) {
+            fprintf(stderr, "\n%s: invoke failed\n", entry.name);
+            return 1;
+        }
+        const run_result_t &last = quantized ? after4 : after;
+        fprintf(stderr, " %3zu>%-3zu %9zu %9zu %10.1f %10.1f\n", numOps, model->subgraphs[0]->operators.size(), before.arenaBytes,
+                last.arenaBytes, before.invokeUs, last.invokeUs);
+        if (before.outputs != after.outputs) {
+            fprintf(stderr, "%s: fused outputs differ from original, header left unchanged\n", entry.name);
+            return 1;
+        }
+        if (quantized) {
+            const int32_t channels = model->subgraphs[0]->tensors[model->subgraphs[0]->outputs[0]]->shape.back();
+            fprintf(stderr, "  int4: %zu > %zu bytes (%+.1f%%),", fused.size(), int4.size(), 100.0 * ((double)int4.size() / fused.size() - 1));
+            report_drift(before, after4, channels);
+            fprintf(stderr, "\n");
+            fused = int4;
+        }
+        std::string path = srcDir + "/" + entry.name;
+        if (!dryRun && write_model_header(path.c_str(), entry.var, fused)) {
+            fprintf(stderr, "Failed writing %s\n", path.c_str());
+            return 1;
+        }
+    }
+    return 0;
+}
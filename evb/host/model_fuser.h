@@ -0,0 +1,103 @@
+/**
+ * @file model_fuser.h
+ * @author Adam Page (adam.page@ambiq.com)
+ * @brief Graph helpers (model_graph.cc) and passes of the host model fuser
+ * @version 1.0
+ * @date 2023-05-02
+ *
+ * @copyright Copyright (c) 2023
+ *
+ * Passes rewrite subgraph 0 of an unpacked model in place and return how many rewrites they made.
+ * They may leave dead operators, tensors and buffers behind; model_fuser.cc removes those once all
+ * passes have run.
+ */
+#ifndef __MODEL_FUSER_H
+#define __MODEL_FUSER_H
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "tensorflow/lite/schema/schema_generated.h"
+
+tflite::BuiltinOperator
+op_code(const tflite::ModelT &model, const tflite::OperatorT &op);
+
+/**
+ * @brief Per-tensor int8 quantization of a tensor
+ * @return false if not per-tensor int8
+ */
+bool
+tensor_quant(const tflite::TensorT &tensor, float *scale, int32_t *zeroPoint);
+
+/**
+ * @brief Whether tensor is [1, 1, W, C]
+ */
+bool
+is_1d(const tflite::TensorT &tensor);
+
+/**
+ * @brief TfLiteFusedActivation of a clamping schema activation
+ * @return false if act is not a clamp
+ */
+bool
+convert_activation(tflite::ActivationFunctionType act, uint8_t *out);
+
+/**
+ * @brief Operators reading each tensor. Graph outputs also list -1, so they count as consumed.
+ */
+std::vector<std::vector<int32_t>>
+tensor_consumers(const tflite::SubGraphT &subgraph);
+
+/**
+ * @brief Index of custom op code, added if missing
+ */
+int32_t
+custom_opcode(tflite::ModelT &model, const char *name);
+
+/**
+ * @brief New custom operator with raw custom options
+ */
+std::unique_ptr<tflite::OperatorT>
+custom_op(int32_t opcode, const std::vector<int32_t> &inputs, const std::vector<int32_t> &outputs, const void *opts, size_t optsLen);
+
+/**
+ * @brief Add a constant tensor with its own buffer
+ * @return Tensor index
+ */
+int32_t
+add_const_tensor(tflite::ModelT &model, const std::string &name, tflite::TensorType type, const std::vector<int32_t> &shape,
+                 const void *data, size_t len);
+
+/**
+ * @brief Swap in replaced[i] for operator i (when set) and drop removed operators, keeping order
+ */
+void
+replace_ops(tflite::SubGraphT &subgraph, std::vector<std::unique_ptr<tflite::OperatorT>> &replaced, const std::vector<bool> &removed);
+
+/**
+ * @brief Remove dead operators, then tensors and constant buffers left unused, and any offline memory plan
+ */
+void
+cleanup(tflite::ModelT &model);
+
+/**
+ * @brief Keep only the operators computing outputs from inputs, which become the graph I/O, then cleanup
+ * @return false if the outputs depend on a non-constant tensor other than inputs
+ */
+bool
+extract_subgraph(tflite::ModelT &model, const std::vector<int32_t> &inputs, const std::vector<int32_t> &outputs);
+
+// Passes, run in this order
+size_t
+fuse_mbconv(tflite::ModelT &model);
+size_t
+fuse_concat(tflite::ModelT &model);
+
+// Lossy pass, run last and only on the models selected with --int4
+size_t
+quantize_int4(tflite::ModelT &model);
+
+#endif // __MODEL_FUSER_H
@@ -0,0 +1,276 @@
+/**
+ * @file model_graph.cc
+ * @author Adam Page (adam.page@ambiq.com)
+ * @brief Graph helpers of the host model tools (model_fuser.h)
+ * @version 1.0
+ * @date 2023-05-02
+ *
+ * @copyright Copyright (c) 2023
+ *
+ */
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "tensorflow/lite/schema/schema_generated.h"
+#include "tensorflow/lite/schema/schema_utils.h"
+
+#include "model_fuser.h"
+
+#define PLAN_METADATA_NAME "OfflineMemoryAllocation"
+
+//*****************************************************************************
+//*** Graph helpers
+tflite::BuiltinOperator
+op_code(const tflite::ModelT &model, const tflite::OperatorT &op) {
+    return tflite::GetBuiltinCode(model.operator_codes[op.opcode_index].get());
+}
+
+bool
+tensor_quant(const tflite::TensorT &tensor, float *scale, int32_t *zeroPoint) {
+    if (tensor.type != tflite::TensorType_INT8 || !tensor.quantization || tensor.quantization->scale.size() != 1 ||
+        tensor.quantization->zero_point.size() != 1) {
+        return false;
+    }
+    *scale = tensor.quantization->scale[0];
+    *zeroPoint = (int32_t)tensor.quantization->zero_point[0];
+    return true;
+}
+
+bool
+is_1d(const tflite::TensorT &tensor) {
+    return tensor.shape.size() == 4 && tensor.shape[0] == 1 && tensor.shape[1] == 1;
+}
+
+bool
+convert_activation(tflite::ActivationFunctionType act, uint8_t *out) {
+    // TfLiteFusedActivation matches the schema enum for the clamping activations
+    if (act == tflite::ActivationFunctionType_NONE || act == tflite::ActivationFunctionType_RELU ||
+        act == tflite::ActivationFunctionType_RELU_N1_TO_1 || act == tflite::ActivationFunctionType_RELU6) {
+        *out = (uint8_t)act;
+        return true;
+    }
+    return false;
+}
+
+std::vector<std::vector<int32_t>>
+tensor_consumers(const tflite::SubGraphT &subgraph) {
+    std::vector<std::vector<int32_t>> consumers(subgraph.tensors.size());
+    for (size_t i = 0; i < subgraph.operators.size(); i++) {
+        for (int32_t t : subgraph.operators[i]->inputs) {
+            if (t >= 0) {
+                consumers[t].push_back(i);
+            }
+        }
+    }
+    // Graph outputs have to stay materialized
+    for (int32_t t : subgraph.outputs) {
+        consumers[t].push_back(-1);
+    }
+    return consumers;
+}
+
+int32_t
+custom_opcode(tflite::ModelT &model, const char *name) {
+    for (size_t i = 0; i < model.operator_codes.size(); i++) {
+        if (tflite::GetBuiltinCode(model.operator_codes[i].get()) == tflite::BuiltinOperator_CUSTOM &&
+            model.operator_codes[i]->custom_code == name) {
+            return i;
+        }
+    }
+    std::unique_ptr<tflite::OperatorCodeT> code(new tflite::OperatorCodeT());
+    code->builtin_code = tflite::BuiltinOperator_CUSTOM;
+    code->deprecated_builtin_code = tflite::BuiltinOperator_CUSTOM;
+    code->custom_code = name;
+    code->version = 1;
+    model.operator_codes.push_back(std::move(code));
+    return model.operator_codes.size() - 1;
+}
+
+std::unique_ptr<tflite::OperatorT>
+custom_op(int32_t opcode, const std::vector<int32_t> &inputs, const std::vector<int32_t> &outputs, const void *opts, size_t optsLen) {
+    std::unique_ptr<tflite::OperatorT> op(new tflite::OperatorT());
+    op->opcode_index = opcode;
+    op->inputs = inputs;
+    op->outputs = outputs;
+    op->custom_options.assign((const uint8_t *)opts, (const uint8_t *)opts + optsLen);
+    op->custom_options_format = tflite::CustomOptionsFormat_FLEXBUFFERS;
+    return op;
+}
+
+int32_t
+add_const_tensor(tflite::ModelT &model, const std::string &name, tflite::TensorType type, const std::vector<int32_t> &shape,
+                 const void *data, size_t len) {
+    tflite::SubGraphT &subgraph = *model.subgraphs[0];
+    std::unique_ptr<tflite::BufferT> buffer(new tflite::BufferT());
+    buffer->data.assign((const uint8_t *)data, (const uint8_t *)data + len);
+    model.buffers.push_back(std::move(buffer));
+    std::unique_ptr<tflite::TensorT> tensor(new tflite::TensorT());
+    tensor->shape = shape;
+    tensor->type = type;
+    tensor->buffer = model.buffers.size() - 1;
+    tensor->name = name;
+    subgraph.tensors.push_back(std::move(tensor));
+    return subgraph.tensors.size() - 1;
+}
+
+void
+replace_ops(tflite::SubGraphT &subgraph, std::vector<std::unique_ptr<tflite::OperatorT>> &replaced, const std::vector<bool> &removed) {
+    std::vector<std::unique_ptr<tflite::OperatorT>> operators;
+    for (size_t i = 0; i < subgraph.operators.size(); i++) {
+        if (replaced[i]) {
+            operators.push_back(std::move(replaced[i]));
+        } else if (!removed[i]) {
+            operators.push_back(std::move(subgraph.operators[i]));
+        }
+    }
+    subgraph.operators = std::move(operators);
+}
+
+//*****************************************************************************
+//*** Cleanup
+static void
+strip_plan(tflite::ModelT &model) {
+    /**
+     * @brief Remove the offline memory plan, whose tensor indices no longer apply
+     */
+    for (auto it = model.metadata.begin(); it != model.metadata.end(); it++) {
+        if ((*it)->name == PLAN_METADATA_NAME) {
+            model.buffers[(*it)->buffer]->data.clear();
+            model.metadata.erase(it);
+            break;
+        }
+    }
+}
+
+static void
+remove_dead_ops(tflite::ModelT &model) {
+    /**
+     * @brief Remove operators none of whose outputs are read, until none are left
+     */
+    tflite::SubGraphT &subgraph = *model.subgraphs[0];
+    for (bool changed = true; changed;) {
+        const std::vector<std::vector<int32_t>> consumers = tensor_consumers(subgraph);
+        std::vector<std::unique_ptr<tflite::OperatorT>> replaced(subgraph.operators.size());
+        std::vector<bool> removed(subgraph.operators.size(), false);
+        changed = false;
+        for (size_t i = 0; i < subgraph.operators.size(); i++) {
+            bool dead = true;
+            for (int32_t t : subgraph.operators[i]->outputs) {
+                dead = dead && (t < 0 || consumers[t].empty());
+            }
+            removed[i] = dead;
+            changed = changed || dead;
+        }
+        replace_ops(subgraph, replaced, removed);
+    }
+}
+
+static void
+drop_unused(tflite::ModelT &model) {
+    /**
+     * @brief Remove tensors no operator or graph I/O references, and empty constant buffers no tensor references
+     */
+    tflite::SubGraphT &subgraph = *model.subgraphs[0];
+    std::vector<int32_t> remap(subgraph.tensors.size(), -1);
+    auto mark = [&](const std::vector<int32_t> &indices) {
+        for (int32_t t : indices) {
+            if (t >= 0) {
+                remap[t] = 0;
+            }
+        }
+    };
+    mark(subgraph.inputs);
+    mark(subgraph.outputs);
+    for (const auto &op : subgraph.operators) {
+        mark(op->inputs);
+        mark(op->outputs);
+        mark(op->intermediates);
+    }
+    std::vector<std::unique_ptr<tflite::TensorT>> tensors;
+    for (size_t t = 0; t < subgraph.tensors.size(); t++) {
+        if (remap[t] == 0) {
+            remap[t] = tensors.size();
+            tensors.push_back(std::move(subgraph.tensors[t]));
+        }
+    }
+    subgraph.tensors = std::move(tensors);
+    auto apply = [&](std::vector<int32_t> &indices) {
+        for (int32_t &t : indices) {
+            t = t >= 0 ? remap[t] : t;
+        }
+    };
+    apply(subgraph.inputs);
+    apply(subgraph.outputs);
+    for (auto &op : subgraph.operators) {
+        apply(op->inputs);
+        apply(op->outputs);
+        apply(op->intermediates);
+    }
+
+    // Buffer indices stay valid, unreferenced buffers are only emptied
+    std::vector<bool> used(model.buffers.size(), false);
+    for (const auto &tensor : subgraph.tensors) {
+        used[tensor->buffer] = true;
+    }
+    for (const auto &metadata : model.metadata) {
+        used[metadata->buffer] = true;
+    }
+    for (size_t b = 0; b < model.buffers.size(); b++) {
+        if (!used[b]) {
+            model.buffers[b]->data.clear();
+        }
+    }
+}
+
+void
+cleanup(tflite::ModelT &model) {
+    strip_plan(model);
+    remove_dead_ops(model);
+    drop_unused(model);
+}
+
+bool
+extract_subgraph(tflite::ModelT &model, const std::vector<int32_t> &inputs, const std::vector<int32_t> &outputs) {
+    tflite::SubGraphT &subgraph = *model.subgraphs[0];
+    std::vector<int32_t> producer(subgraph.tensors.size(), -1);
+    for (size_t i = 0; i < subgraph.operators.size(); i++) {
+        for (int32_t t : subgraph.operators[i]->outputs) {
+            if (t >= 0) {
+                producer[t] = i;
+            }
+        }
+    }
+    // Walk back from the outputs, stopping at the inputs
+    std::vector<bool> visited(subgraph.tensors.size(), false);
+    for (int32_t t : inputs) {
+        visited[t] = true;
+    }
+    std::vector<bool> removed(subgraph.operators.size(), true);
+    std::vector<int32_t> pending(outputs);
+    while (!pending.empty()) {
+        int32_t t = pending.back();
+        pending.pop_back();
+        if (t < 0 || visited[t]) {
+            continue;
+        }
+        visited[t] = true;
+        if (producer[t] < 0) {
+            if (model.buffers[subgraph.tensors[t]->buffer]->data.empty()) {
+                return false;
+            }
+            continue;
+        }
+        removed[producer[t]] = false;
+        for (int32_t in : subgraph.operators[producer[t]]->inputs) {
+            pending.push_back(in);
+        }
+    }
+    std::vector<std::unique_ptr<tflite::OperatorT>> replaced(subgraph.operators.size());
+    replace_ops(subgraph, replaced, removed);
+    subgraph.inputs = inputs;
+    subgraph.outputs = outputs;
+    cleanup(model);
+    return true;
+}
@@ -0,0 +1,64 @@
+/**
+ * @file model_header.cc
+ * @author Adam Page (adam.page@ambiq.com)
+ * @brief Host helpers for tools that rewrite the exported model headers in src/
+ * @version 1.0
+ * @date 2023-05-02
+ *
+ * @copyright Copyright (c) 2023
+ *
+ */
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+#include <string>
+
+#include "arrhythmia_model_buffer.h"
+#include "beat_model_buffer.h"
+#include "segmentation_model_buffer.h"
+
+#include "model_header.h"
+
+const model_entry_t models[] = {
+    {"arrhythmia_model_buffer.h", "g_arrhythmia_model", g_arrhythmia_model, g_arrhythmia_model_len},
+    {"segmentation_model_buffer.h", "g_segmentation_model", g_segmentation_model, g_segmentation_model_len},
+    {"beat_model_buffer.h", "g_beat_model", g_beat_model, g_beat_model_len},
+};
+const size_t numModels = sizeof(models) / sizeof(models[0]);
+
+std::unique_ptr<tflite::ModelT>
+unpack_model(const uint8_t *buf, size_t len) {
+    std::vector<uint64_t> aligned((len + sizeof(uint64_t) - 1) / sizeof(uint64_t));
+    memcpy(aligned.data(), buf, len);
+    return std::unique_ptr<tflite::ModelT>(tflite::GetModel(aligned.data())->UnPack());
+}
+
+std::vector<uint8_t>
+pack_model(const tflite::ModelT &model, size_t sizeHint) {
+    // Vendored flatbuffers has no fallback for a null allocator
+    flatbuffers::DefaultAllocator allocator;
+    flatbuffers::FlatBufferBuilder fbb(sizeHint, &allocator);
+    tflite::FinishModelBuffer(fbb, tflite::Model::Pack(fbb, &model));
+    return std::vector<uint8_t>(fbb.GetBufferPointer(), fbb.GetBufferPointer() + fbb.GetSize());
+}
+
+int
+write_model_header(const char *path, const char *var, const std::vector<uint8_t> &fb) {
+    std::string guard = std::string("__") + var + "_H";
+    std::transform(guard.begin(), guard.end(), guard.begin(), ::toupper);
+    FILE *fp = fopen(path, "w");
+    if (fp == nullptr) {
+        return 1;
+    }
+    fprintf(fp, "#ifndef %s\n#define %s\n", guard.c_str(), guard.c_str());
+    fprintf(fp, "const unsigned char %s[] __attribute__((aligned(16))) = {\n", var);
+    for (size_t i = 0; i < fb.size(); i += 12) {
+        fprintf(fp, " ");
+        for (size_t j = i; j < i + 12 && j < fb.size(); j++) {
+            fprintf(fp, " 0x%02x,", fb[j]);
+        }
+        fprintf(fp, " \n");
+    }
+    fprintf(fp, "};\nconst unsigned int %s_len = %zu;\n#endif // %s\n", var, fb.size(), guard.c_str());
+    return fclose(fp) != 0;
+}
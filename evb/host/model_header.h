@@ -0,0 +1,59 @@
+/**
+ * @file model_header.h
+ * @author Adam Page (adam.page@ambiq.com)
+ * @brief Host helpers for tools that rewrite the exported model headers in src/
+ * @version 1.0
+ * @date 2023-05-02
+ *
+ * @copyright Copyright (c) 2023
+ *
+ */
+#ifndef __MODEL_HEADER_H
+#define __MODEL_HEADER_H
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+#include "tensorflow/lite/schema/schema_generated.h"
+
+typedef struct {
+    const char *name;   // Header basename in src/
+    const char *var;    // C array name
+    const uint8_t *buf; // Flatbuffer
+    uint32_t len;       // Flatbuffer length
+} model_entry_t;
+
+extern const model_entry_t models[];
+extern const size_t numModels;
+
+/**
+ * @brief Unpack a flatbuffer model (copied to an aligned buffer first)
+ * @param buf Flatbuffer
+ * @param len Flatbuffer length
+ * @return Model object
+ */
+std::unique_ptr<tflite::ModelT>
+unpack_model(const uint8_t *buf, size_t len);
+
+/**
+ * @brief Pack a model object into a flatbuffer
+ * @param model Model object
+ * @param sizeHint Initial builder size
+ * @return Flatbuffer
+ */
+std::vector<uint8_t>
+pack_model(const tflite::ModelT &model, size_t sizeHint);
+
+/**
+ * @brief Write model as C array (xxd_c_dump layout, 16-byte aligned for the offline plan's int32 reads)
+ * @param path Header path
+ * @param var C array name
+ * @param fb Flatbuffer
+ * @return 0 on success
+ */
+int
+write_model_header(const char *path, const char *var, const std::vector<uint8_t> &fb);
+
+#endif // __MODEL_HEADER_H
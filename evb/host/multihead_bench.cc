@@ -0,0 +1,207 @@
+/**
+ * @file multihead_bench.cc
+ * @author Adam Page (adam.page@ambiq.com)
+ * @brief Host check and benchmark of MultiHeadModel on the segmentation model split in two
+ * @version 1.0
+ * @date 2023-05-02
+ *
+ * @copyright Copyright (c) 2023
+ *
+ * There is no trained multihead export in the tree, so the segmentation U-Net stands in for one:
+ * its encoder, everything computing the skip inputs of the HK_CONCAT_CONV ops, becomes the backbone
+ * and its decoder the head. Both keep the quantization of the original model, so running the head
+ * through MultiHeadModel on random windows has to give exactly the output of the whole model. The
+ * timings show how much of a window the backbone is, i.e. what every extra head sharing it saves.
+ * Requantization between separately calibrated models is checked against float rounding.
+ *
+ * Build: make -C evb/host multihead
+ */
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <memory>
+#include <random>
+#include <string>
+#include <vector>
+
+#include "tensorflow/lite/micro/all_ops_resolver.h"
+#include "tensorflow/lite/micro/micro_error_reporter.h"
+#include "tensorflow/lite/micro/micro_interpreter.h"
+#include "tensorflow/lite/schema/schema_generated.h"
+#include "tensorflow/lite/schema/schema_utils.h"
+
+#include "segmentation_model_buffer.h"
+
+#include "concat_conv_kernels.h"
+#include "conv1d_kernels.h"
+#include "custom_ops.h"
+#include "model_fuser.h"
+#include "model_header.h"
+#include "multihead_model.h"
+
+#define ARENA_SIZE (512 * 1024)
+#define BENCH_INPUTS (8)
+#define BENCH_RUNS (20)
+#define REQUANT_CASES (200)
+
+static std::vector<int32_t>
+skip_inputs(const tflite::ModelT &model) {
+    /**
+     * @brief Tensors the decoder reads from the encoder: every HK_CONCAT_CONV part but the first
+     */
+    const tflite::SubGraphT &subgraph = *model.subgraphs[0];
+    std::vector<int32_t> skips;
+    for (const auto &op : subgraph.operators) {
+        const tflite::OperatorCodeT *code = model.operator_codes[op->opcode_index].get();
+        if (tflite::GetBuiltinCode(code) != tflite::BuiltinOperator_CUSTOM || code->custom_code != HK_CONCAT_CONV_OP_NAME) {
+            continue;
+        }
+        // Inputs are (input, filter) pairs, then bias
+        for (size_t i = 2; i + 1 < op->inputs.size(); i += 2) {
+            if (std::find(skips.begin(), skips.end(), op->inputs[i]) == skips.end()) {
+                skips.push_back(op->inputs[i]);
+            }
+        }
+    }
+    return skips;
+}
+
+static std::vector<uint64_t>
+aligned_copy(const std::vector<uint8_t> &fb) {
+    std::vector<uint64_t> buf((fb.size() + sizeof(uint64_t) - 1) / sizeof(uint64_t));
+    memcpy(buf.data(), fb.data(), fb.size());
+    return buf;
+}
+
+static int
+check_requant(std::mt19937 &rng) {
+    /**
+     * @brief Compare mh_requant with float requantization on random scales and zero points
+     * @return Values more than 1 LSB off
+     */
+    std::uniform_real_distribution<float> scales(-6.0f, 0.0f);
+    std::uniform_int_distribution<int> values(-128, 127);
+    int failures = 0;
+    int32_t maxDiff = 0;
+    for (int i = 0; i < REQUANT_CASES; i++) {
+        TfLiteTensor from = {}, to = {};
+        from.type = to.type = kTfLiteInt8;
+        from.params.scale = std::exp(scales(rng));
+        to.params.scale = i % 4 == 0 ? from.params.scale : std::exp(scales(rng));
+        from.params.zero_point = values(rng);
+        to.params.zero_point = i % 4 == 0 ? from.params.zero_point : values(rng);
+        mh_requant_t requant;
+        if (mh_requant_init(&requant, &from, &to) != kTfLiteOk) {
+            return REQUANT_CASES;
+        }
+        int8_t x[256], y[256];
+        for (int v = 0; v < 256; v++) {
+            x[v] = (int8_t)(v - 128);
+        }
+        mh_requant(&requant, x, y, 256);
+        for (int v = 0; v < 256; v++) {
+            float real = (x[v] - from.params.zero_point) * from.params.scale;
+            int32_t ref = (int32_t)std::lround(real / to.params.scale) + to.params.zero_point;
+            ref = ref < -128 ? -128 : ref > 127 ? 127 : ref;
+            int32_t diff = std::abs(ref - y[v]);
+            maxDiff = diff > maxDiff ? diff : maxDiff;
+            failures += diff > 1;
+        }
+    }
+    printf("requant cases=%d max |dy|=%d LSB\n", REQUANT_CASES, (int)maxDiff);
+    return failures;
+}
+
+int
+main(void) {
+    static tflite::MicroErrorReporter microErrorReporter;
+    static tflite::AllOpsResolver allOpsResolver;
+    add_custom_ops(allOpsResolver);
+    static Conv1dOpResolver conv1dResolver(allOpsResolver);
+    std::mt19937 rng(0x4b48);
+    std::uniform_int_distribution<int> dist(-128, 127);
+    int failures = 0;
+
+    // Split the segmentation model at its skip connections
+    std::unique_ptr<tflite::ModelT> backboneModel = unpack_model(g_segmentation_model, g_segmentation_model_len);
+    std::unique_ptr<tflite::ModelT> headModel = unpack_model(g_segmentation_model, g_segmentation_model_len);
+    const std::vector<int32_t> skips = skip_inputs(*backboneModel);
+    const std::vector<int32_t> inputs = backboneModel->subgraphs[0]->inputs;
+    const std::vector<int32_t> outputs = backboneModel->subgraphs[0]->outputs;
+    if (skips.empty() || !extract_subgraph(*backboneModel, inputs, skips) || !extract_subgraph(*headModel, skips, outputs)) {
+        fprintf(stderr, "SEG: no encoder/decoder split (run make fuse first)\n");
+        return 1;
+    }
+    const size_t backboneOps = backboneModel->subgraphs[0]->operators.size();
+    const size_t headOps = headModel->subgraphs[0]->operators.size();
+    std::vector<uint64_t> wholeBuf = aligned_copy(std::vector<uint8_t>(g_segmentation_model, g_segmentation_model + g_segmentation_model_len));
+    std::vector<uint64_t> backboneBuf = aligned_copy(pack_model(*backboneModel, g_segmentation_model_len));
+    std::vector<uint64_t> headBuf = aligned_copy(pack_model(*headModel, g_segmentation_model_len));
+
+    std::vector<uint64_t> wholeArena(ARENA_SIZE / sizeof(uint64_t));
+    std::vector<uint64_t> backboneArena(ARENA_SIZE / sizeof(uint64_t));
+    std::vector<uint64_t> headArena(ARENA_SIZE / sizeof(uint64_t));
+    tflite::MicroInterpreter whole(tflite::GetModel(wholeBuf.data()), conv1dResolver, (uint8_t *)wholeArena.data(), ARENA_SIZE,
+                                   &microErrorReporter);
+    tflite::MicroInterpreter backbone(tflite::GetModel(backboneBuf.data()), conv1dResolver, (uint8_t *)backboneArena.data(), ARENA_SIZE,
+                                      &microErrorReporter);
+    tflite::MicroInterpreter head(tflite::GetModel(headBuf.data()), conv1dResolver, (uint8_t *)headArena.data(), ARENA_SIZE,
+                                  &microErrorReporter);
+    static MultiHeadModel multihead;
+    int32_t headIdx = -1;
+    if (whole.AllocateTensors() != kTfLiteOk || backbone.AllocateTensors() != kTfLiteOk || head.AllocateTensors() != kTfLiteOk ||
+        multihead.Init(&backbone) != kTfLiteOk || (headIdx = multihead.AddHead(&head)) < 0 ||
+        multihead.NumRouted(headIdx) != (int32_t)head.inputs_size()) {
+        fprintf(stderr, "SEG: init failed\n");
+        return 1;
+    }
+    printf("SEG   backbone: %zu ops, %zu features, arena %zu bytes  head: %zu ops, arena %zu bytes  whole: arena %zu bytes\n",
+           backboneOps, skips.size(), backbone.arena_used_bytes(), headOps, head.arena_used_bytes(), whole.arena_used_bytes());
+
+    // The split model is the model
+    TfLiteTensor *in = whole.input(0);
+    TfLiteTensor *out = whole.output(0);
+    std::vector<int8_t> window(in->bytes);
+    double wholeUs = 0, backboneUs = 0, headUs = 0;
+    int mismatches = 0;
+    for (int i = 0; i < BENCH_INPUTS; i++) {
+        for (int8_t &x : window) {
+            x = (int8_t)dist(rng);
+        }
+        // The planner reuses input memory once it is consumed, so every invoke needs its input again
+        auto start = std::chrono::steady_clock::now();
+        for (int r = 0; r < BENCH_RUNS; r++) {
+            memcpy(in->data.int8, window.data(), in->bytes);
+            whole.Invoke();
+        }
+        auto mid = std::chrono::steady_clock::now();
+        for (int r = 0; r < BENCH_RUNS; r++) {
+            memcpy(multihead.Input()->data.int8, window.data(), in->bytes);
+            multihead.InvokeBackbone();
+        }
+        auto mid2 = std::chrono::steady_clock::now();
+        for (int r = 0; r < BENCH_RUNS; r++) {
+            if (multihead.InvokeHead(headIdx) != kTfLiteOk) {
+                fprintf(stderr, "SEG: head invoke failed\n");
+                return 1;
+            }
+        }
+        auto end = std::chrono::steady_clock::now();
+        wholeUs += std::chrono::duration<double, std::micro>(mid - start).count() / BENCH_RUNS;
+        backboneUs += std::chrono::duration<double, std::micro>(mid2 - mid).count() / BENCH_RUNS;
+        headUs += std::chrono::duration<double, std::micro>(end - mid2).count() / BENCH_RUNS;
+        mismatches += memcmp(out->data.int8, multihead.HeadOutput(headIdx)->data.int8, out->bytes) != 0;
+    }
+    wholeUs /= BENCH_INPUTS;
+    backboneUs /= BENCH_INPUTS;
+    headUs /= BENCH_INPUTS;
+    printf("whole=%8.1f us backbone=%8.1f us head=%8.1f us (backbone %.0f%% of the window) outputs=%s\n", wholeUs, backboneUs, headUs,
+           100.0 * backboneUs / (backboneUs + headUs), mismatches ? "MISMATCH" : "identical");
+    printf("invokes: backbone=%u head=%u\n", (unsigned)multihead.BackboneInvokes(), (unsigned)multihead.HeadInvokes(headIdx));
+    failures += mismatches;
+    failures += check_requant(rng);
+    return failures ? 1 : 0;
+}
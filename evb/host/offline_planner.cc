@@ -0,0 +1,372 @@
+/**
+ * @file offline_planner.cc
+ * @author Adam Page (adam.page@ambiq.com)
+ * @brief Host tool that embeds offline tensor memory plans in the exported models
+ * @version 1.0
+ * @date 2023-05-02
+ *
+ * @copyright Copyright (c) 2023
+ *
+ * For each model, computes tensor lifetimes the same way TFLM's AllocationInfoBuilder does and
+ * searches for a compact offset plan: the greedy first-fit placement is run over several buffer
+ * orderings plus seeded random swaps of the best one, and the search stops early once it reaches
+ * the lower bound (peak live bytes). The plan is stored as "OfflineMemoryAllocation" metadata
+ * ({version, subgraph, # tensors, offsets...}, -1 = planned online), which AllocateTensors() uses in
+ * place of its own GreedyMemoryPlanner search. Kernel scratch buffers cannot be planned offline,
+ * so the scratch requests recorded on host are reserved as pseudo buffers in the search; the
+ * runtime planner then fits them into the holes left for them.
+ *
+ * The model headers in src/ are rewritten in place (same layout as xxd_c_dump, 16-byte aligned),
+ * and the runtime and offline plans are compared for arena bytes and AllocateTensors() time.
+ * Re-running on an already planned model replaces the existing plan.
+ *
+ * Build: make -C evb/host plan
+ */
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <memory>
+#include <random>
+#include <string>
+#include <vector>
+
+#include "tensorflow/lite/micro/all_ops_resolver.h"
+#include "tensorflow/lite/micro/memory_helpers.h"
+#include "tensorflow/lite/micro/micro_error_reporter.h"
+#include "tensorflow/lite/micro/recording_micro_interpreter.h"
+#include "tensorflow/lite/schema/schema_generated.h"
+
+#include "custom_ops.h"
+#include "model_header.h"
+#include "scratch_recorder.h"
+
+#define PLAN_METADATA_NAME "OfflineMemoryAllocation"
+#define PLAN_VERSION (1)
+#define PLAN_ALIGN (16) // MicroArenaBufferAlignment()
+#define PLAN_ONLINE (-1)
+#define PLAN_SEARCH_ITERS (4000)
+#define ARENA_MAX_SIZE (1024 * 1024)
+#define ALLOC_TIMING_RUNS (50)
+
+typedef struct {
+    int32_t tensor; // Tensor index (-1 = reserved for kernel scratch)
+    int32_t size;
+    int32_t first;
+    int32_t last;
+} plan_buffer_t;
+
+//*****************************************************************************
+//*** Lifetimes
+static std::vector<plan_buffer_t>
+plan_buffers(const tflite::ModelT &model, const std::vector<scratch_request_t> &scratch, tflite::ErrorReporter *reporter) {
+    /**
+     * @brief Non-persistent tensors and kernel scratch of subgraph 0 with aligned sizes and TFLM allocation scopes
+     * @param model Unpacked model
+     * @param scratch Scratch requests recorded during AllocateTensors()
+     * @param reporter Error reporter
+     * @return Buffers to plan
+     */
+    const tflite::SubGraphT &subgraph = *model.subgraphs[0];
+    std::vector<int32_t> first(subgraph.tensors.size(), -1);
+    std::vector<int32_t> last(subgraph.tensors.size(), -1);
+    int32_t scope = 0;
+    for (int32_t idx : subgraph.inputs) {
+        first[idx] = first[idx] < 0 ? scope : first[idx];
+    }
+    for (const auto &op : subgraph.operators) {
+        scope++;
+        for (int32_t idx : op->outputs) {
+            first[idx] = first[idx] < 0 ? scope : first[idx];
+        }
+        for (int32_t idx : op->inputs) {
+            if (idx >= 0) {
+                last[idx] = scope;
+            }
+        }
+        for (int32_t idx : op->outputs) {
+            last[idx] = scope;
+        }
+    }
+    for (int32_t idx : subgraph.outputs) {
+        last[idx] = scope;
+    }
+
+    std::vector<plan_buffer_t> buffers;
+    // Scratch lives only during its operator's scope, which is when the operator's output is created
+    for (const auto &request : scratch) {
+        if (request.outputTensor >= 0 && first[request.outputTensor] >= 0) {
+            int32_t opScope = first[request.outputTensor];
+            buffers.push_back({-1, (int32_t)((request.bytes + PLAN_ALIGN - 1) & ~(PLAN_ALIGN - 1)), opScope, opScope});
+        }
+    }
+    for (size_t i = 0; i < subgraph.tensors.size(); i++) {
+        const tflite::TensorT &tensor = *subgraph.tensors[i];
+        const tflite::BufferT *buffer = model.buffers[tensor.buffer].get();
+        if ((buffer && !buffer->data.empty()) || tensor.is_variable || first[i] < 0 || last[i] < 0) {
+            continue;
+        }
+        TfLiteType type;
+        size_t typeSize;
+        if (tflite::ConvertTensorType(tensor.type, &type, reporter) != kTfLiteOk ||
+            tflite::TfLiteTypeSizeOf(type, &typeSize) != kTfLiteOk) {
+            continue;
+        }
+        size_t bytes = typeSize;
+        for (int32_t dim : tensor.shape) {
+            bytes *= dim;
+        }
+        if (bytes == 0) {
+            continue;
+        }
+        buffers.push_back({(int32_t)i, (int32_t)((bytes + PLAN_ALIGN - 1) & ~(PLAN_ALIGN - 1)), first[i], last[i]});
+    }
+    return buffers;
+}
+
+static int32_t
+plan_lower_bound(const std::vector<plan_buffer_t> &buffers) {
+    int32_t lastScope = 0;
+    for (const auto &b : buffers) {
+        lastScope = std::max(lastScope, b.last);
+    }
+    int32_t bound = 0;
+    for (int32_t t = 0; t <= lastScope; t++) {
+        int32_t live = 0;
+        for (const auto &b : buffers) {
+            live += (b.first <= t && t <= b.last) ? b.size : 0;
+        }
+        bound = std::max(bound, live);
+    }
+    return bound;
+}
+
+//*****************************************************************************
+//*** Placement
+static int32_t
+plan_place(const std::vector<plan_buffer_t> &buffers, const std::vector<int32_t> &order, std::vector<int32_t> &offsets) {
+    /**
+     * @brief First-fit placement of buffers in the given order
+     * @param buffers Buffers
+     * @param order Placement order (indices into buffers)
+     * @param offsets Output offsets (indexed like buffers)
+     * @return Arena bytes of plan
+     */
+    std::vector<int32_t> placed;
+    std::vector<std::pair<int32_t, int32_t>> busy;
+    int32_t peak = 0;
+    placed.reserve(order.size());
+    for (int32_t i : order) {
+        const plan_buffer_t &b = buffers[i];
+        busy.clear();
+        for (int32_t j : placed) {
+            if (buffers[j].first <= b.last && b.first <= buffers[j].last) {
+                busy.push_back({offsets[j], offsets[j] + buffers[j].size});
+            }
+        }
+        std::sort(busy.begin(), busy.end());
+        int32_t offset = 0;
+        for (const auto &range : busy) {
+            if (range.first >= offset + b.size) {
+                break;
+            }
+            offset = std::max(offset, range.second);
+        }
+        offsets[i] = offset;
+        placed.push_back(i);
+        peak = std::max(peak, offset + b.size);
+    }
+    return peak;
+}
+
+static int32_t
+plan_search(const std::vector<plan_buffer_t> &buffers, int32_t bound, std::vector<int32_t> &offsets) {
+    /**
+     * @brief Search buffer orderings for the most compact first-fit plan
+     * @param buffers Buffers
+     * @param bound Lower bound on arena bytes
+     * @param offsets Output offsets of best plan
+     * @return Arena bytes of best plan
+     */
+    const size_t n = buffers.size();
+    auto bySize = [&](int32_t a, int32_t b) { return buffers[a].size > buffers[b].size; };
+    auto byFirst = [&](int32_t a, int32_t b) { return buffers[a].first < buffers[b].first || (buffers[a].first == buffers[b].first && bySize(a, b)); };
+    auto byLife = [&](int32_t a, int32_t b) { return buffers[a].last - buffers[a].first > buffers[b].last - buffers[b].first; };
+    auto byArea = [&](int32_t a, int32_t b) {
+        return (int64_t)buffers[a].size * (buffers[a].last - buffers[a].first + 1) > (int64_t)buffers[b].size * (buffers[b].last - buffers[b].first + 1);
+    };
+    std::vector<int32_t> order(n), bestOrder;
+    std::vector<int32_t> trial(n);
+    int32_t best = INT32_MAX;
+
+    auto try_order = [&](const std::vector<int32_t> &o) {
+        int32_t peak = plan_place(buffers, o, trial);
+        if (peak < best) {
+            best = peak;
+            bestOrder = o;
+            offsets = trial;
+        }
+    };
+    for (size_t i = 0; i < n; i++) {
+        order[i] = i;
+    }
+    // Size order first so the plan is never worse than TFLM's GreedyMemoryPlanner
+    std::stable_sort(order.begin(), order.end(), bySize);
+    try_order(order);
+    std::stable_sort(order.begin(), order.end(), byFirst);
+    try_order(order);
+    std::stable_sort(order.begin(), order.end(), byLife);
+    try_order(order);
+    std::stable_sort(order.begin(), order.end(), byArea);
+    try_order(order);
+
+    std::mt19937 rng(0x4b48);
+    for (uint32_t iter = 0; iter < PLAN_SEARCH_ITERS && best > bound && n > 1; iter++) {
+        order = bestOrder;
+        std::uniform_int_distribution<size_t> pick(0, n - 1);
+        std::swap(order[pick(rng)], order[pick(rng)]);
+        try_order(order);
+    }
+    return best;
+}
+
+//*****************************************************************************
+//*** Model I/O
+static std::vector<uint8_t>
+plan_model(const model_entry_t *entry, const std::vector<scratch_request_t> &scratch, tflite::ErrorReporter *reporter, int32_t *planBytes,
+           int32_t *bound, size_t *numPlanned) {
+    /**
+     * @brief Unpack model, replace its offline plan and repack
+     * @return Planned flatbuffer (empty on error)
+     */
+    std::unique_ptr<tflite::ModelT> model = unpack_model(entry->buf, entry->len);
+    if (model->subgraphs.size() != 1) {
+        fprintf(stderr, "%s: expected 1 subgraph, got %zu\n", entry->name, model->subgraphs.size());
+        return {};
+    }
+    const tflite::SubGraphT &subgraph = *model->subgraphs[0];
+    std::vector<plan_buffer_t> buffers = plan_buffers(*model, scratch, reporter);
+    std::vector<int32_t> offsets(buffers.size(), 0);
+    *bound = plan_lower_bound(buffers);
+    *planBytes = plan_search(buffers, *bound, offsets);
+    *numPlanned = 0;
+
+    std::vector<int32_t> plan(3 + subgraph.tensors.size(), PLAN_ONLINE);
+    plan[0] = PLAN_VERSION;
+    plan[1] = 0;
+    plan[2] = subgraph.tensors.size();
+    for (size_t i = 0; i < buffers.size(); i++) {
+        if (buffers[i].tensor >= 0) {
+            plan[3 + buffers[i].tensor] = offsets[i];
+            *numPlanned += 1;
+        }
+    }
+    std::vector<uint8_t> planData((const uint8_t *)plan.data(), (const uint8_t *)(plan.data() + plan.size()));
+
+    // Replace an existing plan in place, else append a buffer and metadata entry
+    tflite::MetadataT *metadata = nullptr;
+    for (auto &m : model->metadata) {
+        if (m->name == PLAN_METADATA_NAME) {
+            metadata = m.get();
+        }
+    }
+    if (metadata == nullptr) {
+        model->metadata.emplace_back(new tflite::MetadataT());
+        metadata = model->metadata.back().get();
+        metadata->name = PLAN_METADATA_NAME;
+        metadata->buffer = model->buffers.size();
+        model->buffers.emplace_back(new tflite::BufferT());
+    }
+    model->buffers[metadata->buffer]->data = planData;
+    return pack_model(*model, entry->len + 1024);
+}
+
+static std::vector<uint8_t>
+strip_plan(const model_entry_t *entry) {
+    /**
+     * @brief Model without offline plan (runtime planning baseline)
+     */
+    std::unique_ptr<tflite::ModelT> model = unpack_model(entry->buf, entry->len);
+    for (auto it = model->metadata.begin(); it != model->metadata.end(); it++) {
+        if ((*it)->name == PLAN_METADATA_NAME) {
+            // Leave the buffer so indices of other metadata stay valid
+            model->buffers[(*it)->buffer]->data.clear();
+            model->metadata.erase(it);
+            break;
+        }
+    }
+    return pack_model(*model, entry->len + 1024);
+}
+
+static int
+measure_arena(const std::vector<uint8_t> &fb, const tflite::MicroOpResolver &resolver, tflite::ErrorReporter *reporter, size_t *headBytes,
+              double *allocUs) {
+    /**
+     * @brief Non-persistent arena bytes and mean AllocateTensors() time of a model
+     * @return 0 on success
+     */
+    std::vector<uint64_t> modelBuf((fb.size() + sizeof(uint64_t) - 1) / sizeof(uint64_t));
+    memcpy(modelBuf.data(), fb.data(), fb.size());
+    std::vector<uint64_t> arena(ARENA_MAX_SIZE / sizeof(uint64_t));
+    const tflite::Model *model = tflite::GetModel(modelBuf.data());
+    auto start = std::chrono::steady_clock::now();
+    for (uint32_t run = 0; run < ALLOC_TIMING_RUNS; run++) {
+        tflite::RecordingMicroInterpreter interpreter(model, resolver, (uint8_t *)arena.data(), ARENA_MAX_SIZE, reporter);
+        if (interpreter.AllocateTensors() != kTfLiteOk) {
+            return 1;
+        }
+        *headBytes = interpreter.GetMicroAllocator().GetSimpleMemoryAllocator()->GetNonPersistentUsedBytes();
+    }
+    *allocUs = std::chrono::duration<double, std::micro>(std::chrono::steady_clock::now() - start).count() / ALLOC_TIMING_RUNS;
+    return 0;
+}
+
+int
+main(int argc, char **argv) {
+    /**
+     * @brief Plan every model and rewrite its header. Optional argv[1] is the src directory.
+     */
+    static tflite::MicroErrorReporter microErrorReporter;
+    static tflite::AllOpsResolver allOpsResolver;
+    add_custom_ops(allOpsResolver);
+    ScratchRecordingOpResolver resolver(allOpsResolver);
+    std::string srcDir = argc > 1 ? argv[1] : "../src";
+
+    fprintf(stderr, "%-28s %7s %9s %9s %9s %11s %11s\n", "model", "tensors", "bound", "runtime", "offline", "runtime-us", "offline-us");
+    for (size_t m = 0; m < numModels; m++) {
+        const model_entry_t &entry = models[m];
+        int32_t planBytes = 0, bound = 0;
+        size_t numPlanned = 0, runtimeHead = 0, offlineHead = 0;
+        double runtimeUs = 0, offlineUs = 0;
+        std::vector<uint8_t> baseline = strip_plan(&entry);
+        ScratchRecordingOpResolver::Reset();
+        if (measure_arena(baseline, resolver, &microErrorReporter, &runtimeHead, &runtimeUs)) {
+            fprintf(stderr, "%s: AllocateTensors() failed\n", entry.name);
+            return 1;
+        }
+        // Every timing run records the same requests, keep those of one run
+        std::vector<scratch_request_t> scratch(ScratchRecordingOpResolver::Requests().begin(),
+                                               ScratchRecordingOpResolver::Requests().begin() +
+                                                   ScratchRecordingOpResolver::Requests().size() / ALLOC_TIMING_RUNS);
+        std::vector<uint8_t> planned = plan_model(&entry, scratch, &microErrorReporter, &planBytes, &bound, &numPlanned);
+        if (planned.empty() || measure_arena(planned, resolver, &microErrorReporter, &offlineHead, &offlineUs)) {
+            fprintf(stderr, "%s: planning failed\n", entry.name);
+            return 1;
+        }
+        fprintf(stderr, "%-28s %7zu %9d %9zu %9zu %11.1f %11.1f\n", entry.name, numPlanned, bound, runtimeHead, offlineHead, runtimeUs, offlineUs);
+        if (offlineHead > runtimeHead) {
+            fprintf(stderr, "%s: offline plan is larger than runtime plan\n", entry.name);
+            return 1;
+        }
+        if (planned.size() == entry.len && memcmp(planned.data(), entry.buf, entry.len) == 0) {
+            continue;
+        }
+        std::string path = srcDir + "/" + entry.name;
+        if (write_model_header(path.c_str(), entry.var, planned)) {
+            fprintf(stderr, "Failed writing %s\n", path.c_str());
+            return 1;
+        }
+    }
+    return 0;
+}
@@ -0,0 +1,208 @@
+/**
+ * @file pan_tompkins_bench.cc
+ * @author Adam Page (adam.page@ambiq.com)
+ * @brief Host check and benchmark of the Pan-Tompkins HR-only mode against segmentation
+ * @version 1.0
+ * @date 2023-05-02
+ *
+ * @copyright Copyright (c) 2023
+ *
+ * Synthesizes an hour of ECG with synthetic_ecg.cc (sinus rhythm, isolated PACs and PVCs, a minute
+ * of bigeminy and a minute of AFIB every ten), standardizes back to back HK_DATA_LEN windows as
+ * hk_preprocess() does and finds their R peaks with ../src/pan_tompkins.cc. Against the true beats,
+ * within 150 ms, it reports sensitivity, positive predictivity and R peak error (beats in the
+ * last EDGE_LEN samples of a window are counted apart, being inside the detector's latency), the
+ * heart rate error of ecg_bpm() on the detected peaks, and how often hk_pt_irregular() escalates
+ * sinus, ectopic and AFIB windows to the full heads (with the true peaks as a reference). It does so
+ * twice: with a gap before every window, which restarts the detector as non-contiguous windows do,
+ * and with windows overlapping by half, which continue it and only feed their new samples. Then it
+ * times the detector against the segmentation model invokes hk_run makes on a window. The bandpass
+ * of hk_preprocess() is left out, as the detector's own bandpass removes the baseline wander. Host
+ * timings only show the ratio, target cycles come from the PEAKS and SEGMENTATION stage counters.
+ *
+ * Build: make -C evb/host pan_tompkins
+ */
+#include <chrono>
+#include <cmath>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <random>
+#include <vector>
+
+#include "tensorflow/lite/micro/all_ops_resolver.h"
+#include "tensorflow/lite/micro/micro_error_reporter.h"
+#include "tensorflow/lite/micro/micro_interpreter.h"
+#include "tensorflow/lite/schema/schema_generated.h"
+
+#include "segmentation_model_buffer.h"
+
+#include "pan_tompkins.h"
+
+#include "constants.h"
+#include "conv1d_kernels.h"
+#include "custom_ops.h"
+#include "heartkit.h"
+#include "synthetic_ecg.h"
+
+#define ARENA_SIZE (512 * 1024)
+#define REPLAY_SEC (3600)
+#define MATCH_TOL (150 * SAMPLE_RATE / 1000)
+#define BENCH_RUNS (10)
+// A QRS this close to the window end has not peaked in the integral yet and is left to latency
+#define EDGE_LEN (60 * SAMPLE_RATE / 250)
+
+enum WindowClass { WindowSinus, WindowEctopic, WindowAfib, WindowClassCount };
+static const char *windowLabels[] = {"sinus", "ectopic", "AFIB"};
+
+static float
+window_bpm(const std::vector<int32_t> &peaks, std::vector<int32_t> &rr) {
+    /**
+     * @brief RR intervals as ecg_rate() and rate as ecg_bpm() with no limits
+     */
+    rr.assign(peaks.size(), 0);
+    if (peaks.size() < 2) {
+        return 0;
+    }
+    float sum = 0;
+    for (size_t i = 1; i < peaks.size(); i++) {
+        rr[i] = peaks[i] - peaks[i - 1];
+    }
+    rr[0] = rr[1];
+    for (int32_t val : rr) {
+        sum += (float)val / SAMPLE_RATE;
+    }
+    return 60.0f / (sum / rr.size());
+}
+
+static bool
+replay(const std::vector<float> &ecg, const std::vector<ecg_beat_t> &beats, uint32_t step, bool gaps, double *ptUs) {
+    /**
+     * @brief Detect the R peaks of windows every step samples, restarting the detector before each one
+     * if gaps, and score them
+     * @param ptUs Output detector time per window
+     * @return True if the detector misses or adds beats or escalates sinus windows
+     */
+    std::vector<float> data(HK_DATA_LEN);
+    int32_t peaks[HK_PEAK_LEN];
+    uint32_t tp = 0, fp = 0, fn = 0, edge = 0;
+    double rErr = 0, hrErr = 0;
+    uint32_t hrWindows = 0, numWindows = 0;
+    uint32_t windows[WindowClassCount] = {0}, escalated[WindowClassCount] = {0}, truthEscalated[WindowClassCount] = {0};
+    *ptUs = 0;
+    hk_pt_reset();
+    size_t first = 0;
+    for (uint32_t start = 0; start + HK_DATA_LEN <= ecg.size(); start += step) {
+        ecg_standardize(&ecg[start], data.data(), HK_DATA_LEN);
+        auto t0 = std::chrono::steady_clock::now();
+        if (gaps) {
+            hk_pt_restart();
+        }
+        const uint32_t numPeaks = pan_tompkins_peaks(data.data(), start, HK_DATA_LEN, peaks, HK_PEAK_LEN);
+        *ptUs += std::chrono::duration<double, std::micro>(std::chrono::steady_clock::now() - t0).count();
+        numWindows++;
+
+        while (first < beats.size() && beats[first].peak < start) {
+            first++;
+        }
+        std::vector<int32_t> truth;
+        int cls = WindowSinus;
+        for (size_t b = first; b < beats.size() && beats[b].peak < start + HK_DATA_LEN; b++) {
+            truth.push_back(beats[b].peak - start);
+            cls = beats[b].afib ? WindowAfib : (cls == WindowSinus && beats[b].label != HeartBeatNormal) ? WindowEctopic : cls;
+        }
+        // Greedy match in time order
+        std::vector<bool> used(numPeaks, false);
+        for (int32_t t : truth) {
+            int best = -1;
+            for (uint32_t i = 0; i < numPeaks; i++) {
+                if (!used[i] && abs(peaks[i] - t) <= MATCH_TOL && (best < 0 || abs(peaks[i] - t) < abs(peaks[best] - t))) {
+                    best = i;
+                }
+            }
+            if (best < 0) {
+                edge += t >= HK_DATA_LEN - EDGE_LEN;
+                fn += t < HK_DATA_LEN - EDGE_LEN;
+            } else {
+                used[best] = true;
+                tp++;
+                rErr += abs(peaks[best] - t);
+            }
+        }
+        for (bool u : used) {
+            fp += !u;
+        }
+
+        std::vector<int32_t> rr, truthRR;
+        const std::vector<int32_t> detected(peaks, peaks + numPeaks);
+        const float bpm = window_bpm(detected, rr);
+        const float truthBpm = window_bpm(truth, truthRR);
+        windows[cls]++;
+        escalated[cls] += hk_pt_irregular(rr.data(), rr.size());
+        truthEscalated[cls] += hk_pt_irregular(truthRR.data(), truthRR.size());
+        if (cls == WindowSinus) {
+            hrErr += fabsf(bpm - truthBpm);
+            hrWindows++;
+        }
+    }
+    *ptUs /= numWindows;
+    const double se = 100.0 * tp / (tp + fn), ppv = 100.0 * tp / (tp + fp);
+    printf("step=%d %s: %.1f us/window (%.2f us/new sample)\n", step, gaps ? "restarted every window" : "continued across windows",
+           *ptUs, *ptUs / (gaps ? HK_DATA_LEN : step));
+    printf("QRS   Se=%.2f%% PPV=%.2f%% (tp=%u fn=%u fp=%u, %u in the last %d ms) R error=%.1f ms sinus HR error=%.2f bpm\n", se, ppv,
+           tp, fn, fp, edge, 1000 * EDGE_LEN / SAMPLE_RATE, 1000.0 * rErr / tp / SAMPLE_RATE, hrErr / hrWindows);
+    for (int c = 0; c < WindowClassCount; c++) {
+        printf("%-8s windows=%4u escalated=%5.1f%% (true peaks %5.1f%%)\n", windowLabels[c], windows[c], 100.0 * escalated[c] / windows[c],
+               100.0 * truthEscalated[c] / windows[c]);
+    }
+    // Sinus windows have to stay in HR-only mode and keep their beats
+    return se < 99.0 || ppv < 99.0 || escalated[WindowSinus] > windows[WindowSinus] / 10;
+}
+
+int
+main(void) {
+    std::mt19937 rng(0x4b48);
+    std::vector<ecg_beat_t> beats;
+    const std::vector<float> ecg = synthesize_ecg(rng, {REPLAY_SEC, 0.04f, 0.04f, true, true, 0.0f}, beats);
+    printf("%zu beats in %d s\n", beats.size(), REPLAY_SEC);
+    double ptUs, contUs;
+    bool failed = replay(ecg, beats, HK_DATA_LEN, true, &ptUs);
+    failed |= replay(ecg, beats, HK_DATA_LEN / 2, false, &contUs);
+
+    // Detector against the segmentation invokes of one window
+    static tflite::MicroErrorReporter microErrorReporter;
+    static tflite::AllOpsResolver allOpsResolver;
+    add_custom_ops(allOpsResolver);
+    static Conv1dOpResolver conv1dResolver(allOpsResolver);
+    std::vector<uint64_t> modelBuf((g_segmentation_model_len + sizeof(uint64_t) - 1) / sizeof(uint64_t));
+    memcpy(modelBuf.data(), g_segmentation_model, g_segmentation_model_len);
+    const tflite::Model *model = tflite::GetModel(modelBuf.data());
+    std::vector<uint64_t> arena(ARENA_SIZE / sizeof(uint64_t));
+    tflite::MicroInterpreter interpreter(model, conv1dResolver, (uint8_t *)arena.data(), ARENA_SIZE, &microErrorReporter);
+    if (interpreter.AllocateTensors() != kTfLiteOk) {
+        fprintf(stderr, "SEG: init failed\n");
+        return 1;
+    }
+    TfLiteTensor *in = interpreter.input(0);
+    std::vector<float> data(HK_DATA_LEN);
+    ecg_standardize(ecg.data(), data.data(), HK_DATA_LEN);
+    std::vector<size_t> starts;
+    for (size_t i = 0; i < HK_DATA_LEN - HK_SEG_LEN + 1; i += HK_SEG_STEP) {
+        starts.push_back(i);
+    }
+    starts.push_back(HK_DATA_LEN - HK_SEG_LEN);
+    auto t0 = std::chrono::steady_clock::now();
+    for (int r = 0; r < BENCH_RUNS; r++) {
+        for (size_t s : starts) {
+            for (int32_t i = 0; i < HK_SEG_LEN; i++) {
+                const float q = roundf(data[s + i] / in->params.scale) + in->params.zero_point;
+                in->data.int8[i] = (int8_t)fmaxf(-128.0f, fminf(127.0f, q));
+            }
+            interpreter.Invoke();
+        }
+    }
+    const double segUs = std::chrono::duration<double, std::micro>(std::chrono::steady_clock::now() - t0).count() / BENCH_RUNS;
+    printf("window=%d PT=%.1f us segmentation=%zu invokes %.1f us PT/segmentation=%.3f%%\n", HK_DATA_LEN, ptUs, starts.size(), segUs,
+           100.0 * ptUs / segUs);
+    return failed ? 1 : 0;
+}
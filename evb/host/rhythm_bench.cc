@@ -0,0 +1,180 @@
+/**
+ * @file rhythm_bench.cc
+ * @author Adam Page (adam.page@ambiq.com)
+ * @brief Host evaluation of the averaged rhythm decision against flagging any AFIB block
+ * @version 1.0
+ * @date 2023-05-02
+ *
+ * @copyright Copyright (c) 2023
+ *
+ * Synthesizes two hours of ECG with synthetic_ecg.cc (sinus rhythm, isolated PACs and PVCs, a minute
+ * of bigeminy and a minute of AFIB every ten), standardizes back to back HK_DATA_LEN windows as
+ * hk_preprocess() does and runs the arrhythmia model over their blocks as arrhythmia_head_run() does.
+ * A window is AFIB if most of its beats are. Three decisions are scored per window: any AFIB block
+ * (the default), ../src/rhythm_smooth.cc reset at every window (hk_run with no overlap, the demo
+ * loop) and rhythm_smooth.cc carried over contiguous windows. For each it reports the AFIB windows
+ * found, the sinus and ectopic windows flagged, and the windows from an episode's onset to its first
+ * AFIB decision and from its end to the last. The bandpass of hk_preprocess() is left out, as in
+ * pan_tompkins_bench.cc, so the model sees the baseline wander the EVB filters.
+ *
+ * Build: make -C evb/host rhythm
+ */
+#include <cmath>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <random>
+#include <vector>
+
+#include "tensorflow/lite/micro/all_ops_resolver.h"
+#include "tensorflow/lite/micro/micro_error_reporter.h"
+#include "tensorflow/lite/micro/micro_interpreter.h"
+#include "tensorflow/lite/schema/schema_generated.h"
+
+#include "arrhythmia_model_buffer.h"
+
+#include "arm_math.h"
+
+#include "constants.h"
+#include "conv1d_kernels.h"
+#include "custom_ops.h"
+#include "heartkit.h"
+#include "rhythm_smooth.h"
+#include "synthetic_ecg.h"
+
+#define ARENA_SIZE (256 * 1024)
+#define REPLAY_SEC (7200)
+
+enum WindowClass { WindowSinus, WindowEctopic, WindowAfib, WindowClassCount };
+enum Decision { DecisionAnyBlock, DecisionWindow, DecisionContiguous, DecisionCount };
+static const char *decisionLabels[] = {"any block", "avg per window", "avg contiguous"};
+
+typedef struct {
+    uint32_t flagged[WindowClassCount];
+    uint32_t onsetWindows;  // Episode onset to the first AFIB decision inside it
+    uint32_t offsetWindows; // Episode end to the last AFIB decision after it
+    uint32_t missedEpisodes;
+} decision_stats_t;
+
+int
+main(void) {
+    static tflite::MicroErrorReporter microErrorReporter;
+    static tflite::AllOpsResolver allOpsResolver;
+    add_custom_ops(allOpsResolver);
+    static Conv1dOpResolver conv1dResolver(allOpsResolver);
+
+    // Model arrays in the generated headers are not aligned
+    std::vector<uint64_t> modelBuf((g_arrhythmia_model_len + sizeof(uint64_t) - 1) / sizeof(uint64_t));
+    memcpy(modelBuf.data(), g_arrhythmia_model, g_arrhythmia_model_len);
+    std::vector<uint64_t> arena(ARENA_SIZE / sizeof(uint64_t));
+    tflite::MicroInterpreter interpreter(tflite::GetModel(modelBuf.data()), conv1dResolver, (uint8_t *)arena.data(), ARENA_SIZE,
+                                         &microErrorReporter);
+    if (interpreter.AllocateTensors() != kTfLiteOk) {
+        fprintf(stderr, "ARR: init failed\n");
+        return 1;
+    }
+    TfLiteTensor *in = interpreter.input(0);
+    TfLiteTensor *out = interpreter.output(0);
+
+    std::mt19937 rng(0x4b48);
+    std::vector<ecg_beat_t> beats;
+    const std::vector<float> ecg = synthesize_ecg(rng, {REPLAY_SEC, 0.04f, 0.04f, true, true, 0.0f}, beats);
+    std::vector<float> data(HK_DATA_LEN);
+
+    // Class and block outputs of every window
+    std::vector<int> classes;
+    std::vector<std::vector<float32_t>> logits;
+    size_t first = 0;
+    for (uint32_t start = 0; start + HK_DATA_LEN <= ecg.size(); start += HK_DATA_LEN) {
+        ecg_standardize(&ecg[start], data.data(), HK_DATA_LEN);
+        std::vector<float32_t> y;
+        for (size_t i = 0; i < HK_DATA_LEN; i += HK_ARR_LEN) {
+            i = MIN(i, HK_DATA_LEN - HK_ARR_LEN);
+            for (int j = 0; j < HK_ARR_LEN; j++) {
+                in->data.int8[j] = (int8_t)fmaxf(-128, fminf(127, data[i + j] / in->params.scale + in->params.zero_point));
+            }
+            if (interpreter.Invoke() != kTfLiteOk) {
+                fprintf(stderr, "ARR: invoke failed\n");
+                return 1;
+            }
+            for (int c = 0; c < HK_ARR_CLASSES; c++) {
+                y.push_back(((float32_t)out->data.int8[c] - out->params.zero_point) * out->params.scale);
+            }
+        }
+        logits.push_back(y);
+
+        while (first < beats.size() && beats[first].peak < start) {
+            first++;
+        }
+        uint32_t numBeats = 0, numAfib = 0, numEctopic = 0;
+        for (size_t b = first; b < beats.size() && beats[b].peak < start + HK_DATA_LEN; b++) {
+            numBeats++;
+            numAfib += beats[b].afib;
+            numEctopic += beats[b].label != HeartBeatNormal;
+        }
+        classes.push_back(2 * numAfib > numBeats ? WindowAfib : numEctopic ? WindowEctopic : WindowSinus);
+    }
+
+    // Decisions per window
+    const size_t numBlocks = logits[0].size() / HK_ARR_CLASSES;
+    std::vector<std::vector<bool>> afib(DecisionCount, std::vector<bool>(classes.size()));
+    for (int d = 0; d < DecisionCount; d++) {
+        hk_rhythm_reset();
+        for (size_t w = 0; w < classes.size(); w++) {
+            bool flag = false;
+            if (d == DecisionWindow) {
+                hk_rhythm_reset();
+            }
+            for (size_t b = 0; b < numBlocks; b++) {
+                const float32_t *y = &logits[w][b * HK_ARR_CLASSES];
+                if (d == DecisionAnyBlock) {
+                    flag |= y[HeartRhythmAfib] > y[HeartRhythmNormal];
+                } else {
+                    flag = hk_rhythm_update(y) == HeartRhythmAfib;
+                }
+            }
+            afib[d][w] = flag;
+        }
+    }
+
+    uint32_t windows[WindowClassCount] = {0};
+    uint32_t episodes = 0;
+    for (size_t w = 0; w < classes.size(); w++) {
+        windows[classes[w]]++;
+        episodes += classes[w] == WindowAfib && (w == 0 || classes[w - 1] != WindowAfib);
+    }
+    printf("%zu beats in %d s, %zu windows: %u sinus, %u ectopic, %u AFIB in %u episodes\n", beats.size(), REPLAY_SEC, classes.size(),
+           windows[WindowSinus], windows[WindowEctopic], windows[WindowAfib], episodes);
+    for (int d = 0; d < DecisionCount; d++) {
+        decision_stats_t stats = {};
+        for (size_t w = 0; w < classes.size(); w++) {
+            stats.flagged[classes[w]] += afib[d][w];
+            if (classes[w] != WindowAfib || (w > 0 && classes[w - 1] == WindowAfib)) {
+                continue;
+            }
+            // Episode from w to end
+            size_t end = w;
+            while (end < classes.size() && classes[end] == WindowAfib) {
+                end++;
+            }
+            size_t onset = w;
+            while (onset < end && !afib[d][onset]) {
+                onset++;
+            }
+            stats.missedEpisodes += onset == end;
+            stats.onsetWindows += onset - w;
+            size_t offset = end;
+            while (offset < classes.size() && afib[d][offset] && classes[offset] != WindowAfib) {
+                offset++;
+            }
+            stats.offsetWindows += offset - end;
+        }
+        printf("%-15s AFIB found=%5.1f%% sinus flagged=%5.1f%% ectopic flagged=%5.1f%% onset=%4.1f windows offset=%4.1f windows "
+               "missed episodes=%u\n",
+               decisionLabels[d], 100.0 * stats.flagged[WindowAfib] / MAX(windows[WindowAfib], 1u),
+               100.0 * stats.flagged[WindowSinus] / MAX(windows[WindowSinus], 1u),
+               100.0 * stats.flagged[WindowEctopic] / MAX(windows[WindowEctopic], 1u), (double)stats.onsetWindows / MAX(episodes, 1u),
+               (double)stats.offsetWindows / MAX(episodes, 1u), stats.missedEpisodes);
+    }
+    return 0;
+}
@@ -0,0 +1,133 @@
+/**
+ * @file roi_bench.cc
+ * @author Adam Page (adam.page@ambiq.com)
+ * @brief Host check and benchmark of region-of-interest segmentation against dense segmentation
+ * @version 1.0
+ * @date 2023-05-02
+ *
+ * @copyright Copyright (c) 2023
+ *
+ * Synthesizes five minutes of ECG with PACs and PVCs (synthetic_ecg.cc) at several mean heart rates
+ * and standardizes back to back HK_DATA_LEN windows as hk_preprocess() does. Each window is
+ * segmented densely, streaming the whole window as segmentation_stream() does, and over the regions
+ * ../src/roi_segmentation.cc plans around ../src/pan_tompkins.cc candidates, as the segmentation
+ * head does with HK_SEG_ROI_ENABLE, at several contexts. For each it reports the share of samples
+ * streamed, host time against dense (detector included), the labels that agree with dense, and the
+ * P, QRS and T boundaries (onsets and offsets) of the dense mask the regions miss or move, within
+ * 40 ms. Dense segmentation also labels spurious waves between beats, which the regions drop, so
+ * the synthesized wave boundaries are the reference too: at the default context the regions have to
+ * find the true QRS boundaries dense segmentation finds. Host timings only show the ratio, target
+ * cycles come from the SEGMENTATION stage counters.
+ *
+ * Build: make -C evb/host roi
+ */
+#include <chrono>
+#include <cmath>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <random>
+#include <vector>
+
+#include "tensorflow/lite/schema/schema_generated.h"
+
+#include "segmentation_model_buffer.h"
+
+#include "pan_tompkins.h"
+
+#include "constants.h"
+#include "heartkit.h"
+#include "model_arena.h"
+#include "roi_segmentation.h"
+#include "segment_eval.h"
+#include "stream_model.h"
+#include "synthetic_ecg.h"
+
+#define REPLAY_SEC (300)
+#define BOUNDARY_TOL (40 * SAMPLE_RATE / 1000)
+
+static const float rates[] = {45.0f, 65.0f, 90.0f};
+static const uint32_t contexts[] = {16, HK_ROI_CONTEXT, 64, 128};
+
+const char *HK_SEGMENT_LABELS[] = {"NONE", "P-WAVE", "QRS", "T-WAVE"};
+
+int
+main(void) {
+    std::vector<uint64_t> modelBuf((g_segmentation_model_len + sizeof(uint64_t) - 1) / sizeof(uint64_t));
+    memcpy(modelBuf.data(), g_segmentation_model, g_segmentation_model_len);
+    const tflite::Model *model = tflite::GetModel(modelBuf.data());
+    std::vector<uint8_t> streamArena(HK_SEG_STREAM_ARENA_SIZE);
+    static StreamModel stream;
+    if (stream.Init(model, streamArena.data(), streamArena.size(), HK_SEG_STREAM_STEP, HK_DATA_LEN) != kTfLiteOk) {
+        fprintf(stderr, "SEG: init failed\n");
+        return 1;
+    }
+    printf("SEG   stream align=%d latency=%d samples, regions: pre=%d samples QTc=%.2f s tail=%d samples\n", (int)stream.Align(),
+           (int)stream.Latency(), HK_ROI_PRE, HK_ROI_QTC, HK_ROI_TAIL);
+    int failures = 0;
+    std::vector<float> data(HK_DATA_LEN);
+    std::vector<uint8_t> dense(HK_DATA_LEN), roiMask(HK_DATA_LEN);
+    int32_t peaks[HK_PEAK_LEN];
+    hk_roi_t rois[HK_PEAK_LEN + 1];
+    for (float bpm : rates) {
+        std::mt19937 rng(0x4b48);
+        std::vector<ecg_beat_t> beats;
+        const std::vector<float> ecg = synthesize_ecg(rng, {REPLAY_SEC, 0.04f, 0.04f, false, false, bpm}, beats);
+        const std::vector<uint8_t> truthMask = ecg_segment_mask(beats, ecg.size());
+        const size_t numCtx = sizeof(contexts) / sizeof(contexts[0]);
+        std::vector<uint64_t> fed(numCtx, 0);
+        std::vector<size_t> agree(numCtx, 0);
+        std::vector<double> roiUs(numCtx, 0);
+        std::vector<std::vector<boundary_score_t>> vsDense(numCtx, std::vector<boundary_score_t>(4)),
+            vsTruth(numCtx, std::vector<boundary_score_t>(4));
+        boundary_score_t denseVsTruth[4] = {};
+        double denseUs = 0;
+        uint64_t samples = 0;
+        hk_pt_reset();
+        for (uint32_t start = 0; start + HK_DATA_LEN <= ecg.size(); start += HK_DATA_LEN) {
+            ecg_standardize(&ecg[start], data.data(), HK_DATA_LEN);
+            memset(dense.data(), HeartSegmentNormal, HK_DATA_LEN);
+            auto t0 = std::chrono::steady_clock::now();
+            failures += stream_segment(&stream, data.data(), HK_DATA_LEN, dense.data()) != 0;
+            auto t1 = std::chrono::steady_clock::now();
+            const uint32_t numCands = pan_tompkins_peaks(data.data(), start, HK_DATA_LEN, peaks, HK_PEAK_LEN);
+            auto t2 = std::chrono::steady_clock::now();
+            denseUs += std::chrono::duration<double, std::micro>(t1 - t0).count();
+            samples += HK_DATA_LEN;
+            const std::vector<boundary_t> denseBounds = mask_boundaries(dense.data(), HK_DATA_LEN);
+            const std::vector<boundary_t> truthBounds = mask_boundaries(&truthMask[start], HK_DATA_LEN);
+            score_boundaries(truthBounds, denseBounds, BOUNDARY_TOL, denseVsTruth);
+            for (size_t c = 0; c < numCtx; c++) {
+                // As segmentation_roi_run() in heartkit.cc
+                auto t3 = std::chrono::steady_clock::now();
+                memset(roiMask.data(), HeartSegmentNormal, HK_DATA_LEN);
+                const uint32_t numRois = hk_roi_plan(peaks, numCands, HK_DATA_LEN, contexts[c], stream.Align(), rois, HK_PEAK_LEN + 1);
+                for (uint32_t i = 0; i < numRois; i++) {
+                    failures += stream_segment(&stream, &data[rois[i].start], rois[i].end - rois[i].start, &roiMask[rois[i].start]) != 0;
+                    memset(&roiMask[rois[i].start], HeartSegmentNormal, rois[i].labelStart - rois[i].start);
+                    memset(&roiMask[rois[i].labelEnd], HeartSegmentNormal, rois[i].end - rois[i].labelEnd);
+                    fed[c] += rois[i].end - rois[i].start;
+                }
+                roiUs[c] += std::chrono::duration<double, std::micro>(std::chrono::steady_clock::now() - t3 + (t2 - t1)).count();
+                for (uint32_t i = 0; i < HK_DATA_LEN; i++) {
+                    agree[c] += roiMask[i] == dense[i];
+                }
+                const std::vector<boundary_t> roiBounds = mask_boundaries(roiMask.data(), HK_DATA_LEN);
+                score_boundaries(denseBounds, roiBounds, BOUNDARY_TOL, vsDense[c].data());
+                score_boundaries(truthBounds, roiBounds, BOUNDARY_TOL, vsTruth[c].data());
+            }
+        }
+        printf("bpm=%.0f (%zu beats in %d s), dense: %.1f us/window\n", bpm, beats.size(), REPLAY_SEC, denseUs / (samples / HK_DATA_LEN));
+        print_scores("dense vs truth", denseVsTruth);
+        for (size_t c = 0; c < numCtx; c++) {
+            printf(" context=%-3u streamed=%5.1f%% time=%5.1f%% labels agree=%6.2f%%\n", contexts[c], 100.0 * fed[c] / samples,
+                   100.0 * roiUs[c] / denseUs, 100.0 * agree[c] / samples);
+            print_scores("vs dense", vsDense[c].data());
+            print_scores("vs truth", vsTruth[c].data());
+            // At the default context the regions have to find the true QRS boundaries dense segmentation finds
+            const boundary_score_t &qrs = vsTruth[c][HeartSegmentQrs];
+            failures += contexts[c] == HK_ROI_CONTEXT && qrs.matched + qrs.total / 200 < denseVsTruth[HeartSegmentQrs].matched;
+        }
+    }
+    return failures ? 1 : 0;
+}
@@ -0,0 +1,152 @@
+/**
+ * @file rpc_frame_bench.cc
+ * @author Adam Page (adam.page@ambiq.com)
+ * @brief Host microbenchmark of eRPC frame encode/decode (bytes per cycle)
+ * @version 1.0
+ * @date 2023-05-02
+ *
+ * @copyright Copyright (c) 2023
+ *
+ * Compares the bitwise CRC16 + copy path in erpc.a against the table-driven CRC16 (rpc_crc16.cc)
+ * and the in-place path of rpc_transport.cc (CRC chained over prefix and payload, no copy).
+ *
+ * Build: make -C evb/host bench
+ */
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#endif
+
+#include "erpc_config_internal.h"
+#include "erpc_crc16.hpp"
+
+#define BENCH_PREFIX_LEN (40)
+#define BENCH_ITERS (20000)
+
+struct Header {
+    uint16_t m_messageSize;
+    uint16_t m_crc;
+};
+
+static uint64_t
+bench_cycles(void) {
+#if defined(__x86_64__) || defined(__i386__)
+    return __rdtsc();
+#elif defined(__aarch64__)
+    uint64_t val;
+    asm volatile("mrs %0, cntvct_el0" : "=r"(val));
+    return val;
+#else
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+#endif
+}
+
+static uint16_t
+crc16_bitwise(uint32_t crcStart, const uint8_t *data, uint32_t lengthInBytes) {
+    /**
+     * @brief Reference ITU-CCITT CRC-16 (same algorithm as erpc_crc16.o)
+     */
+    uint32_t crc = crcStart;
+    for (uint32_t j = 0; j < lengthInBytes; j++) {
+        crc ^= (uint32_t)data[j] << 8;
+        for (uint32_t i = 0; i < 8; i++) {
+            uint32_t temp = crc << 1;
+            if (crc & 0x8000) {
+                temp ^= 0x1021;
+            }
+            crc = temp;
+        }
+    }
+    return (uint16_t)crc;
+}
+
+static uint8_t payload[ERPC_DEFAULT_BUFFER_SIZE];
+static uint8_t message[ERPC_DEFAULT_BUFFER_SIZE];
+static uint8_t wire[ERPC_DEFAULT_BUFFER_SIZE + sizeof(Header)];
+static volatile uint32_t sink;
+
+static uint32_t
+encode_copy_bitwise(uint32_t len) {
+    memcpy(&message[BENCH_PREFIX_LEN], payload, len);
+    Header h = {(uint16_t)(BENCH_PREFIX_LEN + len), crc16_bitwise(0xEF4A, message, BENCH_PREFIX_LEN + len)};
+    return h.m_crc;
+}
+
+static uint32_t
+encode_copy_table(erpc::Crc16 &crc, uint32_t len) {
+    memcpy(&message[BENCH_PREFIX_LEN], payload, len);
+    Header h = {(uint16_t)(BENCH_PREFIX_LEN + len), crc.computeCRC16(message, BENCH_PREFIX_LEN + len)};
+    return h.m_crc;
+}
+
+static uint32_t
+encode_inplace_table(erpc::Crc16 &crc, uint32_t len) {
+    erpc::Crc16 payloadCrc(crc.computeCRC16(message, BENCH_PREFIX_LEN));
+    Header h = {(uint16_t)(BENCH_PREFIX_LEN + len), payloadCrc.computeCRC16(payload, len)};
+    return h.m_crc;
+}
+
+static uint32_t
+decode_bitwise(uint32_t) {
+    Header h;
+    memcpy(&h, wire, sizeof(h));
+    return crc16_bitwise(0xEF4A, &wire[sizeof(h)], h.m_messageSize) == h.m_crc;
+}
+
+static uint32_t
+decode_table(erpc::Crc16 &crc, uint32_t) {
+    Header h;
+    memcpy(&h, wire, sizeof(h));
+    return crc.computeCRC16(&wire[sizeof(h)], h.m_messageSize) == h.m_crc;
+}
+
+template <typename F>
+static double
+bench_bytes_per_cycle(F fn, uint32_t len) {
+    uint64_t best = UINT64_MAX;
+    for (uint32_t r = 0; r < 5; r++) {
+        uint64_t start = bench_cycles();
+        for (uint32_t i = 0; i < BENCH_ITERS; i++) {
+            sink = fn(len);
+        }
+        uint64_t elapsed = bench_cycles() - start;
+        best = elapsed < best ? elapsed : best;
+    }
+    return (double)len * BENCH_ITERS / (double)best;
+}
+
+int
+main(void) {
+    erpc::Crc16 crc;
+    for (uint32_t i = 0; i < sizeof(payload); i++) {
+        payload[i] = (uint8_t)(i * 31 + 7);
+    }
+    for (uint32_t i = 0; i < BENCH_PREFIX_LEN; i++) {
+        message[i] = (uint8_t)(i * 13 + 1);
+    }
+
+    // Table and in-place CRC must match the library exactly, including odd lengths
+    for (uint32_t len = 0; len < 64; len++) {
+        uint32_t ref = encode_copy_bitwise(len);
+        if (encode_copy_table(crc, len) != ref || encode_inplace_table(crc, len) != ref) {
+            printf("CRC mismatch at len=%u\n", len);
+            return 1;
+        }
+    }
+
+    printf("%8s %14s %14s %14s %14s %14s\n", "bytes", "enc-bitwise", "enc-table", "enc-inplace", "dec-bitwise", "dec-table");
+    const uint32_t sizes[] = {50 * sizeof(float), 250, 250 * sizeof(float), ERPC_DEFAULT_BUFFER_SIZE - BENCH_PREFIX_LEN};
+    for (uint32_t len : sizes) {
+        Header h = {(uint16_t)(BENCH_PREFIX_LEN + len), (uint16_t)encode_copy_bitwise(len)};
+        memcpy(wire, &h, sizeof(h));
+        memcpy(&wire[sizeof(h)], message, BENCH_PREFIX_LEN + len);
+        printf("%8u %14.3f %14.3f %14.3f %14.3f %14.3f\n", len, bench_bytes_per_cycle(encode_copy_bitwise, len),
+               bench_bytes_per_cycle([&](uint32_t n) { return encode_copy_table(crc, n); }, len),
+               bench_bytes_per_cycle([&](uint32_t n) { return encode_inplace_table(crc, n); }, len),
+               bench_bytes_per_cycle(decode_bitwise, len), bench_bytes_per_cycle([&](uint32_t n) { return decode_table(crc, n); }, len));
+    }
+    return 0;
+}
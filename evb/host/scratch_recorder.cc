@@ -0,0 +1,115 @@
+/**
+ * @file scratch_recorder.cc
+ * @author Adam Page (adam.page@ambiq.com)
+ * @brief Host op resolver that records kernel scratch buffer requests
+ * @version 1.0
+ * @date 2023-05-02
+ *
+ * @copyright Copyright (c) 2023
+ *
+ */
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+
+#include "scratch_recorder.h"
+
+typedef struct {
+    TfLiteStatus (*prepare)(TfLiteContext *context, TfLiteNode *node);
+    TfLiteRegistration registration;
+    tflite::BuiltinOperator op;
+    const char *custom; // Custom op name (nullptr for builtins)
+} recorded_op_t;
+
+static recorded_op_t recordedOps[SCRATCH_MAX_OP_TYPES];
+static uint32_t numRecordedOps = 0;
+static TfLiteStatus (*requestScratch)(TfLiteContext *, size_t, int *) = nullptr;
+static std::vector<scratch_request_t> requests;
+static int32_t activeOutput = -1;
+
+static TfLiteStatus
+record_scratch(TfLiteContext *context, size_t bytes, int *buffer_idx) {
+    requests.push_back({activeOutput, bytes});
+    return requestScratch(context, bytes, buffer_idx);
+}
+
+template <int Slot>
+static TfLiteStatus
+recorded_prepare(TfLiteContext *context, TfLiteNode *node) {
+    requestScratch = context->RequestScratchBufferInArena;
+    context->RequestScratchBufferInArena = record_scratch;
+    activeOutput = node->outputs->size > 0 ? node->outputs->data[0] : -1;
+    TfLiteStatus status = recordedOps[Slot].prepare(context, node);
+    context->RequestScratchBufferInArena = requestScratch;
+    return status;
+}
+
+#define RECORDED_PREPARE_4(n) recorded_prepare<n>, recorded_prepare<n + 1>, recorded_prepare<n + 2>, recorded_prepare<n + 3>
+static TfLiteStatus (*const recordedPrepares[SCRATCH_MAX_OP_TYPES])(TfLiteContext *, TfLiteNode *) = {
+    RECORDED_PREPARE_4(0), RECORDED_PREPARE_4(4), RECORDED_PREPARE_4(8), RECORDED_PREPARE_4(12), RECORDED_PREPARE_4(16), RECORDED_PREPARE_4(20)};
+
+static const TfLiteRegistration *
+record_op(const TfLiteRegistration *registration, tflite::BuiltinOperator op, const char *custom) {
+    /**
+     * @brief Copy registration into the next slot with its prepare wrapped
+     */
+    if (registration == nullptr || registration->prepare == nullptr) {
+        return registration;
+    }
+    if (numRecordedOps >= SCRATCH_MAX_OP_TYPES) {
+        fprintf(stderr, "Too many op types, raise SCRATCH_MAX_OP_TYPES\n");
+        exit(1);
+    }
+    recorded_op_t *slot = &recordedOps[numRecordedOps];
+    slot->op = op;
+    slot->custom = custom;
+    slot->prepare = registration->prepare;
+    slot->registration = *registration;
+    slot->registration.prepare = recordedPrepares[numRecordedOps];
+    numRecordedOps++;
+    return &slot->registration;
+}
+
+const TfLiteRegistration *
+ScratchRecordingOpResolver::FindOp(tflite::BuiltinOperator op) const {
+    for (uint32_t i = 0; i < numRecordedOps; i++) {
+        if (recordedOps[i].custom == nullptr && recordedOps[i].op == op) {
+            return &recordedOps[i].registration;
+        }
+    }
+    return record_op(m_resolver.FindOp(op), op, nullptr);
+}
+
+const TfLiteRegistration *
+ScratchRecordingOpResolver::FindOp(const char *op) const {
+    for (uint32_t i = 0; i < numRecordedOps; i++) {
+        if (recordedOps[i].custom != nullptr && strcmp(recordedOps[i].custom, op) == 0) {
+            return &recordedOps[i].registration;
+        }
+    }
+    const TfLiteRegistration *registration = m_resolver.FindOp(op);
+    return record_op(registration, tflite::BuiltinOperator_CUSTOM, registration ? registration->custom_name : nullptr);
+}
+
+void
+ScratchRecordingOpResolver::Reset(void) {
+    requests.clear();
+}
+
+const std::vector<scratch_request_t> &
+ScratchRecordingOpResolver::Requests(void) {
+    return requests;
+}
+
+size_t
+ScratchRecordingOpResolver::MaxOpScratch(void) {
+    size_t maxBytes = 0;
+    for (size_t i = 0; i < requests.size(); i++) {
+        size_t opBytes = 0;
+        for (const auto &r : requests) {
+            opBytes += r.outputTensor == requests[i].outputTensor ? r.bytes : 0;
+        }
+        maxBytes = opBytes > maxBytes ? opBytes : maxBytes;
+    }
+    return maxBytes;
+}
@@ -0,0 +1,64 @@
+/**
+ * @file scratch_recorder.h
+ * @author Adam Page (adam.page@ambiq.com)
+ * @brief Host op resolver that records kernel scratch buffer requests
+ * @version 1.0
+ * @date 2023-05-02
+ *
+ * @copyright Copyright (c) 2023
+ *
+ */
+#ifndef __SCRATCH_RECORDER_H
+#define __SCRATCH_RECORDER_H
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#include "tensorflow/lite/micro/micro_op_resolver.h"
+
+#define SCRATCH_MAX_OP_TYPES (24)
+
+typedef struct {
+    int32_t outputTensor; // Output 0 of requesting node (identifies the operator)
+    size_t bytes;         // Bytes requested
+} scratch_request_t;
+
+/**
+ * @brief Op resolver that wraps each kernel's prepare so RequestScratchBufferInArena calls
+ * made during AllocateTensors() are recorded per operator.
+ */
+class ScratchRecordingOpResolver : public tflite::MicroOpResolver {
+  public:
+    explicit ScratchRecordingOpResolver(const tflite::MicroOpResolver &resolver) : m_resolver(resolver) {}
+
+    virtual const TfLiteRegistration *
+    FindOp(tflite::BuiltinOperator op) const override;
+    virtual const TfLiteRegistration *
+    FindOp(const char *op) const override;
+    virtual BuiltinParseFunction
+    GetOpDataParser(tflite::BuiltinOperator op) const override {
+        return m_resolver.GetOpDataParser(op);
+    }
+
+    /**
+     * @brief Clear recorded requests (call before AllocateTensors)
+     */
+    static void
+    Reset(void);
+    /**
+     * @brief Requests recorded since Reset
+     */
+    static const std::vector<scratch_request_t> &
+    Requests(void);
+    /**
+     * @brief Largest total request of a single operator since Reset
+     */
+    static size_t
+    MaxOpScratch(void);
+
+  private:
+    const tflite::MicroOpResolver &m_resolver;
+};
+
+#endif // __SCRATCH_RECORDER_H
@@ -0,0 +1,96 @@
+/**
+ * @file segment_eval.cc
+ * @author Adam Page (adam.page@ambiq.com)
+ * @brief Host segmentation streaming and wave boundary scores for the segmentation benches
+ * @version 1.0
+ * @date 2023-05-02
+ *
+ * @copyright Copyright (c) 2023
+ *
+ */
+#include <cstdio>
+#include <cstdlib>
+
+#include "arm_math.h"
+
+#include "constants.h"
+#include "heartkit.h"
+#include "segment_eval.h"
+
+int
+stream_segment(StreamModel *stream, const float *data, uint32_t len, uint8_t *segMask) {
+    int8_t x[HK_SEG_STREAM_STEP];
+    const int32_t channels = stream->OutputChannels();
+    int32_t count;
+    uint32_t yIdx = 0;
+    len -= len % stream->Align();
+    stream->Reset();
+    auto labels = [&](int32_t n) {
+        const int8_t *rows = stream->Output();
+        for (int32_t i = 0; i < n; i++) {
+            uint8_t best = 0;
+            for (int32_t j = 1; j < channels; j++) {
+                best = rows[i * channels + j] > rows[i * channels + best] ? j : best;
+            }
+            segMask[yIdx++] = best;
+        }
+    };
+    for (uint32_t i = 0; i < len; i += HK_SEG_STREAM_STEP) {
+        const uint32_t xLen = MIN(HK_SEG_STREAM_STEP, len - i);
+        for (uint32_t j = 0; j < xLen; j++) {
+            x[j] = (int8_t)(data[i + j] / stream->InputScale() + stream->InputZeroPoint());
+        }
+        if ((count = stream->Push(x, xLen)) < 0) {
+            return -1;
+        }
+        labels(count);
+    }
+    while ((count = stream->Finish()) > 0) {
+        labels(count);
+    }
+    return count < 0 ? -1 : 0;
+}
+
+std::vector<boundary_t>
+mask_boundaries(const uint8_t *segMask, uint32_t len) {
+    std::vector<boundary_t> bounds;
+    for (uint32_t i = 1; i < len; i++) {
+        if (segMask[i] == segMask[i - 1]) {
+            continue;
+        }
+        if (segMask[i - 1] != HeartSegmentNormal) {
+            bounds.push_back({i, segMask[i - 1], false});
+        }
+        if (segMask[i] != HeartSegmentNormal) {
+            bounds.push_back({i, segMask[i], true});
+        }
+    }
+    return bounds;
+}
+
+void
+score_boundaries(const std::vector<boundary_t> &ref, const std::vector<boundary_t> &test, int32_t tol, boundary_score_t *scores) {
+    for (const boundary_t &r : ref) {
+        int32_t best = tol + 1;
+        for (const boundary_t &t : test) {
+            if (t.label == r.label && t.onset == r.onset) {
+                best = MIN(best, abs((int32_t)t.idx - (int32_t)r.idx));
+            }
+        }
+        scores[r.label].total++;
+        if (best <= tol) {
+            scores[r.label].matched++;
+            scores[r.label].err += best;
+        }
+    }
+}
+
+void
+print_scores(const char *name, const boundary_score_t *scores) {
+    printf("  %-14s", name);
+    for (int s = HeartSegmentPWave; s <= HeartSegmentTWave; s++) {
+        printf(" %s missed=%5.2f%% err=%4.1f ms", HK_SEGMENT_LABELS[s], 100.0 * (scores[s].total - scores[s].matched) / MAX(1u, scores[s].total),
+               1000.0 * scores[s].err / MAX(1u, scores[s].matched) / SAMPLE_RATE);
+    }
+    printf("\n");
+}
@@ -0,0 +1,58 @@
+/**
+ * @file segment_eval.h
+ * @author Adam Page (adam.page@ambiq.com)
+ * @brief Host segmentation streaming and wave boundary scores for the segmentation benches
+ * @version 1.0
+ * @date 2023-05-02
+ *
+ * @copyright Copyright (c) 2023
+ *
+ */
+#ifndef __SEGMENT_EVAL_H
+#define __SEGMENT_EVAL_H
+
+#include <cstdint>
+#include <vector>
+
+#include "stream_model.h"
+
+typedef struct {
+    uint32_t idx;
+    uint8_t label;
+    bool onset;
+} boundary_t;
+
+typedef struct {
+    uint32_t total;
+    uint32_t matched;
+    double err;
+} boundary_score_t;
+
+/**
+ * @brief Segment a signal by streaming it through the model, as segmentation_stream() in model.cc
+ * @param segMask Output labels [len], the last len % stream->Align() samples are not labeled
+ * @return 0 on success, -1 on error
+ */
+int
+stream_segment(StreamModel *stream, const float *data, uint32_t len, uint8_t *segMask);
+
+/**
+ * @brief Onsets and offsets of the waves (labels other than HeartSegmentNormal) of a mask
+ */
+std::vector<boundary_t>
+mask_boundaries(const uint8_t *segMask, uint32_t len);
+
+/**
+ * @brief Nearest test boundary of the same wave and side within tol samples of each ref boundary
+ * @param scores Per segment label [4]
+ */
+void
+score_boundaries(const std::vector<boundary_t> &ref, const std::vector<boundary_t> &test, int32_t tol, boundary_score_t *scores);
+
+/**
+ * @brief Print the boundaries missed and the mean error of the matched ones per wave
+ */
+void
+print_scores(const char *name, const boundary_score_t *scores);
+
+#endif // __SEGMENT_EVAL_H
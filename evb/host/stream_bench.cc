@@ -0,0 +1,225 @@
+/**
+ * @file stream_bench.cc
+ * @author Adam Page (adam.page@ambiq.com)
+ * @brief Host check and benchmark of streamed segmentation against the windowed model
+ * @version 1.0
+ * @date 2023-05-02
+ *
+ * @copyright Copyright (c) 2023
+ *
+ * Streams random windows of HK_SEG_LEN samples through StreamModel in pushes of several sizes and
+ * checks the outputs are bit-identical to Invoke() of the windowed model. Then segments random
+ * HK_DATA_LEN signals both as hk_run does (overlapping windows, HK_SEG_OLP trimmed) and streamed,
+ * and reports the time per input sample of each and how many labels agree. Streamed labels
+ * differ from the windowed ones near the window seams, where the windowed model sees padding.
+ * Last, it segments overlapping windows of synthetic ECG both by restreaming each window and by
+ * continuing one stream across them (../src/stream_window.cc), which must push each sample once.
+ * Host timings only show the work saved; target cycles come from the SEGMENTATION stage counters.
+ *
+ * Build: make -C evb/host stream
+ */
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <random>
+#include <vector>
+
+#include "tensorflow/lite/micro/all_ops_resolver.h"
+#include "tensorflow/lite/micro/micro_error_reporter.h"
+#include "tensorflow/lite/micro/micro_interpreter.h"
+#include "tensorflow/lite/schema/schema_generated.h"
+
+#include "segmentation_model_buffer.h"
+
+#include "arm_math.h"
+
+#include "constants.h"
+#include "conv1d_kernels.h"
+#include "custom_ops.h"
+#include "model_arena.h"
+#include "segment_eval.h"
+#include "stream_model.h"
+#include "stream_window.h"
+#include "synthetic_ecg.h"
+
+#define ARENA_SIZE (512 * 1024)
+#define BENCH_INPUTS (8)
+#define BENCH_RUNS (10)
+#define OVERLAP_SEC (300)
+
+static const int32_t pushLens[] = {HK_SEG_STREAM_STEP, 7, 1};
+static const uint32_t windowSteps[] = {HK_DATA_LEN / 2, HK_DATA_LEN / 4};
+
+const char *HK_SEGMENT_LABELS[] = {"NONE", "P-WAVE", "QRS", "T-WAVE"};
+
+static int32_t
+stream_run(StreamModel *stream, const int8_t *input, int32_t len, int32_t pushLen, int8_t *output) {
+    /**
+     * @brief Stream len samples in pushes of pushLen, then finish
+     * @return Output positions, or -1 on error
+     */
+    const int32_t channels = stream->OutputChannels();
+    int32_t outLen = 0;
+    stream->Reset();
+    int32_t count;
+    for (int32_t i = 0; i < len; i += pushLen) {
+        if ((count = stream->Push(&input[i], std::min(pushLen, len - i))) < 0) {
+            return -1;
+        }
+        memcpy(&output[outLen * channels], stream->Output(), count * channels);
+        outLen += count;
+    }
+    while ((count = stream->Finish()) > 0) {
+        memcpy(&output[outLen * channels], stream->Output(), count * channels);
+        outLen += count;
+    }
+    return count < 0 ? -1 : outLen;
+}
+
+static void
+argmax_rows(const int8_t *rows, int32_t len, int32_t channels, uint8_t *labels) {
+    for (int32_t i = 0; i < len; i++) {
+        int32_t best = 0;
+        for (int32_t c = 1; c < channels; c++) {
+            best = rows[i * channels + c] > rows[i * channels + best] ? c : best;
+        }
+        labels[i] = (uint8_t)best;
+    }
+}
+
+int
+main(void) {
+    static tflite::MicroErrorReporter microErrorReporter;
+    static tflite::AllOpsResolver allOpsResolver;
+    add_custom_ops(allOpsResolver);
+    static Conv1dOpResolver conv1dResolver(allOpsResolver);
+    std::mt19937 rng(0x4b48);
+    std::uniform_int_distribution<int> dist(-128, 127);
+    int failures = 0;
+
+    // Model arrays in the generated headers are only byte aligned on host
+    std::vector<uint64_t> modelBuf((g_segmentation_model_len + sizeof(uint64_t) - 1) / sizeof(uint64_t));
+    memcpy(modelBuf.data(), g_segmentation_model, g_segmentation_model_len);
+    const tflite::Model *model = tflite::GetModel(modelBuf.data());
+    std::vector<uint64_t> arena(ARENA_SIZE / sizeof(uint64_t));
+    tflite::MicroInterpreter interpreter(model, conv1dResolver, (uint8_t *)arena.data(), ARENA_SIZE, &microErrorReporter);
+    std::vector<uint8_t> streamArena(HK_SEG_STREAM_ARENA_SIZE);
+    static StreamModel stream;
+    if (interpreter.AllocateTensors() != kTfLiteOk ||
+        stream.Init(model, streamArena.data(), streamArena.size(), HK_SEG_STREAM_STEP, HK_DATA_LEN) != kTfLiteOk) {
+        fprintf(stderr, "SEG: init failed\n");
+        return 1;
+    }
+    TfLiteTensor *in = interpreter.input(0);
+    TfLiteTensor *out = interpreter.output(0);
+    const int32_t channels = stream.OutputChannels();
+    printf("SEG   window=%d align=%d latency=%d samples arena: windowed=%d streamed=%d bytes\n", HK_SEG_LEN, (int)stream.Align(),
+           (int)stream.Latency(), HK_SEG_ARENA_SIZE, HK_SEG_STREAM_ARENA_SIZE);
+
+    // Streaming one window is the windowed model
+    std::vector<int8_t> window(HK_SEG_LEN);
+    std::vector<int8_t> streamed(HK_DATA_LEN * channels);
+    for (int32_t pushLen : pushLens) {
+        int mismatches = 0;
+        for (int i = 0; i < BENCH_INPUTS; i++) {
+            for (int8_t &x : window) {
+                x = (int8_t)dist(rng);
+            }
+            memcpy(in->data.int8, window.data(), in->bytes);
+            interpreter.Invoke();
+            int32_t len = stream_run(&stream, window.data(), HK_SEG_LEN, pushLen, streamed.data());
+            mismatches += len != HK_SEG_LEN || memcmp(out->data.int8, streamed.data(), out->bytes) != 0;
+        }
+        printf("push=%-3d outputs=%s\n", (int)pushLen, mismatches ? "MISMATCH" : "identical");
+        failures += mismatches;
+    }
+
+    // Signal segmentation, windowed (as hk_run) vs streamed
+    const int32_t streamLen = HK_DATA_LEN - HK_DATA_LEN % stream.Align();
+    std::vector<int8_t> signal(HK_DATA_LEN);
+    std::vector<uint8_t> windowedMask(HK_DATA_LEN), streamedMask(HK_DATA_LEN);
+    std::vector<size_t> starts;
+    for (size_t i = 0; i < HK_DATA_LEN - HK_SEG_LEN + 1; i += HK_SEG_STEP) {
+        starts.push_back(i);
+    }
+    starts.push_back(HK_DATA_LEN - HK_SEG_LEN);
+    double windowedUs = 0, streamedUs = 0;
+    size_t agree = 0, compared = 0;
+    for (int i = 0; i < BENCH_INPUTS; i++) {
+        for (int8_t &x : signal) {
+            x = (int8_t)dist(rng);
+        }
+        auto start = std::chrono::steady_clock::now();
+        for (int r = 0; r < BENCH_RUNS; r++) {
+            for (size_t s : starts) {
+                memcpy(in->data.int8, &signal[s], in->bytes);
+                interpreter.Invoke();
+                argmax_rows(&out->data.int8[HK_SEG_OLP * channels], HK_SEG_LEN - 2 * HK_SEG_OLP, channels, &windowedMask[s + HK_SEG_OLP]);
+            }
+        }
+        auto mid = std::chrono::steady_clock::now();
+        for (int r = 0; r < BENCH_RUNS; r++) {
+            if (stream_run(&stream, signal.data(), streamLen, HK_SEG_STREAM_STEP, streamed.data()) != streamLen) {
+                fprintf(stderr, "SEG: stream failed\n");
+                return 1;
+            }
+            argmax_rows(streamed.data(), streamLen, channels, streamedMask.data());
+        }
+        auto end = std::chrono::steady_clock::now();
+        windowedUs += std::chrono::duration<double, std::micro>(mid - start).count() / BENCH_RUNS;
+        streamedUs += std::chrono::duration<double, std::micro>(end - mid).count() / BENCH_RUNS;
+        for (int32_t j = HK_SEG_OLP; j < streamLen; j++) {
+            agree += windowedMask[j] == streamedMask[j];
+            compared++;
+        }
+    }
+    windowedUs /= BENCH_INPUTS;
+    streamedUs /= BENCH_INPUTS;
+    printf("signal=%d windowed=%zu invokes %7.2f us/sample streamed=%7.2f us/sample speedup=%.2fx labels agree=%.1f%%\n", HK_DATA_LEN,
+           starts.size(), windowedUs / HK_DATA_LEN, streamedUs / streamLen, (windowedUs / HK_DATA_LEN) / (streamedUs / streamLen),
+           100.0 * agree / compared);
+
+    // Overlapping windows of synthetic ECG, each restreamed (segmentation_stream) or continued (stream_window.cc)
+    std::vector<uint8_t> contArena(HK_SEG_STREAM_ARENA_SIZE);
+    static StreamModel contStream;
+    if (contStream.Init(model, contArena.data(), contArena.size(), HK_SEG_STREAM_STEP, HK_DATA_LEN) != kTfLiteOk) {
+        fprintf(stderr, "SEG: init failed\n");
+        return 1;
+    }
+    std::mt19937 ecgRng(0x4b48);
+    std::vector<ecg_beat_t> beats;
+    const std::vector<float> ecg = synthesize_ecg(ecgRng, {OVERLAP_SEC, 0.04f, 0.04f, false, false, 0.0f}, beats);
+    std::vector<float> data(HK_DATA_LEN);
+    std::vector<uint8_t> restreamedMask(HK_DATA_LEN), continuedMask(HK_DATA_LEN);
+    static hk_stream_window_t win;
+    for (uint32_t step : windowSteps) {
+        hk_stream_window_reset(&win);
+        double restreamedUs = 0, continuedUs = 0;
+        uint64_t restreamed = 0, newSamples = 0;
+        agree = compared = 0;
+        for (uint32_t start = 0; start + HK_DATA_LEN <= ecg.size(); start += step) {
+            ecg_standardize(&ecg[start], data.data(), HK_DATA_LEN);
+            auto t0 = std::chrono::steady_clock::now();
+            failures += stream_segment(&stream, data.data(), HK_DATA_LEN, restreamedMask.data()) != 0;
+            auto t1 = std::chrono::steady_clock::now();
+            failures += hk_stream_window_run(&contStream, &win, data.data(), start, continuedMask.data()) != 0;
+            auto t2 = std::chrono::steady_clock::now();
+            restreamedUs += std::chrono::duration<double, std::micro>(t1 - t0).count();
+            continuedUs += std::chrono::duration<double, std::micro>(t2 - t1).count();
+            restreamed += HK_DATA_LEN;
+            newSamples += start == 0 ? HK_DATA_LEN : step;
+            // Labels of both up to the continued stream's latency
+            for (uint32_t i = 0; i < win.labeled - start; i++) {
+                agree += restreamedMask[i] == continuedMask[i];
+                compared++;
+            }
+        }
+        printf("step=%4u restreamed=%8llu samples %9.0f us continued=%8u samples %9.0f us (%4.1f%%) labels agree=%.1f%%\n", step,
+               (unsigned long long)restreamed, restreamedUs, win.pushed, continuedUs, 100.0 * continuedUs / restreamedUs,
+               100.0 * agree / compared);
+        // Each sample is pushed once
+        failures += win.pushed != newSamples;
+    }
+    return failures ? 1 : 0;
+}
@@ -0,0 +1,137 @@
+/**
+ * @file synthetic_ecg.cc
+ * @author Adam Page (adam.page@ambiq.com)
+ * @brief Host ECG synthesizer with beat labels and wave boundaries for the replay tools
+ * @version 1.0
+ * @date 2023-05-02
+ *
+ * @copyright Copyright (c) 2023
+ *
+ * There is no recording with beat labels and wave boundaries in the tree, so the host replays of
+ * beat screening, QRS detection, segmentation and HRV draw their ECG from here. Waves are Gaussians,
+ * and a wave's boundaries are taken WAVE_SPAN standard deviations either side of its centre.
+ */
+#include <cmath>
+
+#include "arm_math.h"
+#include "constants.h"
+#include "heartkit.h"
+#include "synthetic_ecg.h"
+
+#define WAVE_SPAN (2.5f)
+
+static void
+add_wave(std::vector<float> &ecg, float centre, float amp, float width) {
+    /**
+     * @brief Add a Gaussian wave at centre (s) of amp and standard deviation width (s)
+     */
+    const int32_t lo = MAX(0, (int32_t)((centre - 4 * width) * SAMPLE_RATE));
+    const int32_t hi = MIN((int32_t)ecg.size(), (int32_t)((centre + 4 * width) * SAMPLE_RATE) + 1);
+    for (int32_t i = lo; i < hi; i++) {
+        const float d = ((float)i / SAMPLE_RATE - centre) / width;
+        ecg[i] += amp * expf(-0.5f * d * d);
+    }
+}
+
+static uint32_t
+wave_edge(float centre, float width, float side) {
+    return (uint32_t)MAX(0.0f, (centre + side * WAVE_SPAN * width) * SAMPLE_RATE);
+}
+
+std::vector<float>
+synthesize_ecg(std::mt19937 &rng, const ecg_config_t &config, std::vector<ecg_beat_t> &beats) {
+    std::normal_distribution<float> noise(0.0f, 1.0f);
+    std::uniform_real_distribution<float> unit(0.0f, 1.0f);
+    std::vector<float> ecg(config.seconds * SAMPLE_RATE, 0.0f);
+    const float bpm = config.bpm > 0 ? config.bpm : 65.0f;
+    float t = 1.0f;
+    uint32_t n = 0;
+    while (t < config.seconds - 1.0f) {
+        const uint32_t minute = ((uint32_t)t / 60) % 10;
+        const bool bigeminy = config.bigeminy && minute == 5;
+        const bool afib = config.afib && minute == 8;
+        uint32_t label = HeartBeatNormal;
+        if (afib) {
+            label = HeartBeatNormal;
+        } else if (bigeminy ? n % 2 == 1 : unit(rng) < config.pvcRate) {
+            label = HeartBeatPvc;
+        } else if (!bigeminy && unit(rng) < config.pacRate / (1 - config.pvcRate)) {
+            label = HeartBeatPac;
+        }
+        const float resp = 1.0f + 0.1f * sinf(2 * (float)M_PI * 0.25f * t);
+        const float base = 60.0f / (bpm + 10.0f * sinf(2 * (float)M_PI * t / 600.0f));
+        const float rr = base * (1.0f + (afib ? 0.25f : 0.03f) * noise(rng)) * (afib ? 0.8f : 1.0f);
+        ecg_beat_t beat = {0, label, afib, 0, 0, 0, 0, 0, 0};
+        if (label == HeartBeatPvc) {
+            // Most are premature with a compensatory pause, some come late enough that only their
+            // shape tells them apart
+            const float tp = t + (unit(rng) < 0.3f ? 0.9f : 0.6f) * rr;
+            add_wave(ecg, tp - 0.02f, -1.1f * resp, 0.035f);
+            add_wave(ecg, tp + 0.06f, 0.4f * resp, 0.03f);
+            add_wave(ecg, tp + 0.3f, 0.45f * resp, 0.07f);
+            beat.peak = (uint32_t)(tp * SAMPLE_RATE);
+            beat.qrsOn = wave_edge(tp - 0.02f, 0.035f, -1);
+            beat.qrsOff = wave_edge(tp + 0.06f, 0.03f, 1);
+            beat.tOn = wave_edge(tp + 0.3f, 0.07f, -1);
+            beat.tOff = wave_edge(tp + 0.3f, 0.07f, 1);
+            t += rr;
+        } else {
+            t += label == HeartBeatPac ? 0.7f * MAX(rr, 0.4f) : MAX(rr, 0.3f);
+            if (!afib) {
+                // Ectopic atrial focus: smaller, inverted P wave
+                add_wave(ecg, t - 0.16f, (label == HeartBeatPac ? -0.08f : 0.15f) * resp, 0.025f);
+                beat.pOn = wave_edge(t - 0.16f, 0.025f, -1);
+                beat.pOff = wave_edge(t - 0.16f, 0.025f, 1);
+            }
+            add_wave(ecg, t - 0.025f, -0.1f * resp, 0.01f);
+            add_wave(ecg, t, 1.0f * resp, 0.012f);
+            add_wave(ecg, t + 0.03f, -0.2f * resp, 0.012f);
+            add_wave(ecg, t + 0.28f, 0.3f * resp, 0.05f);
+            beat.peak = (uint32_t)(t * SAMPLE_RATE);
+            beat.qrsOn = wave_edge(t - 0.025f, 0.01f, -1);
+            beat.qrsOff = wave_edge(t + 0.03f, 0.012f, 1);
+            beat.tOn = wave_edge(t + 0.28f, 0.05f, -1);
+            beat.tOff = wave_edge(t + 0.28f, 0.05f, 1);
+        }
+        beats.push_back(beat);
+        n++;
+    }
+    for (size_t i = 0; i < ecg.size(); i++) {
+        const float s = (float)i / SAMPLE_RATE;
+        ecg[i] += 0.15f * sinf(2 * (float)M_PI * 0.2f * s) + 0.02f * noise(rng);
+        if (config.afib && ((uint32_t)s / 60) % 10 == 8) {
+            // Fibrillatory waves
+            ecg[i] += 0.04f * sinf(2 * (float)M_PI * 6.0f * s + sinf(2 * (float)M_PI * 0.5f * s));
+        }
+    }
+    return ecg;
+}
+
+std::vector<uint8_t>
+ecg_segment_mask(const std::vector<ecg_beat_t> &beats, size_t len) {
+    std::vector<uint8_t> mask(len, HeartSegmentNormal);
+    for (const ecg_beat_t &beat : beats) {
+        const uint32_t waves[3][3] = {
+            {beat.pOn, beat.pOff, HeartSegmentPWave}, {beat.qrsOn, beat.qrsOff, HeartSegmentQrs}, {beat.tOn, beat.tOff, HeartSegmentTWave}};
+        for (const auto &wave : waves) {
+            for (uint32_t i = wave[0]; i < MIN(wave[1], (uint32_t)len); i++) {
+                mask[i] = wave[2];
+            }
+        }
+    }
+    return mask;
+}
+
+void
+ecg_standardize(const float *x, float *y, size_t len) {
+    float mean = 0, var = 0;
+    for (size_t i = 0; i < len; i++) {
+        mean += x[i] / len;
+    }
+    for (size_t i = 0; i < len; i++) {
+        var += (x[i] - mean) * (x[i] - mean) / len;
+    }
+    for (size_t i = 0; i < len; i++) {
+        y[i] = (x[i] - mean) / sqrtf(var);
+    }
+}
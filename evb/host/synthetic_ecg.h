@@ -0,0 +1,63 @@
+/**
+ * @file synthetic_ecg.h
+ * @author Adam Page (adam.page@ambiq.com)
+ * @brief Host ECG synthesizer with beat labels and wave boundaries for the replay tools
+ * @version 1.0
+ * @date 2023-05-02
+ *
+ * @copyright Copyright (c) 2023
+ *
+ */
+#ifndef __SYNTHETIC_ECG_H
+#define __SYNTHETIC_ECG_H
+
+#include <cstdint>
+#include <random>
+#include <vector>
+
+typedef struct {
+    uint32_t peak;   // R peak sample
+    uint32_t label;  // HeartBeat
+    bool afib;       // Beat of an AFIB episode
+    uint32_t pOn;    // P wave [pOn, pOff), empty if the beat has none
+    uint32_t pOff;
+    uint32_t qrsOn;  // QRS [qrsOn, qrsOff)
+    uint32_t qrsOff;
+    uint32_t tOn;    // T wave [tOn, tOff)
+    uint32_t tOff;
+} ecg_beat_t;
+
+typedef struct {
+    uint32_t seconds;
+    float pacRate;   // Share of isolated PACs outside bigeminy and AFIB
+    float pvcRate;   // Share of isolated PVCs outside bigeminy and AFIB
+    bool bigeminy;   // Minute 5 of every 10 is PVC bigeminy
+    bool afib;       // Minute 8 of every 10 is AFIB
+    float bpm;       // Mean sinus rate, swinging 10 bpm either way over 10 minutes (0 for 65)
+} ecg_config_t;
+
+/**
+ * @brief ECG at SAMPLE_RATE from Gaussian P, QRS and T waves: sinus rhythm with heart rate
+ * variability, respiratory amplitude modulation, baseline wander and noise, plus the ectopy and
+ * episodes of config. PACs come early with an inverted P wave, PVCs have no P wave, a wide inverted
+ * QRS and a discordant T, and most come early with a compensatory pause. AFIB has irregular RR, no P
+ * waves and fibrillatory waves.
+ * @param beats Beats, in order
+ * @return Signal [config.seconds * SAMPLE_RATE]
+ */
+std::vector<float>
+synthesize_ecg(std::mt19937 &rng, const ecg_config_t &config, std::vector<ecg_beat_t> &beats);
+
+/**
+ * @brief Segment labels (HeartSegment) of the synthesized beats' wave boundaries
+ */
+std::vector<uint8_t>
+ecg_segment_mask(const std::vector<ecg_beat_t> &beats, size_t len);
+
+/**
+ * @brief Standardize a window of the signal as hk_preprocess() leaves it (zero mean, unit variance)
+ */
+void
+ecg_standardize(const float *x, float *y, size_t len);
+
+#endif // __SYNTHETIC_ECG_H
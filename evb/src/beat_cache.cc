@@ -0,0 +1,91 @@
+/**
+ * @file beat_cache.cc
+ * @author Adam Page (adam.page@ambiq.com)
+ * @brief Beat labels of overlapping windows, keyed by absolute R peak sample
+ * @version 1.0
+ * @date 2023-05-02
+ *
+ * @copyright Copyright (c) 2023
+ *
+ * With HK_WINDOW_STEP below HK_DATA_LEN each window repeats the tail of the last one, and every beat
+ * in the overlap would go through the beat model again. The beat head looks each beat up by the
+ * absolute sample of its R peak and only invokes the model for beats not seen before, beats whose
+ * previous, next or average RR moved by more than HK_BEAT_CACHE_RR_TOL samples (the model input is
+ * the beat and its neighbours avgRR away) and beats the model was unsure of (margin under
+ * HK_BEAT_CACHE_MARGIN). Peaks may move by HK_BEAT_CACHE_PEAK_TOL samples between windows, as each
+ * window is filtered and segmented on its own. A full cache replaces its oldest beat, so
+ * HK_BEAT_CACHE_LEN only has to cover the beats of one overlap.
+ */
+#include <cstring>
+
+#include "beat_cache.h"
+#include "constants.h"
+
+static hk_beat_entry_t hkBeatCache[HK_BEAT_CACHE_LEN];
+static uint32_t hkBeatCacheLookups = 0;
+static uint32_t hkBeatCacheHits = 0;
+
+static uint32_t
+abs_diff(uint32_t a, uint32_t b) {
+    return a > b ? a - b : b - a;
+}
+
+static int32_t
+beat_cache_find(uint32_t peak) {
+    /**
+     * @brief Index of the entry of the R peak at peak, -1 if none
+     */
+    for (int32_t i = 0; i < HK_BEAT_CACHE_LEN; i++) {
+        if (hkBeatCache[i].valid && abs_diff(hkBeatCache[i].peak, peak) <= HK_BEAT_CACHE_PEAK_TOL) {
+            return i;
+        }
+    }
+    return -1;
+}
+
+int32_t
+hk_beat_cache_lookup(const hk_beat_entry_t *beat) {
+    hkBeatCacheLookups++;
+    const int32_t i = beat_cache_find(beat->peak);
+    if (i < 0) {
+        return -1;
+    }
+    const hk_beat_entry_t *entry = &hkBeatCache[i];
+    if (abs_diff(entry->prevRR, beat->prevRR) > HK_BEAT_CACHE_RR_TOL || abs_diff(entry->nextRR, beat->nextRR) > HK_BEAT_CACHE_RR_TOL ||
+        abs_diff(entry->avgRR, beat->avgRR) > HK_BEAT_CACHE_RR_TOL || entry->margin < HK_BEAT_CACHE_MARGIN) {
+        return -1;
+    }
+    hkBeatCacheHits++;
+    return entry->label;
+}
+
+void
+hk_beat_cache_store(const hk_beat_entry_t *beat) {
+    int32_t i = beat_cache_find(beat->peak);
+    if (i < 0) {
+        // An empty entry, else the oldest beat
+        i = 0;
+        for (int32_t j = 0; j < HK_BEAT_CACHE_LEN; j++) {
+            if (!hkBeatCache[j].valid) {
+                i = j;
+                break;
+            }
+            i = hkBeatCache[j].peak < hkBeatCache[i].peak ? j : i;
+        }
+    }
+    hkBeatCache[i] = *beat;
+    hkBeatCache[i].valid = true;
+}
+
+void
+hk_beat_cache_reset(void) {
+    memset(hkBeatCache, 0, sizeof(hkBeatCache));
+    hkBeatCacheLookups = 0;
+    hkBeatCacheHits = 0;
+}
+
+void
+hk_beat_cache_stats(uint32_t *lookups, uint32_t *hits) {
+    *lookups = hkBeatCacheLookups;
+    *hits = hkBeatCacheHits;
+}
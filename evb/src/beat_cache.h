@@ -0,0 +1,55 @@
+/**
+ * @file beat_cache.h
+ * @author Adam Page (adam.page@ambiq.com)
+ * @brief Beat labels of overlapping windows, keyed by absolute R peak sample
+ * @version 1.0
+ * @date 2023-05-02
+ *
+ * @copyright Copyright (c) 2023
+ *
+ */
+#ifndef __BEAT_CACHE_H
+#define __BEAT_CACHE_H
+
+#include "arm_math.h"
+#include <stdint.h>
+
+/**
+ * @brief A classified beat and the RR context the beat model saw
+ */
+typedef struct {
+    uint32_t peak;    // Absolute sample index of the R peak
+    uint32_t prevRR;  // Samples from the previous peak
+    uint32_t nextRR;  // Samples to the next peak
+    uint32_t avgRR;   // Offset of the neighbour beats fed to the model
+    float32_t margin; // Softmax top minus runner-up
+    uint32_t label;
+    bool valid;
+} hk_beat_entry_t;
+
+/**
+ * @brief Cached label of a beat seen in an earlier window with the same context
+ * @return Label, or -1 if the beat is new, its context moved or its margin was low
+ */
+int32_t
+hk_beat_cache_lookup(const hk_beat_entry_t *beat);
+
+/**
+ * @brief Keep a classified beat, replacing its earlier entry or else the oldest one
+ */
+void
+hk_beat_cache_store(const hk_beat_entry_t *beat);
+
+/**
+ * @brief Forget every beat (the signal is discontinuous)
+ */
+void
+hk_beat_cache_reset(void);
+
+/**
+ * @brief Lookups and hits since reset (each hit is a beat model invoke saved)
+ */
+void
+hk_beat_cache_stats(uint32_t *lookups, uint32_t *hits);
+
+#endif // __BEAT_CACHE_H
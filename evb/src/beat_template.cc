@@ -0,0 +1,105 @@
+/**
+ * @file beat_template.cc
+ * @author Adam Page (adam.page@ambiq.com)
+ * @brief Running normal beat template that screens beats before the beat model
+ * @version 1.0
+ * @date 2023-05-02
+ *
+ * @copyright Copyright (c) 2023
+ *
+ * Most beats of a recording are the patient's dominant normal beat, and the beat model spends most
+ * of its invokes confirming that. With HK_BEAT_TEMPLATE_ENABLE the beat head first correlates each
+ * beat with a template of the patient's normal beats, and only beats under HK_TEMPLATE_SIMILARITY go
+ * to the model. The template is zero mean and unit norm, so the normalised correlation is one
+ * arm_dot_prod_f32 of the centred beat over its norm, and amplitude and baseline do not count. A PAC
+ * looks like a normal beat but comes early, so a beat under HK_TEMPLATE_RR_TOL of the average RR
+ * always goes to the model, and so does a beat after an ectopic one, whose RR runs from the ectopic
+ * beat (a PAC after a PVC's compensatory pause is not early). Normal beats, screened or classified,
+ * update the template with an exponential average of weight HK_TEMPLATE_ALPHA, following slow
+ * changes of lead placement and axis. Until HK_TEMPLATE_WARMUP beats are in, every beat goes to the
+ * model.
+ */
+#include <cmath>
+#include <cstring>
+
+#include "beat_template.h"
+#include "constants.h"
+
+static float32_t hkTemplate[HK_BEAT_LEN];
+static float32_t hkTemplateScratch[HK_BEAT_LEN];
+static uint32_t hkTemplateBeats = 0;
+static uint32_t hkTemplateScreened = 0;
+static uint32_t hkTemplateNormal = 0;
+
+static float32_t
+template_centre(const float32_t *beat) {
+    /**
+     * @brief Beat less its mean into the scratch buffer
+     * @return Norm of the centred beat
+     */
+    float32_t mean, energy;
+    arm_mean_f32(beat, HK_BEAT_LEN, &mean);
+    arm_offset_f32(beat, -mean, hkTemplateScratch, HK_BEAT_LEN);
+    arm_dot_prod_f32(hkTemplateScratch, hkTemplateScratch, HK_BEAT_LEN, &energy);
+    return sqrtf(energy);
+}
+
+static bool
+template_premature(uint32_t prevRR, uint32_t avgRR) {
+    return prevRR < (1.0f - HK_TEMPLATE_RR_TOL) * avgRR;
+}
+
+float32_t
+hk_template_similarity(const float32_t *beat) {
+    if (hkTemplateBeats < HK_TEMPLATE_WARMUP) {
+        return -1.0f;
+    }
+    float32_t dot;
+    const float32_t norm = template_centre(beat);
+    if (norm <= 0) {
+        return -1.0f;
+    }
+    arm_dot_prod_f32(hkTemplateScratch, hkTemplate, HK_BEAT_LEN, &dot);
+    return dot / norm;
+}
+
+bool
+hk_template_screen(const float32_t *beat, uint32_t prevRR, uint32_t avgRR, bool prevNormal, float32_t threshold) {
+    hkTemplateScreened++;
+    if (!prevNormal || template_premature(prevRR, avgRR) || hk_template_similarity(beat) < threshold) {
+        return false;
+    }
+    hkTemplateNormal++;
+    return true;
+}
+
+void
+hk_template_update(const float32_t *beat, uint32_t prevRR, uint32_t avgRR) {
+    const float32_t norm = template_centre(beat);
+    if (template_premature(prevRR, avgRR) || norm <= 0) {
+        return;
+    }
+    // Mean of the first beats, then an exponential average, renormalised to unit norm
+    const float32_t alpha = hkTemplateBeats < HK_TEMPLATE_WARMUP ? 1.0f / (hkTemplateBeats + 1) : HK_TEMPLATE_ALPHA;
+    float32_t energy;
+    arm_scale_f32(hkTemplate, 1.0f - alpha, hkTemplate, HK_BEAT_LEN);
+    arm_scale_f32(hkTemplateScratch, alpha / norm, hkTemplateScratch, HK_BEAT_LEN);
+    arm_add_f32(hkTemplate, hkTemplateScratch, hkTemplate, HK_BEAT_LEN);
+    arm_dot_prod_f32(hkTemplate, hkTemplate, HK_BEAT_LEN, &energy);
+    arm_scale_f32(hkTemplate, 1.0f / sqrtf(energy), hkTemplate, HK_BEAT_LEN);
+    hkTemplateBeats++;
+}
+
+void
+hk_template_reset(void) {
+    memset(hkTemplate, 0, sizeof(hkTemplate));
+    hkTemplateBeats = 0;
+    hkTemplateScreened = 0;
+    hkTemplateNormal = 0;
+}
+
+void
+hk_template_stats(uint32_t *screened, uint32_t *normal) {
+    *screened = hkTemplateScreened;
+    *normal = hkTemplateNormal;
+}
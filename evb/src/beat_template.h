@@ -0,0 +1,55 @@
+/**
+ * @file beat_template.h
+ * @author Adam Page (adam.page@ambiq.com)
+ * @brief Running normal beat template that screens beats before the beat model
+ * @version 1.0
+ * @date 2023-05-02
+ *
+ * @copyright Copyright (c) 2023
+ *
+ */
+#ifndef __BEAT_TEMPLATE_H
+#define __BEAT_TEMPLATE_H
+
+#include "arm_math.h"
+#include <stdint.h>
+
+/**
+ * @brief Normalised correlation of a beat with the template
+ * @param beat Beat centred on its R peak [HK_BEAT_LEN]
+ * @return Correlation in [-1, 1], or -1 until HK_TEMPLATE_WARMUP beats are in the template
+ */
+float32_t
+hk_template_similarity(const float32_t *beat);
+
+/**
+ * @brief Whether a beat is the patient's normal beat: it matches the template and is not premature
+ * @param beat Beat centred on its R peak [HK_BEAT_LEN]
+ * @param prevRR Samples from the previous R peak
+ * @param avgRR Average RR interval of the window
+ * @param prevNormal The previous beat was normal, so prevRR is a sinus interval
+ * @param threshold Similarity a normal beat reaches
+ * @return True if the beat can skip the beat model as normal
+ */
+bool
+hk_template_screen(const float32_t *beat, uint32_t prevRR, uint32_t avgRR, bool prevNormal, float32_t threshold);
+
+/**
+ * @brief Fold a normal beat into the template's exponential average (premature beats are skipped)
+ */
+void
+hk_template_update(const float32_t *beat, uint32_t prevRR, uint32_t avgRR);
+
+/**
+ * @brief Forget the template (new patient or discontinuous signal)
+ */
+void
+hk_template_reset(void);
+
+/**
+ * @brief Beats screened and screened out as normal since reset
+ */
+void
+hk_template_stats(uint32_t *screened, uint32_t *normal);
+
+#endif // __BEAT_TEMPLATE_H
@@ -0,0 +1,93 @@
+/**
+ * @file cascade_model.cc
+ * @author Adam Page (adam.page@ambiq.com)
+ * @brief Small classifier that defers to a large one when unsure
+ * @version 1.0
+ * @date 2023-05-02
+ *
+ * @copyright Copyright (c) 2023
+ *
+ * With HK_CASCADE_ENABLE each classifier head has a small variant (heartkit export with a
+ * small_model_file) running on every sample, and the usual model only runs on the samples the small
+ * one cannot separate. Average energy follows the small model and the escalation rate, while the
+ * hard samples still get the large model's accuracy. The margin is taken on the softmax of the
+ * dequantized logits, so one threshold means the same for models calibrated to different ranges.
+ */
+#include <cmath>
+
+#include "cascade_model.h"
+
+float
+cascade_margin(const TfLiteTensor *logits, int32_t *label) {
+    const int32_t classes = logits->dims->data[logits->dims->size - 1];
+    int32_t yIdx = 0;
+    for (int32_t i = 1; i < classes; i++) {
+        yIdx = logits->data.int8[i] > logits->data.int8[yIdx] ? i : yIdx;
+    }
+    int32_t nIdx = yIdx == 0 ? 1 : 0;
+    for (int32_t i = 0; i < classes; i++) {
+        nIdx = i != yIdx && logits->data.int8[i] > logits->data.int8[nIdx] ? i : nIdx;
+    }
+    // p_max - p_next = (1 - exp(y_next - y_max)) / sum(exp(y_i - y_max))
+    float sum = 0;
+    for (int32_t i = 0; i < classes; i++) {
+        sum += expf((logits->data.int8[i] - logits->data.int8[yIdx]) * logits->params.scale);
+    }
+    if (label != nullptr) {
+        *label = yIdx;
+    }
+    return (1.0f - expf((logits->data.int8[nIdx] - logits->data.int8[yIdx]) * logits->params.scale)) / sum;
+}
+
+TfLiteStatus
+CascadeModel::Init(tflite::MicroInterpreter *small, tflite::MicroInterpreter *large, float margin) {
+    tflite::MicroInterpreter *levels[HK_CASCADE_LEVELS] = {small, large};
+    m_numClasses = 0;
+    m_margin = margin;
+    for (int32_t l = 0; l < HK_CASCADE_LEVELS; l++) {
+        const TfLiteTensor *input = levels[l]->input(0);
+        const TfLiteTensor *output = levels[l]->output(0);
+        if (input->type != kTfLiteInt8 || output->type != kTfLiteInt8 || output->dims->size != 2 || output->dims->data[1] < 2) {
+            return kTfLiteError;
+        }
+        if (l > 0 && (input->bytes != levels[0]->input(0)->bytes || output->dims->data[1] != m_numClasses)) {
+            return kTfLiteError;
+        }
+        m_numClasses = output->dims->data[1];
+        m_levels[l].interpreter = levels[l];
+    }
+    ResetCounters();
+    return kTfLiteOk;
+}
+
+int32_t
+CascadeModel::Invoke(cascade_fill_t fill, const void *ctx, float *y, int32_t *level) {
+    for (int32_t l = 0; l < HK_CASCADE_LEVELS; l++) {
+        cascade_level_t *entry = &m_levels[l];
+        fill(entry->interpreter->input(0), ctx);
+        if (entry->interpreter->Invoke() != kTfLiteOk) {
+            return -1;
+        }
+        entry->invokes++;
+        int32_t label;
+        const TfLiteTensor *logits = entry->interpreter->output(0);
+        if (cascade_margin(logits, &label) < m_margin && l < HK_CASCADE_LEVELS - 1) {
+            continue;
+        }
+        for (int32_t i = 0; y != nullptr && i < m_numClasses; i++) {
+            y[i] = ((float)logits->data.int8[i] - logits->params.zero_point) * logits->params.scale;
+        }
+        if (level != nullptr) {
+            *level = l;
+        }
+        return label;
+    }
+    return -1;
+}
+
+void
+CascadeModel::ResetCounters(void) {
+    for (int32_t l = 0; l < HK_CASCADE_LEVELS; l++) {
+        m_levels[l].invokes = 0;
+    }
+}
@@ -0,0 +1,87 @@
+/**
+ * @file cascade_model.h
+ * @author Adam Page (adam.page@ambiq.com)
+ * @brief Small classifier that defers to a large one when unsure
+ * @version 1.0
+ * @date 2023-05-02
+ *
+ * @copyright Copyright (c) 2023
+ *
+ */
+#ifndef __CASCADE_MODEL_H
+#define __CASCADE_MODEL_H
+
+#include <stdint.h>
+
+#include "tensorflow/lite/micro/micro_interpreter.h"
+
+#define HK_CASCADE_LEVELS (2)
+
+/**
+ * @brief Quantizes the caller's sample into the input tensor of the level about to run
+ */
+typedef void (*cascade_fill_t)(TfLiteTensor *input, const void *ctx);
+
+/**
+ * @brief Level of a CascadeModel
+ */
+typedef struct {
+    tflite::MicroInterpreter *interpreter;
+    uint32_t invokes; // Invokes since ResetCounters()
+} cascade_level_t;
+
+/**
+ * @brief Softmax probability margin between the two largest int8 logits
+ * @param logits Logits tensor [1, classes]
+ * @param label Index of the largest logit (nullptr to skip)
+ */
+float
+cascade_margin(const TfLiteTensor *logits, int32_t *label);
+
+/**
+ * @brief A small and a large variant of one classifier.
+ *
+ * Every sample runs the small model. Only samples whose softmax margin (top probability minus the
+ * runner-up) falls below the threshold run the large model as well, which then decides. Both read the
+ * same sample, so their inputs must match in shape and their outputs in classes. The planner reuses
+ * input memory once a model has run, so each level's input is filled just before it runs.
+ */
+class CascadeModel {
+  public:
+    /**
+     * @brief Use allocated small and large interpreters
+     * @param margin Small model margin under which the large model runs (0 never, above 1 always)
+     * @return kTfLiteError if the inputs or outputs do not match
+     */
+    TfLiteStatus
+    Init(tflite::MicroInterpreter *small, tflite::MicroInterpreter *large, float margin);
+
+    /**
+     * @brief Classify a sample
+     * @param fill Fills a level's input with the sample
+     * @param ctx Passed to fill
+     * @param y Dequantized logits of the deciding level [NumClasses()] (nullptr to skip)
+     * @param level Deciding level, 0 small and 1 large (nullptr to skip)
+     * @return Label index, or -1 on error
+     */
+    int32_t
+    Invoke(cascade_fill_t fill, const void *ctx, float *y, int32_t *level);
+
+    int32_t
+    NumClasses(void) const {
+        return m_numClasses;
+    }
+    const cascade_level_t *
+    Level(int32_t level) const {
+        return &m_levels[level];
+    }
+    void
+    ResetCounters(void);
+
+  private:
+    cascade_level_t m_levels[HK_CASCADE_LEVELS];
+    int32_t m_numClasses;
+    float m_margin;
+};
+
+#endif // __CASCADE_MODEL_H
@@ -0,0 +1,106 @@
+/**
+ * @file coarse_segmentation.cc
+ * @author Adam Page (adam.page@ambiq.com)
+ * @brief Decimation front end and boundary regions of coarse-to-fine segmentation
+ * @version 1.0
+ * @date 2023-05-02
+ *
+ * @copyright Copyright (c) 2023
+ *
+ * Most segmentation labels sit inside a wave or the isoelectric line, where the full sample rate
+ * adds nothing, and only the wave boundaries need it. With HK_SEG_COARSE_ENABLE the segmentation
+ * head decimates the window by HK_SEG_COARSE_FACTOR and labels it with a small coarse model
+ * (seg_coarse_model_buffer.h) in one invoke. The coarse labels are upsampled to the full rate, and
+ * the full-rate model is streamed over a band of HK_SEG_COARSE_BAND samples at each side of the
+ * boundaries of the refined waves only, plus context for its receptive field. The decimator is the
+ * CMSIS arm_fir_decimate_f32 with a Hamming-windowed sinc low pass at 80% of the coarse Nyquist
+ * rate. Output n of the decimator filters up to input n * HK_SEG_COARSE_FACTOR, and its
+ * (HK_SEG_COARSE_TAPS - 1) / 2 sample delay is a whole number COARSE_LAG of coarse samples, so
+ * dropping the first COARSE_LAG outputs and feeding COARSE_LAG coarse samples of zeros at the end puts
+ * coarse sample k on input sample k * HK_SEG_COARSE_FACTOR. The window is standardized as a whole, so the filter starts from
+ * zeros on every window.
+ */
+#include <cmath>
+#include <cstring>
+
+#include "coarse_segmentation.h"
+#include "constants.h"
+
+#define COARSE_DELAY ((HK_SEG_COARSE_TAPS - 1) / 2)
+#define COARSE_LAG (COARSE_DELAY / HK_SEG_COARSE_FACTOR)
+#define COARSE_CUTOFF (0.4f / HK_SEG_COARSE_FACTOR)
+
+static_assert(HK_SEG_COARSE_TAPS % 2 == 1 && COARSE_DELAY % HK_SEG_COARSE_FACTOR == 0,
+              "Decimator delay has to put coarse samples on input samples");
+static_assert(HK_SEG_COARSE_BLOCK % HK_SEG_COARSE_FACTOR == 0 && COARSE_LAG * HK_SEG_COARSE_FACTOR <= HK_SEG_COARSE_BLOCK,
+              "Decimator blocks have to be whole coarse samples");
+
+static float32_t hkCoarseTaps[HK_SEG_COARSE_TAPS];
+static float32_t hkCoarseState[HK_SEG_COARSE_TAPS + HK_SEG_COARSE_BLOCK - 1];
+static const float32_t hkCoarseZeros[COARSE_LAG * HK_SEG_COARSE_FACTOR] = {0};
+static float32_t hkCoarseLag[COARSE_LAG];
+static arm_fir_decimate_instance_f32 hkCoarseDecimator;
+
+uint32_t
+hk_coarse_init(void) {
+    float32_t sum = 0;
+    for (int32_t i = 0; i < HK_SEG_COARSE_TAPS; i++) {
+        const float32_t t = (float32_t)(i - COARSE_DELAY);
+        const float32_t sinc = i == COARSE_DELAY ? 1.0f : sinf(2.0f * PI * COARSE_CUTOFF * t) / (2.0f * PI * COARSE_CUTOFF * t);
+        hkCoarseTaps[i] = sinc * (0.54f - 0.46f * cosf(2.0f * PI * i / (HK_SEG_COARSE_TAPS - 1)));
+        sum += hkCoarseTaps[i];
+    }
+    // Unit gain at DC
+    for (int32_t i = 0; i < HK_SEG_COARSE_TAPS; i++) {
+        hkCoarseTaps[i] /= sum;
+    }
+    return arm_fir_decimate_init_f32(&hkCoarseDecimator, HK_SEG_COARSE_TAPS, HK_SEG_COARSE_FACTOR, hkCoarseTaps, hkCoarseState,
+                                     HK_SEG_COARSE_BLOCK) == ARM_MATH_SUCCESS
+               ? 0
+               : 1;
+}
+
+void
+hk_coarse_decimate(const float32_t *data, uint32_t len, float32_t *coarse) {
+    memset(hkCoarseState, 0, sizeof(hkCoarseState));
+    // The first outputs are the filter delay
+    arm_fir_decimate_f32(&hkCoarseDecimator, data, hkCoarseLag, COARSE_LAG * HK_SEG_COARSE_FACTOR);
+    uint32_t i = COARSE_LAG * HK_SEG_COARSE_FACTOR;
+    for (; i < len; i += HK_SEG_COARSE_BLOCK) {
+        const uint32_t blockLen = MIN(HK_SEG_COARSE_BLOCK, len - i);
+        arm_fir_decimate_f32(&hkCoarseDecimator, &data[i], &coarse[(i - COARSE_LAG * HK_SEG_COARSE_FACTOR) / HK_SEG_COARSE_FACTOR], blockLen);
+    }
+    arm_fir_decimate_f32(&hkCoarseDecimator, hkCoarseZeros, &coarse[len / HK_SEG_COARSE_FACTOR - COARSE_LAG], COARSE_LAG * HK_SEG_COARSE_FACTOR);
+}
+
+void
+hk_coarse_upsample(const uint8_t *coarseMask, uint32_t coarseLen, uint32_t start, uint32_t end, uint8_t *segMask) {
+    for (uint32_t i = start; i < end; i++) {
+        segMask[i] = coarseMask[MIN(coarseLen - 1, (i + HK_SEG_COARSE_FACTOR / 2) / HK_SEG_COARSE_FACTOR)];
+    }
+}
+
+uint32_t
+hk_coarse_plan(const uint8_t *coarseMask, uint32_t coarseLen, uint32_t refine, uint32_t context, uint32_t align, hk_roi_t *rois,
+               uint32_t maxRois) {
+    const uint32_t dataLen = coarseLen * HK_SEG_COARSE_FACTOR;
+    uint32_t numRois = 0;
+    for (uint32_t k = 1; k < coarseLen; k++) {
+        if (coarseMask[k] == coarseMask[k - 1] || !(((refine >> coarseMask[k]) & 1) || ((refine >> coarseMask[k - 1]) & 1))) {
+            continue;
+        }
+        // Upsampled, the boundary falls half a coarse sample before coarse sample k
+        const uint32_t edge = k * HK_SEG_COARSE_FACTOR - HK_SEG_COARSE_FACTOR / 2;
+        const uint32_t labelStart = edge - MIN(edge, HK_SEG_COARSE_BAND);
+        const uint32_t labelEnd = MIN(dataLen, edge + HK_SEG_COARSE_BAND);
+        // Closer than both contexts (and the alignment) is cheaper streamed through. Past maxRois the
+        // last region takes the rest.
+        if (numRois > 0 && (labelStart <= rois[numRois - 1].labelEnd + 2 * context + align || numRois == maxRois)) {
+            rois[numRois - 1].labelEnd = labelEnd;
+        } else if (numRois < maxRois) {
+            rois[numRois++] = {0, 0, labelStart, labelEnd};
+        }
+    }
+    hk_roi_expand(rois, numRois, dataLen, context, align);
+    return numRois;
+}
@@ -0,0 +1,57 @@
+/**
+ * @file coarse_segmentation.h
+ * @author Adam Page (adam.page@ambiq.com)
+ * @brief Decimation front end and boundary regions of coarse-to-fine segmentation
+ * @version 1.0
+ * @date 2023-05-02
+ *
+ * @copyright Copyright (c) 2023
+ *
+ */
+#ifndef __COARSE_SEGMENTATION_H
+#define __COARSE_SEGMENTATION_H
+
+#include "arm_math.h"
+#include <stdint.h>
+
+#include "roi_segmentation.h"
+
+/**
+ * @brief Design the anti-aliasing filter and set up the CMSIS decimator
+ * @return 0 on success
+ */
+uint32_t
+hk_coarse_init(void);
+
+/**
+ * @brief Low pass and decimate a signal by HK_SEG_COARSE_FACTOR (arm_fir_decimate_f32). The filter
+ * delay is compensated, so coarse[k] lines up with data[k * HK_SEG_COARSE_FACTOR].
+ * @param data Signal [len], len a multiple of HK_SEG_COARSE_FACTOR
+ * @param coarse Decimated signal [len / HK_SEG_COARSE_FACTOR]
+ */
+void
+hk_coarse_decimate(const float32_t *data, uint32_t len, float32_t *coarse);
+
+/**
+ * @brief Label samples [start, end) of the full-rate mask with the nearest coarse label
+ * @param coarseMask Coarse labels [coarseLen]
+ */
+void
+hk_coarse_upsample(const uint8_t *coarseMask, uint32_t coarseLen, uint32_t start, uint32_t end, uint8_t *segMask);
+
+/**
+ * @brief Plan the full-rate regions that refine the coarse boundaries: HK_SEG_COARSE_BAND samples at
+ * each side of every boundary of a refined wave, with context on both sides. Regions closer than
+ * their contexts are merged, as in hk_roi_plan().
+ * @param coarseMask Coarse labels [coarseLen]
+ * @param refine Waves whose boundaries are refined, a bit per HeartSegment label
+ * @param context Samples streamed at each side of a region and not labeled
+ * @param align Streamed lengths are rounded up to a multiple of align
+ * @param rois Output regions in full-rate samples, ascending and disjoint [maxRois]
+ * @return Number of regions
+ */
+uint32_t
+hk_coarse_plan(const uint8_t *coarseMask, uint32_t coarseLen, uint32_t refine, uint32_t context, uint32_t align, hk_roi_t *rois,
+               uint32_t maxRois);
+
+#endif // __COARSE_SEGMENTATION_H
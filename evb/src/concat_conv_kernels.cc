@@ -0,0 +1,129 @@
+/**
+ * @file concat_conv_kernels.cc
+ * @author Adam Page (adam.page@ambiq.com)
+ * @brief Int8 conv custom op over concatenated inputs for TFLM
+ * @version 1.0
+ * @date 2023-05-02
+ *
+ * @copyright Copyright (c) 2023
+ *
+ * The U-Net decoder of the segmentation model concatenates an upsampled tensor with a skip tensor
+ * along channels, and a (stride 1) TRANSPOSE_CONV reads the result. With NHWC layout a channel
+ * concat interleaves its inputs row by row, so no arena placement makes it a view of its inputs.
+ * host/concat_pass.cc instead rewrites the TRANSPOSE_CONV into HK_CONCAT_CONV: the equivalent conv
+ * (flipped filter, mirrored padding) with the filter split per input. Each output is the sum of
+ * the per-input dot products, so the concat copy and its arena buffer go away, as does the
+ * output sized int32 scratch of the reference TRANSPOSE_CONV.
+ */
+#include <cstring>
+
+#include "tensorflow/lite/c/builtin_op_data.h"
+#include "tensorflow/lite/kernels/kernel_util.h"
+#include "tensorflow/lite/micro/kernels/kernel_util.h"
+#include "tensorflow/lite/micro/micro_context.h"
+
+#include "concat_conv_kernels.h"
+#include "conv1d_kernels.h"
+
+typedef struct {
+    hk_concat_conv_options_t opts;
+    tflite::OpDataConv conv;
+    int32_t numParts;
+    int32_t inLen;
+    int32_t kLen;
+    int32_t outCh;
+    int32_t channels[HK_CONCAT_CONV_MAX_PARTS];
+} concat_conv_op_data_t;
+
+static void *
+concat_conv_init(TfLiteContext *context, const char *buffer, size_t length) {
+    concat_conv_op_data_t *data = (concat_conv_op_data_t *)context->AllocatePersistentBuffer(context, sizeof(concat_conv_op_data_t));
+    if (data == nullptr) {
+        return nullptr;
+    }
+    memset(data, 0, sizeof(concat_conv_op_data_t));
+    // Custom options are not aligned within the flatbuffer
+    if (buffer != nullptr && length >= sizeof(hk_concat_conv_options_t)) {
+        memcpy(&data->opts, buffer, sizeof(hk_concat_conv_options_t));
+    }
+    return data;
+}
+
+static TfLiteStatus
+concat_conv_prepare(TfLiteContext *context, TfLiteNode *node) {
+    concat_conv_op_data_t *data = (concat_conv_op_data_t *)node->user_data;
+    TF_LITE_ENSURE(context, data != nullptr);
+    TF_LITE_ENSURE_EQ(context, data->opts.version, HK_CONCAT_CONV_OPTIONS_VERSION);
+    TF_LITE_ENSURE(context, node->inputs->size % 2 == 1);
+    data->numParts = node->inputs->size / 2;
+    TF_LITE_ENSURE(context, data->numParts >= 1 && data->numParts <= HK_CONCAT_CONV_MAX_PARTS);
+
+    tflite::MicroContext *microContext = tflite::GetMicroContext(context);
+    TfLiteTensor *first = microContext->AllocateTempInputTensor(node, 0);
+    TfLiteTensor *firstFilter = microContext->AllocateTempInputTensor(node, 1);
+    TfLiteTensor *bias = microContext->AllocateTempInputTensor(node, node->inputs->size - 1);
+    TfLiteTensor *output = microContext->AllocateTempOutputTensor(node, 0);
+    TF_LITE_ENSURE(context, first != nullptr && firstFilter != nullptr && bias != nullptr && output != nullptr);
+    TF_LITE_ENSURE(context, first->dims->size == 4 && firstFilter->dims->size == 4 && output->dims->size == 4);
+    data->inLen = first->dims->data[2];
+    data->kLen = firstFilter->dims->data[2];
+    data->outCh = firstFilter->dims->data[0];
+    TF_LITE_ENSURE_EQ(context, output->dims->data[3], data->outCh);
+
+    for (int32_t i = 0; i < data->numParts; i++) {
+        TfLiteTensor *input = microContext->AllocateTempInputTensor(node, 2 * i);
+        TfLiteTensor *filter = microContext->AllocateTempInputTensor(node, 2 * i + 1);
+        TF_LITE_ENSURE(context, input != nullptr && filter != nullptr);
+        TF_LITE_ENSURE_TYPES_EQ(context, input->type, kTfLiteInt8);
+        TF_LITE_ENSURE_TYPES_EQ(context, filter->type, kTfLiteInt8);
+        TF_LITE_ENSURE(context, input->dims->size == 4 && input->dims->data[0] == 1 && input->dims->data[1] == 1 &&
+                                    input->dims->data[2] == data->inLen);
+        TF_LITE_ENSURE(context, filter->dims->size == 4 && filter->dims->data[0] == data->outCh && filter->dims->data[1] == 1 &&
+                                    filter->dims->data[2] == data->kLen && filter->dims->data[3] == input->dims->data[3]);
+        TF_LITE_ENSURE(context, input->params.scale == first->params.scale && input->params.zero_point == first->params.zero_point);
+        data->channels[i] = input->dims->data[3];
+        microContext->DeallocateTempTfLiteTensor(input);
+        microContext->DeallocateTempTfLiteTensor(filter);
+    }
+
+    // Filter slices share the per-channel scales of the original filter
+    data->conv.padding.width = data->opts.padding;
+    data->conv.per_channel_output_multiplier = (int32_t *)context->AllocatePersistentBuffer(context, data->outCh * sizeof(int32_t));
+    data->conv.per_channel_output_shift = (int32_t *)context->AllocatePersistentBuffer(context, data->outCh * sizeof(int32_t));
+    TF_LITE_ENSURE_STATUS(tflite::PopulateConvolutionQuantizationParams(
+        context, first, firstFilter, bias, output, (TfLiteFusedActivation)data->opts.activation, &data->conv.output_multiplier,
+        &data->conv.output_shift, &data->conv.output_activation_min, &data->conv.output_activation_max,
+        data->conv.per_channel_output_multiplier, data->conv.per_channel_output_shift, data->outCh));
+    data->conv.input_zero_point = first->params.zero_point;
+    data->conv.filter_zero_point = firstFilter->params.zero_point;
+    data->conv.output_zero_point = output->params.zero_point;
+
+    microContext->DeallocateTempTfLiteTensor(first);
+    microContext->DeallocateTempTfLiteTensor(firstFilter);
+    microContext->DeallocateTempTfLiteTensor(bias);
+    microContext->DeallocateTempTfLiteTensor(output);
+    return kTfLiteOk;
+}
+
+static TfLiteStatus
+concat_conv_invoke(TfLiteContext *context, TfLiteNode *node) {
+    const concat_conv_op_data_t *data = (const concat_conv_op_data_t *)node->user_data;
+    conv1d_part_t parts[HK_CONCAT_CONV_MAX_PARTS];
+    for (int32_t i = 0; i < data->numParts; i++) {
+        parts[i].input = tflite::micro::GetTensorData<int8_t>(tflite::micro::GetEvalInput(context, node, 2 * i));
+        parts[i].filter = tflite::micro::GetTensorData<int8_t>(tflite::micro::GetEvalInput(context, node, 2 * i + 1));
+        parts[i].channels = data->channels[i];
+    }
+    const int32_t *bias = tflite::micro::GetTensorData<int32_t>(tflite::micro::GetEvalInput(context, node, 2 * data->numParts));
+    TfLiteEvalTensor *output = tflite::micro::GetEvalOutput(context, node, 0);
+    const int32_t outLen = output->dims->data[2];
+    conv1d_concat_s8(data->conv, data->opts.stride, data->inLen, data->kLen, 0, outLen, data->outCh, data->numParts, parts, bias,
+                     tflite::micro::GetTensorData<int8_t>(output));
+    return kTfLiteOk;
+}
+
+TfLiteRegistration *
+Register_HK_CONCAT_CONV(void) {
+    static TfLiteRegistration registration = tflite::micro::RegisterOp(concat_conv_init, concat_conv_prepare, concat_conv_invoke);
+    return &registration;
+}
@@ -0,0 +1,40 @@
+/**
+ * @file concat_conv_kernels.h
+ * @author Adam Page (adam.page@ambiq.com)
+ * @brief Int8 conv custom op over concatenated inputs for TFLM
+ * @version 1.0
+ * @date 2023-05-02
+ *
+ * @copyright Copyright (c) 2023
+ *
+ */
+#ifndef __CONCAT_CONV_KERNELS_H
+#define __CONCAT_CONV_KERNELS_H
+
+#include <stdint.h>
+
+#include "tensorflow/lite/micro/micro_mutable_op_resolver.h"
+
+#define HK_CONCAT_CONV_OP_NAME "HK_CONCAT_CONV"
+#define HK_CONCAT_CONV_OPTIONS_VERSION (1)
+#define HK_CONCAT_CONV_MAX_PARTS (4)
+
+/**
+ * @brief Custom options, written by host/concat_pass.cc
+ */
+typedef struct __attribute__((packed)) {
+    uint8_t version;    // HK_CONCAT_CONV_OPTIONS_VERSION
+    uint8_t stride;     // Width stride
+    uint8_t padding;    // Left zero padding (right padding follows from the output width)
+    uint8_t activation; // TfLiteFusedActivation
+} hk_concat_conv_options_t;
+
+/**
+ * @brief Unit-height conv over the channel concatenation of its inputs, which is never materialized.
+ * Inputs: pairs of input [1,1,W,Ci] and filter slice [Cout,1,K,Ci] in concatenation order, then bias [Cout].
+ * All inputs share one quantization, as CONCATENATION requires. Output: [1,1,W',Cout].
+ */
+TfLiteRegistration *
+Register_HK_CONCAT_CONV(void);
+
+#endif // __CONCAT_CONV_KERNELS_H
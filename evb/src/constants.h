@@ -17,16 +17,157 @@
 #define ARRHTYHMIA_ENABLE
 #define SEGMENTATION_ENABLE
 #define BEAT_ENABLE
+// Per-operator cycle tables for each model (streamed to PC after results)
+// #define HK_PROFILE_ENABLE
+// Replace unit-height CONV_2D/DEPTHWISE_CONV_2D with 1-D int8 kernels (conv1d_kernels.cc)
+#define HK_CONV1D_ENABLE
+// Decide the rhythm on arrhythmia outputs averaged since the last gap instead of flagging any AFIB block
+// (rhythm_smooth.cc). `make -C host rhythm` measures onset delay and false AFIB windows.
+// #define HK_ARR_SMOOTH_ENABLE
+// Stream segmentation over the signal instead of sliding the windowed model (stream_model.cc)
+// #define HK_SEG_STREAM_ENABLE
+// Run the heads on the features of one shared backbone pass per window (multihead_model.cc). Needs
+// the mh_*_model_buffer.h headers of `heartkit --task multihead --mode export`.
+// #define HK_MULTIHEAD_ENABLE
+// Stop the arrhythmia model at the first confident exit classifier (early_exit_model.cc). Needs the
+// arr_exit*_model_buffer.h headers of `heartkit --task arrhythmia --mode export` with early_exit.
+// #define HK_ARR_EXIT_ENABLE
+// Run a small arrhythmia and beat model first and the standalone model only when its margin is low
+// (cascade_model.cc). Needs the *_small_model_buffer.h headers of export with small_model_file.
+// #define HK_CASCADE_ENABLE
+// Stretch the head periods while rhythm, beats and RR statistics hold still, back to full rate on
+// any change (duty_cycle.cc). `make -C host duty` replays the delay against the runs saved.
+// #define HK_DUTY_CYCLE_ENABLE
+// Only send beats unlike the patient's normal beat template to the beat model (beat_template.cc)
+// #define HK_BEAT_TEMPLATE_ENABLE
+// Heart rate from a streaming integer Pan-Tompkins QRS detector instead of the models, running the
+// full heads only while RR is irregular (pan_tompkins.cc). `make -C host pan_tompkins` checks it.
+// #define HK_HR_ONLY_ENABLE
+// Stream segmentation only over regions around Pan-Tompkins QRS candidates (roi_segmentation.cc).
+// Needs HK_SEG_STREAM_ENABLE. `make -C host roi` compares it with dense segmentation.
+// #define HK_SEG_ROI_ENABLE
+// Label the decimated window with a small coarse segmentation model and stream the full-rate model
+// over the wave boundaries only (coarse_segmentation.cc). Needs HK_SEG_STREAM_ENABLE and the
+// seg_coarse_model_buffer.h header of a segmentation export of `"model": "small"` at SAMPLE_RATE /
+// HK_SEG_COARSE_FACTOR. `make -C host coarse` compares it with dense segmentation.
+// #define HK_SEG_COARSE_ENABLE
 
 #define DISPLAY_LEN_USEC (2000000)
+// Between overlapping windows the sensor keeps running, drained this often so its 32 sample FIFO
+// never rolls over (main.cc)
+#define SENSOR_DRAIN_USEC (50000)
+
+// Head cadence in windows (hk_run calls), e.g. 3 runs arrhythmia every 3 * HK_WINDOW_STEP samples (15 s).
+// A head also runs when a due head needs what it makes, so segmentation follows the fastest of HRV and
+// beats (head_registry.cc).
+#define HK_ARR_PERIOD (1)
+#define HK_SEG_PERIOD (1)
+#define HK_HRV_PERIOD (1)
+#define HK_BEAT_PERIOD (1)
+// Duty cycling: stable observations before the periods double, at most period << HK_DUTY_MAX_SHIFT,
+// and the change in RR mean or spread, relative to the mean, that snaps back to full rate
+#define HK_DUTY_STABLE_WINDOWS (3)
+#define HK_DUTY_MAX_SHIFT (3)
+#define HK_DUTY_RR_TOL (0.1f)
 
 #define HK_DATA_LEN (10 * SAMPLE_RATE)
+// Samples each window advances. Below HK_DATA_LEN, main.cc keeps the raw tail of sensor windows and
+// drains the sensor in between, so windows overlap and follow each other without a gap. Client
+// (PC) frames are independent and never overlap.
+#define HK_WINDOW_STEP (HK_DATA_LEN / 2)
+// Reuse the beat labels of peaks an overlapping window already classified (beat_cache.cc). Windows
+// that do not overlap never hit, so the cache is only on with them. `make -C host beat_cache`
+// replays the default step.
+#if HK_WINDOW_STEP < HK_DATA_LEN
+    #define HK_BEAT_CACHE_ENABLE
+#endif
 #define HK_PEAK_LEN (120)
 #define HK_ARR_LEN (1000)
+#define HK_ARR_CLASSES (2)
+// Arrhythmia blocks the rhythm average spans (a 10 s window). Longer only delays AFIB onsets, see
+// `make -C host rhythm`.
+#define HK_ARR_SMOOTH_BLOCKS (3)
+// Early-exit arrhythmia parts and the softmax confidence an exit stops at
+#define HK_ARR_EXIT_PARTS (3)
+#define HK_ARR_EXIT_THRESHOLD (0.9f)
+// Softmax margin (top minus runner-up) under which the cascade escalates to the standalone model
+#define HK_ARR_CASCADE_MARGIN (0.5f)
+#define HK_BEAT_CASCADE_MARGIN (0.5f)
 #define HK_BEAT_LEN (200)
+// Beat cache entries, how far a peak and its RR context may move and still hit (samples), and the
+// margin a label needs to be reused
+#define HK_BEAT_CACHE_LEN (64)
+#define HK_BEAT_CACHE_PEAK_TOL (2)
+#define HK_BEAT_CACHE_RR_TOL (10)
+#define HK_BEAT_CACHE_MARGIN (0.5f)
+// Beat template: correlation a normal beat reaches, RR shortening that still sends it to the model,
+// exponential average weight and beats averaged before screening starts
+#define HK_TEMPLATE_SIMILARITY (0.9f)
+#define HK_TEMPLATE_RR_TOL (0.15f)
+#define HK_TEMPLATE_ALPHA (0.05f)
+#define HK_TEMPLATE_WARMUP (8)
+// Pan-Tompkins: input scale to int16, samples the thresholds learn over after reset and refractory
+// period. RR spread (coefficient of variation) or a single RR off the mean by more than HK_HR_RR_TOL
+// is irregular, and the full heads run for HK_HR_ESCALATE_WINDOWS windows after the last irregular one.
+#define HK_PT_SCALE (64)
+#define HK_PT_LEARN_LEN (2 * SAMPLE_RATE)
+#define HK_PT_REFRACTORY (SAMPLE_RATE / 5)
+#define HK_HR_RR_CV (0.1f)
+#define HK_HR_RR_TOL (0.2f)
+#define HK_HR_ESCALATE_WINDOWS (3)
+// Segmentation regions: samples before an R peak (P wave), QTc in seconds bounding the T wave after
+// it, samples streamed at each side for the model's receptive field, and samples at the end always
+// segmented (a QRS in the detector's latency and its P wave)
+#define HK_ROI_PRE (SAMPLE_RATE / 4)
+#define HK_ROI_QTC (0.5f)
+#define HK_ROI_CONTEXT (32)
+#define HK_ROI_TAIL (SAMPLE_RATE / 2)
+// Coarse segmentation: decimation factor (the coarse model is trained at SAMPLE_RATE / factor),
+// decimated window and the coarse model's frame (a multiple of its strides, the last samples take the
+// label before them), FIR taps (8 * factor + 1 lines coarse samples up with input samples) and block,
+// samples refined at each side of a coarse boundary, the waves whose boundaries are refined (a bit per
+// HeartSegment label: QRS, 0xE adds the P and T waves) and context streamed at each side of a region
+#define HK_SEG_COARSE_FACTOR (2)
+#define HK_SEG_COARSE_LEN (HK_DATA_LEN / HK_SEG_COARSE_FACTOR)
+#define HK_SEG_COARSE_FRAME (1248)
+#define HK_SEG_COARSE_TAPS (8 * HK_SEG_COARSE_FACTOR + 1)
+#define HK_SEG_COARSE_BLOCK (256)
+#define HK_SEG_COARSE_BAND (4 * HK_SEG_COARSE_FACTOR)
+#define HK_SEG_COARSE_REFINE (0x4)
+#define HK_SEG_COARSE_CONTEXT (16)
+// Fiducials: shortest run of a label that starts a wave (shorter runs are glitches the wave around
+// them absorbs), and the longest P onset to QRS onset and QRS onset to T offset that tie a P and a
+// T wave to a beat
+#define HK_FID_MIN_RUN (SAMPLE_RATE / 50)
+#define HK_FID_PR_MAX (SAMPLE_RATE * 3 / 10)
+#define HK_FID_QT_MAX (SAMPLE_RATE * 6 / 10)
+// HRV: RR intervals in the sliding window, the range an RR must fall in and the change from the
+// previous RR past which it is dropped (ectopic, missed or extra beats), successive difference pNN50
+// counts (ms), accepted beats between LF/HF spectra, tachogram resampling rate (Hz) and length (a
+// power of 2, 64 s at 4 Hz), and the LF and HF band edges (Hz)
+#define HK_HRV_WINDOW (300)
+#define HK_HRV_RR_MIN (SAMPLE_RATE * 3 / 10)
+#define HK_HRV_RR_MAX (2 * SAMPLE_RATE)
+#define HK_HRV_RR_TOL (0.2f)
+#define HK_HRV_NN_MS (50)
+#define HK_HRV_SPECTRUM_BEATS (32)
+#define HK_HRV_RESAMPLE_HZ (4)
+#define HK_HRV_FFT_LEN (256)
+#define HK_HRV_LF_LO (0.04f)
+#define HK_HRV_LF_HI (0.15f)
+#define HK_HRV_HF_HI (0.4f)
 #define HK_SEG_LEN (624)
 #define HK_SEG_OLP (25)
 #define HK_SEG_STEP (HK_SEG_LEN - 2 * HK_SEG_OLP)
+#define HK_SEG_STREAM_STEP (16)
+// Multihead window: the heads trim HK_MH_OLP samples at each edge, and steps keep beat features aligned
+#define HK_MH_LEN (1024)
+#define HK_MH_OLP (32)
+#define HK_MH_STEP (HK_MH_LEN - 2 * HK_MH_OLP)
+// Backbone features the beat head crops: input samples per position and channels
+#define HK_MH_BEAT_STRIDE (4)
+#define HK_MH_BEAT_CHANNELS (32)
+#define HK_PROFILE_ROWS_PER_BLOCK (32)
 
 #define MIN(a, b) ((a) < (b) ? (a) : (b))
 #define MAX(a, b) ((a) > (b) ? (a) : (b))
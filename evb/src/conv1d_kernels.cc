@@ -0,0 +1,498 @@
+/**
+ * @file conv1d_kernels.cc
+ * @author Adam Page (adam.page@ambiq.com)
+ * @brief Int8 1-D (unit height) convolution kernels for TFLM
+ * @version 1.0
+ * @date 2023-05-02
+ *
+ * @copyright Copyright (c) 2023
+ *
+ * HeartKit models feed [1, 1, N, C] tensors, so every CONV_2D and DEPTHWISE_CONV_2D has height 1.
+ * With unit height and no dilation the receptive field of an output sample is one contiguous run
+ * of K * Cin input bytes, and so is each filter row. A conv output is then a plain dot product of
+ * that run with each filter row (no im2col buffer), and a depthwise output is a per-channel sum
+ * over K rows of the input. Zero padding is handled by clipping the run at the edges.
+ *
+ * On Cortex-M4 (__ARM_FEATURE_DSP) four int8 values are unpacked into two int16 pairs with
+ * SXTB16, offset with SADD16 and accumulated with SMLAD (two MACs per instruction). Conv computes
+ * two output channels per pass so each unpacked input word is used twice. Other targets (host)
+ * use the portable loops, which give bit-identical results.
+ *
+ * Int4 filters (conv1d_s4) pack 8 values per word so that masking the word with 0x0F0F0F0F << 4
+ * and 0xF0F0F0F0 gives the same four-lane int8 layout as an int8 filter word, each value scaled
+ * by 16. Those feed SMLAD as above and the sum is shifted back down (exactly, as every product is
+ * a multiple of 16), so unpacking costs two logic ops per 8 weights.
+ */
+#include <cstring>
+
+#include "tensorflow/lite/c/builtin_op_data.h"
+#include "tensorflow/lite/kernels/internal/common.h"
+#include "tensorflow/lite/micro/kernels/depthwise_conv.h"
+#include "tensorflow/lite/micro/kernels/kernel_util.h"
+#include "tensorflow/lite/micro/micro_context.h"
+
+#if defined(__ARM_FEATURE_DSP) && (__ARM_FEATURE_DSP == 1)
+    #include "arm_math.h"
+    #define CONV1D_USE_DSP
+#endif
+
+#include "conv1d_kernels.h"
+
+typedef struct {
+    tflite::OpDataConv conv; // Quantization params (1-D path)
+    void *fallbackData;      // Fallback kernel user_data
+    bool conv1d;             // Node runs the 1-D path
+} conv1d_op_data_t;
+
+static const TfLiteRegistration *convFallback = nullptr;
+static const TfLiteRegistration *dwFallback = nullptr;
+static TfLiteRegistration convRegistration;
+static TfLiteRegistration dwRegistration;
+
+//*****************************************************************************
+//*** Inner loops
+static inline int32_t
+read_s8x4(const int8_t *p) {
+    int32_t val;
+    memcpy(&val, p, sizeof(val));
+    return val;
+}
+
+static inline void
+dot2_s8(const int8_t *in, const int8_t *w0, const int8_t *w1, int32_t len, int32_t inOffset, int32_t *acc0, int32_t *acc1) {
+    /**
+     * @brief Accumulate (in + inOffset) . w0 and (in + inOffset) . w1 over len values
+     */
+    int32_t sum0 = *acc0;
+    int32_t sum1 = *acc1;
+#ifdef CONV1D_USE_DSP
+    const int32_t offset2 = __PKHBT(inOffset, inOffset, 16);
+    for (; len >= 4; len -= 4) {
+        int32_t x = read_s8x4(in);
+        int32_t xEven = __SADD16(__SXTB16(x), offset2);
+        int32_t xOdd = __SADD16(__SXTB16(__ROR(x, 8)), offset2);
+        int32_t y = read_s8x4(w0);
+        sum0 = __SMLAD(xEven, __SXTB16(y), sum0);
+        sum0 = __SMLAD(xOdd, __SXTB16(__ROR(y, 8)), sum0);
+        y = read_s8x4(w1);
+        sum1 = __SMLAD(xEven, __SXTB16(y), sum1);
+        sum1 = __SMLAD(xOdd, __SXTB16(__ROR(y, 8)), sum1);
+        in += 4;
+        w0 += 4;
+        w1 += 4;
+    }
+#endif
+    for (; len > 0; len--) {
+        int32_t x = *in++ + inOffset;
+        sum0 += x * *w0++;
+        sum1 += x * *w1++;
+    }
+    *acc0 = sum0;
+    *acc1 = sum1;
+}
+
+static inline int8_t
+requantize(int32_t acc, const tflite::OpDataConv &data, int32_t channel) {
+    acc = tflite::MultiplyByQuantizedMultiplier(acc, data.per_channel_output_multiplier[channel], data.per_channel_output_shift[channel]);
+    acc += data.output_zero_point;
+    acc = acc > data.output_activation_max ? data.output_activation_max : acc;
+    acc = acc < data.output_activation_min ? data.output_activation_min : acc;
+    return (int8_t)acc;
+}
+
+static inline int32_t
+s4_value(const int8_t *row, int32_t j) {
+    /**
+     * @brief Value j of a packed int4 row (group j / 8, byte j % 4, high nibble for j % 8 >= 4)
+     */
+    const int8_t b = row[(j >> 3) * 4 + (j & 3)];
+    return (j & 4) ? (b >> 4) : ((int8_t)(b << 4) >> 4);
+}
+
+static inline void
+dot2_s4(const int8_t *in, const int8_t *w0, const int8_t *w1, int32_t j, int32_t len, int32_t inOffset, int32_t *acc0, int32_t *acc1) {
+    /**
+     * @brief Accumulate (in + inOffset) . w0[j, j + len) and (in + inOffset) . w1[j, j + len) for packed int4 rows w0, w1
+     */
+    int32_t sum0 = *acc0;
+    int32_t sum1 = *acc1;
+    const int32_t end = j + len;
+    // Scalar up to a group boundary, then whole groups
+    for (; j < end && (j & 7); j++) {
+        int32_t x = *in++ + inOffset;
+        sum0 += x * s4_value(w0, j);
+        sum1 += x * s4_value(w1, j);
+    }
+#ifdef CONV1D_USE_DSP
+    const int32_t offset2 = __PKHBT(inOffset, inOffset, 16);
+    int32_t sum0x16 = 0;
+    int32_t sum1x16 = 0;
+    for (; j + 8 <= end; j += 8) {
+        int32_t x = read_s8x4(in);
+        int32_t xEvenLo = __SADD16(__SXTB16(x), offset2);
+        int32_t xOddLo = __SADD16(__SXTB16(__ROR(x, 8)), offset2);
+        x = read_s8x4(in + 4);
+        int32_t xEvenHi = __SADD16(__SXTB16(x), offset2);
+        int32_t xOddHi = __SADD16(__SXTB16(__ROR(x, 8)), offset2);
+        int32_t y = read_s8x4(&w0[(j >> 3) * 4]);
+        int32_t lo = (int32_t)(((uint32_t)y << 4) & 0xF0F0F0F0);
+        int32_t hi = (int32_t)((uint32_t)y & 0xF0F0F0F0);
+        sum0x16 = __SMLAD(xEvenLo, __SXTB16(lo), sum0x16);
+        sum0x16 = __SMLAD(xOddLo, __SXTB16(__ROR(lo, 8)), sum0x16);
+        sum0x16 = __SMLAD(xEvenHi, __SXTB16(hi), sum0x16);
+        sum0x16 = __SMLAD(xOddHi, __SXTB16(__ROR(hi, 8)), sum0x16);
+        y = read_s8x4(&w1[(j >> 3) * 4]);
+        lo = (int32_t)(((uint32_t)y << 4) & 0xF0F0F0F0);
+        hi = (int32_t)((uint32_t)y & 0xF0F0F0F0);
+        sum1x16 = __SMLAD(xEvenLo, __SXTB16(lo), sum1x16);
+        sum1x16 = __SMLAD(xOddLo, __SXTB16(__ROR(lo, 8)), sum1x16);
+        sum1x16 = __SMLAD(xEvenHi, __SXTB16(hi), sum1x16);
+        sum1x16 = __SMLAD(xOddHi, __SXTB16(__ROR(hi, 8)), sum1x16);
+        in += 8;
+    }
+    sum0 += sum0x16 >> 4;
+    sum1 += sum1x16 >> 4;
+#else
+    for (; j + 8 <= end; j += 8) {
+        const int8_t *y0 = &w0[(j >> 3) * 4];
+        const int8_t *y1 = &w1[(j >> 3) * 4];
+        for (int32_t i = 0; i < 4; i++) {
+            int32_t xLo = in[i] + inOffset;
+            int32_t xHi = in[i + 4] + inOffset;
+            sum0 += xLo * ((int8_t)(y0[i] << 4) >> 4) + xHi * (y0[i] >> 4);
+            sum1 += xLo * ((int8_t)(y1[i] << 4) >> 4) + xHi * (y1[i] >> 4);
+        }
+        in += 8;
+    }
+#endif
+    for (; j < end; j++) {
+        int32_t x = *in++ + inOffset;
+        sum0 += x * s4_value(w0, j);
+        sum1 += x * s4_value(w1, j);
+    }
+    *acc0 = sum0;
+    *acc1 = sum1;
+}
+
+void
+conv1d_concat_s8(const tflite::OpDataConv &data, int32_t stride, int32_t inLen, int32_t kLen, int32_t outStart, int32_t outEnd,
+                 int32_t outCh, int32_t numParts, const conv1d_part_t *parts, const int32_t *bias, int8_t *output) {
+    /**
+     * @brief Int8 conv over the width axis of the channel concatenation of parts
+     */
+    const int32_t inOffset = -data.input_zero_point;
+    for (int32_t x = outStart; x < outEnd; x++) {
+        // Clip the window to the input (zero padding contributes nothing once offset)
+        int32_t inStart = x * stride - data.padding.width;
+        int32_t kStart = inStart < 0 ? -inStart : 0;
+        int32_t kEnd = inStart + kLen > inLen ? inLen - inStart : kLen;
+        int32_t c = 0;
+        for (; c + 1 < outCh; c += 2) {
+            int32_t acc0 = bias ? bias[c] : 0;
+            int32_t acc1 = bias ? bias[c + 1] : 0;
+            for (int32_t i = 0; i < numParts; i++) {
+                const int32_t inCh = parts[i].channels;
+                const int8_t *w = &parts[i].filter[c * kLen * inCh + kStart * inCh];
+                dot2_s8(&parts[i].input[(inStart + kStart) * inCh], w, w + kLen * inCh, (kEnd - kStart) * inCh, inOffset, &acc0, &acc1);
+            }
+            output[c] = requantize(acc0, data, c);
+            output[c + 1] = requantize(acc1, data, c + 1);
+        }
+        if (c < outCh) {
+            int32_t acc0 = bias ? bias[c] : 0;
+            int32_t acc1 = 0;
+            for (int32_t i = 0; i < numParts; i++) {
+                const int32_t inCh = parts[i].channels;
+                const int8_t *w = &parts[i].filter[c * kLen * inCh + kStart * inCh];
+                dot2_s8(&parts[i].input[(inStart + kStart) * inCh], w, w, (kEnd - kStart) * inCh, inOffset, &acc0, &acc1);
+            }
+            output[c] = requantize(acc0, data, c);
+        }
+        output += outCh;
+    }
+}
+
+void
+conv1d_s8(const tflite::OpDataConv &data, int32_t stride, int32_t inLen, int32_t inCh, int32_t kLen, int32_t outStart, int32_t outEnd,
+          int32_t outCh, const int8_t *input, const int8_t *filter, const int32_t *bias, int8_t *output) {
+    /**
+     * @brief Int8 conv over the width axis. Filter is [outCh, 1, kLen, inCh].
+     */
+    const conv1d_part_t part = {input, filter, inCh};
+    conv1d_concat_s8(data, stride, inLen, kLen, outStart, outEnd, outCh, 1, &part, bias, output);
+}
+
+void
+conv1d_s4(const tflite::OpDataConv &data, int32_t stride, int32_t inLen, int32_t inCh, int32_t kLen, int32_t outStart, int32_t outEnd,
+          int32_t outCh, const int8_t *input, const int8_t *filter, const int32_t *bias, int8_t *output) {
+    /**
+     * @brief Conv over the width axis with packed int4 weights. Filter is [outCh, conv1d_s4_row_bytes(kLen * inCh)].
+     */
+    const int32_t inOffset = -data.input_zero_point;
+    const int32_t rowBytes = conv1d_s4_row_bytes(kLen * inCh);
+    for (int32_t x = outStart; x < outEnd; x++) {
+        int32_t inStart = x * stride - data.padding.width;
+        int32_t kStart = inStart < 0 ? -inStart : 0;
+        int32_t kEnd = inStart + kLen > inLen ? inLen - inStart : kLen;
+        const int8_t *in = &input[(inStart + kStart) * inCh];
+        int32_t c = 0;
+        for (; c + 1 < outCh; c += 2) {
+            int32_t acc0 = bias ? bias[c] : 0;
+            int32_t acc1 = bias ? bias[c + 1] : 0;
+            const int8_t *w = &filter[c * rowBytes];
+            dot2_s4(in, w, w + rowBytes, kStart * inCh, (kEnd - kStart) * inCh, inOffset, &acc0, &acc1);
+            output[c] = requantize(acc0, data, c);
+            output[c + 1] = requantize(acc1, data, c + 1);
+        }
+        if (c < outCh) {
+            int32_t acc0 = bias ? bias[c] : 0;
+            int32_t acc1 = 0;
+            const int8_t *w = &filter[c * rowBytes];
+            dot2_s4(in, w, w, kStart * inCh, (kEnd - kStart) * inCh, inOffset, &acc0, &acc1);
+            output[c] = requantize(acc0, data, c);
+        }
+        output += outCh;
+    }
+}
+
+void
+depthwise_conv1d_s8(const tflite::OpDataConv &data, int32_t stride, int32_t inLen, int32_t channels, int32_t kLen, int32_t outStart,
+                    int32_t outEnd, const int8_t *input, const int8_t *filter, const int32_t *bias, int8_t *output) {
+    /**
+     * @brief Int8 depthwise conv (depth multiplier 1) over the width axis. Filter is [1, 1, kLen, channels].
+     */
+    const int32_t inOffset = -data.input_zero_point;
+    for (int32_t x = outStart; x < outEnd; x++) {
+        int32_t inStart = x * stride - data.padding.width;
+        int32_t kStart = inStart < 0 ? -inStart : 0;
+        int32_t kEnd = inStart + kLen > inLen ? inLen - inStart : kLen;
+        int32_t c = 0;
+#ifdef CONV1D_USE_DSP
+        const int32_t offset2 = __PKHBT(inOffset, inOffset, 16);
+        for (; c + 3 < channels; c += 4) {
+            int32_t acc0 = bias ? bias[c] : 0;
+            int32_t acc1 = bias ? bias[c + 1] : 0;
+            int32_t acc2 = bias ? bias[c + 2] : 0;
+            int32_t acc3 = bias ? bias[c + 3] : 0;
+            for (int32_t k = kStart; k < kEnd; k++) {
+                int32_t xv = read_s8x4(&input[(inStart + k) * channels + c]);
+                int32_t wv = read_s8x4(&filter[k * channels + c]);
+                int32_t xEven = __SADD16(__SXTB16(xv), offset2);
+                int32_t xOdd = __SADD16(__SXTB16(__ROR(xv, 8)), offset2);
+                int32_t wEven = __SXTB16(wv);
+                int32_t wOdd = __SXTB16(__ROR(wv, 8));
+                // Halfword products map to SMLABB/SMLATT
+                acc0 += (int16_t)xEven * (int16_t)wEven;
+                acc2 += (xEven >> 16) * (wEven >> 16);
+                acc1 += (int16_t)xOdd * (int16_t)wOdd;
+                acc3 += (xOdd >> 16) * (wOdd >> 16);
+            }
+            output[c] = requantize(acc0, data, c);
+            output[c + 1] = requantize(acc1, data, c + 1);
+            output[c + 2] = requantize(acc2, data, c + 2);
+            output[c + 3] = requantize(acc3, data, c + 3);
+        }
+#endif
+        for (; c < channels; c++) {
+            int32_t acc = bias ? bias[c] : 0;
+            for (int32_t k = kStart; k < kEnd; k++) {
+                acc += (input[(inStart + k) * channels + c] + inOffset) * filter[k * channels + c];
+            }
+            output[c] = requantize(acc, data, c);
+        }
+        output += channels;
+    }
+}
+
+//*****************************************************************************
+//*** Kernel callbacks
+static void *
+conv1d_init(TfLiteContext *context, const char *, size_t) {
+    // Fallback init is deferred to prepare so 1-D nodes don't allocate its op data
+    conv1d_op_data_t *data = (conv1d_op_data_t *)context->AllocatePersistentBuffer(context, sizeof(conv1d_op_data_t));
+    if (data != nullptr) {
+        memset(data, 0, sizeof(conv1d_op_data_t));
+    }
+    return data;
+}
+
+static bool
+conv1d_supported(TfLiteContext *context, TfLiteNode *node, bool depthwise) {
+    /**
+     * @brief Check node is int8, unit height, undilated and (depthwise) depth multiplier 1
+     */
+    tflite::MicroContext *microContext = tflite::GetMicroContext(context);
+    TfLiteTensor *input = microContext->AllocateTempInputTensor(node, tflite::kConvInputTensor);
+    TfLiteTensor *filter = microContext->AllocateTempInputTensor(node, tflite::kConvWeightsTensor);
+    TfLiteTensor *output = microContext->AllocateTempOutputTensor(node, tflite::kConvOutputTensor);
+    bool supported = input && filter && output && input->type == kTfLiteInt8 && filter->type == kTfLiteInt8 && input->dims->size == 4 &&
+                     filter->dims->size == 4 && output->dims->size == 4 && input->dims->data[1] == 1 && filter->dims->data[1] == 1 &&
+                     output->dims->data[1] == 1 && filter->quantization.type == kTfLiteAffineQuantization;
+    if (supported && depthwise) {
+        const auto *params = (const TfLiteDepthwiseConvParams *)node->builtin_data;
+        supported = params->dilation_width_factor == 1 && params->dilation_height_factor == 1 &&
+                    filter->dims->data[3] == input->dims->data[3];
+    } else if (supported) {
+        const auto *params = (const TfLiteConvParams *)node->builtin_data;
+        supported = params->dilation_width_factor == 1 && params->dilation_height_factor == 1 &&
+                    filter->dims->data[3] == input->dims->data[3];
+    }
+    if (input) {
+        microContext->DeallocateTempTfLiteTensor(input);
+    }
+    if (filter) {
+        microContext->DeallocateTempTfLiteTensor(filter);
+    }
+    if (output) {
+        microContext->DeallocateTempTfLiteTensor(output);
+    }
+    return supported;
+}
+
+static TfLiteStatus
+conv1d_prepare_quant(TfLiteContext *context, TfLiteNode *node, bool depthwise, conv1d_op_data_t *data) {
+    /**
+     * @brief Fill per-channel quantization params with the same helpers as the TFLM kernels
+     */
+    tflite::MicroContext *microContext = tflite::GetMicroContext(context);
+    TfLiteTensor *input = microContext->AllocateTempInputTensor(node, tflite::kConvInputTensor);
+    TfLiteTensor *filter = microContext->AllocateTempInputTensor(node, tflite::kConvWeightsTensor);
+    TfLiteTensor *output = microContext->AllocateTempOutputTensor(node, tflite::kConvOutputTensor);
+    const int channels = filter->dims->data[depthwise ? tflite::kDepthwiseConvQuantizedDimension : tflite::kConvQuantizedDimension];
+    TfLiteStatus status;
+    data->conv.per_channel_output_multiplier = (int32_t *)context->AllocatePersistentBuffer(context, channels * sizeof(int32_t));
+    data->conv.per_channel_output_shift = (int32_t *)context->AllocatePersistentBuffer(context, channels * sizeof(int32_t));
+    if (depthwise) {
+        status = tflite::CalculateOpDataDepthwiseConv(context, node, *(const TfLiteDepthwiseConvParams *)node->builtin_data,
+                                                      input->dims->data[2], input->dims->data[1], filter->dims->data[2],
+                                                      filter->dims->data[1], output->dims->data[2], output->dims->data[1], kTfLiteInt8,
+                                                      &data->conv);
+    } else {
+        status = tflite::CalculateOpDataConv(context, node, *(const TfLiteConvParams *)node->builtin_data, input->dims->data[2],
+                                             input->dims->data[1], filter->dims->data[2], filter->dims->data[1], output->dims->data[2],
+                                             output->dims->data[1], kTfLiteInt8, &data->conv);
+    }
+    microContext->DeallocateTempTfLiteTensor(input);
+    microContext->DeallocateTempTfLiteTensor(filter);
+    microContext->DeallocateTempTfLiteTensor(output);
+    return status;
+}
+
+static TfLiteStatus
+conv1d_prepare_common(TfLiteContext *context, TfLiteNode *node, bool depthwise) {
+    const TfLiteRegistration *fallback = depthwise ? dwFallback : convFallback;
+    conv1d_op_data_t *data = (conv1d_op_data_t *)node->user_data;
+    TF_LITE_ENSURE(context, data != nullptr);
+    data->conv1d = conv1d_supported(context, node, depthwise);
+    if (data->conv1d) {
+        return conv1d_prepare_quant(context, node, depthwise, data);
+    }
+    if (fallback->init) {
+        data->fallbackData = fallback->init(context, nullptr, 0);
+    }
+    TfLiteStatus status = kTfLiteOk;
+    if (fallback->prepare) {
+        node->user_data = data->fallbackData;
+        status = fallback->prepare(context, node);
+        node->user_data = data;
+    }
+    return status;
+}
+
+static TfLiteStatus
+conv1d_invoke_fallback(TfLiteContext *context, TfLiteNode *node, const TfLiteRegistration *fallback) {
+    conv1d_op_data_t *data = (conv1d_op_data_t *)node->user_data;
+    node->user_data = data->fallbackData;
+    TfLiteStatus status = fallback->invoke(context, node);
+    node->user_data = data;
+    return status;
+}
+
+static TfLiteStatus
+conv1d_prepare(TfLiteContext *context, TfLiteNode *node) {
+    return conv1d_prepare_common(context, node, false);
+}
+
+static TfLiteStatus
+depthwise_conv1d_prepare(TfLiteContext *context, TfLiteNode *node) {
+    return conv1d_prepare_common(context, node, true);
+}
+
+static TfLiteStatus
+conv1d_invoke(TfLiteContext *context, TfLiteNode *node) {
+    conv1d_op_data_t *data = (conv1d_op_data_t *)node->user_data;
+    if (!data->conv1d) {
+        return conv1d_invoke_fallback(context, node, convFallback);
+    }
+    const auto &params = *(const TfLiteConvParams *)node->builtin_data;
+    const TfLiteEvalTensor *input = tflite::micro::GetEvalInput(context, node, tflite::kConvInputTensor);
+    const TfLiteEvalTensor *filter = tflite::micro::GetEvalInput(context, node, tflite::kConvWeightsTensor);
+    const TfLiteEvalTensor *bias = node->inputs->size == 3 ? tflite::micro::GetEvalInput(context, node, tflite::kConvBiasTensor) : nullptr;
+    TfLiteEvalTensor *output = tflite::micro::GetEvalOutput(context, node, tflite::kConvOutputTensor);
+    const int32_t inLen = input->dims->data[2];
+    const int32_t inCh = input->dims->data[3];
+    const int32_t outLen = output->dims->data[2];
+    const int32_t outCh = output->dims->data[3];
+    for (int32_t b = 0; b < input->dims->data[0]; b++) {
+        conv1d_s8(data->conv, params.stride_width, inLen, inCh, filter->dims->data[2], 0, outLen, outCh,
+                  &tflite::micro::GetTensorData<int8_t>(input)[b * inLen * inCh], tflite::micro::GetTensorData<int8_t>(filter),
+                  tflite::micro::GetOptionalTensorData<int32_t>(bias), &tflite::micro::GetTensorData<int8_t>(output)[b * outLen * outCh]);
+    }
+    return kTfLiteOk;
+}
+
+static TfLiteStatus
+depthwise_conv1d_invoke(TfLiteContext *context, TfLiteNode *node) {
+    conv1d_op_data_t *data = (conv1d_op_data_t *)node->user_data;
+    if (!data->conv1d) {
+        return conv1d_invoke_fallback(context, node, dwFallback);
+    }
+    const auto &params = *(const TfLiteDepthwiseConvParams *)node->builtin_data;
+    const TfLiteEvalTensor *input = tflite::micro::GetEvalInput(context, node, tflite::kDepthwiseConvInputTensor);
+    const TfLiteEvalTensor *filter = tflite::micro::GetEvalInput(context, node, tflite::kDepthwiseConvWeightsTensor);
+    const TfLiteEvalTensor *bias =
+        node->inputs->size == 3 ? tflite::micro::GetEvalInput(context, node, tflite::kDepthwiseConvBiasTensor) : nullptr;
+    TfLiteEvalTensor *output = tflite::micro::GetEvalOutput(context, node, tflite::kDepthwiseConvOutputTensor);
+    const int32_t inLen = input->dims->data[2];
+    const int32_t channels = input->dims->data[3];
+    const int32_t outLen = output->dims->data[2];
+    for (int32_t b = 0; b < input->dims->data[0]; b++) {
+        depthwise_conv1d_s8(data->conv, params.stride_width, inLen, channels, filter->dims->data[2], 0, outLen,
+                            &tflite::micro::GetTensorData<int8_t>(input)[b * inLen * channels], tflite::micro::GetTensorData<int8_t>(filter),
+                            tflite::micro::GetOptionalTensorData<int32_t>(bias),
+                            &tflite::micro::GetTensorData<int8_t>(output)[b * outLen * channels]);
+    }
+    return kTfLiteOk;
+}
+
+const TfLiteRegistration *
+Conv1dOpResolver::FindOp(tflite::BuiltinOperator op) const {
+    /**
+     * @brief Return 1-D registration for conv ops (falling back to the wrapped resolver's kernel per node)
+     * @param op Builtin operator
+     * @return Registration
+     */
+    const TfLiteRegistration *registration = m_resolver.FindOp(op);
+    if (registration == nullptr || registration->invoke == nullptr) {
+        return registration;
+    }
+    if (op == tflite::BuiltinOperator_CONV_2D) {
+        convFallback = registration;
+        convRegistration = *registration;
+        convRegistration.init = conv1d_init;
+        convRegistration.free = nullptr;
+        convRegistration.prepare = conv1d_prepare;
+        convRegistration.invoke = conv1d_invoke;
+        return &convRegistration;
+    }
+    if (op == tflite::BuiltinOperator_DEPTHWISE_CONV_2D) {
+        dwFallback = registration;
+        dwRegistration = *registration;
+        dwRegistration.init = conv1d_init;
+        dwRegistration.free = nullptr;
+        dwRegistration.prepare = depthwise_conv1d_prepare;
+        dwRegistration.invoke = depthwise_conv1d_invoke;
+        return &dwRegistration;
+    }
+    return registration;
+}
@@ -0,0 +1,136 @@
+/**
+ * @file conv1d_kernels.h
+ * @author Adam Page (adam.page@ambiq.com)
+ * @brief Int8 1-D (unit height) convolution kernels for TFLM
+ * @version 1.0
+ * @date 2023-05-02
+ *
+ * @copyright Copyright (c) 2023
+ *
+ */
+#ifndef __CONV1D_KERNELS_H
+#define __CONV1D_KERNELS_H
+
+#include "tensorflow/lite/micro/kernels/conv.h"
+#include "tensorflow/lite/micro/micro_op_resolver.h"
+
+/**
+ * @brief Int8 conv over the width axis of a unit-height input, for output positions [outStart, outEnd)
+ * @param data Quantization params and padding (per-channel multipliers/shifts)
+ * @param stride Width stride
+ * @param inLen Input width
+ * @param inCh Input channels
+ * @param kLen Filter width
+ * @param outStart First output position
+ * @param outEnd Output position past the last
+ * @param outCh Output channels
+ * @param input Input [inLen, inCh]
+ * @param filter Filter [outCh, 1, kLen, inCh]
+ * @param bias Bias [outCh] or nullptr
+ * @param output Output row of outStart
+ */
+void
+conv1d_s8(const tflite::OpDataConv &data, int32_t stride, int32_t inLen, int32_t inCh, int32_t kLen, int32_t outStart, int32_t outEnd,
+          int32_t outCh, const int8_t *input, const int8_t *filter, const int32_t *bias, int8_t *output);
+
+/**
+ * @brief One input of a conv over concatenated channels, with the filter slice for its channels
+ */
+typedef struct {
+    const int8_t *input;  // Input [inLen, channels]
+    const int8_t *filter; // Filter [outCh, 1, kLen, channels]
+    int32_t channels;
+} conv1d_part_t;
+
+/**
+ * @brief Int8 conv over the width axis of the channel concatenation of parts, without materializing it.
+ * All parts share the input quantization.
+ * @param data Quantization params and padding (per-channel multipliers/shifts)
+ * @param stride Width stride
+ * @param inLen Input width (all parts)
+ * @param kLen Filter width
+ * @param outStart First output position
+ * @param outEnd Output position past the last
+ * @param outCh Output channels
+ * @param numParts Number of parts
+ * @param parts Parts in concatenation order
+ * @param bias Bias [outCh] or nullptr
+ * @param output Output row of outStart
+ */
+void
+conv1d_concat_s8(const tflite::OpDataConv &data, int32_t stride, int32_t inLen, int32_t kLen, int32_t outStart, int32_t outEnd,
+                 int32_t outCh, int32_t numParts, const conv1d_part_t *parts, const int32_t *bias, int8_t *output);
+
+/**
+ * @brief Int8 depthwise conv (depth multiplier 1) over the width axis, for output positions [outStart, outEnd)
+ * @param data Quantization params and padding (per-channel multipliers/shifts)
+ * @param stride Width stride
+ * @param inLen Input width
+ * @param channels Channels
+ * @param kLen Filter width
+ * @param outStart First output position
+ * @param outEnd Output position past the last
+ * @param input Input [inLen, channels]
+ * @param filter Filter [1, 1, kLen, channels]
+ * @param bias Bias [channels] or nullptr
+ * @param output Output row of outStart
+ */
+void
+depthwise_conv1d_s8(const tflite::OpDataConv &data, int32_t stride, int32_t inLen, int32_t channels, int32_t kLen, int32_t outStart,
+                    int32_t outEnd, const int8_t *input, const int8_t *filter, const int32_t *bias, int8_t *output);
+
+/**
+ * @brief Bytes of a packed int4 filter row of len values (whole groups of 8 values)
+ */
+static inline int32_t
+conv1d_s4_row_bytes(int32_t len) {
+    return ((len + 7) / 8) * 4;
+}
+
+/**
+ * @brief Conv over the width axis with packed int4 weights, for output positions [outStart, outEnd).
+ * Each filter row holds the kLen * inCh values of [1, kLen, inCh] as signed nibbles in groups of 8:
+ * byte i of a group packs value i (low nibble) and value i + 4 (high nibble). Rows are padded to
+ * whole groups (conv1d_s4_row_bytes). Filter scales are per output channel.
+ * @param data Quantization params and padding (per-channel multipliers/shifts)
+ * @param stride Width stride
+ * @param inLen Input width
+ * @param inCh Input channels
+ * @param kLen Filter width
+ * @param outStart First output position
+ * @param outEnd Output position past the last
+ * @param outCh Output channels
+ * @param input Input [inLen, inCh]
+ * @param filter Packed filter [outCh, conv1d_s4_row_bytes(kLen * inCh)]
+ * @param bias Bias [outCh] or nullptr
+ * @param output Output row of outStart
+ */
+void
+conv1d_s4(const tflite::OpDataConv &data, int32_t stride, int32_t inLen, int32_t inCh, int32_t kLen, int32_t outStart, int32_t outEnd,
+          int32_t outCh, const int8_t *input, const int8_t *filter, const int32_t *bias, int8_t *output);
+
+/**
+ * @brief Op resolver that replaces CONV_2D and DEPTHWISE_CONV_2D with 1-D kernels.
+ * Each node checks its shapes in prepare: int8 input of height 1, filter of height 1, no dilation
+ * and (depthwise) depth multiplier 1. Nodes that do not match run the wrapped resolver's kernel.
+ */
+class Conv1dOpResolver : public tflite::MicroOpResolver {
+  public:
+    explicit Conv1dOpResolver(const tflite::MicroOpResolver &resolver) : m_resolver(resolver) {}
+
+    virtual const TfLiteRegistration *
+    FindOp(tflite::BuiltinOperator op) const override;
+    virtual const TfLiteRegistration *
+    FindOp(const char *op) const override {
+        return m_resolver.FindOp(op);
+    }
+    virtual BuiltinParseFunction
+    GetOpDataParser(tflite::BuiltinOperator op) const override {
+        return m_resolver.GetOpDataParser(op);
+    }
+
+  private:
+    const tflite::MicroOpResolver &m_resolver;
+};
+
+#endif // __CONV1D_KERNELS_H
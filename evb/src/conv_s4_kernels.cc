@@ -0,0 +1,111 @@
+/**
+ * @file conv_s4_kernels.cc
+ * @author Adam Page (adam.page@ambiq.com)
+ * @brief Conv and fully connected custom op with packed int4 weights for TFLM
+ * @version 1.0
+ * @date 2023-05-02
+ *
+ * @copyright Copyright (c) 2023
+ *
+ * Weights dominate the flash footprint of the HeartKit models, and every inference reads all of
+ * them from flash/MRAM. host/int4_pass.cc requantizes the int8 weights of CONV_2D and
+ * FULLY_CONNECTED to int4 (symmetric, one scale per output channel) and rewrites the op into
+ * HK_CONV_S4, halving the weight bytes. Activations stay int8 and the output is requantized as
+ * CONV_2D does, so only the weight rounding changes the results. The nibbles are unpacked in
+ * registers by conv1d_s4 (conv1d_kernels.cc).
+ */
+#include <cstring>
+
+#include "tensorflow/lite/c/builtin_op_data.h"
+#include "tensorflow/lite/kernels/kernel_util.h"
+#include "tensorflow/lite/micro/kernels/kernel_util.h"
+#include "tensorflow/lite/micro/micro_context.h"
+
+#include "conv1d_kernels.h"
+#include "conv_s4_kernels.h"
+
+typedef struct {
+    hk_conv_s4_options_t opts;
+    tflite::OpDataConv conv;
+    int32_t inLen;
+    int32_t inCh;
+    int32_t outLen;
+    int32_t outCh;
+} conv_s4_op_data_t;
+
+static void *
+conv_s4_init(TfLiteContext *context, const char *buffer, size_t length) {
+    conv_s4_op_data_t *data = (conv_s4_op_data_t *)context->AllocatePersistentBuffer(context, sizeof(conv_s4_op_data_t));
+    if (data == nullptr) {
+        return nullptr;
+    }
+    memset(data, 0, sizeof(conv_s4_op_data_t));
+    // Custom options are not aligned within the flatbuffer
+    if (buffer != nullptr && length >= sizeof(hk_conv_s4_options_t)) {
+        memcpy(&data->opts, buffer, sizeof(hk_conv_s4_options_t));
+    }
+    return data;
+}
+
+static TfLiteStatus
+conv_s4_prepare(TfLiteContext *context, TfLiteNode *node) {
+    conv_s4_op_data_t *data = (conv_s4_op_data_t *)node->user_data;
+    TF_LITE_ENSURE(context, data != nullptr);
+    TF_LITE_ENSURE_EQ(context, data->opts.version, HK_CONV_S4_OPTIONS_VERSION);
+    TF_LITE_ENSURE_EQ(context, node->inputs->size, 3);
+
+    tflite::MicroContext *microContext = tflite::GetMicroContext(context);
+    TfLiteTensor *input = microContext->AllocateTempInputTensor(node, 0);
+    TfLiteTensor *filter = microContext->AllocateTempInputTensor(node, 1);
+    TfLiteTensor *bias = microContext->AllocateTempInputTensor(node, 2);
+    TfLiteTensor *output = microContext->AllocateTempOutputTensor(node, 0);
+    TF_LITE_ENSURE(context, input != nullptr && filter != nullptr && bias != nullptr && output != nullptr);
+    TF_LITE_ENSURE_TYPES_EQ(context, input->type, kTfLiteInt8);
+    TF_LITE_ENSURE_TYPES_EQ(context, filter->type, kTfLiteInt8);
+    TF_LITE_ENSURE_TYPES_EQ(context, output->type, kTfLiteInt8);
+    TF_LITE_ENSURE(context, filter->dims->size == 4 && input->dims->size >= 2 && output->dims->size == input->dims->size);
+
+    // Width is 1 for fully connected inputs [1, Cin]
+    data->inCh = input->dims->data[input->dims->size - 1];
+    data->inLen = tflite::NumElements(input) / data->inCh;
+    data->outCh = filter->dims->data[0];
+    data->outLen = tflite::NumElements(output) / data->outCh;
+    TF_LITE_ENSURE_EQ(context, output->dims->data[output->dims->size - 1], data->outCh);
+    TF_LITE_ENSURE_EQ(context, filter->dims->data[3], conv1d_s4_row_bytes(data->opts.kLen * data->inCh));
+    TF_LITE_ENSURE(context, data->opts.stride > 0 && (data->outLen - 1) * data->opts.stride < data->inLen + data->opts.padding);
+
+    data->conv.padding.width = data->opts.padding;
+    data->conv.per_channel_output_multiplier = (int32_t *)context->AllocatePersistentBuffer(context, data->outCh * sizeof(int32_t));
+    data->conv.per_channel_output_shift = (int32_t *)context->AllocatePersistentBuffer(context, data->outCh * sizeof(int32_t));
+    TF_LITE_ENSURE_STATUS(tflite::PopulateConvolutionQuantizationParams(
+        context, input, filter, bias, output, (TfLiteFusedActivation)data->opts.activation, &data->conv.output_multiplier,
+        &data->conv.output_shift, &data->conv.output_activation_min, &data->conv.output_activation_max,
+        data->conv.per_channel_output_multiplier, data->conv.per_channel_output_shift, data->outCh));
+    data->conv.input_zero_point = input->params.zero_point;
+    data->conv.filter_zero_point = 0;
+    data->conv.output_zero_point = output->params.zero_point;
+
+    microContext->DeallocateTempTfLiteTensor(input);
+    microContext->DeallocateTempTfLiteTensor(filter);
+    microContext->DeallocateTempTfLiteTensor(bias);
+    microContext->DeallocateTempTfLiteTensor(output);
+    return kTfLiteOk;
+}
+
+static TfLiteStatus
+conv_s4_invoke(TfLiteContext *context, TfLiteNode *node) {
+    const conv_s4_op_data_t *data = (const conv_s4_op_data_t *)node->user_data;
+    const int8_t *input = tflite::micro::GetTensorData<int8_t>(tflite::micro::GetEvalInput(context, node, 0));
+    const int8_t *filter = tflite::micro::GetTensorData<int8_t>(tflite::micro::GetEvalInput(context, node, 1));
+    const int32_t *bias = tflite::micro::GetTensorData<int32_t>(tflite::micro::GetEvalInput(context, node, 2));
+    int8_t *output = tflite::micro::GetTensorData<int8_t>(tflite::micro::GetEvalOutput(context, node, 0));
+    conv1d_s4(data->conv, data->opts.stride, data->inLen, data->inCh, data->opts.kLen, 0, data->outLen, data->outCh, input, filter, bias,
+              output);
+    return kTfLiteOk;
+}
+
+TfLiteRegistration *
+Register_HK_CONV_S4(void) {
+    static TfLiteRegistration registration = tflite::micro::RegisterOp(conv_s4_init, conv_s4_prepare, conv_s4_invoke);
+    return &registration;
+}
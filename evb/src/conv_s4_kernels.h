@@ -0,0 +1,40 @@
+/**
+ * @file conv_s4_kernels.h
+ * @author Adam Page (adam.page@ambiq.com)
+ * @brief Conv and fully connected custom op with packed int4 weights for TFLM
+ * @version 1.0
+ * @date 2023-05-02
+ *
+ * @copyright Copyright (c) 2023
+ *
+ */
+#ifndef __CONV_S4_KERNELS_H
+#define __CONV_S4_KERNELS_H
+
+#include <stdint.h>
+
+#include "tensorflow/lite/micro/micro_mutable_op_resolver.h"
+
+#define HK_CONV_S4_OP_NAME "HK_CONV_S4"
+#define HK_CONV_S4_OPTIONS_VERSION (1)
+
+/**
+ * @brief Custom options, written by host/int4_pass.cc
+ */
+typedef struct __attribute__((packed)) {
+    uint8_t version;    // HK_CONV_S4_OPTIONS_VERSION
+    uint8_t stride;     // Width stride
+    uint8_t padding;    // Left zero padding (right padding follows from the output width)
+    uint8_t activation; // TfLiteFusedActivation
+    uint8_t kLen;       // Filter width
+} hk_conv_s4_options_t;
+
+/**
+ * @brief Unit-height conv (or fully connected, as a conv of width 1) with int8 activations and int4 weights.
+ * Inputs: input [1,1,W,Cin] (or [1,Cin]), packed filter [Cout,1,1,conv1d_s4_row_bytes(K * Cin)] with
+ * per-channel scales (see conv1d_s4), bias [Cout]. Output: [1,1,W',Cout] (or [1,Cout]).
+ */
+TfLiteRegistration *
+Register_HK_CONV_S4(void);
+
+#endif // __CONV_S4_KERNELS_H
@@ -0,0 +1,41 @@
+/**
+ * @file custom_ops.h
+ * @author Adam Page (adam.page@ambiq.com)
+ * @brief Registration of the HeartKit custom ops written by the host model passes
+ * @version 1.0
+ * @date 2023-05-02
+ *
+ * @copyright Copyright (c) 2023
+ *
+ */
+#ifndef __CUSTOM_OPS_H
+#define __CUSTOM_OPS_H
+
+#include "tensorflow/lite/micro/micro_mutable_op_resolver.h"
+
+#include "concat_conv_kernels.h"
+#include "conv_s4_kernels.h"
+#include "mbconv_kernels.h"
+
+template <unsigned int tOpCount>
+TfLiteStatus
+add_custom_ops(tflite::MicroMutableOpResolver<tOpCount> &resolver) {
+    /**
+     * @brief Register every HeartKit custom op with a resolver
+     * @param resolver Op resolver
+     * @return kTfLiteOk on success
+     */
+    TfLiteStatus status = resolver.AddCustom(HK_MBCONV_SQUEEZE_OP_NAME, Register_HK_MBCONV_SQUEEZE());
+    if (status == kTfLiteOk) {
+        status = resolver.AddCustom(HK_MBCONV_OP_NAME, Register_HK_MBCONV());
+    }
+    if (status == kTfLiteOk) {
+        status = resolver.AddCustom(HK_CONCAT_CONV_OP_NAME, Register_HK_CONCAT_CONV());
+    }
+    if (status == kTfLiteOk) {
+        status = resolver.AddCustom(HK_CONV_S4_OP_NAME, Register_HK_CONV_S4());
+    }
+    return status;
+}
+
+#endif // __CUSTOM_OPS_H
@@ -0,0 +1,81 @@
+/**
+ * @file duty_cycle.cc
+ * @author Adam Page (adam.page@ambiq.com)
+ * @brief Back off head cadence while results are stable
+ * @version 1.0
+ * @date 2023-05-02
+ *
+ * @copyright Copyright (c) 2023
+ *
+ * A patient in steady sinus rhythm gives the same heart rate, rhythm and beat classes window after
+ * window, and every model run past the first few only confirms them. With HK_DUTY_CYCLE_ENABLE
+ * hk_run shows each window's results to this policy, which doubles every head period after
+ * HK_DUTY_STABLE_WINDOWS stable observations, up to period << HK_DUTY_MAX_SHIFT. A move of the RR
+ * mean or spread past HK_DUTY_RR_TOL of the mean, a new rhythm label or ectopic beats appearing or
+ * going away snaps all heads back to full rate, so the cost of backing off is the detection delay of
+ * a change that starts while heads are skipped: at most the stretched period of the head seeing it.
+ * Observations are only the products heads made that window, so a skipped head is never read as
+ * stable. The reference stays at the window that last changed, so a slow drift adds up to a change.
+ */
+#include <cmath>
+#include <cstring>
+
+#include "constants.h"
+#include "duty_cycle.h"
+#include "rr_stats.h"
+
+static hk_duty_state_t hkDuty;
+
+void
+hk_duty_reset(void) {
+    memset(&hkDuty, 0, sizeof(hkDuty));
+}
+
+uint32_t
+hk_duty_update(const hk_context_t *ctx, uint32_t made) {
+    const hk_result_t *result = ctx->result;
+    const bool ectopic = result->numPacBeats + result->numPvcBeats > 0;
+    float32_t meanRR = 0, sdRR = 0;
+    bool rrValid = false;
+    bool changed = !hkDuty.valid;
+    hkDuty.windows++;
+    if (!(made & (HeartProductRR | HeartProductRhythm | HeartProductBeats))) {
+        return hkDuty.shift;
+    }
+    if (made & HeartProductRR) {
+        rrValid = hk_rr_stats(ctx->rrIntervals, ctx->numPeaks, &meanRR, &sdRR) == 0;
+        // Too few beats to tell is not stable
+        changed |= !rrValid;
+        changed |= rrValid && hkDuty.valid && fabsf(meanRR - hkDuty.meanRR) > HK_DUTY_RR_TOL * hkDuty.meanRR;
+        changed |= rrValid && hkDuty.valid && fabsf(sdRR - hkDuty.sdRR) > HK_DUTY_RR_TOL * hkDuty.meanRR;
+    }
+    if (made & HeartProductRhythm) {
+        changed |= result->arrhythmia != hkDuty.arrhythmia;
+    }
+    if (made & HeartProductBeats) {
+        changed |= ectopic != hkDuty.ectopic;
+    }
+    if (!changed) {
+        if (++hkDuty.stable >= HK_DUTY_STABLE_WINDOWS && hkDuty.shift < HK_DUTY_MAX_SHIFT) {
+            hkDuty.shift++;
+            hkDuty.stable = 0;
+        }
+        return hkDuty.shift;
+    }
+    hkDuty.snaps += hkDuty.shift > 0;
+    hkDuty.shift = 0;
+    hkDuty.stable = 0;
+    if (rrValid) {
+        hkDuty.meanRR = meanRR;
+        hkDuty.sdRR = sdRR;
+        hkDuty.valid = true;
+    }
+    hkDuty.arrhythmia = result->arrhythmia;
+    hkDuty.ectopic = ectopic;
+    return hkDuty.shift;
+}
+
+const hk_duty_state_t *
+hk_duty_state(void) {
+    return &hkDuty;
+}
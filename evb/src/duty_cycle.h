@@ -0,0 +1,55 @@
+/**
+ * @file duty_cycle.h
+ * @author Adam Page (adam.page@ambiq.com)
+ * @brief Back off head cadence while results are stable
+ * @version 1.0
+ * @date 2023-05-02
+ *
+ * @copyright Copyright (c) 2023
+ *
+ */
+#ifndef __DUTY_CYCLE_H
+#define __DUTY_CYCLE_H
+
+#include "arm_math.h"
+#include <stdint.h>
+
+#include "head_registry.h"
+
+/**
+ * @brief Policy state, from the last observation that changed something
+ */
+typedef struct {
+    uint32_t shift;      // Heads run at period << shift
+    uint32_t stable;     // Consecutive stable observations at this shift
+    uint32_t snaps;      // Returns to full rate since reset
+    uint32_t windows;    // Windows seen since reset
+    bool valid;          // Reference below is set
+    float32_t meanRR;    // Reference RR mean in samples
+    float32_t sdRR;      // Reference RR standard deviation in samples
+    uint32_t arrhythmia; // Reference rhythm label
+    bool ectopic;        // Reference had PAC or PVC beats
+} hk_duty_state_t;
+
+/**
+ * @brief Back to full rate with no reference
+ */
+void
+hk_duty_reset(void);
+
+/**
+ * @brief Observe a window hk_heads_run() just ran and pick the backoff of the next ones
+ * @param ctx Window context, RR intervals only read if made has HeartProductRR
+ * @param made Products made in the window (hk_heads_made())
+ * @return Backoff shift for hk_heads_set_backoff()
+ */
+uint32_t
+hk_duty_update(const hk_context_t *ctx, uint32_t made);
+
+/**
+ * @brief Current policy state
+ */
+const hk_duty_state_t *
+hk_duty_state(void);
+
+#endif // __DUTY_CYCLE_H
@@ -0,0 +1,148 @@
+/**
+ * @file early_exit_model.cc
+ * @author Adam Page (adam.page@ambiq.com)
+ * @brief Classifier split into parts with early exits
+ * @version 1.0
+ * @date 2023-05-02
+ *
+ * @copyright Copyright (c) 2023
+ *
+ * Most arrhythmia blocks are plain sinus rhythm that a fraction of the network already classifies
+ * with confidence. The early-exit export (heartkit/arrhythmia.py, early_exit) adds classifiers after
+ * the middle stages and cuts the network there into separate models, so the EVB can stop invoking
+ * once one is sure. TFLM has no way to stop a model halfway, hence one model per part. Exits are
+ * decided on the softmax of the dequantized logits, as in training. Their cost is a few exps per
+ * part, against the deeper stages skipped.
+ */
+#include <cmath>
+
+#include "early_exit_model.h"
+
+float
+ee_confidence(const TfLiteTensor *logits, int32_t *label) {
+    const int32_t classes = logits->dims->data[logits->dims->size - 1];
+    int32_t yIdx = 0;
+    for (int32_t i = 1; i < classes; i++) {
+        yIdx = logits->data.int8[i] > logits->data.int8[yIdx] ? i : yIdx;
+    }
+    // max softmax = 1 / sum(exp(y_i - y_max))
+    float sum = 0;
+    for (int32_t i = 0; i < classes; i++) {
+        sum += expf((logits->data.int8[i] - logits->data.int8[yIdx]) * logits->params.scale);
+    }
+    if (label != nullptr) {
+        *label = yIdx;
+    }
+    return 1.0f / sum;
+}
+
+void
+EarlyExitModel::Init(ee_cycle_counter_t counter) {
+    m_numParts = 0;
+    m_numClasses = 0;
+    m_counter = counter;
+    ResetCounters();
+}
+
+TfLiteStatus
+EarlyExitModel::AddPart(tflite::MicroInterpreter *part) {
+    if (m_numParts >= HK_EE_MAX_PARTS || part->inputs_size() != 1 || part->outputs_size() > 2) {
+        return kTfLiteError;
+    }
+    ee_part_t *entry = &m_parts[m_numParts];
+    entry->interpreter = part;
+    entry->logits = -1;
+    entry->feature = -1;
+    for (int32_t i = 0; i < (int32_t)part->outputs_size(); i++) {
+        const TfLiteTensor *output = part->output(i);
+        if (output->type != kTfLiteInt8) {
+            return kTfLiteError;
+        }
+        if (output->dims->size == 2 && entry->logits < 0) {
+            entry->logits = i;
+        } else {
+            entry->feature = i;
+        }
+    }
+    if (entry->logits < 0 && entry->feature < 0) {
+        return kTfLiteError;
+    }
+    if (entry->logits >= 0) {
+        const int32_t classes = part->output(entry->logits)->dims->data[1];
+        if (m_numClasses && classes != m_numClasses) {
+            return kTfLiteError;
+        }
+        m_numClasses = classes;
+    }
+    if (m_numParts > 0) {
+        ee_part_t *prev = &m_parts[m_numParts - 1];
+        if (prev->feature < 0 || prev->interpreter->output(prev->feature)->bytes != part->input(0)->bytes) {
+            return kTfLiteError;
+        }
+        TF_LITE_ENSURE_STATUS(mh_requant_init(&prev->requant, prev->interpreter->output(prev->feature), part->input(0)));
+    }
+    entry->runs = entry->exits = 0;
+    entry->cycles = 0;
+    m_numParts++;
+    return kTfLiteOk;
+}
+
+int32_t
+EarlyExitModel::Invoke(float threshold, float *y, int32_t *exitPart) {
+    for (int32_t p = 0; p < m_numParts; p++) {
+        ee_part_t *part = &m_parts[p];
+        if (p > 0) {
+            const ee_part_t *prev = &m_parts[p - 1];
+            TfLiteTensor *input = part->interpreter->input(0);
+            mh_requant(&prev->requant, prev->interpreter->output(prev->feature)->data.int8, input->data.int8, input->bytes);
+        }
+        const uint32_t start = m_counter ? m_counter() : 0;
+        if (part->interpreter->Invoke() != kTfLiteOk) {
+            return -1;
+        }
+        part->cycles += m_counter ? m_counter() - start : 0;
+        part->runs++;
+        if (part->logits < 0) {
+            continue;
+        }
+        int32_t label;
+        const TfLiteTensor *logits = part->interpreter->output(part->logits);
+        if (ee_confidence(logits, &label) < threshold && part->feature >= 0) {
+            continue;
+        }
+        part->exits++;
+        m_invokes++;
+        for (int32_t i = 0; y != nullptr && i < m_numClasses; i++) {
+            y[i] = ((float)logits->data.int8[i] - logits->params.zero_point) * logits->params.scale;
+        }
+        if (exitPart != nullptr) {
+            *exitPart = p;
+        }
+        return label;
+    }
+    // Last part is missing
+    return -1;
+}
+
+uint32_t
+EarlyExitModel::AverageCyclesSaved(void) const {
+    if (m_invokes == 0) {
+        return 0;
+    }
+    uint64_t full = 0, used = 0;
+    for (int32_t p = 0; p < m_numParts; p++) {
+        full += m_parts[p].runs ? m_parts[p].cycles / m_parts[p].runs : 0;
+        used += m_parts[p].cycles;
+    }
+    used /= m_invokes;
+    return full > used ? (uint32_t)(full - used) : 0;
+}
+
+void
+EarlyExitModel::ResetCounters(void) {
+    m_invokes = 0;
+    for (int32_t p = 0; p < m_numParts; p++) {
+        m_parts[p].runs = m_parts[p].exits = 0;
+        m_parts[p].cycles = 0;
+    }
+}
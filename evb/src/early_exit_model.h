@@ -0,0 +1,119 @@
+/**
+ * @file early_exit_model.h
+ * @author Adam Page (adam.page@ambiq.com)
+ * @brief Classifier split into parts with early exits
+ * @version 1.0
+ * @date 2023-05-02
+ *
+ * @copyright Copyright (c) 2023
+ *
+ */
+#ifndef __EARLY_EXIT_MODEL_H
+#define __EARLY_EXIT_MODEL_H
+
+#include <stdint.h>
+
+#include "tensorflow/lite/micro/micro_interpreter.h"
+
+#include "multihead_model.h"
+
+#define HK_EE_MAX_PARTS (4)
+
+/**
+ * @brief Cycle counter read before and after each part (e.g. DWT CYCCNT), wrapping at 32 bits
+ */
+typedef uint32_t (*ee_cycle_counter_t)(void);
+
+/**
+ * @brief Part of an EarlyExitModel
+ */
+typedef struct {
+    tflite::MicroInterpreter *interpreter;
+    int32_t logits;       // Exit classifier output index ([1, classes]), -1 if the part has no exit
+    int32_t feature;      // Output read by the next part, -1 for the last part
+    mh_requant_t requant; // Feature to next part input
+    uint32_t runs;        // Invokes since ResetCounters()
+    uint32_t exits;       // Invokes that stopped after this part
+    uint64_t cycles;      // Cycles of all runs
+} ee_part_t;
+
+/**
+ * @brief Softmax probability of the largest int8 logit
+ * @param logits Logits tensor [1, classes]
+ * @param label Index of the largest logit (nullptr to skip)
+ */
+float
+ee_confidence(const TfLiteTensor *logits, int32_t *label);
+
+/**
+ * @brief A classifier cut into parts, each a separate model whose exit classifier can end the invoke.
+ *
+ * Part 0 reads the model input. Every other part reads the feature output of the part before it,
+ * copied into its arena (and requantized if the parts were calibrated separately). A part with an exit
+ * outputs logits next to its feature, and once their softmax confidence reaches the threshold the
+ * deeper parts are skipped. The last part outputs only the logits of the full network.
+ */
+class EarlyExitModel {
+  public:
+    /**
+     * @brief Start an empty model
+     * @param counter Cycle counter for the per-part statistics (nullptr to skip them)
+     */
+    void
+    Init(ee_cycle_counter_t counter);
+
+    /**
+     * @brief Append an allocated part interpreter
+     * @return kTfLiteError if there are too many parts or it does not read the previous part's feature
+     */
+    TfLiteStatus
+    AddPart(tflite::MicroInterpreter *part);
+
+    /**
+     * @brief Run the parts on Input() until an exit is confident enough
+     * @param threshold Confidence to exit at (above 1 runs every part)
+     * @param y Dequantized logits of the exit taken [NumClasses()] (nullptr to skip)
+     * @param exitPart Part the invoke stopped after (nullptr to skip)
+     * @return Label index, or -1 on error
+     */
+    int32_t
+    Invoke(float threshold, float *y, int32_t *exitPart);
+
+    TfLiteTensor *
+    Input(void) {
+        return m_parts[0].interpreter->input(0);
+    }
+    int32_t
+    NumParts(void) const {
+        return m_numParts;
+    }
+    int32_t
+    NumClasses(void) const {
+        return m_numClasses;
+    }
+    uint32_t
+    Invokes(void) const {
+        return m_invokes;
+    }
+    const ee_part_t *
+    Part(int32_t part) const {
+        return &m_parts[part];
+    }
+    /**
+     * @brief Mean cycles per invoke saved by exiting early, against running every part.
+     * Parts that never ran count as free, so this is a lower bound until each part has run.
+     */
+    uint32_t
+    AverageCyclesSaved(void) const;
+    void
+    ResetCounters(void);
+
+  private:
+    ee_part_t m_parts[HK_EE_MAX_PARTS];
+    int32_t m_numParts;
+    int32_t m_numClasses;
+    ee_cycle_counter_t m_counter;
+    uint32_t m_invokes;
+};
+
+#endif // __EARLY_EXIT_MODEL_H
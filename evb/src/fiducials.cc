@@ -0,0 +1,141 @@
+/**
+ * @file fiducials.cc
+ * @author Adam Page (adam.page@ambiq.com)
+ * @brief Beats, waves and intervals from one run-length pass over the segment mask
+ * @version 1.0
+ * @date 2023-05-02
+ *
+ * @copyright Copyright (c) 2023
+ *
+ * The segment mask already holds every wave of the window, and the peaks, HRV and beat heads only
+ * need it as runs. hk_fiducials_extract() walks the mask once, keeping the wave it is in and a
+ * candidate label. A candidate becomes the wave once it has lasted HK_FID_MIN_RUN samples, starting
+ * where the candidate started, and returning to the wave before that drops it, so the model's short
+ * glitches neither split a wave nor make one. Each finished run updates a beat in progress: a P wave
+ * is held for the next QRS, a QRS closes the previous beat and opens one, and a T wave ends the open
+ * beat's QT. The R peak is the largest absolute sample of the QRS (arm_absmax_f32), where
+ * pan_tompkins.cc puts its peaks too, rather than the QRS midpoint. QTc uses the RR before the beat,
+ * and waves cut by the window edges have no intervals.
+ */
+#include <cmath>
+
+#include "constants.h"
+#include "fiducials.h"
+#include "heartkit.h"
+
+#define FID_NONE (0xFF)
+
+typedef struct {
+    const float32_t *data;
+    uint32_t len;
+    hk_fiducial_t *beats;
+    uint32_t maxBeats;
+    uint32_t numBeats;
+    hk_fiducial_t beat; // Beat in progress, its qrsOn is -1 before the first QRS
+    int32_t pOn;        // Last P wave since the last QRS, -1 if none
+    int32_t pOff;
+    int32_t prevPeak;   // R peak of the last closed beat, -1 if none
+} fid_state_t;
+
+static void
+fid_close_beat(fid_state_t *s) {
+    /**
+     * @brief Measure the beat in progress and append it
+     */
+    hk_fiducial_t *b = &s->beat;
+    if (b->qrsOn == -1 || s->numBeats >= s->maxBeats) {
+        return;
+    }
+    const bool whole = b->qrsOn > 0 && b->qrsOff < (int32_t)s->len;
+    b->qrs = whole ? b->qrsOff - b->qrsOn : -1;
+    b->pr = whole && b->pOn != -1 ? b->qrsOn - b->pOn : -1;
+    b->qt = whole && b->tOn != -1 ? b->tOff - b->qrsOn : -1;
+    b->qtc = -1;
+    if (b->qt != -1 && s->prevPeak != -1) {
+        const float32_t rr = (float32_t)(b->peak - s->prevPeak) / SAMPLE_RATE;
+        b->qtc = (int32_t)(b->qt / sqrtf(rr) + 0.5f);
+    }
+    s->prevPeak = b->peak;
+    s->beats[s->numBeats++] = *b;
+}
+
+static void
+fid_run(fid_state_t *s, uint8_t label, int32_t start, int32_t end) {
+    /**
+     * @brief Fold a finished run [start, end) of a label into the beat in progress
+     */
+    hk_fiducial_t *b = &s->beat;
+    if (label == HeartSegmentPWave) {
+        // The window start cuts it
+        if (start > 0) {
+            s->pOn = start;
+            s->pOff = end;
+        }
+    } else if (label == HeartSegmentQrs) {
+        fid_close_beat(s);
+        float32_t val;
+        uint32_t idx;
+        arm_absmax_f32(&s->data[start], end - start, &val, &idx);
+        *b = {start + (int32_t)idx, start, end, -1, -1, -1, -1, -1, -1, -1, -1};
+        if (s->pOn != -1 && start - s->pOn <= HK_FID_PR_MAX) {
+            b->pOn = s->pOn;
+            b->pOff = s->pOff;
+        }
+        s->pOn = -1;
+    } else if (label == HeartSegmentTWave) {
+        if (b->qrsOn != -1 && b->tOn == -1 && end < (int32_t)s->len && end - b->qrsOn <= HK_FID_QT_MAX) {
+            b->tOn = start;
+            b->tOff = end;
+        }
+    }
+}
+
+uint32_t
+hk_fiducials_extract(const float32_t *data, const uint8_t *segMask, uint32_t len, hk_fiducial_t *beats, uint32_t maxBeats) {
+    fid_state_t s = {data, len, beats, maxBeats, 0, {}, -1, -1, -1};
+    s.beat.qrsOn = -1;
+    // The first wave starts once a label has lasted too
+    uint8_t wave = FID_NONE;
+    uint8_t cand = FID_NONE;
+    uint32_t waveStart = 0, candStart = 0;
+    for (uint32_t i = 0; i < len; i++) {
+        const uint8_t label = segMask[i] & 0x0F;
+        if (label == wave) {
+            cand = FID_NONE;
+            continue;
+        }
+        if (label != cand) {
+            cand = label;
+            candStart = i;
+        }
+        if (i + 1 - candStart >= HK_FID_MIN_RUN) {
+            fid_run(&s, wave, waveStart, candStart);
+            wave = cand;
+            waveStart = candStart;
+            cand = FID_NONE;
+        }
+    }
+    fid_run(&s, wave, waveStart, len);
+    fid_close_beat(&s);
+    return s.numBeats;
+}
+
+void
+hk_fiducials_summary(const hk_fiducial_t *beats, uint32_t numBeats, hk_intervals_t *intervals) {
+    int32_t sums[4] = {0, 0, 0, 0};
+    int32_t counts[4] = {0, 0, 0, 0};
+    for (uint32_t i = 0; i < numBeats; i++) {
+        const int32_t vals[4] = {beats[i].pr, beats[i].qrs, beats[i].qt, beats[i].qtc};
+        for (int j = 0; j < 4; j++) {
+            if (vals[j] != -1) {
+                sums[j] += vals[j];
+                counts[j] += 1;
+            }
+        }
+    }
+    int32_t means[4];
+    for (int j = 0; j < 4; j++) {
+        means[j] = counts[j] ? (sums[j] + counts[j] / 2) / counts[j] : -1;
+    }
+    *intervals = {means[0], means[1], means[2], means[3]};
+}
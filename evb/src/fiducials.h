@@ -0,0 +1,63 @@
+/**
+ * @file fiducials.h
+ * @author Adam Page (adam.page@ambiq.com)
+ * @brief Beats, waves and intervals from one run-length pass over the segment mask
+ * @version 1.0
+ * @date 2023-05-02
+ *
+ * @copyright Copyright (c) 2023
+ *
+ */
+#ifndef __FIDUCIALS_H
+#define __FIDUCIALS_H
+
+#include "arm_math.h"
+#include <stdint.h>
+
+/**
+ * @brief A beat: its QRS, the P and T waves tied to it and their intervals in samples
+ */
+typedef struct {
+    int32_t peak;   // R peak, largest absolute sample of the QRS
+    int32_t qrsOn;  // QRS [qrsOn, qrsOff)
+    int32_t qrsOff;
+    int32_t pOn;    // P wave [pOn, pOff), -1 if the beat has none
+    int32_t pOff;
+    int32_t tOn;    // T wave [tOn, tOff), -1 if the beat has none
+    int32_t tOff;
+    int32_t pr;     // P onset to QRS onset, -1 without a P wave
+    int32_t qrs;    // QRS duration, -1 if the window cuts the QRS
+    int32_t qt;     // QRS onset to T offset, -1 without a T wave
+    int32_t qtc;    // QT over the square root of the previous RR in seconds (Bazett), -1 without QT or RR
+} hk_fiducial_t;
+
+/**
+ * @brief Mean intervals of a window's beats in samples, -1 where no beat has one
+ */
+typedef struct {
+    int32_t pr;
+    int32_t qrs;
+    int32_t qt;
+    int32_t qtc;
+} hk_intervals_t;
+
+/**
+ * @brief Extract the beats of a segment mask in one pass over its runs. Runs shorter than
+ * HK_FID_MIN_RUN do not change the wave, each QRS is a beat with its R peak at the largest absolute
+ * sample inside it, and the last P wave within HK_FID_PR_MAX before a QRS and the first T wave ending
+ * within HK_FID_QT_MAX after it are the beat's. Waves cut by the window edges are not measured.
+ * @param data Preprocessed signal [len]
+ * @param segMask Segment labels, the upper nibble is ignored [len]
+ * @param beats Output beats, ascending [maxBeats]
+ * @return Number of beats
+ */
+uint32_t
+hk_fiducials_extract(const float32_t *data, const uint8_t *segMask, uint32_t len, hk_fiducial_t *beats, uint32_t maxBeats);
+
+/**
+ * @brief Mean PR, QRS duration, QT and QTc of the beats that have them
+ */
+void
+hk_fiducials_summary(const hk_fiducial_t *beats, uint32_t numBeats, hk_intervals_t *intervals);
+
+#endif // __FIDUCIALS_H
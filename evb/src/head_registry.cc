@@ -0,0 +1,134 @@
+/**
+ * @file head_registry.cc
+ * @author Adam Page (adam.page@ambiq.com)
+ * @brief Heads of the hk_run pipeline, each run at its own cadence
+ * @version 1.0
+ * @date 2023-05-02
+ *
+ * @copyright Copyright (c) 2023
+ *
+ * Rhythm changes over tens of seconds while beats change every window, yet hk_run used to run every
+ * model on every window. Each head now declares its period in windows and the products it needs and
+ * makes, and hk_heads_run() runs the heads due in the window. A head that is due pulls in the heads
+ * making what it needs, even if they are not due themselves, so e.g. beats every window keep
+ * segmentation every window while arrhythmia runs every third. A new head is one hk_head_t and one
+ * hk_head_register() call.
+ *
+ * A head is due once period << backoff windows have passed since it last ran, counted per head
+ * rather than off a shared window index, so a backoff that changes between windows (duty_cycle.cc)
+ * stretches or shrinks the next gap instead of skipping a run or bunching two together.
+ */
+#include "head_registry.h"
+
+static const hk_head_t *hkHeads[HK_MAX_HEADS];
+static uint32_t hkHeadRuns[HK_MAX_HEADS];
+// Window each head last ran in, HK_HEAD_NEVER until it runs after a reset
+static uint32_t hkHeadLast[HK_MAX_HEADS];
+static uint32_t hkNumHeads = 0;
+static uint32_t hkWindow = 0;
+static uint32_t hkBackoff = 0;
+static uint32_t hkMade = 0;
+
+#define HK_HEAD_NEVER (0xFFFFFFFF)
+
+int32_t
+hk_head_register(const hk_head_t *head) {
+    if (hkNumHeads >= HK_MAX_HEADS || head->run == nullptr || head->period == 0) {
+        return -1;
+    }
+    hkHeads[hkNumHeads] = head;
+    hkHeadRuns[hkNumHeads] = 0;
+    hkHeadLast[hkNumHeads] = HK_HEAD_NEVER;
+    return hkNumHeads++;
+}
+
+uint32_t
+hk_heads_init(void) {
+    uint32_t err = 0;
+    for (uint32_t i = 0; i < hkNumHeads; i++) {
+        if (hkHeads[i]->init != nullptr) {
+            err |= hkHeads[i]->init();
+        }
+    }
+    return err;
+}
+
+uint32_t
+hk_heads_run(hk_context_t *ctx) {
+    uint32_t err = 0;
+    bool due[HK_MAX_HEADS];
+    for (uint32_t i = 0; i < hkNumHeads; i++) {
+        due[i] = hkHeadLast[i] == HK_HEAD_NEVER || hkWindow - hkHeadLast[i] >= hkHeads[i]->period << hkBackoff;
+    }
+    // Pull in the producers of what due heads need, and theirs in turn
+    for (bool changed = true; changed;) {
+        changed = false;
+        for (uint32_t i = 0; i < hkNumHeads; i++) {
+            for (uint32_t j = 0; due[i] && j < hkNumHeads; j++) {
+                if (!due[j] && (hkHeads[i]->needs & hkHeads[j]->makes)) {
+                    due[j] = changed = true;
+                }
+            }
+        }
+    }
+    // Run each due head once the products it needs are made
+    uint32_t made = 0;
+    bool ran[HK_MAX_HEADS] = {false};
+    for (bool progress = true; progress;) {
+        progress = false;
+        for (uint32_t i = 0; i < hkNumHeads; i++) {
+            if (!due[i] || ran[i] || (hkHeads[i]->needs & ~made)) {
+                continue;
+            }
+            err |= hkHeads[i]->run(ctx);
+            made |= hkHeads[i]->makes;
+            hkHeadRuns[i]++;
+            hkHeadLast[i] = hkWindow;
+            ran[i] = progress = true;
+        }
+    }
+    for (uint32_t i = 0; i < hkNumHeads; i++) {
+        err |= due[i] && !ran[i];
+    }
+    hkMade = made;
+    hkWindow++;
+    return err;
+}
+
+void
+hk_heads_reset(void) {
+    for (uint32_t i = 0; i < hkNumHeads; i++) {
+        hkHeadLast[i] = HK_HEAD_NEVER;
+    }
+    hkWindow = 0;
+    hkBackoff = 0;
+    hkMade = 0;
+}
+
+void
+hk_heads_set_backoff(uint32_t shift) {
+    hkBackoff = shift;
+}
+
+uint32_t
+hk_heads_backoff(void) {
+    return hkBackoff;
+}
+
+uint32_t
+hk_heads_made(void) {
+    return hkMade;
+}
+
+uint32_t
+hk_heads_count(void) {
+    return hkNumHeads;
+}
+
+const hk_head_t *
+hk_head(uint32_t index, uint32_t *runs) {
+    if (runs != nullptr) {
+        *runs = hkHeadRuns[index];
+    }
+    return hkHeads[index];
+}
@@ -0,0 +1,120 @@
+/**
+ * @file head_registry.h
+ * @author Adam Page (adam.page@ambiq.com)
+ * @brief Heads of the hk_run pipeline, each run at its own cadence
+ * @version 1.0
+ * @date 2023-05-02
+ *
+ * @copyright Copyright (c) 2023
+ *
+ */
+#ifndef __HEAD_REGISTRY_H
+#define __HEAD_REGISTRY_H
+
+#include "arm_math.h"
+#include <stdint.h>
+
+#include "fiducials.h"
+#include "heartkit.h"
+
+#define HK_MAX_HEADS (8)
+
+/**
+ * @brief Intermediate products heads share within a window
+ */
+enum HeartProduct {
+    HeartProductMask = 1 << 0,     // Segment labels in segMask
+    HeartProductPeaks = 1 << 1,    // peaks, numPeaks, fiducials
+    HeartProductRR = 1 << 2,       // rrIntervals, avgRR
+    HeartProductFeatures = 1 << 3, // Multihead backbone beat features (model.cc)
+    HeartProductRhythm = 1 << 4,   // result->arrhythmia
+    HeartProductBeats = 1 << 5,    // result beat counts
+};
+typedef enum HeartProduct HeartProduct;
+
+/**
+ * @brief Window and products passed to every head hk_heads_run() runs
+ */
+typedef struct {
+    float32_t *data;      // Preprocessed signal [HK_DATA_LEN]
+    uint32_t start;       // Absolute sample index of data[0] since hk_reset
+    uint8_t *segMask;     // Segment labels, beat labels in the upper nibble [HK_DATA_LEN]
+    int32_t *peaks;       // R peak indices [HK_PEAK_LEN]
+    uint32_t numPeaks;
+    hk_fiducial_t *fiducials; // Waves and intervals of each peak, nullptr if the peaks are not from the mask [HK_PEAK_LEN]
+    int32_t *rrIntervals; // RR intervals in samples [HK_PEAK_LEN]
+    uint32_t avgRR;
+    hk_result_t *result;  // Fields of heads that did not run keep their last values
+} hk_context_t;
+
+/**
+ * @brief A head: a model or stage reading the window and products of the heads it needs
+ */
+typedef struct {
+    const char *name;
+    uint32_t (*init)(void);             // Called by hk_heads_init() (nullptr if none), non-zero on error
+    uint32_t (*run)(hk_context_t *ctx); // Non-zero on error
+    uint32_t period;                    // Runs every period-th window (1 every window), before backoff
+    uint32_t needs;                     // HeartProduct bits it reads
+    uint32_t makes;                     // HeartProduct bits it writes
+} hk_head_t;
+
+/**
+ * @brief Add a head. Heads making a product must be registered before hk_heads_run() needs it.
+ * @return Head index, or -1 if the registry is full or the head has no run or period
+ */
+int32_t
+hk_head_register(const hk_head_t *head);
+
+/**
+ * @brief Initialize every registered head
+ * @return Non-zero if a head failed
+ */
+uint32_t
+hk_heads_init(void);
+
+/**
+ * @brief Run the heads due this window, and the heads making products they need, producers first
+ * @return Non-zero if a head failed or needed a product no head makes
+ */
+uint32_t
+hk_heads_run(hk_context_t *ctx);
+
+/**
+ * @brief Start the cadence over at full rate, running every head on the next window
+ */
+void
+hk_heads_reset(void);
+
+/**
+ * @brief Stretch every head's period to period << shift from the next window on (0 is full rate)
+ */
+void
+hk_heads_set_backoff(uint32_t shift);
+
+/**
+ * @brief Current backoff shift
+ */
+uint32_t
+hk_heads_backoff(void);
+
+/**
+ * @brief HeartProduct bits made by the heads that ran in the last hk_heads_run() window
+ */
+uint32_t
+hk_heads_made(void);
+
+/**
+ * @brief Registered heads
+ */
+uint32_t
+hk_heads_count(void);
+
+/**
+ * @brief Head at index
+ * @param runs Windows it ran since boot (nullptr to skip)
+ */
+const hk_head_t *
+hk_head(uint32_t index, uint32_t *runs);
+
+#endif // __HEAD_REGISTRY_H
@@ -3,28 +3,169 @@
 #include <stdbool.h>
 
 #include "ns_ambiqsuite_harness.h"
+#include "ns_perf_profile.h"
+#include "ns_timer.h"
 
+#include "beat_cache.h"
+#include "beat_template.h"
+#include "coarse_segmentation.h"
 #include "constants.h"
+#include "duty_cycle.h"
+#include "fiducials.h"
+#include "head_registry.h"
 #include "heartkit.h"
+#include "hrv.h"
 #include "model.h"
+#include "pan_tompkins.h"
 #include "preprocessing.h"
+#include "rhythm_smooth.h"
+#include "roi_segmentation.h"
 
 static int32_t hkPeaks[HK_PEAK_LEN];
 static int32_t hkRRIntervals[HK_PEAK_LEN];
+static hk_fiducial_t hkFiducials[HK_PEAK_LEN];
+static hk_stage_perf_t hkStagePerf[HeartStageCount];
+static uint32_t hkStageStartUs = 0;
+// Absolute sample index one past the last window
+static uint32_t hkWindowEnd = 0;
+#ifdef HK_SEG_ROI_ENABLE
+    #if !defined(HK_SEG_STREAM_ENABLE) || defined(HK_MULTIHEAD_ENABLE)
+        #error "HK_SEG_ROI_ENABLE streams the segmentation model over regions, enable HK_SEG_STREAM_ENABLE without HK_MULTIHEAD_ENABLE"
+    #endif
+static int32_t hkRoiPeaks[HK_PEAK_LEN];
+static hk_roi_t hkRois[HK_PEAK_LEN + 1];
+// Samples segmentation streamed and the signal samples it covered since reset
+static uint32_t hkRoiFed = 0;
+static uint32_t hkRoiSamples = 0;
+#endif
+#ifdef HK_SEG_COARSE_ENABLE
+    #if !defined(HK_SEG_STREAM_ENABLE) || defined(HK_MULTIHEAD_ENABLE) || defined(HK_SEG_ROI_ENABLE)
+        #error "HK_SEG_COARSE_ENABLE refines with the streamed segmentation model, enable HK_SEG_STREAM_ENABLE without HK_MULTIHEAD_ENABLE or HK_SEG_ROI_ENABLE"
+    #endif
+static float32_t hkCoarseData[HK_SEG_COARSE_LEN];
+static uint8_t hkCoarseMask[HK_SEG_COARSE_FRAME];
+// Boundaries past the last region merge into it
+static hk_roi_t hkCoarseRois[2 * HK_PEAK_LEN];
+// Samples the full-rate model refined and the signal samples it covered since reset
+static uint32_t hkCoarseFed = 0;
+static uint32_t hkCoarseSamples = 0;
+#endif
+#ifdef HK_HR_ONLY_ENABLE
+// Windows left on the full heads, and windows seen and escalated since reset
+static uint32_t hkEscalate = 0;
+static uint32_t hkHrWindows = 0;
+static uint32_t hkHrEscalated = 0;
+#endif
+
+static ns_timer_config_t hkTickTimer = {
+    .api = &ns_timer_V1_0_0, .timer = NS_TIMER_COUNTER, .enableInterrupt = false, .periodInMicroseconds = 0, .callback = NULL};
 
 const char *HK_RHYTHM_LABELS[] = {"NSR", "AFIB/AFL", "AFIB/AFL"};
 const char *HK_BEAT_LABELS[] = {"NORMAL", "PAC", "PVC"};
 const char *HK_HEART_RATE_LABELS[] = {"NORMAL", "TACHYCARDIA", "BRADYCARDIA"};
 const char *HK_SEGMENT_LABELS[] = {"NONE", "P-WAVE", "QRS", "T-WAVE"};
+const char *HK_STAGE_LABELS[] = {"PREPROCESS", "ARRHYTHMIA", "SEGMENTATION", "PEAKS", "HRV", "BEAT"};
+
+static uint32_t
+register_heads();
+
+static void
+stage_start() {
+    /**
+     * @brief Reset and start DWT counters for a stage
+     *
+     */
+    ns_reset_perf_counters();
+    ns_start_perf_profiler();
+    hkStageStartUs = ns_us_ticker_read(&hkTickTimer);
+}
+
+static void
+stage_stop(HeartStage stage, bool accumulate = false) {
+    /**
+     * @brief Stop DWT counters and record stage
+     * @param stage Stage to record
+     * @param accumulate Add to the stage instead of replacing it (stages run in several parts)
+     */
+    ns_perf_counters_t pc;
+    ns_stop_perf_profiler();
+    ns_capture_perf_profiler(&pc);
+    if (!accumulate) {
+        memset(&hkStagePerf[stage], 0, sizeof(hk_stage_perf_t));
+    }
+    hkStagePerf[stage].cycles += pc.cyccnt;
+    hkStagePerf[stage].usec += ns_us_ticker_read(&hkTickTimer) - hkStageStartUs;
+}
 
 uint32_t
 init_heartkit() {
     uint32_t err = 0;
+    uint32_t startUs;
     err = init_preprocess();
+    err |= ns_timer_init(&hkTickTimer);
+    // Boot cost of AllocateTensors (compare runtime vs offline memory plans)
+    startUs = ns_us_ticker_read(&hkTickTimer);
     err |= init_models();
+    ns_printf("init_models took %lu us\n", ns_us_ticker_read(&hkTickTimer) - startUs);
+#ifdef HK_SEG_COARSE_ENABLE
+    err |= hk_coarse_init();
+#endif
+    err |= hk_hrv_init();
+    err |= register_heads();
+    err |= hk_heads_init();
+    ns_init_perf_profiler();
     return err;
 }
 
+void
+hk_reset() {
+    /**
+     * @brief Reset state carried across hk_run calls (call when the signal is discontinuous)
+     *
+     */
+    hk_rhythm_reset();
+    segmentation_stream_reset();
+    hk_heads_reset();
+    hk_duty_reset();
+    hk_beat_cache_reset();
+    hk_template_reset();
+#ifdef HK_SEG_ROI_ENABLE
+    hkRoiFed = 0;
+    hkRoiSamples = 0;
+#endif
+#ifdef HK_SEG_COARSE_ENABLE
+    hkCoarseFed = 0;
+    hkCoarseSamples = 0;
+#endif
+#if defined(HK_HR_ONLY_ENABLE) || defined(HK_SEG_ROI_ENABLE)
+    hk_pt_reset();
+#endif
+#ifdef HK_HR_ONLY_ENABLE
+    hkEscalate = 0;
+    hkHrWindows = 0;
+    hkHrEscalated = 0;
+#endif
+    hk_hrv_reset();
+    hkWindowEnd = 0;
+}
+
+static void
+rhythm_apply(int val, const float32_t *logits, hk_result_t *result) {
+    /**
+     * @brief Fold a block's arrhythmia label (and logits) into the result
+     *
+     */
+#ifdef HK_ARR_SMOOTH_ENABLE
+    val = hk_rhythm_update(logits);
+    result->arrhythmia = (val == HeartRhythmAfib || val == HeartRhythmAfut) ? HeartRhythmAfib : HeartRhythmNormal;
+#else
+    (void)logits;
+    if (val == HeartRhythmAfib || val == HeartRhythmAfut) {
+        result->arrhythmia = HeartRhythmAfib;
+    }
+#endif
+}
+
 uint32_t
 hk_preprocess(float32_t *data) {
     /**
@@ -32,27 +173,21 @@ hk_preprocess(float32_t *data) {
      *
      */
     uint32_t err = 0;
+    stage_start();
     err = bandpass_filter(data, data, HK_DATA_LEN);
     err |= standardize(data, data, HK_DATA_LEN);
+    stage_stop(HeartStagePreprocess);
     return err;
 }
 
 uint32_t
 find_peaks_from_segments(float32_t *data, uint8_t *segMask, uint32_t dataLen, int32_t *peaks) {
-    uint32_t numPeaks = 0;
-    uint32_t qrsStartIdx = 0, qrsEndIdx = 0, qrsLen = 0;
-    for (size_t i = 1; i < dataLen; i++) {
-        // QRS start case
-        if (segMask[i] == HeartSegmentQrs && segMask[i - i] == HeartSegmentNormal) {
-            qrsStartIdx = i - 1;
-        }
-        // QRS end case
-        if (segMask[i - 1] == HeartSegmentQrs && segMask[i] == HeartSegmentNormal) {
-            qrsEndIdx = i - 1;
-            qrsLen = qrsEndIdx - qrsStartIdx + 1;
-            peaks[numPeaks++] = (qrsEndIdx + qrsStartIdx) >> 1;
-            // QRS width must be within limits and # QRS points must be at least 70%
-        }
+    /**
+     * @brief R peaks of the beats fiducials.cc extracts from the mask, left in hkFiducials
+     */
+    const uint32_t numPeaks = hk_fiducials_extract(data, segMask, dataLen, hkFiducials, HK_PEAK_LEN);
+    for (uint32_t i = 0; i < numPeaks; i++) {
+        peaks[i] = hkFiducials[i].peak;
     }
     return numPeaks;
 }
@@ -88,55 +223,290 @@ ecg_bpm(int32_t *rrIntervals, uint32_t dataLen, float32_t sampling_rate, float32
     return bpm;
 }
 
-uint32_t
-hk_run(float32_t *data, uint8_t *segMask, hk_result_t *result) {
+#ifdef HK_MULTIHEAD_ENABLE
+static uint32_t
+multihead_head_run(hk_context_t *ctx) {
+    /**
+     * @brief One backbone pass per window feeds the arrhythmia and segmentation heads and keeps the beat
+     * features. Backbone cycles count as ARRHYTHMIA. Windows overlap by 2 * HK_MH_OLP samples, the
+     * last one ending at the last sample, and the mask edges stay normal as with the windowed model.
+     */
     uint32_t err = 0;
     int val = 0;
+    float32_t arrLogits[HK_ARR_CLASSES];
+    ctx->result->arrhythmia = HeartRhythmNormal;
+    for (size_t i = 0, last = 0; !last; i += HK_MH_STEP) {
+        last = i >= HK_DATA_LEN - HK_MH_LEN;
+        i = MIN(i, HK_DATA_LEN - HK_MH_LEN);
+        stage_start();
+        val = multihead_backbone(ctx->data, i);
+        if (val != -1) {
+            val = multihead_arrhythmia(arrLogits);
+        }
+        if (val == -1) {
+            err = 1;
+        } else {
+            rhythm_apply(val, arrLogits, ctx->result);
+        }
+        stage_stop(HeartStageArrhythmia, i > 0);
+        stage_start();
+        if (val != -1 && multihead_segmentation(&ctx->segMask[i], HK_MH_OLP) == -1) {
+            err = 1;
+        }
+        stage_stop(HeartStageSegmentation, i > 0);
+    }
+    return err;
+}
 
-    result->heartRate = 0;
-    result->heartRhythm = HeartRateNormal;
-    result->numPacBeats = 0;
-    result->numPvcBeats = 0;
-    result->numNormBeats = 0;
-    result->arrhythmia = HeartRhythmNormal;
-
-    // Apply arrhythmia model
-    for (size_t i = 0; i < HK_DATA_LEN - HK_ARR_LEN + 1; i += HK_ARR_LEN) {
-        val = arrhythmia_inference(&data[i], 0);
+// Arrhythmia and segmentation share the backbone pass, so they share a cadence
+static const hk_head_t hkMultiheadHead = {
+    "MULTIHEAD", nullptr, multihead_head_run, MIN(HK_ARR_PERIOD, HK_SEG_PERIOD), 0,
+    HeartProductMask | HeartProductFeatures | HeartProductRhythm};
+#else
+static uint32_t
+arrhythmia_head_run(hk_context_t *ctx) {
+    /**
+     * @brief Apply arrhythmia model. Blocks tile the signal, the last one ending at the last sample.
+     */
+    uint32_t err = 0;
+    int val = 0;
+    float32_t arrLogits[HK_ARR_CLASSES];
+    ctx->result->arrhythmia = HeartRhythmNormal;
+    stage_start();
+    for (size_t i = 0; i < HK_DATA_LEN; i += HK_ARR_LEN) {
+        i = MIN(i, HK_DATA_LEN - HK_ARR_LEN);
+        val = arrhythmia_inference(&ctx->data[i], HK_ARR_EXIT_THRESHOLD, arrLogits);
         if (val == -1) {
             err = 1;
-        } else if (val == HeartRhythmAfib || val == HeartRhythmAfut) {
-            result->arrhythmia = HeartRhythmAfib;
+            continue;
         }
+        rhythm_apply(val, arrLogits, ctx->result);
     }
+    stage_stop(HeartStageArrhythmia);
+    return err;
+}
 
-    // Apply segmentatiom model
-    // We dont predict on first and last overlap size so set to normal
-    memset(segMask, HeartSegmentNormal, HK_DATA_LEN);
+#ifdef HK_SEG_ROI_ENABLE
+static int
+segmentation_roi_run(hk_context_t *ctx) {
+    /**
+     * @brief Stream segmentation over the regions around Pan-Tompkins QRS candidates (roi_segmentation.cc)
+     * @return Success (-1 if err)
+     */
+    int err = 0;
+    const uint32_t numCands = pan_tompkins_peaks(ctx->data, ctx->start, HK_DATA_LEN, hkRoiPeaks, HK_PEAK_LEN);
+    const uint32_t numRois =
+        hk_roi_plan(hkRoiPeaks, numCands, HK_DATA_LEN, HK_ROI_CONTEXT, segmentation_stream_align(), hkRois, HK_PEAK_LEN + 1);
+    for (uint32_t i = 0; i < numRois; i++) {
+        const hk_roi_t *roi = &hkRois[i];
+        if (segmentation_stream(&ctx->data[roi->start], &ctx->segMask[roi->start], roi->end - roi->start) == -1) {
+            err = -1;
+        }
+        // Context labels saw the stream edges
+        memset(&ctx->segMask[roi->start], HeartSegmentNormal, roi->labelStart - roi->start);
+        memset(&ctx->segMask[roi->labelEnd], HeartSegmentNormal, roi->end - roi->labelEnd);
+        hkRoiFed += roi->end - roi->start;
+    }
+    hkRoiSamples += HK_DATA_LEN;
+    return err;
+}
+#endif
 
+#ifdef HK_SEG_COARSE_ENABLE
+static int
+segmentation_coarse_run(hk_context_t *ctx) {
+    /**
+     * @brief Label the decimated window with the coarse model, then stream the full-rate model over
+     * the boundaries of the refined waves (coarse_segmentation.cc)
+     * @return Success (-1 if err)
+     */
+    int err = 0;
+    hk_coarse_decimate(ctx->data, HK_DATA_LEN, hkCoarseData);
+    if (segmentation_coarse(hkCoarseData, hkCoarseMask) == -1) {
+        return -1;
+    }
+    hk_coarse_upsample(hkCoarseMask, HK_SEG_COARSE_FRAME, 0, HK_DATA_LEN, ctx->segMask);
+    const uint32_t numRois = hk_coarse_plan(hkCoarseMask, HK_SEG_COARSE_FRAME, HK_SEG_COARSE_REFINE, HK_SEG_COARSE_CONTEXT,
+                                            segmentation_stream_align(), hkCoarseRois, sizeof(hkCoarseRois) / sizeof(hkCoarseRois[0]));
+    for (uint32_t i = 0; i < numRois; i++) {
+        const hk_roi_t *roi = &hkCoarseRois[i];
+        if (segmentation_stream(&ctx->data[roi->start], &ctx->segMask[roi->start], roi->end - roi->start) == -1) {
+            err = -1;
+        }
+        // Context labels saw the stream edges, the coarse ones stand
+        hk_coarse_upsample(hkCoarseMask, HK_SEG_COARSE_FRAME, roi->start, roi->labelStart, ctx->segMask);
+        hk_coarse_upsample(hkCoarseMask, HK_SEG_COARSE_FRAME, roi->labelEnd, roi->end, ctx->segMask);
+        hkCoarseFed += roi->end - roi->start;
+    }
+    hkCoarseSamples += HK_DATA_LEN;
+    return err;
+}
+#endif
+
+static uint32_t
+segmentation_head_run(hk_context_t *ctx) {
+    /**
+     * @brief Apply segmentation model. We dont predict on first and last overlap size so those stay normal.
+     */
+    uint32_t err = 0;
+    int val = 0;
+    stage_start();
+#if defined(HK_SEG_ROI_ENABLE)
+    val = segmentation_roi_run(ctx);
+    if (val == -1) {
+        err = 1;
+    }
+#elif defined(HK_SEG_COARSE_ENABLE)
+    val = segmentation_coarse_run(ctx);
+    if (val == -1) {
+        err = 1;
+    }
+#elif defined(HK_SEG_STREAM_ENABLE) && HK_WINDOW_STEP < HK_DATA_LEN
+    // Overlapping windows only stream the samples after the last one
+    val = segmentation_stream_window(ctx->data, ctx->start, ctx->segMask);
+    if (val == -1) {
+        err = 1;
+    }
+#elif defined(HK_SEG_STREAM_ENABLE)
+    val = segmentation_stream(ctx->data, ctx->segMask, HK_DATA_LEN);
+    if (val == -1) {
+        err = 1;
+    }
+#else
     for (size_t i = 0; i < HK_DATA_LEN - HK_SEG_LEN + 1; i += HK_SEG_STEP) {
-        val = segmentation_inference(&data[i], &segMask[i], HK_SEG_OLP);
+        val = segmentation_inference(&ctx->data[i], &ctx->segMask[i], HK_SEG_OLP);
         if (val == -1) {
             err = 1;
         }
     }
-    val = segmentation_inference(&data[HK_DATA_LEN - HK_SEG_LEN], &segMask[HK_DATA_LEN - HK_SEG_LEN], HK_SEG_OLP);
+    val = segmentation_inference(&ctx->data[HK_DATA_LEN - HK_SEG_LEN], &ctx->segMask[HK_DATA_LEN - HK_SEG_LEN], HK_SEG_OLP);
     if (val == -1) {
         err = 1;
     }
+#endif
+    stage_stop(HeartStageSegmentation);
+    return err;
+}
+
+static const hk_head_t hkArrhythmiaHead = {"ARRHYTHMIA", nullptr, arrhythmia_head_run, HK_ARR_PERIOD, 0, HeartProductRhythm};
+static const hk_head_t hkSegmentationHead = {"SEGMENTATION", nullptr, segmentation_head_run, HK_SEG_PERIOD, 0, HeartProductMask};
+#endif
+
+static uint32_t
+peaks_head_run(hk_context_t *ctx) {
+    stage_start();
+    ctx->numPeaks = find_peaks_from_segments(ctx->data, ctx->segMask, HK_DATA_LEN, ctx->peaks);
+    ctx->fiducials = hkFiducials;
+    stage_stop(HeartStagePeaks);
+    return 0;
+}
+
+static void
+hrv_apply(hk_result_t *result) {
+    /**
+     * @brief Copy the metrics of the HRV window (hrv.cc) to the result
+     */
+    hk_hrv_t hrv;
+    hk_hrv_metrics(&hrv);
+    result->numRR = hrv.numRR;
+    result->sdnn = hrv.sdnn;
+    result->rmssd = hrv.rmssd;
+    result->pnn50 = hrv.pnn50;
+    result->lfPower = hrv.lfPower;
+    result->hfPower = hrv.hfPower;
+    result->lfHfRatio = hrv.hfPower > 0 ? hrv.lfPower / hrv.hfPower : 0;
+}
 
-    // Apply HRV
-    int numPeaks = find_peaks_from_segments(data, segMask, HK_DATA_LEN, hkPeaks);
-    ecg_rate(hkPeaks, numPeaks, hkRRIntervals);
-    float32_t bpm = ecg_bpm(hkRRIntervals, numPeaks, SAMPLE_RATE, -1, -1);
-    uint32_t avgRR = (uint32_t)(SAMPLE_RATE / (bpm / 60));
-    result->heartRhythm = bpm < 60 ? HeartRateBradycardia : bpm <= 100 ? HeartRateNormal : HeartRateTachycardia;
-    result->heartRate = (uint32_t)bpm;
-    ns_printf("avgRR=%lu\n", avgRR);
+static void
+intervals_apply(const hk_fiducial_t *fiducials, uint32_t numBeats, hk_result_t *result) {
+    /**
+     * @brief Mean intervals of the window's beats (fiducials.cc) to the result in ms
+     */
+    hk_intervals_t intervals;
+    hk_fiducials_summary(fiducials, numBeats, &intervals);
+    const int32_t vals[] = {intervals.pr, intervals.qrs, intervals.qt, intervals.qtc};
+    int32_t *fields[] = {&result->prInterval, &result->qrsDuration, &result->qtInterval, &result->qtcInterval};
+    for (size_t i = 0; i < sizeof(vals) / sizeof(vals[0]); i++) {
+        *fields[i] = vals[i] == -1 ? -1 : vals[i] * 1000 / SAMPLE_RATE;
+    }
+}
 
-    // Apply beat head
+static uint32_t
+hrv_head_run(hk_context_t *ctx) {
+    stage_start();
+    ecg_rate(ctx->peaks, ctx->numPeaks, ctx->rrIntervals);
+    float32_t bpm = ecg_bpm(ctx->rrIntervals, ctx->numPeaks, SAMPLE_RATE, -1, -1);
+    ctx->avgRR = (uint32_t)(SAMPLE_RATE / (bpm / 60));
+    ctx->result->heartRhythm = bpm < 60 ? HeartRateBradycardia : bpm <= 100 ? HeartRateNormal : HeartRateTachycardia;
+    ctx->result->heartRate = (uint32_t)bpm;
+    // Overlapping windows feed their peaks again, hrv.cc skips beats it already has
+    for (uint32_t i = 0; i < ctx->numPeaks; i++) {
+        hk_hrv_push(ctx->start + ctx->peaks[i]);
+    }
+    hrv_apply(ctx->result);
+    if (ctx->fiducials) {
+        intervals_apply(ctx->fiducials, ctx->numPeaks, ctx->result);
+    }
+    stage_stop(HeartStageHrv);
+    ns_printf("avgRR=%lu\n", ctx->avgRR);
+    return 0;
+}
+
+static uint32_t
+beat_classify(hk_context_t *ctx, int i, uint32_t bStart, bool prevNormal) {
+    /**
+     * @brief Label of the beat at peaks[i], from the beat cache if an overlapping window already
+     * classified it in the same RR context, or normal if it matches the normal beat template
+     * @param prevNormal Beat at peaks[i - 1] was labeled normal
+     */
+    const uint32_t avgRR = ctx->avgRR;
+    float32_t margin = 0;
+    int label;
+#ifdef HK_BEAT_CACHE_ENABLE
+    const uint32_t bIdx = ctx->peaks[i];
+    hk_beat_entry_t beat = {ctx->start + bIdx, bIdx - ctx->peaks[i - 1], ctx->peaks[i + 1] - bIdx, avgRR, 0, 0, false};
+    label = hk_beat_cache_lookup(&beat);
+    if (label != -1) {
+        return label;
+    }
+#endif
+#ifdef HK_BEAT_TEMPLATE_ENABLE
+    const uint32_t prevRR = ctx->peaks[i] - ctx->peaks[i - 1];
+    if (hk_template_screen(&ctx->data[bStart], prevRR, avgRR, prevNormal, HK_TEMPLATE_SIMILARITY)) {
+        hk_template_update(&ctx->data[bStart], prevRR, avgRR);
+        return HeartBeatNormal;
+    }
+#endif
+    ns_printf("beats (%lu, %lu, %lu)\n", bStart - avgRR, bStart, bStart + avgRR);
+#ifdef HK_MULTIHEAD_ENABLE
+    label = multihead_beat(bStart - avgRR, bStart, bStart + avgRR, &margin);
+#else
+    label = beat_inference(&ctx->data[bStart - avgRR], &ctx->data[bStart], &ctx->data[bStart + avgRR], &margin);
+#endif
+#ifdef HK_BEAT_CACHE_ENABLE
+    if (label != -1) {
+        beat.margin = margin;
+        beat.label = label;
+        hk_beat_cache_store(&beat);
+    }
+#endif
+#ifdef HK_BEAT_TEMPLATE_ENABLE
+    if (label == HeartBeatNormal) {
+        hk_template_update(&ctx->data[bStart], prevRR, avgRR);
+    }
+#endif
+    return label;
+}
+
+static uint32_t
+beat_head_run(hk_context_t *ctx) {
+    /**
+     * @brief Apply beat model to each beat with a previous and next beat avgRR away
+     */
     uint32_t bIdx;
-    uint32_t beatLabel;
+    uint32_t beatLabel = HeartBeatNormal;
+    hk_result_t *result = ctx->result;
+    const uint32_t avgRR = ctx->avgRR;
 
     result->numPacBeats = 0;
     result->numPvcBeats = 0;
@@ -144,17 +514,17 @@ hk_run(float32_t *data, uint8_t *segMask, hk_result_t *result) {
 
     uint32_t bOffset = (HK_BEAT_LEN >> 1);
     uint32_t bStart = 0;
-    for (int i = 1; i < numPeaks - 1; i++) {
-        bIdx = hkPeaks[i];
+    stage_start();
+    for (int i = 1; i < (int)ctx->numPeaks - 1; i++) {
+        bIdx = ctx->peaks[i];
         bStart = bIdx - bOffset;
         if (bIdx < bOffset || bStart < avgRR || bStart + avgRR + HK_BEAT_LEN > HK_DATA_LEN) {
             beatLabel = HeartBeatNormal;
         } else {
-            ns_printf("beats (%lu, %lu, %lu)\n", bStart - avgRR, bStart, bStart + avgRR);
-            beatLabel = beat_inference(&data[bStart - avgRR], &data[bStart], &data[bStart + avgRR]);
+            beatLabel = beat_classify(ctx, i, bStart, beatLabel == HeartBeatNormal);
         }
         // Place beat label in upper nibble
-        segMask[bIdx] |= ((beatLabel + 1) << 4);
+        ctx->segMask[bIdx] |= ((beatLabel + 1) << 4);
         if (beatLabel == HeartBeatPac) {
             result->numPacBeats += 1;
         } else if (beatLabel == HeartBeatPvc) {
@@ -163,6 +533,118 @@ hk_run(float32_t *data, uint8_t *segMask, hk_result_t *result) {
             result->numNormBeats += 1;
         }
     }
+    stage_stop(HeartStageBeat);
+    return 0;
+}
+
+static const hk_head_t hkPeaksHead = {"PEAKS", nullptr, peaks_head_run, HK_HRV_PERIOD, HeartProductMask, HeartProductPeaks};
+static const hk_head_t hkHrvHead = {"HRV", nullptr, hrv_head_run, HK_HRV_PERIOD, HeartProductPeaks, HeartProductRR};
+#ifdef HK_MULTIHEAD_ENABLE
+static const hk_head_t hkBeatHead = {
+    "BEAT", nullptr, beat_head_run, HK_BEAT_PERIOD, HeartProductPeaks | HeartProductRR | HeartProductFeatures, HeartProductBeats};
+#else
+static const hk_head_t hkBeatHead = {
+    "BEAT", nullptr, beat_head_run, HK_BEAT_PERIOD, HeartProductPeaks | HeartProductRR, HeartProductBeats};
+#endif
+
+static uint32_t
+register_heads() {
+    /**
+     * @brief Register the built-in heads of the enabled models
+     *
+     */
+    uint32_t err = 0;
+#ifdef HK_MULTIHEAD_ENABLE
+    err |= hk_head_register(&hkMultiheadHead) < 0;
+#else
+#ifdef ARRHTYHMIA_ENABLE
+    err |= hk_head_register(&hkArrhythmiaHead) < 0;
+#endif
+#ifdef SEGMENTATION_ENABLE
+    err |= hk_head_register(&hkSegmentationHead) < 0;
+#endif
+#endif
+    err |= hk_head_register(&hkPeaksHead) < 0;
+    err |= hk_head_register(&hkHrvHead) < 0;
+#ifdef BEAT_ENABLE
+    err |= hk_head_register(&hkBeatHead) < 0;
+#endif
+    return err;
+}
+
+#ifdef HK_HR_ONLY_ENABLE
+static bool
+hr_only_run(hk_context_t *ctx) {
+    /**
+     * @brief Heart rate from Pan-Tompkins peaks, timed as PEAKS and HRV
+     * @return True if the RR intervals are regular enough for heart rate alone
+     */
+    stage_start();
+    ctx->numPeaks = pan_tompkins_peaks(ctx->data, ctx->start, HK_DATA_LEN, ctx->peaks, HK_PEAK_LEN);
+    stage_stop(HeartStagePeaks);
+    if (ctx->numPeaks < 3) {
+        return false;
+    }
+    hrv_head_run(ctx);
+    return !hk_pt_irregular(ctx->rrIntervals, ctx->numPeaks);
+}
+
+static bool
+hr_only_hold(const hk_context_t *ctx, uint32_t made) {
+    /**
+     * @brief Whether what the heads made this window still calls for them: irregular RR, AFIB or ectopic beats
+     */
+    const hk_result_t *result = ctx->result;
+    return ((made & HeartProductRR) && hk_pt_irregular(ctx->rrIntervals, ctx->numPeaks)) ||
+           ((made & HeartProductRhythm) && result->arrhythmia != HeartRhythmNormal) ||
+           ((made & HeartProductBeats) && result->numPacBeats + result->numPvcBeats > 0);
+}
+#endif
+
+uint32_t
+hk_run(float32_t *data, uint32_t overlap, uint8_t *segMask, hk_result_t *result) {
+    /**
+     * @brief Run the heads due on a preprocessed signal (head_registry.cc), backed off by duty_cycle.cc.
+     * With HK_HR_ONLY_ENABLE, windows with regular RR only get Pan-Tompkins heart rate (pan_tompkins.cc).
+     * @param data Signal [HK_DATA_LEN]
+     * @param overlap Leading samples of data that ended the previous window (0 if not contiguous)
+     * @param segMask Output segment and beat labels, normal where segmentation did not run [HK_DATA_LEN]
+     * @param result Results, keeping the last values of heads that did not run
+     * @return Non-zero on error
+     */
+    const uint32_t start = hkWindowEnd - MIN(overlap, hkWindowEnd);
+    if (overlap == 0) {
+        // A gap (display, another patient) precedes the window, no RR interval, rhythm average,
+        // segmentation stream or QRS detector filter spans it
+        hk_hrv_break();
+        hk_rhythm_reset();
+        segmentation_stream_reset();
+#if defined(HK_HR_ONLY_ENABLE) || defined(HK_SEG_ROI_ENABLE)
+        hk_pt_restart();
+#endif
+    }
+    hk_context_t ctx = {data, start, segMask, hkPeaks, 0, nullptr, hkRRIntervals, 0, result};
+    hkWindowEnd = start + HK_DATA_LEN;
+    memset(segMask, HeartSegmentNormal, HK_DATA_LEN);
+    memset(&hkStagePerf[HeartStageArrhythmia], 0, (HeartStageCount - HeartStageArrhythmia) * sizeof(hk_stage_perf_t));
+#ifdef HK_HR_ONLY_ENABLE
+    hkHrWindows++;
+    if (hkEscalate == 0 && hr_only_run(&ctx)) {
+        memcpy(result->perf, hkStagePerf, sizeof(hkStagePerf));
+        return 0;
+    }
+    // Irregular: the heads run until HK_HR_ESCALATE_WINDOWS windows in a row are clear
+    hkEscalate = MAX(hkEscalate, 1);
+    hkHrEscalated++;
+#endif
+    uint32_t err = hk_heads_run(&ctx);
+#ifdef HK_DUTY_CYCLE_ENABLE
+    hk_heads_set_backoff(hk_duty_update(&ctx, hk_heads_made()));
+#endif
+#ifdef HK_HR_ONLY_ENABLE
+    hkEscalate = hr_only_hold(&ctx, hk_heads_made()) ? HK_HR_ESCALATE_WINDOWS : hkEscalate - 1;
+#endif
+    memcpy(result->perf, hkStagePerf, sizeof(hkStagePerf));
     return err;
 }
 
@@ -181,5 +663,78 @@ hk_print_result(hk_result_t *result) {
     ns_printf("   PVC Beats: %lu\n", result->numPvcBeats);
     ns_printf("  Arrhythmia: %lu\n", result->arrhythmia);
     ns_printf("----------------------\n");
+    ns_printf("        SDNN: %d.%d ms (%lu RR)\n", (int)result->sdnn, (int)(10 * result->sdnn) % 10, result->numRR);
+    ns_printf("       RMSSD: %d.%d ms\n", (int)result->rmssd, (int)(10 * result->rmssd) % 10);
+    ns_printf("       pNN50: %d.%d %%\n", (int)result->pnn50, (int)(10 * result->pnn50) % 10);
+    ns_printf("       LF/HF: %d.%02d (%lu / %lu ms^2)\n", (int)result->lfHfRatio, (int)(100 * result->lfHfRatio) % 100,
+              (uint32_t)result->lfPower, (uint32_t)result->hfPower);
+    ns_printf("----------------------\n");
+    // -1 where no beat had the waves
+    const int32_t intervals[] = {result->prInterval, result->qrsDuration, result->qtInterval, result->qtcInterval};
+    const char *intervalLabels[] = {"PR", "QRS", "QT", "QTc"};
+    for (size_t i = 0; i < sizeof(intervals) / sizeof(intervals[0]); i++) {
+        ns_printf("%12s: %ld ms\n", intervalLabels[i], intervals[i]);
+    }
+    ns_printf("----------------------\n");
+    for (size_t i = 0; i < HeartStageCount; i++) {
+        ns_printf("%12s: %lu cyc, %lu us\n", HK_STAGE_LABELS[i], result->perf[i].cycles, result->perf[i].usec);
+    }
+    ns_printf("----------------------\n");
+    for (uint32_t i = 0; i < hk_heads_count(); i++) {
+        uint32_t runs;
+        const hk_head_t *head = hk_head(i, &runs);
+        ns_printf("%12s: %lu runs (every %lu)\n", head->name, runs, head->period << hk_heads_backoff());
+    }
+    ns_printf("----------------------\n");
+#ifdef HK_BEAT_CACHE_ENABLE
+    uint32_t lookups, hits;
+    hk_beat_cache_stats(&lookups, &hits);
+    ns_printf("BEAT cache: %lu of %lu beats hit (model invokes saved)\n", hits, lookups);
+    ns_printf("----------------------\n");
+#endif
+#ifdef HK_BEAT_TEMPLATE_ENABLE
+    uint32_t screened, normal;
+    hk_template_stats(&screened, &normal);
+    ns_printf("BEAT template: %lu of %lu beats screened out as normal\n", normal, screened);
+    ns_printf("----------------------\n");
+#endif
+#ifdef HK_SEG_ROI_ENABLE
+    ns_printf("SEGMENTATION regions: %lu of %lu samples streamed\n", hkRoiFed, hkRoiSamples);
+    ns_printf("----------------------\n");
+#endif
+#ifdef HK_SEG_COARSE_ENABLE
+    ns_printf("SEGMENTATION coarse: %lu of %lu samples refined at full rate\n", hkCoarseFed, hkCoarseSamples);
+    ns_printf("----------------------\n");
+#endif
+#ifdef HK_HR_ONLY_ENABLE
+    ns_printf("HR-only: %lu of %lu windows escalated to the heads\n", hkHrEscalated, hkHrWindows);
+    ns_printf("----------------------\n");
+#endif
+#ifdef HK_DUTY_CYCLE_ENABLE
+    const hk_duty_state_t *duty = hk_duty_state();
+    ns_printf("Duty backoff: x%lu, %lu stable, %lu snaps in %lu windows\n", 1UL << duty->shift, duty->stable, duty->snaps, duty->windows);
+    ns_printf("----------------------\n");
+#endif
+#ifdef HK_ARR_EXIT_ENABLE
+    uint32_t exits[HK_ARR_EXIT_PARTS];
+    uint32_t cyclesSaved;
+    int numParts = arrhythmia_exits(exits, &cyclesSaved);
+    for (int i = 0; i < numParts; i++) {
+        ns_printf("ARR exit %d: %lu blocks\n", i + 1, exits[i]);
+    }
+    ns_printf("ARR saved: %lu cyc/block\n", cyclesSaved);
+    ns_printf("----------------------\n");
+#endif
+#ifdef HK_CASCADE_ENABLE
+    const HeartModel cascades[] = {HeartModelArrhythmia, HeartModelBeat};
+    const char *cascadeLabels[] = {"ARR", "BEAT"};
+    for (size_t i = 0; i < sizeof(cascades) / sizeof(cascades[0]); i++) {
+        uint32_t smallInvokes, largeInvokes;
+        if (cascade_invokes(cascades[i], &smallInvokes, &largeInvokes) == 0) {
+            ns_printf("%s cascade: small=%lu large=%lu\n", cascadeLabels[i], smallInvokes, largeInvokes);
+        }
+    }
+    ns_printf("----------------------\n");
+#endif
     return 0;
 }
@@ -12,6 +12,22 @@
 #ifndef __HEARTKIT_H
 #define __HEARTKIT_H
 
+enum HeartStage {
+    HeartStagePreprocess,
+    HeartStageArrhythmia,
+    HeartStageSegmentation,
+    HeartStagePeaks,
+    HeartStageHrv,
+    HeartStageBeat,
+    HeartStageCount
+};
+typedef enum HeartStage HeartStage;
+
+typedef struct {
+    uint32_t cycles; // DWT CYCCNT
+    uint32_t usec;   // Wall time
+} hk_stage_perf_t;
+
 typedef struct {
     uint32_t heartRate;
     uint32_t heartRhythm;
@@ -19,6 +35,19 @@ typedef struct {
     uint32_t numPacBeats;
     uint32_t numPvcBeats;
     uint32_t arrhythmia;
+    hk_stage_perf_t perf[HeartStageCount];
+    // Extended record, after perf so hosts reading the fields above still parse it
+    uint32_t numRR;        // RR intervals in the HRV window (hrv.cc)
+    float32_t sdnn;        // ms
+    float32_t rmssd;       // ms
+    float32_t pnn50;       // %
+    float32_t lfPower;     // ms^2, 0 until the first spectrum
+    float32_t hfPower;     // ms^2
+    float32_t lfHfRatio;   // 0 without HF power
+    int32_t prInterval;    // Mean intervals of the last window's beats (fiducials.cc), ms, -1 if none
+    int32_t qrsDuration;
+    int32_t qtInterval;
+    int32_t qtcInterval;
 } hk_result_t;
 
 enum HeartRhythm { HeartRhythmNormal, HeartRhythmAfib, HeartRhythmAfut };
@@ -37,9 +66,12 @@ extern const char *HK_RHYTHM_LABELS[3];
 extern const char *HK_BEAT_LABELS[3];
 extern const char *HK_HEART_RATE_LABELS[3];
 extern const char *HK_SEGMENT_LABELS[4];
+extern const char *HK_STAGE_LABELS[HeartStageCount];
 
 uint32_t
 init_heartkit();
+void
+hk_reset();
 uint32_t
 hk_preprocess(float32_t *data);
 uint32_t
@@ -47,7 +79,7 @@ ecg_rate(int32_t *peaks, uint32_t dataLen, int32_t *rrIntervals);
 uint32_t
 find_peaks_from_segments(float32_t *data, uint8_t *segMask, uint32_t dataLen, int32_t *peaks);
 uint32_t
-hk_run(float32_t *data, uint8_t *segMask, hk_result_t *result);
+hk_run(float32_t *data, uint32_t overlap, uint8_t *segMask, hk_result_t *result);
 uint32_t
 hk_print_result(hk_result_t *result);
 
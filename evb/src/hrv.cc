@@ -0,0 +1,228 @@
+/**
+ * @file hrv.cc
+ * @author Adam Page (adam.page@ambiq.com)
+ * @brief Streaming HRV: running time-domain metrics and periodic LF/HF over a sliding RR window
+ * @version 1.0
+ * @date 2023-05-02
+ *
+ * @copyright Copyright (c) 2023
+ *
+ * The HRV head used to reduce a window's RR intervals to a mean rate, and SDNN, RMSSD, pNN50 and the
+ * LF/HF balance were recomputed on the PC from raw uploads. Here every new RR interval updates a ring
+ * of the last HK_HRV_WINDOW intervals. Each entry keeps its RR, its squared successive difference and
+ * whether that difference passes HK_HRV_NN_MS, so the running sums behind SDNN, RMSSD and pNN50 add
+ * the new entry and subtract the one it replaces in O(1). The sums are integers in samples and never
+ * drift. Every HK_HRV_SPECTRUM_BEATS intervals, once the window spans HK_HRV_FFT_LEN samples at
+ * HK_HRV_RESAMPLE_HZ, the RR tachogram (each RR at its closing R peak) is resampled with cubic Hermite
+ * segments, which keep the HF band that linear resampling attenuates. Its mean is removed, a Hann
+ * window applied, and arm_rfft_fast_f32 gives the LF and HF band powers. Intervals out of range or off
+ * the previous RR by more than HK_HRV_RR_TOL (ectopic, missed or extra beats) are left out, the
+ * successive difference across one is not counted, and the tachogram interpolates over it.
+ */
+#include <cmath>
+#include <cstdlib>
+
+#include "constants.h"
+#include "hrv.h"
+
+#define HRV_DIFF (1 << 0)
+#define HRV_NN50 (1 << 1)
+// Samples between tachogram points and the span the tachogram covers
+#define HRV_STEP ((float32_t)SAMPLE_RATE / HK_HRV_RESAMPLE_HZ)
+#define HRV_SPAN ((HK_HRV_FFT_LEN - 1) * HRV_STEP)
+#define HRV_MS (1000.0f / SAMPLE_RATE)
+
+typedef struct {
+    uint32_t end;  // R peak closing the interval
+    int32_t rr;    // Samples
+    uint32_t d2;   // Squared difference to the previous RR, 0 without one
+    uint8_t flags; // HRV_DIFF, HRV_NN50
+} hrv_entry_t;
+
+static hrv_entry_t hkHrvRing[HK_HRV_WINDOW];
+static uint32_t hkHrvHead = 0;
+static uint32_t hkHrvCount = 0;
+static int64_t hkHrvSum = 0;
+static int64_t hkHrvSumSq = 0;
+static uint64_t hkHrvSumD2 = 0;
+static uint32_t hkHrvDiffs = 0;
+static uint32_t hkHrvNN50 = 0;
+// Last R peak, last RR in range (0 if none) and whether it joined the window
+static bool hkHrvHasPeak = false;
+static uint32_t hkHrvLastPeak = 0;
+static int32_t hkHrvPrevRR = 0;
+static bool hkHrvPrevAccepted = false;
+static uint32_t hkHrvSinceSpectrum = 0;
+static float32_t hkHrvLf = 0;
+static float32_t hkHrvHf = 0;
+
+static float32_t hkHrvHann[HK_HRV_FFT_LEN];
+static float32_t hkHrvHannPower = 0;
+static float32_t hkHrvTacho[HK_HRV_FFT_LEN];
+static float32_t hkHrvSpectrum[HK_HRV_FFT_LEN];
+static arm_rfft_fast_instance_f32 hkHrvFft;
+
+uint32_t
+hk_hrv_init(void) {
+    hkHrvHannPower = 0;
+    for (uint32_t i = 0; i < HK_HRV_FFT_LEN; i++) {
+        hkHrvHann[i] = 0.5f - 0.5f * cosf(2.0f * PI * i / (HK_HRV_FFT_LEN - 1));
+        hkHrvHannPower += hkHrvHann[i] * hkHrvHann[i];
+    }
+    hk_hrv_reset();
+    return arm_rfft_fast_init_f32(&hkHrvFft, HK_HRV_FFT_LEN) == ARM_MATH_SUCCESS ? 0 : 1;
+}
+
+void
+hk_hrv_reset(void) {
+    hkHrvHead = 0;
+    hkHrvCount = 0;
+    hkHrvSum = 0;
+    hkHrvSumSq = 0;
+    hkHrvSumD2 = 0;
+    hkHrvDiffs = 0;
+    hkHrvNN50 = 0;
+    hkHrvHasPeak = false;
+    hkHrvLastPeak = 0;
+    hkHrvPrevRR = 0;
+    hkHrvPrevAccepted = false;
+    hkHrvSinceSpectrum = 0;
+    hkHrvLf = 0;
+    hkHrvHf = 0;
+}
+
+void
+hk_hrv_break(void) {
+    hkHrvHasPeak = false;
+    hkHrvPrevRR = 0;
+    hkHrvPrevAccepted = false;
+}
+
+static const hrv_entry_t *
+hrv_entry(uint32_t i) {
+    /**
+     * @brief Entry i of the window, oldest first
+     */
+    return &hkHrvRing[(hkHrvHead + HK_HRV_WINDOW - hkHrvCount + i) % HK_HRV_WINDOW];
+}
+
+static bool
+hrv_spectrum(void) {
+    /**
+     * @brief LF and HF power of the last HRV_SPAN samples of the tachogram
+     * @return False if the window does not span it yet
+     */
+    const uint32_t tEnd = hrv_entry(hkHrvCount - 1)->end;
+    if ((float32_t)(tEnd - hrv_entry(0)->end) < HRV_SPAN) {
+        return false;
+    }
+    // Resample the RR at their closing peaks with cubic Hermite segments, oldest grid point first. Times
+    // are ages in samples before tEnd, and tangents are central differences over the neighbours.
+    uint32_t k = 0;
+    float32_t mean = 0;
+    for (uint32_t j = 0; j < HK_HRV_FFT_LEN; j++) {
+        const float32_t age = (HK_HRV_FFT_LEN - 1 - j) * HRV_STEP;
+        while ((float32_t)(tEnd - hrv_entry(k + 1)->end) > age) {
+            k++;
+        }
+        const hrv_entry_t *p[4] = {hrv_entry(k > 0 ? k - 1 : k), hrv_entry(k), hrv_entry(k + 1),
+                                   hrv_entry(k + 2 < hkHrvCount ? k + 2 : k + 1)};
+        float32_t t[4], y[4];
+        for (int i = 0; i < 4; i++) {
+            t[i] = -(float32_t)(tEnd - p[i]->end);
+            y[i] = HRV_MS * p[i]->rr;
+        }
+        const float32_t h = t[2] - t[1];
+        const float32_t s = h > 0 ? (-age - t[1]) / h : 1.0f;
+        const float32_t m1 = t[2] > t[0] ? h * (y[2] - y[0]) / (t[2] - t[0]) : 0;
+        const float32_t m2 = t[3] > t[1] ? h * (y[3] - y[1]) / (t[3] - t[1]) : 0;
+        const float32_t s2 = s * s, s3 = s2 * s;
+        hkHrvTacho[j] = (2 * s3 - 3 * s2 + 1) * y[1] + (s3 - 2 * s2 + s) * m1 + (-2 * s3 + 3 * s2) * y[2] + (s3 - s2) * m2;
+        mean += hkHrvTacho[j] / HK_HRV_FFT_LEN;
+    }
+    for (uint32_t j = 0; j < HK_HRV_FFT_LEN; j++) {
+        hkHrvTacho[j] = (hkHrvTacho[j] - mean) * hkHrvHann[j];
+    }
+    // Packed output: bin k at [2k, 2k + 1] from k = 1. One-sided bin power 2|X|^2 / (N sum(w^2)) in ms^2.
+    arm_rfft_fast_f32(&hkHrvFft, hkHrvTacho, hkHrvSpectrum, 0);
+    const float32_t df = (float32_t)HK_HRV_RESAMPLE_HZ / HK_HRV_FFT_LEN;
+    const float32_t scale = 2.0f / (HK_HRV_FFT_LEN * hkHrvHannPower);
+    hkHrvLf = 0;
+    hkHrvHf = 0;
+    for (uint32_t i = 1; i < HK_HRV_FFT_LEN / 2; i++) {
+        const float32_t f = i * df;
+        const float32_t p = scale * (hkHrvSpectrum[2 * i] * hkHrvSpectrum[2 * i] + hkHrvSpectrum[2 * i + 1] * hkHrvSpectrum[2 * i + 1]);
+        if (f >= HK_HRV_LF_LO && f < HK_HRV_LF_HI) {
+            hkHrvLf += p;
+        } else if (f >= HK_HRV_LF_HI && f < HK_HRV_HF_HI) {
+            hkHrvHf += p;
+        }
+    }
+    return true;
+}
+
+bool
+hk_hrv_push(uint32_t peak) {
+    if (hkHrvHasPeak && peak <= hkHrvLastPeak + HK_HRV_RR_MIN / 2) {
+        return false;
+    }
+    const bool hadPeak = hkHrvHasPeak;
+    const int32_t rr = (int32_t)(peak - hkHrvLastPeak);
+    hkHrvHasPeak = true;
+    hkHrvLastPeak = peak;
+    if (!hadPeak || rr < HK_HRV_RR_MIN || rr > HK_HRV_RR_MAX) {
+        hkHrvPrevAccepted = false;
+        return false;
+    }
+    const int32_t prevRR = hkHrvPrevRR;
+    hkHrvPrevRR = rr;
+    if (prevRR != 0 && abs(rr - prevRR) > HK_HRV_RR_TOL * prevRR) {
+        hkHrvPrevAccepted = false;
+        return false;
+    }
+    hrv_entry_t entry = {peak, rr, 0, 0};
+    if (hkHrvPrevAccepted) {
+        const int32_t d = rr - prevRR;
+        entry.d2 = (uint32_t)(d * d);
+        entry.flags = HRV_DIFF | (abs(d) * 1000 > HK_HRV_NN_MS * SAMPLE_RATE ? HRV_NN50 : 0);
+    }
+    hkHrvPrevAccepted = true;
+    // The oldest entry leaves a full window
+    hrv_entry_t *slot = &hkHrvRing[hkHrvHead];
+    if (hkHrvCount == HK_HRV_WINDOW) {
+        hkHrvSum -= slot->rr;
+        hkHrvSumSq -= (int64_t)slot->rr * slot->rr;
+        if (slot->flags & HRV_DIFF) {
+            hkHrvSumD2 -= slot->d2;
+            hkHrvDiffs -= 1;
+            hkHrvNN50 -= (slot->flags & HRV_NN50) ? 1 : 0;
+        }
+    } else {
+        hkHrvCount += 1;
+    }
+    *slot = entry;
+    hkHrvHead = (hkHrvHead + 1) % HK_HRV_WINDOW;
+    hkHrvSum += rr;
+    hkHrvSumSq += (int64_t)rr * rr;
+    if (entry.flags & HRV_DIFF) {
+        hkHrvSumD2 += entry.d2;
+        hkHrvDiffs += 1;
+        hkHrvNN50 += (entry.flags & HRV_NN50) ? 1 : 0;
+    }
+    hkHrvSinceSpectrum += 1;
+    if (hkHrvSinceSpectrum >= HK_HRV_SPECTRUM_BEATS && hrv_spectrum()) {
+        hkHrvSinceSpectrum = 0;
+    }
+    return true;
+}
+
+void
+hk_hrv_metrics(hk_hrv_t *hrv) {
+    const int64_t n = hkHrvCount;
+    hrv->numRR = hkHrvCount;
+    hrv->sdnn = n > 1 ? HRV_MS * sqrtf((float32_t)(n * hkHrvSumSq - hkHrvSum * hkHrvSum) / (float32_t)(n * (n - 1))) : 0;
+    hrv->rmssd = hkHrvDiffs ? HRV_MS * sqrtf((float32_t)hkHrvSumD2 / hkHrvDiffs) : 0;
+    hrv->pnn50 = hkHrvDiffs ? 100.0f * hkHrvNN50 / hkHrvDiffs : 0;
+    hrv->lfPower = hkHrvLf;
+    hrv->hfPower = hkHrvHf;
+}
@@ -0,0 +1,63 @@
+/**
+ * @file hrv.h
+ * @author Adam Page (adam.page@ambiq.com)
+ * @brief Streaming HRV: running time-domain metrics and periodic LF/HF over a sliding RR window
+ * @version 1.0
+ * @date 2023-05-02
+ *
+ * @copyright Copyright (c) 2023
+ *
+ */
+#ifndef __HRV_H
+#define __HRV_H
+
+#include "arm_math.h"
+#include <stdint.h>
+
+typedef struct {
+    uint32_t numRR;    // RR intervals in the window
+    float32_t sdnn;    // Standard deviation of the RR intervals (ms)
+    float32_t rmssd;   // Root mean square of successive differences (ms)
+    float32_t pnn50;   // Successive differences over HK_HRV_NN_MS (%)
+    float32_t lfPower; // HK_HRV_LF_LO to HK_HRV_LF_HI power (ms^2), 0 until the first spectrum
+    float32_t hfPower; // HK_HRV_LF_HI to HK_HRV_HF_HI power (ms^2)
+} hk_hrv_t;
+
+/**
+ * @brief Set up the FFT of the LF/HF spectrum
+ * @return 0 on success
+ */
+uint32_t
+hk_hrv_init(void);
+
+/**
+ * @brief Empty the window (new patient or discontinuous signal)
+ */
+void
+hk_hrv_reset(void);
+
+/**
+ * @brief Mark a gap in the signal (windows that are not contiguous). The window keeps its intervals,
+ * but the next peak starts a new run: no RR or successive difference spans the gap.
+ */
+void
+hk_hrv_break(void);
+
+/**
+ * @brief Feed an R peak. Peaks within HK_HRV_RR_MIN / 2 of the last one are the same beat seen again
+ * (overlapping windows) and ignored. The RR to the last peak joins the window in O(1) unless it is out
+ * of range or off the previous RR by more than HK_HRV_RR_TOL, and every HK_HRV_SPECTRUM_BEATS
+ * intervals the LF/HF spectrum is recomputed.
+ * @param peak Absolute sample index of the R peak since reset, ascending
+ * @return True if an RR interval joined the window
+ */
+bool
+hk_hrv_push(uint32_t peak);
+
+/**
+ * @brief Current metrics of the window
+ */
+void
+hk_hrv_metrics(hk_hrv_t *hrv);
+
+#endif // __HRV_H
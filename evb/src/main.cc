@@ -19,11 +19,15 @@
 #include "ns_peripherals_button.h"
 #include "ns_peripherals_power.h"
 #include "ns_rpc_generic_data.h"
+#include "ns_timer.h"
 #include "ns_usb.h"
 // Locals
 #include "constants.h"
 #include "heartkit.h"
 #include "main.h"
+#include "model.h"
+#include "ns-core/ns_malloc_pool.h"
+#include "rpc_transport.h"
 #include "sensor.h"
 
 // Application globals
@@ -31,6 +35,25 @@ static uint32_t numSamples = 0;
 
 static float32_t hkData[HK_DATA_LEN + SAMPLE_RATE];
 static uint8_t hkSegMask[HK_DATA_LEN];
+// Leading samples of hkData the window shares with the last one, and the raw tail the next one starts with
+static uint32_t hkOverlap = 0;
+static uint32_t hkTailLen = 0;
+#if HK_WINDOW_STEP < HK_DATA_LEN
+static float32_t hkTail[HK_DATA_LEN - HK_WINDOW_STEP];
+// Sensor samples drained between windows, so the next window follows the tail without a gap. The
+// timer interrupt owns the sensor while hkDraining is set.
+static float32_t hkPending[HK_WINDOW_STEP + SENSOR_MAX_SAMPLES];
+static volatile uint32_t hkPendingLen = 0;
+static volatile bool hkPendingGap = false;
+static volatile bool hkDraining = false;
+static void
+drain_sensor(ns_timer_config_t *timer);
+static ns_timer_config_t hkDrainTimer = {.api = &ns_timer_V1_0_0,
+                                         .timer = NS_TIMER_INTERRUPT,
+                                         .enableInterrupt = true,
+                                         .periodInMicroseconds = SENSOR_DRAIN_USEC,
+                                         .callback = drain_sensor};
+#endif
 static hk_result_t hkResults;
 
 static bool usbAvailable = false;
@@ -149,6 +172,10 @@ stop_collecting(void) {
      * @brief Disable sensor
      *
      */
+#if HK_WINDOW_STEP < HK_DATA_LEN
+    am_hal_timer_stop(hkDrainTimer.timer);
+    hkDraining = false;
+#endif
     if (collectMode == SENSOR_DATA_COLLECT) {
         stop_sensor();
     }
@@ -208,7 +235,7 @@ send_samples_to_pc(float32_t *samples, uint32_t offset, uint32_t numSamples) {
     };
     dataBlock commandBlock = {
         .length = offset, .dType = float32_e, .description = rpcSendSamplesDesc, .cmd = generic_cmd, .buffer = binaryBlock};
-    ns_rpc_data_sendBlockToPC(&commandBlock);
+    rpc_send_block_to_pc(&commandBlock);
 }
 
 void
@@ -226,7 +253,7 @@ send_mask_to_pc(uint8_t *mask, uint32_t offset, uint32_t maskLen) {
     };
     dataBlock commandBlock = {
         .length = offset, .dType = uint8_e, .description = rpcSendMaskDesc, .cmd = generic_cmd, .buffer = binaryBlock};
-    ns_rpc_data_sendBlockToPC(&commandBlock);
+    rpc_send_block_to_pc(&commandBlock);
 }
 
 void
@@ -244,9 +271,90 @@ send_results_to_pc(hk_result_t *result) {
         .dataLength = sizeof(hk_result_t),
     };
     dataBlock commandBlock = {.length = 1, .dType = uint32_e, .description = rpcSendResultsDesc, .cmd = generic_cmd, .buffer = binaryBlock};
-    ns_rpc_data_sendBlockToPC(&commandBlock);
+    rpc_send_block_to_pc(&commandBlock);
 }
 
+void
+send_profile_to_pc() {
+    /**
+     * @brief Send per-operator profile tables to PC (block length = model << 16 | first row)
+     */
+#ifdef HK_PROFILE_ENABLE
+    static char rpcSendProfileDesc[] = "SEND_PROFILE";
+    const hk_op_profile_t *ops;
+    uint32_t numOps;
+    if (!usbAvailable) {
+        return;
+    }
+    for (uint32_t m = 0; m < HeartModelCount; m++) {
+        numOps = model_op_profile((HeartModel)m, &ops);
+        for (uint32_t i = 0; i < numOps; i += HK_PROFILE_ROWS_PER_BLOCK) {
+            binary_t binaryBlock = {
+                .data = (uint8_t *)&ops[i],
+                .dataLength = MIN(numOps - i, HK_PROFILE_ROWS_PER_BLOCK) * sizeof(hk_op_profile_t),
+            };
+            dataBlock commandBlock = {
+                .length = (m << 16) | i, .dType = uint8_e, .description = rpcSendProfileDesc, .cmd = generic_cmd, .buffer = binaryBlock};
+            rpc_send_block_to_pc(&commandBlock);
+        }
+    }
+    model_op_profile_reset();
+#endif
+}
+
+#if HK_WINDOW_STEP < HK_DATA_LEN
+static void
+drain_sensor(ns_timer_config_t *timer) {
+    /**
+     * @brief Move the sensor FIFO to the pending samples before it rolls over (timer interrupt)
+     *
+     */
+    if (!hkDraining) {
+        return;
+    }
+    const uint32_t newSamples = capture_sensor_data(&hkPending[hkPendingLen]);
+    if (hkPendingLen + newSamples > HK_WINDOW_STEP) {
+        // The next window is late and the tail no longer fits: keep the newest samples and start after a gap
+        memmove(hkPending, &hkPending[hkPendingLen], newSamples * sizeof(float32_t));
+        hkPendingLen = 0;
+        hkPendingGap = true;
+    }
+    hkPendingLen += newSamples;
+}
+
+void
+drain_collecting(void) {
+    /**
+     * @brief Keep the sensor running after a window and drain it until the next one
+     *
+     */
+    hkPendingLen = 0;
+    hkPendingGap = false;
+    hkDraining = true;
+    am_hal_timer_clear(hkDrainTimer.timer);
+}
+
+void
+resume_collecting(void) {
+    /**
+     * @brief Start the window from the tail of the last one and the samples drained since, and show
+     * them to the PC where they now sit
+     *
+     */
+    am_hal_timer_stop(hkDrainTimer.timer);
+    hkDraining = false;
+    if (hkPendingGap) {
+        hkTailLen = 0;
+    }
+    memcpy(hkData, hkTail, hkTailLen * sizeof(float32_t));
+    memcpy(&hkData[hkTailLen], hkPending, hkPendingLen * sizeof(float32_t));
+    numSamples = hkTailLen + hkPendingLen;
+    if (numSamples) {
+        send_samples_to_pc(hkData, 0, numSamples);
+    }
+}
+#endif
+
 uint32_t
 collect_samples() {
     /**
@@ -306,6 +414,10 @@ setup() {
     err |= init_sensor();
     err |= init_heartkit();
     err |= ns_peripheral_button_init(&button_config);
+#if HK_WINDOW_STEP < HK_DATA_LEN
+    err |= ns_timer_init(&hkDrainTimer);
+    am_hal_timer_clear_stop(hkDrainTimer.timer);
+#endif
     ns_printf("♥️ HeartKit Demo\n\n");
     ns_printf("Please select data collection options:\n\n\t1. BTN1=sensor\n\t2. BTN2=client\n");
 }
@@ -320,6 +432,10 @@ loop() {
     switch (state) {
     case IDLE_STATE:
         if (sensorCollectBtnPressed | clientCollectBtnPressed) {
+            // Rhythm state carries across recordings of one source only
+            if (collectMode != (sensorCollectBtnPressed ? SENSOR_DATA_COLLECT : CLIENT_DATA_COLLECT)) {
+                hk_reset();
+            }
             collectMode = sensorCollectBtnPressed ? SENSOR_DATA_COLLECT : CLIENT_DATA_COLLECT;
             wakeup();
             state = START_COLLECT_STATE;
@@ -333,7 +449,17 @@ loop() {
         print_to_pc("COLLECT_STATE\n");
         sensorCollectBtnPressed = false; // DEBOUNCE
         clientCollectBtnPressed = false; // DEBOUNCE
+#if HK_WINDOW_STEP < HK_DATA_LEN
+        if (hkDraining) {
+            resume_collecting();
+        } else {
+            hkTailLen = 0;
+            start_collecting();
+        }
+#else
         start_collecting();
+#endif
+        hkOverlap = hkTailLen;
         state = COLLECT_STATE;
         break;
 
@@ -345,20 +471,36 @@ loop() {
         break;
 
     case STOP_COLLECT_STATE:
+#if HK_WINDOW_STEP < HK_DATA_LEN
+        // The sensor signal is contiguous, so the next window continues it. PC frames are drawn
+        // independently and never overlap.
+        if (collectMode == SENSOR_DATA_COLLECT) {
+            drain_collecting();
+        } else {
+            stop_collecting();
+        }
+#else
         stop_collecting();
+#endif
         am_hal_pwrctrl_mcu_mode_select(AM_HAL_PWRCTRL_MCU_MODE_HIGH_PERFORMANCE);
         state = PREPROCESS_STATE;
         break;
 
     case PREPROCESS_STATE:
         print_to_pc("PREPROCESS_STATE\n");
+#if HK_WINDOW_STEP < HK_DATA_LEN
+        if (collectMode == SENSOR_DATA_COLLECT) {
+            memcpy(hkTail, &hkData[HK_WINDOW_STEP], sizeof(hkTail));
+            hkTailLen = HK_DATA_LEN - HK_WINDOW_STEP;
+        }
+#endif
         hk_preprocess(hkData);
         state = INFERENCE_STATE;
         break;
 
     case INFERENCE_STATE:
         print_to_pc("INFERENCE_STATE\n");
-        app_err = hk_run(hkData, hkSegMask, &hkResults);
+        app_err = hk_run(hkData, hkOverlap, hkSegMask, &hkResults);
         am_hal_pwrctrl_mcu_mode_select(AM_HAL_PWRCTRL_MCU_MODE_LOW_POWER);
         state = app_err == 1 ? FAIL_STATE : DISPLAY_STATE;
         break;
@@ -369,6 +511,10 @@ loop() {
             send_mask_to_pc(&hkSegMask[i], i, maskLen);
         }
         send_results_to_pc(&hkResults);
+        send_profile_to_pc();
+#ifdef HK_PROFILE_ENABLE
+        ns_malloc_pool_print();
+#endif
         ns_delay_us(10000);
         print_to_pc("DISPLAY_STATE\n");
         ns_delay_us(DISPLAY_LEN_USEC);
@@ -376,6 +522,7 @@ loop() {
         if (sensorCollectBtnPressed | clientCollectBtnPressed) {
             sensorCollectBtnPressed = false;
             clientCollectBtnPressed = false;
+            stop_collecting();
             state = IDLE_STATE;
         } else {
             state = START_COLLECT_STATE;
@@ -384,6 +531,11 @@ loop() {
 
     case FAIL_STATE:
         ns_printf("FAIL_STATE err=%d\n", app_err);
+        // Exhausted classes fall back to the heap, which may be what failed
+        ns_malloc_pool_print();
+        hk_reset();
+        stop_collecting();
+        hkTailLen = 0;
         state = IDLE_STATE;
         app_err = 0;
         break;
@@ -0,0 +1,418 @@
+/**
+ * @file mbconv_kernels.cc
+ * @author Adam Page (adam.page@ambiq.com)
+ * @brief Fused int8 MBConv custom ops for TFLM
+ * @version 1.0
+ * @date 2023-05-02
+ *
+ * @copyright Copyright (c) 2023
+ *
+ * Each MBConv block of the HeartKit heads runs as DEPTHWISE_CONV_2D -> [MAX_POOL_2D] -> SE
+ * (MEAN -> CONV_2D -> CONV_2D -> MINIMUM -> RELU -> MUL) -> CONV_2D -> [ADD]. Unfused, the depthwise,
+ * pooled, SE scaled and projected tensors are all materialized in the arena. host/mbconv_fuser.cc
+ * rewrites each block into two custom ops around the (tiny) SE layers:
+ *
+ *   HK_MBCONV_SQUEEZE: depthwise -> pool -> mean, accumulating the mean tile by tile.
+ *   HK_MBCONV: depthwise -> pool -> SE scale -> projection -> residual, tile by tile.
+ *
+ * The depthwise conv is computed twice (cheap next to the projection) so that only the block input
+ * and output live in the arena, plus a scratch tile of HK_MBCONV_TILE_LEN positions. The per-channel
+ * requantization of the depthwise and projection convs is precomputed by the fuser into a constant
+ * tensor, so it stays in flash rather than in persistent arena. Every stage requantizes exactly like
+ * the TFLM kernel it replaces, so fused models are bit-identical.
+ */
+#include <cstddef>
+#include <cstring>
+
+#include "tensorflow/lite/c/builtin_op_data.h"
+#include "tensorflow/lite/kernels/internal/common.h"
+#include "tensorflow/lite/kernels/internal/quantization_util.h"
+#include "tensorflow/lite/kernels/kernel_util.h"
+#include "tensorflow/lite/kernels/padding.h"
+#include "tensorflow/lite/micro/kernels/kernel_util.h"
+#include "tensorflow/lite/micro/micro_context.h"
+
+#include "conv1d_kernels.h"
+#include "mbconv_kernels.h"
+
+typedef struct {
+    hk_mbconv_options_t opts;
+    tflite::OpDataConv dw; // Depthwise quantization and padding
+    int32_t inLen;         // Block input width
+    int32_t channels;      // Block input channels
+    int32_t kLen;          // Depthwise filter width
+    int32_t dwLen;         // Depthwise output width
+    int32_t blockLen;      // Pooled (or depthwise) output width
+    int32_t tileRows;      // Depthwise rows per tile
+    int32_t poolPadding;
+    int32_t poolMin;
+    int32_t poolMax;
+    int scratchIdx;
+} mbconv_block_t;
+
+typedef struct {
+    mbconv_block_t block;
+    int32_t meanMultiplier;
+    int meanShift;
+    int32_t meanZeroPoint;
+} mbconv_squeeze_data_t;
+
+typedef struct {
+    mbconv_block_t block;
+    tflite::OpDataConv proj; // Projection quantization
+    int32_t outCh;           // Projection output channels
+    int32_t seZeroPoint;
+    int32_t mulMultiplier;
+    int mulShift;
+    int32_t mulMin;
+    int32_t mulMax;
+    int32_t addInputOffset;
+    int32_t addProjOffset;
+    int32_t addOutputOffset;
+    int32_t addInputMultiplier;
+    int addInputShift;
+    int32_t addProjMultiplier;
+    int addProjShift;
+    int32_t addOutputMultiplier;
+    int addOutputShift;
+    int32_t addMin;
+    int32_t addMax;
+} mbconv_op_data_t;
+
+enum { kMbconvInput = 0, kMbconvDwFilter, kMbconvDwBias, kMbconvRequant, kMbconvSeScale, kMbconvProjFilter, kMbconvProjBias };
+
+static void
+quant_tensor(TfLiteTensor *tensor, float scale, int32_t zeroPoint) {
+    /**
+     * @brief Stand-in for a tensor the fused op does not materialize (only its quantization is read)
+     */
+    memset(tensor, 0, sizeof(TfLiteTensor));
+    tensor->type = kTfLiteInt8;
+    tensor->params.scale = scale;
+    tensor->params.zero_point = zeroPoint;
+    tensor->quantization.type = kTfLiteAffineQuantization;
+}
+
+//*****************************************************************************
+//*** Tiles
+static int8_t *
+mbconv_tile(const mbconv_block_t *block, int32_t p0, int32_t p1, const int8_t *input, const int8_t *filter, const int32_t *bias,
+            int8_t *tile) {
+    /**
+     * @brief Compute block rows [p0, p1) (depthwise, then max pool if present) into the tile buffer
+     * @return Block rows [p1 - p0, channels]
+     */
+    const hk_mbconv_options_t &opts = block->opts;
+    const int32_t channels = block->channels;
+    if (opts.poolSize == 0) {
+        depthwise_conv1d_s8(block->dw, opts.dwStride, block->inLen, channels, block->kLen, p0, p1, input, filter, bias, tile);
+        return tile;
+    }
+    int32_t d0 = p0 * opts.poolStride - block->poolPadding;
+    int32_t d1 = (p1 - 1) * opts.poolStride - block->poolPadding + opts.poolSize;
+    d0 = d0 < 0 ? 0 : d0;
+    d1 = d1 > block->dwLen ? block->dwLen : d1;
+    depthwise_conv1d_s8(block->dw, opts.dwStride, block->inLen, channels, block->kLen, d0, d1, input, filter, bias, tile);
+    int8_t *pooled = &tile[block->tileRows * channels];
+    for (int32_t p = p0; p < p1; p++) {
+        int32_t ws = p * opts.poolStride - block->poolPadding;
+        int32_t we = ws + opts.poolSize;
+        ws = ws < 0 ? 0 : ws;
+        we = we > block->dwLen ? block->dwLen : we;
+        for (int32_t c = 0; c < channels; c++) {
+            int32_t val = INT8_MIN;
+            for (int32_t d = ws; d < we; d++) {
+                int32_t v = tile[(d - d0) * channels + c];
+                val = v > val ? v : val;
+            }
+            val = val < block->poolMin ? block->poolMin : val;
+            val = val > block->poolMax ? block->poolMax : val;
+            pooled[(p - p0) * channels + c] = (int8_t)val;
+        }
+    }
+    return pooled;
+}
+
+//*****************************************************************************
+//*** Kernel callbacks
+static void *
+mbconv_alloc(TfLiteContext *context, const char *buffer, size_t length, size_t size) {
+    /**
+     * @brief Allocate op data of size bytes starting with an mbconv_block_t and copy in the custom options
+     */
+    mbconv_block_t *block = (mbconv_block_t *)context->AllocatePersistentBuffer(context, size);
+    if (block == nullptr) {
+        return nullptr;
+    }
+    memset(block, 0, size);
+    // Custom options are not aligned within the flatbuffer. Version 1 ends before projInt4.
+    if (buffer != nullptr && length >= offsetof(hk_mbconv_options_t, projInt4)) {
+        memcpy(&block->opts, buffer, length < sizeof(hk_mbconv_options_t) ? length : sizeof(hk_mbconv_options_t));
+    }
+    return block;
+}
+
+static void *
+mbconv_squeeze_init(TfLiteContext *context, const char *buffer, size_t length) {
+    return mbconv_alloc(context, buffer, length, sizeof(mbconv_squeeze_data_t));
+}
+
+static void *
+mbconv_init(TfLiteContext *context, const char *buffer, size_t length) {
+    return mbconv_alloc(context, buffer, length, sizeof(mbconv_op_data_t));
+}
+
+static TfLiteStatus
+mbconv_prepare_block(TfLiteContext *context, TfLiteNode *node, mbconv_block_t *block, int32_t requantLen, const int32_t **requant,
+                     size_t *scratchBytes) {
+    /**
+     * @brief Depthwise and pool params shared by both ops
+     * @param requantLen Minimum length of the requantization tensor beyond the depthwise part
+     * @param requant Returns the requantization data following the depthwise part
+     */
+    const hk_mbconv_options_t &opts = block->opts;
+    tflite::MicroContext *microContext = tflite::GetMicroContext(context);
+    TF_LITE_ENSURE(context, opts.version == 1 || opts.version == HK_MBCONV_OPTIONS_VERSION);
+    TfLiteTensor *input = microContext->AllocateTempInputTensor(node, kMbconvInput);
+    TfLiteTensor *filter = microContext->AllocateTempInputTensor(node, kMbconvDwFilter);
+    TfLiteTensor *requantTensor = microContext->AllocateTempInputTensor(node, kMbconvRequant);
+    TF_LITE_ENSURE(context, input != nullptr && filter != nullptr && requantTensor != nullptr);
+    TF_LITE_ENSURE_TYPES_EQ(context, input->type, kTfLiteInt8);
+    TF_LITE_ENSURE_TYPES_EQ(context, filter->type, kTfLiteInt8);
+    TF_LITE_ENSURE_TYPES_EQ(context, requantTensor->type, kTfLiteInt32);
+    TF_LITE_ENSURE(context, tflite::IsConstantTensor(requantTensor));
+    TF_LITE_ENSURE(context, input->dims->size == 4 && input->dims->data[0] == 1 && input->dims->data[1] == 1);
+    TF_LITE_ENSURE(context, filter->dims->size == 4 && filter->dims->data[1] == 1 && filter->dims->data[3] == input->dims->data[3]);
+    block->inLen = input->dims->data[2];
+    block->channels = input->dims->data[3];
+    block->kLen = filter->dims->data[2];
+    // HK_MBCONV_SQUEEZE shares the tensor of its HK_MBCONV
+    TF_LITE_ENSURE(context, tflite::NumElements(requantTensor) >= 2 * block->channels + requantLen);
+
+    int outHeight;
+    block->dw.padding = tflite::ComputePaddingHeightWidth(1, opts.dwStride, 1, 1, 1, block->inLen, 1, block->kLen,
+                                                          (TfLitePadding)opts.dwPadding, &outHeight, &block->dwLen);
+    // Layout: depthwise multipliers, depthwise shifts, then op specific (flash resident)
+    block->dw.per_channel_output_multiplier = requantTensor->data.i32;
+    block->dw.per_channel_output_shift = &requantTensor->data.i32[block->channels];
+    *requant = &requantTensor->data.i32[2 * block->channels];
+    TfLiteTensor dwOutput;
+    quant_tensor(&dwOutput, opts.dwScale, opts.dwZeroPoint);
+    TF_LITE_ENSURE_STATUS(tflite::CalculateActivationRangeQuantized(context, (TfLiteFusedActivation)opts.dwActivation, &dwOutput,
+                                                                     &block->dw.output_activation_min, &block->dw.output_activation_max));
+    block->dw.input_zero_point = input->params.zero_point;
+    block->dw.filter_zero_point = filter->params.zero_point;
+    block->dw.output_zero_point = opts.dwZeroPoint;
+
+    if (opts.poolSize) {
+        TfLitePaddingValues padding = tflite::ComputePaddingHeightWidth(1, opts.poolStride, 1, 1, 1, block->dwLen, 1, opts.poolSize,
+                                                                        (TfLitePadding)opts.poolPadding, &outHeight, &block->blockLen);
+        block->poolPadding = padding.width;
+        TF_LITE_ENSURE_STATUS(tflite::CalculateActivationRangeQuantized(context, (TfLiteFusedActivation)opts.poolActivation, &dwOutput,
+                                                                         &block->poolMin, &block->poolMax));
+        block->tileRows = (HK_MBCONV_TILE_LEN - 1) * opts.poolStride + opts.poolSize;
+        *scratchBytes = (block->tileRows + HK_MBCONV_TILE_LEN) * block->channels;
+    } else {
+        block->blockLen = block->dwLen;
+        block->tileRows = HK_MBCONV_TILE_LEN;
+        *scratchBytes = block->tileRows * block->channels;
+    }
+    microContext->DeallocateTempTfLiteTensor(input);
+    microContext->DeallocateTempTfLiteTensor(filter);
+    microContext->DeallocateTempTfLiteTensor(requantTensor);
+    return kTfLiteOk;
+}
+
+static TfLiteStatus
+mbconv_squeeze_prepare(TfLiteContext *context, TfLiteNode *node) {
+    mbconv_squeeze_data_t *data = (mbconv_squeeze_data_t *)node->user_data;
+    TF_LITE_ENSURE(context, data != nullptr);
+    TF_LITE_ENSURE_EQ(context, node->inputs->size, 4);
+    const int32_t *requant;
+    size_t scratchBytes;
+    TF_LITE_ENSURE_STATUS(mbconv_prepare_block(context, node, &data->block, 0, &requant, &scratchBytes));
+
+    tflite::MicroContext *microContext = tflite::GetMicroContext(context);
+    TfLiteTensor *output = microContext->AllocateTempOutputTensor(node, 0);
+    TF_LITE_ENSURE(context, output != nullptr);
+    TF_LITE_ENSURE_TYPES_EQ(context, output->type, kTfLiteInt8);
+    TF_LITE_ENSURE_EQ(context, tflite::NumElements(output), data->block.channels);
+    // Same multiplier as MEAN (reduce_common.cc)
+    tflite::QuantizeMultiplier((double)data->block.opts.dwScale / (double)output->params.scale, &data->meanMultiplier, &data->meanShift);
+    data->meanZeroPoint = output->params.zero_point;
+    microContext->DeallocateTempTfLiteTensor(output);
+
+    // Channel accumulators go first to keep them aligned
+    return context->RequestScratchBufferInArena(context, data->block.channels * sizeof(int32_t) + scratchBytes, &data->block.scratchIdx);
+}
+
+static TfLiteStatus
+mbconv_prepare(TfLiteContext *context, TfLiteNode *node) {
+    mbconv_op_data_t *data = (mbconv_op_data_t *)node->user_data;
+    TF_LITE_ENSURE(context, data != nullptr);
+    TF_LITE_ENSURE_EQ(context, node->inputs->size, 7);
+    tflite::MicroContext *microContext = tflite::GetMicroContext(context);
+    TfLiteTensor *filter = microContext->AllocateTempInputTensor(node, kMbconvProjFilter);
+    TF_LITE_ENSURE(context, filter != nullptr && filter->dims->size == 4);
+    data->outCh = filter->dims->data[0];
+    const int32_t *requant;
+    size_t scratchBytes;
+    TF_LITE_ENSURE_STATUS(mbconv_prepare_block(context, node, &data->block, 2 * data->outCh, &requant, &scratchBytes));
+    const mbconv_block_t &block = data->block;
+    const hk_mbconv_options_t &opts = block.opts;
+
+    TfLiteTensor *input = microContext->AllocateTempInputTensor(node, kMbconvInput);
+    TfLiteTensor *seScale = microContext->AllocateTempInputTensor(node, kMbconvSeScale);
+    TfLiteTensor *output = microContext->AllocateTempOutputTensor(node, 0);
+    TF_LITE_ENSURE(context, seScale != nullptr && output != nullptr);
+    TF_LITE_ENSURE_TYPES_EQ(context, seScale->type, kTfLiteInt8);
+    TF_LITE_ENSURE_TYPES_EQ(context, filter->type, kTfLiteInt8);
+    TF_LITE_ENSURE_EQ(context, tflite::NumElements(seScale), block.channels);
+    TF_LITE_ENSURE(context, filter->dims->data[1] == 1 && filter->dims->data[2] == 1 &&
+                                filter->dims->data[3] == (opts.projInt4 ? conv1d_s4_row_bytes(block.channels) : block.channels));
+    TF_LITE_ENSURE(context, output->dims->size == 4 && output->dims->data[2] == block.blockLen && output->dims->data[3] == data->outCh);
+
+    // SE scale, as MUL (mul_common.cc)
+    TfLiteTensor mulOutput;
+    quant_tensor(&mulOutput, opts.mulScale, opts.mulZeroPoint);
+    TF_LITE_ENSURE_STATUS(tflite::CalculateActivationRangeQuantized(context, (TfLiteFusedActivation)opts.mulActivation, &mulOutput,
+                                                                     &data->mulMin, &data->mulMax));
+    tflite::QuantizeMultiplier((double)opts.dwScale * (double)seScale->params.scale / (double)opts.mulScale, &data->mulMultiplier,
+                               &data->mulShift);
+    data->seZeroPoint = seScale->params.zero_point;
+
+    // Projection, as CONV_2D (conv_common.cc)
+    TfLiteTensor projOutput;
+    quant_tensor(&projOutput, opts.projScale, opts.projZeroPoint);
+    TfLiteTensor *projTensor = opts.residual ? &projOutput : output;
+    data->proj.per_channel_output_multiplier = const_cast<int32_t *>(requant);
+    data->proj.per_channel_output_shift = const_cast<int32_t *>(&requant[data->outCh]);
+    TF_LITE_ENSURE_STATUS(tflite::CalculateActivationRangeQuantized(context, (TfLiteFusedActivation)opts.projActivation, projTensor,
+                                                                     &data->proj.output_activation_min, &data->proj.output_activation_max));
+    data->proj.input_zero_point = opts.mulZeroPoint;
+    data->proj.filter_zero_point = filter->params.zero_point;
+    data->proj.output_zero_point = projTensor->params.zero_point;
+
+    // Residual, as ADD (add_common.cc)
+    if (opts.residual) {
+        TF_LITE_ENSURE(context, data->outCh == block.channels && block.blockLen == block.inLen);
+        data->addInputOffset = -input->params.zero_point;
+        data->addProjOffset = -projOutput.params.zero_point;
+        data->addOutputOffset = output->params.zero_point;
+        const double twiceMaxInputScale = 2 * (double)std::max(input->params.scale, projOutput.params.scale);
+        tflite::QuantizeMultiplierSmallerThanOneExp((double)input->params.scale / twiceMaxInputScale, &data->addInputMultiplier,
+                                                    &data->addInputShift);
+        tflite::QuantizeMultiplierSmallerThanOneExp((double)projOutput.params.scale / twiceMaxInputScale, &data->addProjMultiplier,
+                                                    &data->addProjShift);
+        tflite::QuantizeMultiplierSmallerThanOneExp(twiceMaxInputScale / ((1 << 20) * (double)output->params.scale),
+                                                    &data->addOutputMultiplier, &data->addOutputShift);
+        TF_LITE_ENSURE_STATUS(tflite::CalculateActivationRangeQuantized(context, (TfLiteFusedActivation)opts.addActivation, output,
+                                                                         &data->addMin, &data->addMax));
+    }
+    microContext->DeallocateTempTfLiteTensor(input);
+    microContext->DeallocateTempTfLiteTensor(seScale);
+    microContext->DeallocateTempTfLiteTensor(filter);
+    microContext->DeallocateTempTfLiteTensor(output);
+    return context->RequestScratchBufferInArena(context, scratchBytes, &data->block.scratchIdx);
+}
+
+static TfLiteStatus
+mbconv_squeeze_invoke(TfLiteContext *context, TfLiteNode *node) {
+    const mbconv_squeeze_data_t *data = (const mbconv_squeeze_data_t *)node->user_data;
+    const mbconv_block_t &block = data->block;
+    const int32_t channels = block.channels;
+    const int8_t *input = tflite::micro::GetTensorData<int8_t>(tflite::micro::GetEvalInput(context, node, kMbconvInput));
+    const int8_t *filter = tflite::micro::GetTensorData<int8_t>(tflite::micro::GetEvalInput(context, node, kMbconvDwFilter));
+    const int32_t *bias = tflite::micro::GetTensorData<int32_t>(tflite::micro::GetEvalInput(context, node, kMbconvDwBias));
+    int8_t *output = tflite::micro::GetTensorData<int8_t>(tflite::micro::GetEvalOutput(context, node, 0));
+    int32_t *acc = (int32_t *)context->GetScratchBuffer(context, block.scratchIdx);
+    int8_t *tile = (int8_t *)&acc[channels];
+
+    memset(acc, 0, channels * sizeof(int32_t));
+    for (int32_t p0 = 0; p0 < block.blockLen; p0 += HK_MBCONV_TILE_LEN) {
+        int32_t p1 = p0 + HK_MBCONV_TILE_LEN < block.blockLen ? p0 + HK_MBCONV_TILE_LEN : block.blockLen;
+        const int8_t *rows = mbconv_tile(&block, p0, p1, input, filter, bias, tile);
+        for (int32_t i = 0; i < (p1 - p0); i++) {
+            for (int32_t c = 0; c < channels; c++) {
+                acc[c] += rows[i * channels + c] - block.opts.dwZeroPoint;
+            }
+        }
+    }
+    // Same rounding as reference_integer_ops::Mean
+    const int32_t num = block.blockLen;
+    for (int32_t c = 0; c < channels; c++) {
+        int32_t val = tflite::MultiplyByQuantizedMultiplier(acc[c], data->meanMultiplier, data->meanShift);
+        val = val > 0 ? (val + num / 2) / num : (val - num / 2) / num;
+        val += data->meanZeroPoint;
+        output[c] = (int8_t)std::min<int32_t>(std::max<int32_t>(val, INT8_MIN), INT8_MAX);
+    }
+    return kTfLiteOk;
+}
+
+static TfLiteStatus
+mbconv_invoke(TfLiteContext *context, TfLiteNode *node) {
+    const mbconv_op_data_t *data = (const mbconv_op_data_t *)node->user_data;
+    const mbconv_block_t &block = data->block;
+    const hk_mbconv_options_t &opts = block.opts;
+    const int32_t channels = block.channels;
+    const int32_t outCh = data->outCh;
+    const int8_t *input = tflite::micro::GetTensorData<int8_t>(tflite::micro::GetEvalInput(context, node, kMbconvInput));
+    const int8_t *dwFilter = tflite::micro::GetTensorData<int8_t>(tflite::micro::GetEvalInput(context, node, kMbconvDwFilter));
+    const int32_t *dwBias = tflite::micro::GetTensorData<int32_t>(tflite::micro::GetEvalInput(context, node, kMbconvDwBias));
+    const int8_t *seScale = tflite::micro::GetTensorData<int8_t>(tflite::micro::GetEvalInput(context, node, kMbconvSeScale));
+    const int8_t *projFilter = tflite::micro::GetTensorData<int8_t>(tflite::micro::GetEvalInput(context, node, kMbconvProjFilter));
+    const int32_t *projBias = tflite::micro::GetTensorData<int32_t>(tflite::micro::GetEvalInput(context, node, kMbconvProjBias));
+    int8_t *output = tflite::micro::GetTensorData<int8_t>(tflite::micro::GetEvalOutput(context, node, 0));
+    int8_t *tile = (int8_t *)context->GetScratchBuffer(context, block.scratchIdx);
+
+    for (int32_t p0 = 0; p0 < block.blockLen; p0 += HK_MBCONV_TILE_LEN) {
+        int32_t p1 = p0 + HK_MBCONV_TILE_LEN < block.blockLen ? p0 + HK_MBCONV_TILE_LEN : block.blockLen;
+        int32_t rowsLen = p1 - p0;
+        int8_t *rows = mbconv_tile(&block, p0, p1, input, dwFilter, dwBias, tile);
+        // SE scale in place, as reference_integer_ops::BroadcastMul4DSlow
+        for (int32_t i = 0; i < rowsLen; i++) {
+            for (int32_t c = 0; c < channels; c++) {
+                int32_t val = (rows[i * channels + c] - opts.dwZeroPoint) * (seScale[c] - data->seZeroPoint);
+                val = opts.mulZeroPoint + tflite::MultiplyByQuantizedMultiplier(val, data->mulMultiplier, data->mulShift);
+                val = val < data->mulMin ? data->mulMin : val;
+                val = val > data->mulMax ? data->mulMax : val;
+                rows[i * channels + c] = (int8_t)val;
+            }
+        }
+        int8_t *out = &output[p0 * outCh];
+        if (opts.projInt4) {
+            conv1d_s4(data->proj, 1, rowsLen, channels, 1, 0, rowsLen, outCh, rows, projFilter, projBias, out);
+        } else {
+            conv1d_s8(data->proj, 1, rowsLen, channels, 1, 0, rowsLen, outCh, rows, projFilter, projBias, out);
+        }
+        if (!opts.residual) {
+            continue;
+        }
+        // Residual in place, as reference_integer_ops::AddFunc
+        const int8_t *in = &input[p0 * channels];
+        for (int32_t i = 0; i < rowsLen * outCh; i++) {
+            int32_t a = (in[i] + data->addInputOffset) * (1 << 20);
+            int32_t b = (out[i] + data->addProjOffset) * (1 << 20);
+            a = tflite::MultiplyByQuantizedMultiplierSmallerThanOneExp(a, data->addInputMultiplier, data->addInputShift);
+            b = tflite::MultiplyByQuantizedMultiplierSmallerThanOneExp(b, data->addProjMultiplier, data->addProjShift);
+            int32_t val = tflite::MultiplyByQuantizedMultiplierSmallerThanOneExp(a + b, data->addOutputMultiplier, data->addOutputShift) +
+                          data->addOutputOffset;
+            val = val < data->addMin ? data->addMin : val;
+            val = val > data->addMax ? data->addMax : val;
+            out[i] = (int8_t)val;
+        }
+    }
+    return kTfLiteOk;
+}
+
+TfLiteRegistration *
+Register_HK_MBCONV_SQUEEZE(void) {
+    static TfLiteRegistration registration = tflite::micro::RegisterOp(mbconv_squeeze_init, mbconv_squeeze_prepare, mbconv_squeeze_invoke);
+    return &registration;
+}
+
+TfLiteRegistration *
+Register_HK_MBCONV(void) {
+    static TfLiteRegistration registration = tflite::micro::RegisterOp(mbconv_init, mbconv_prepare, mbconv_invoke);
+    return &registration;
+}
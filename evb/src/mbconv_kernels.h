@@ -0,0 +1,78 @@
+/**
+ * @file mbconv_kernels.h
+ * @author Adam Page (adam.page@ambiq.com)
+ * @brief Fused int8 MBConv custom ops for TFLM
+ * @version 1.0
+ * @date 2023-05-02
+ *
+ * @copyright Copyright (c) 2023
+ *
+ */
+#ifndef __MBCONV_KERNELS_H
+#define __MBCONV_KERNELS_H
+
+#include <stdint.h>
+
+#include "tensorflow/lite/micro/micro_mutable_op_resolver.h"
+
+#define HK_MBCONV_OP_NAME "HK_MBCONV"
+#define HK_MBCONV_SQUEEZE_OP_NAME "HK_MBCONV_SQUEEZE"
+#define HK_MBCONV_OPTIONS_VERSION (2)
+
+#ifndef HK_MBCONV_TILE_LEN
+    #define HK_MBCONV_TILE_LEN (8) // Block positions computed per tile
+#endif
+
+/**
+ * @brief Custom options of both ops, written by host/mbconv_fuser.cc (little endian, unaligned).
+ * Quantization of the tensors the fused ops no longer materialize is carried here.
+ */
+typedef struct __attribute__((packed)) {
+    uint8_t version;        // HK_MBCONV_OPTIONS_VERSION
+    uint8_t dwStride;       // Depthwise width stride
+    uint8_t dwPadding;      // Depthwise TfLitePadding
+    uint8_t dwActivation;   // Depthwise TfLiteFusedActivation
+    uint8_t poolSize;       // Max pool width (0 = no pool)
+    uint8_t poolStride;     // Max pool width stride
+    uint8_t poolPadding;    // Max pool TfLitePadding
+    uint8_t poolActivation; // Max pool TfLiteFusedActivation
+    uint8_t mulActivation;  // SE scale TfLiteFusedActivation
+    uint8_t projActivation; // Projection TfLiteFusedActivation
+    uint8_t addActivation;  // Residual add TfLiteFusedActivation
+    uint8_t residual;       // Add block input to projection output
+    float dwScale;          // Depthwise (and max pool) output scale
+    int32_t dwZeroPoint;    // Depthwise (and max pool) output zero point
+    float mulScale;         // SE scaled output scale
+    int32_t mulZeroPoint;   // SE scaled output zero point
+    float projScale;        // Projection output scale (residual only)
+    int32_t projZeroPoint;  // Projection output zero point (residual only)
+    uint8_t projInt4;       // Projection filter is packed int4 (version 2, see conv1d_s4)
+} hk_mbconv_options_t;
+
+/*
+ * requant is a constant int32 tensor written by the fuser: depthwise per-channel output multipliers
+ * and shifts, followed (HK_MBCONV only) by the projection ones, as PopulateConvolutionQuantizationParams
+ * would compute them.
+ */
+
+/**
+ * @brief Squeeze half of an MBConv block: depthwise conv, optional max pool and channel mean.
+ * Inputs: block input [1,1,W,C], depthwise filter [1,1,K,C], bias [C], requant (of the HK_MBCONV).
+ * Output: mean [1,1,1,C].
+ * The depthwise output is streamed through a tile buffer and never stored.
+ */
+TfLiteRegistration *
+Register_HK_MBCONV_SQUEEZE(void);
+
+/**
+ * @brief Excite half of an MBConv block: depthwise conv, optional max pool, SE channel scale,
+ * pointwise projection and optional residual add.
+ * Inputs: block input [1,1,W,C], depthwise filter [1,1,K,C], bias [C], requant [2C + 2Cout],
+ * SE scale [1,1,1,C], projection filter [Cout,1,1,C] (packed [Cout,1,1,conv1d_s4_row_bytes(C)] with projInt4),
+ * bias [Cout]. Output: block output [1,1,W',Cout].
+ * The depthwise conv is recomputed tile by tile so only the block input and output live in the arena.
+ */
+TfLiteRegistration *
+Register_HK_MBCONV(void);
+
+#endif // __MBCONV_KERNELS_H
@@ -11,8 +11,44 @@
 #include "model.h"
 #include "arrhythmia_model_buffer.h"
 #include "beat_model_buffer.h"
+#include "cascade_model.h"
 #include "constants.h"
+#include "conv1d_kernels.h"
+#include "custom_ops.h"
+#include "model_arena.h"
 #include "segmentation_model_buffer.h"
+#include "stream_model.h"
+#include "stream_window.h"
+#ifdef HK_MULTIHEAD_ENABLE
+    #include "mh_backbone_model_buffer.h"
+    #include "multihead_model.h"
+    #ifdef ARRHTYHMIA_ENABLE
+        #include "mh_arrhythmia_model_buffer.h"
+    #endif
+    #ifdef SEGMENTATION_ENABLE
+        #include "mh_segmentation_model_buffer.h"
+    #endif
+    #ifdef BEAT_ENABLE
+        #include "mh_beat_model_buffer.h"
+    #endif
+#endif
+#ifdef HK_ARR_EXIT_ENABLE
+    #include "arr_exit1_model_buffer.h"
+    #include "arr_exit2_model_buffer.h"
+    #include "arr_exit3_model_buffer.h"
+    #include "early_exit_model.h"
+#endif
+#ifdef HK_CASCADE_ENABLE
+    #ifdef ARRHTYHMIA_ENABLE
+        #include "arr_small_model_buffer.h"
+    #endif
+    #ifdef BEAT_ENABLE
+        #include "beat_small_model_buffer.h"
+    #endif
+#endif
+#ifdef HK_SEG_COARSE_ENABLE
+    #include "seg_coarse_model_buffer.h"
+#endif
 
 #include "ns_ambiqsuite_harness.h"
 
@@ -24,12 +60,88 @@
 #include "tensorflow/lite/micro/system_setup.h"
 #include "tensorflow/lite/schema/schema_generated.h"
 
+// With HK_MULTIHEAD_ENABLE the enabled heads run on the shared backbone and the standalone models are not linked
+#if defined(ARRHTYHMIA_ENABLE) && !defined(HK_MULTIHEAD_ENABLE) && !defined(HK_ARR_EXIT_ENABLE)
+    #define HK_ARR_MODEL_ENABLE
+#endif
+#if defined(SEGMENTATION_ENABLE) && !defined(HK_MULTIHEAD_ENABLE)
+    #define HK_SEG_MODEL_ENABLE
+#endif
+#if defined(BEAT_ENABLE) && !defined(HK_MULTIHEAD_ENABLE)
+    #define HK_BEAT_MODEL_ENABLE
+#endif
+#if defined(HK_MULTIHEAD_ENABLE) && defined(HK_PROFILE_ENABLE)
+    #error "Operator profiles are kept per standalone model, disable HK_PROFILE_ENABLE with HK_MULTIHEAD_ENABLE"
+#endif
+#ifdef HK_ARR_EXIT_ENABLE
+    #if defined(HK_MULTIHEAD_ENABLE) || defined(HK_PROFILE_ENABLE)
+        #error "HK_ARR_EXIT_ENABLE splits the standalone arrhythmia model, disable HK_MULTIHEAD_ENABLE and HK_PROFILE_ENABLE"
+    #endif
+    #if defined(ARRHTYHMIA_ENABLE)
+        #define HK_ARR_EXIT_MODEL_ENABLE
+    #endif
+#endif
+#ifdef HK_CASCADE_ENABLE
+    #if defined(HK_MULTIHEAD_ENABLE) || defined(HK_ARR_EXIT_ENABLE) || defined(HK_PROFILE_ENABLE)
+        #error "HK_CASCADE_ENABLE puts small models in front of the standalone ones, disable HK_MULTIHEAD_ENABLE, HK_ARR_EXIT_ENABLE and HK_PROFILE_ENABLE"
+    #endif
+    #ifdef HK_ARR_MODEL_ENABLE
+        #define HK_ARR_CASCADE_ENABLE
+    #endif
+    #ifdef HK_BEAT_MODEL_ENABLE
+        #define HK_BEAT_CASCADE_ENABLE
+    #endif
+#endif
+#if defined(HK_SEG_COARSE_ENABLE) && defined(HK_SEG_MODEL_ENABLE)
+    #define HK_SEG_COARSE_MODEL_ENABLE
+#endif
+
+#ifdef HK_PROFILE_ENABLE
+// Kernels are wrapped by ProfilingOpResolver rather than passing the profilers to MicroInterpreter
+static OpProfiler modelProfilers[HeartModelCount];
+#endif
+
+// Arena sizes come from model_arena.h, which is only valid for the models it was generated from
+static_assert(g_arrhythmia_model_len == HK_ARR_MODEL_LEN, "Arrhythmia model changed, regenerate model_arena.h (make -C host arena)");
+static_assert(g_segmentation_model_len == HK_SEG_MODEL_LEN, "Segmentation model changed, regenerate model_arena.h (make -C host arena)");
+static_assert(g_beat_model_len == HK_BEAT_MODEL_LEN, "Beat model changed, regenerate model_arena.h (make -C host arena)");
+#ifdef HK_MULTIHEAD_ENABLE
+static_assert(g_mh_backbone_model_len == HK_MH_BACKBONE_MODEL_LEN, "Backbone model changed, regenerate model_arena.h (make -C host arena)");
+    #ifdef ARRHTYHMIA_ENABLE
+static_assert(g_mh_arrhythmia_model_len == HK_MH_ARR_MODEL_LEN, "Arrhythmia head changed, regenerate model_arena.h (make -C host arena)");
+    #endif
+    #ifdef SEGMENTATION_ENABLE
+static_assert(g_mh_segmentation_model_len == HK_MH_SEG_MODEL_LEN, "Segmentation head changed, regenerate model_arena.h (make -C host arena)");
+    #endif
+    #ifdef BEAT_ENABLE
+static_assert(g_mh_beat_model_len == HK_MH_BEAT_MODEL_LEN, "Beat head changed, regenerate model_arena.h (make -C host arena)");
+    #endif
+#endif
+#ifdef HK_ARR_EXIT_MODEL_ENABLE
+static_assert(g_arr_exit1_model_len == HK_ARR_EXIT1_MODEL_LEN && g_arr_exit2_model_len == HK_ARR_EXIT2_MODEL_LEN &&
+                  g_arr_exit3_model_len == HK_ARR_EXIT3_MODEL_LEN,
+              "Early-exit arrhythmia model changed, regenerate model_arena.h (make -C host arena)");
+#endif
+#ifdef HK_ARR_CASCADE_ENABLE
+static_assert(g_arr_small_model_len == HK_ARR_SMALL_MODEL_LEN, "Small arrhythmia model changed, regenerate model_arena.h (make -C host arena)");
+#endif
+#ifdef HK_BEAT_CASCADE_ENABLE
+static_assert(g_beat_small_model_len == HK_BEAT_SMALL_MODEL_LEN, "Small beat model changed, regenerate model_arena.h (make -C host arena)");
+#endif
+#ifdef HK_SEG_COARSE_MODEL_ENABLE
+static_assert(g_seg_coarse_model_len == HK_SEG_COARSE_MODEL_LEN, "Coarse segmentation model changed, regenerate model_arena.h (make -C host arena)");
+#endif
+#ifdef HK_MULTIHEAD_ENABLE
+static_assert(HK_MH_STEP % HK_MH_BEAT_STRIDE == 0 && (HK_DATA_LEN - HK_MH_LEN) % HK_MH_BEAT_STRIDE == 0 && HK_MH_OLP % HK_MH_BEAT_STRIDE == 0,
+              "Multihead windows must start on a beat feature position");
+#endif
+
 //*****************************************************************************
 //*** Tensorflow Globals
 tflite::ErrorReporter *errorReporter = nullptr;
 
-#ifdef ARRHTYHMIA_ENABLE
-constexpr int arrTensorArenaSize = 1024 * 65;
+#ifdef HK_ARR_MODEL_ENABLE
+constexpr int arrTensorArenaSize = HK_ARR_ARENA_SIZE;
 alignas(16) static uint8_t arrTensorArena[arrTensorArenaSize];
 const tflite::Model *arrModel = nullptr;
 tflite::MicroInterpreter *arrInterpreter = nullptr;
@@ -37,17 +149,47 @@ TfLiteTensor *arrModelInput = nullptr;
 TfLiteTensor *arrModelOutput = nullptr;
 #endif
 
-#ifdef SEGMENTATION_ENABLE
-constexpr int segTensorArenaSize = 1024 * 65;
-alignas(16) static uint8_t segTensorArena[segTensorArenaSize];
+#ifdef HK_ARR_EXIT_MODEL_ENABLE
+alignas(16) static uint8_t arrExit1Arena[HK_ARR_EXIT1_ARENA_SIZE];
+alignas(16) static uint8_t arrExit2Arena[HK_ARR_EXIT2_ARENA_SIZE];
+alignas(16) static uint8_t arrExit3Arena[HK_ARR_EXIT3_ARENA_SIZE];
+static EarlyExitModel arrExitModel;
+
+static uint32_t
+arr_exit_cycles(void) {
+    // Runs inside the ARRHYTHMIA stage, whose profiler keeps CYCCNT counting
+    return DWT->CYCCNT;
+}
+#endif
+
+#ifdef HK_ARR_CASCADE_ENABLE
+alignas(16) static uint8_t arrSmallArena[HK_ARR_SMALL_ARENA_SIZE];
+static CascadeModel arrCascade;
+#endif
+
+#ifdef HK_SEG_MODEL_ENABLE
 const tflite::Model *segModel = nullptr;
+#ifdef HK_SEG_STREAM_ENABLE
+alignas(16) static uint8_t segStreamArena[HK_SEG_STREAM_ARENA_SIZE];
+static StreamModel segStream;
+// Stream carried across overlapping windows (stream_window.cc)
+static hk_stream_window_t segStreamWindow;
+#else
+constexpr int segTensorArenaSize = HK_SEG_ARENA_SIZE;
+alignas(16) static uint8_t segTensorArena[segTensorArenaSize];
 tflite::MicroInterpreter *segInterpreter = nullptr;
 TfLiteTensor *segModelInput = nullptr;
 TfLiteTensor *segModelOutput = nullptr;
 #endif
+#endif
 
-#ifdef BEAT_ENABLE
-constexpr int beatTensorArenaSize = 1024 * 60;
+#ifdef HK_SEG_COARSE_MODEL_ENABLE
+alignas(16) static uint8_t segCoarseArena[HK_SEG_COARSE_ARENA_SIZE];
+static tflite::MicroInterpreter *segCoarseInterpreter = nullptr;
+#endif
+
+#ifdef HK_BEAT_MODEL_ENABLE
+constexpr int beatTensorArenaSize = HK_BEAT_ARENA_SIZE;
 alignas(16) static uint8_t beatTensorArena[beatTensorArenaSize];
 const tflite::Model *beatModel = nullptr;
 tflite::MicroInterpreter *beatInterpreter = nullptr;
@@ -55,6 +197,245 @@ TfLiteTensor *beatModelInput = nullptr;
 TfLiteTensor *beatModelOutput = nullptr;
 #endif
 
+#ifdef HK_BEAT_CASCADE_ENABLE
+alignas(16) static uint8_t beatSmallArena[HK_BEAT_SMALL_ARENA_SIZE];
+static CascadeModel beatCascade;
+
+// Beats a beat_fill() call quantizes
+typedef struct {
+    const float32_t *pBeat;
+    const float32_t *beat;
+    const float32_t *nBeat;
+} beat_sample_t;
+#endif
+
+#ifdef HK_MULTIHEAD_ENABLE
+alignas(16) static uint8_t mhBackboneArena[HK_MH_BACKBONE_ARENA_SIZE];
+static MultiHeadModel mhModel;
+#ifdef ARRHTYHMIA_ENABLE
+alignas(16) static uint8_t mhArrArena[HK_MH_ARR_ARENA_SIZE];
+static int32_t mhArrHead = -1;
+#endif
+#ifdef SEGMENTATION_ENABLE
+alignas(16) static uint8_t mhSegArena[HK_MH_SEG_ARENA_SIZE];
+static int32_t mhSegHead = -1;
+#endif
+#ifdef BEAT_ENABLE
+alignas(16) static uint8_t mhBeatArena[HK_MH_BEAT_ARENA_SIZE];
+static int32_t mhBeatHead = -1;
+// Backbone features the beat head crops, kept for the whole signal [HK_DATA_LEN / HK_MH_BEAT_STRIDE, HK_MH_BEAT_CHANNELS]
+static int8_t mhBeatFeatures[HK_DATA_LEN / HK_MH_BEAT_STRIDE * HK_MH_BEAT_CHANNELS];
+static int32_t mhBeatFeature = -1;
+static mh_requant_t mhBeatRequant;
+#endif
+#endif
+
+#if defined(HK_MULTIHEAD_ENABLE) || defined(HK_ARR_EXIT_MODEL_ENABLE) || defined(HK_CASCADE_ENABLE) || defined(HK_SEG_COARSE_MODEL_ENABLE)
+static const tflite::Model *
+load_model(const unsigned char *buf, const char *name) {
+    /**
+     * @brief Load a multihead, early-exit, cascade or coarse model, checking its schema
+     * @return Model, or nullptr on mismatch
+     */
+    const tflite::Model *model = tflite::GetModel(buf);
+    if (model->version() != TFLITE_SCHEMA_VERSION) {
+        TF_LITE_REPORT_ERROR(errorReporter, "%s schema mismatch: given=%d != expected=%d.", name, model->version(), TFLITE_SCHEMA_VERSION);
+        return nullptr;
+    }
+    return model;
+}
+
+static uint32_t
+allocate_model(tflite::MicroInterpreter *interpreter, size_t arenaSize, const char *name) {
+    /**
+     * @brief Allocate tensors of one of those models and check the arena it used
+     * @return 0 on success
+     */
+    if (interpreter->AllocateTensors() != kTfLiteOk) {
+        TF_LITE_REPORT_ERROR(errorReporter, "%s AllocateTensors() failed", name);
+        return 1;
+    }
+    size_t bytesUsed = interpreter->arena_used_bytes();
+    if (bytesUsed > arenaSize) {
+        TF_LITE_REPORT_ERROR(errorReporter, "%s arena mismatch: given=%d < expected=%d bytes.", name, arenaSize, bytesUsed);
+        return 1;
+    }
+    ns_printf("%s needs %d bytes\n", name, bytesUsed);
+    return 0;
+}
+
+#endif
+
+#ifdef HK_MULTIHEAD_ENABLE
+static uint32_t
+init_multihead(const tflite::MicroOpResolver &opResolver) {
+    /**
+     * @brief Initialize the backbone and the enabled heads
+     *
+     */
+    const tflite::Model *model;
+    if ((model = load_model(g_mh_backbone_model, "Backbone")) == nullptr) {
+        return 1;
+    }
+    static tflite::MicroInterpreter backbone(model, opResolver, mhBackboneArena, sizeof(mhBackboneArena), errorReporter);
+    if (allocate_model(&backbone, sizeof(mhBackboneArena), "Backbone") || mhModel.Init(&backbone) != kTfLiteOk) {
+        return 1;
+    }
+
+#ifdef ARRHTYHMIA_ENABLE
+    if ((model = load_model(g_mh_arrhythmia_model, "Arrhythmia head")) == nullptr) {
+        return 1;
+    }
+    static tflite::MicroInterpreter arrHead(model, opResolver, mhArrArena, sizeof(mhArrArena), errorReporter);
+    if (allocate_model(&arrHead, sizeof(mhArrArena), "Arrhythmia head") || (mhArrHead = mhModel.AddHead(&arrHead)) < 0) {
+        return 1;
+    }
+    if (mhModel.NumRouted(mhArrHead) != (int32_t)arrHead.inputs_size() || arrHead.output(0)->dims->data[1] != HK_ARR_CLASSES) {
+        TF_LITE_REPORT_ERROR(errorReporter, "Arrhythmia head does not match the backbone");
+        return 1;
+    }
+#endif
+
+#ifdef SEGMENTATION_ENABLE
+    if ((model = load_model(g_mh_segmentation_model, "Segmentation head")) == nullptr) {
+        return 1;
+    }
+    static tflite::MicroInterpreter segHead(model, opResolver, mhSegArena, sizeof(mhSegArena), errorReporter);
+    if (allocate_model(&segHead, sizeof(mhSegArena), "Segmentation head") || (mhSegHead = mhModel.AddHead(&segHead)) < 0) {
+        return 1;
+    }
+    if (mhModel.NumRouted(mhSegHead) != (int32_t)segHead.inputs_size() || segHead.output(0)->dims->data[1] != HK_MH_LEN) {
+        TF_LITE_REPORT_ERROR(errorReporter, "Segmentation head does not match the backbone");
+        return 1;
+    }
+#endif
+
+#ifdef BEAT_ENABLE
+    if ((model = load_model(g_mh_beat_model, "Beat head")) == nullptr) {
+        return 1;
+    }
+    static tflite::MicroInterpreter beatHead(model, opResolver, mhBeatArena, sizeof(mhBeatArena), errorReporter);
+    if (allocate_model(&beatHead, sizeof(mhBeatArena), "Beat head") || (mhBeatHead = mhModel.AddHead(&beatHead)) < 0) {
+        return 1;
+    }
+    // Input is the previous, target and next beat features side by side [1, 1, HK_BEAT_LEN / HK_MH_BEAT_STRIDE, 3 * HK_MH_BEAT_CHANNELS]
+    mhBeatFeature = mhModel.FindFeature(HK_MH_LEN / HK_MH_BEAT_STRIDE, HK_MH_BEAT_CHANNELS);
+    if (mhBeatFeature < 0 || mhModel.NumRouted(mhBeatHead) != 0 ||
+        beatHead.input(0)->bytes != (HK_BEAT_LEN / HK_MH_BEAT_STRIDE) * 3 * HK_MH_BEAT_CHANNELS ||
+        mh_requant_init(&mhBeatRequant, mhModel.Feature(mhBeatFeature), beatHead.input(0)) != kTfLiteOk) {
+        TF_LITE_REPORT_ERROR(errorReporter, "Beat head does not match the backbone");
+        return 1;
+    }
+#endif
+    return 0;
+}
+#endif
+
+#ifdef HK_ARR_EXIT_MODEL_ENABLE
+static uint32_t
+init_arr_exit(const tflite::MicroOpResolver &opResolver) {
+    /**
+     * @brief Initialize the early-exit arrhythmia parts
+     *
+     */
+    const tflite::Model *model;
+    arrExitModel.Init(arr_exit_cycles);
+    if ((model = load_model(g_arr_exit1_model, "Arrhythmia part 1")) == nullptr) {
+        return 1;
+    }
+    static tflite::MicroInterpreter part1(model, opResolver, arrExit1Arena, sizeof(arrExit1Arena), errorReporter);
+    if (allocate_model(&part1, sizeof(arrExit1Arena), "Arrhythmia part 1") || arrExitModel.AddPart(&part1) != kTfLiteOk) {
+        return 1;
+    }
+    if ((model = load_model(g_arr_exit2_model, "Arrhythmia part 2")) == nullptr) {
+        return 1;
+    }
+    static tflite::MicroInterpreter part2(model, opResolver, arrExit2Arena, sizeof(arrExit2Arena), errorReporter);
+    if (allocate_model(&part2, sizeof(arrExit2Arena), "Arrhythmia part 2") || arrExitModel.AddPart(&part2) != kTfLiteOk) {
+        return 1;
+    }
+    if ((model = load_model(g_arr_exit3_model, "Arrhythmia part 3")) == nullptr) {
+        return 1;
+    }
+    static tflite::MicroInterpreter part3(model, opResolver, arrExit3Arena, sizeof(arrExit3Arena), errorReporter);
+    if (allocate_model(&part3, sizeof(arrExit3Arena), "Arrhythmia part 3") || arrExitModel.AddPart(&part3) != kTfLiteOk) {
+        return 1;
+    }
+    if (arrExitModel.NumClasses() != HK_ARR_CLASSES || arrExitModel.Part(HK_ARR_EXIT_PARTS - 1)->feature >= 0) {
+        TF_LITE_REPORT_ERROR(errorReporter, "Early-exit arrhythmia parts do not chain into HK_ARR_CLASSES logits");
+        return 1;
+    }
+    return 0;
+}
+#endif
+
+#ifdef HK_CASCADE_ENABLE
+static uint32_t
+init_cascades(const tflite::MicroOpResolver &opResolver) {
+    /**
+     * @brief Initialize the small models and put them in front of the standalone ones
+     *
+     */
+    const tflite::Model *model;
+#ifdef HK_ARR_CASCADE_ENABLE
+    if ((model = load_model(g_arr_small_model, "Small arrhythmia")) == nullptr) {
+        return 1;
+    }
+    static tflite::MicroInterpreter arrSmall(model, opResolver, arrSmallArena, sizeof(arrSmallArena), errorReporter);
+    if (allocate_model(&arrSmall, sizeof(arrSmallArena), "Small arrhythmia")) {
+        return 1;
+    }
+    if (arrCascade.Init(&arrSmall, arrInterpreter, HK_ARR_CASCADE_MARGIN) != kTfLiteOk) {
+        TF_LITE_REPORT_ERROR(errorReporter, "Small arrhythmia model does not match the arrhythmia model");
+        return 1;
+    }
+#endif
+#ifdef HK_BEAT_CASCADE_ENABLE
+    if ((model = load_model(g_beat_small_model, "Small beat")) == nullptr) {
+        return 1;
+    }
+    static tflite::MicroInterpreter beatSmall(model, opResolver, beatSmallArena, sizeof(beatSmallArena), errorReporter);
+    if (allocate_model(&beatSmall, sizeof(beatSmallArena), "Small beat")) {
+        return 1;
+    }
+    if (beatCascade.Init(&beatSmall, beatInterpreter, HK_BEAT_CASCADE_MARGIN) != kTfLiteOk) {
+        TF_LITE_REPORT_ERROR(errorReporter, "Small beat model does not match the beat model");
+        return 1;
+    }
+#endif
+    return 0;
+}
+#endif
+
+#ifdef HK_ARR_CASCADE_ENABLE
+static void
+arr_fill(TfLiteTensor *input, const void *ctx) {
+    /**
+     * @brief Quantize an arrhythmia block (ctx) into a cascade level's input
+     */
+    const float32_t *x = (const float32_t *)ctx;
+    for (int i = 0; i < input->dims->data[2]; i++) {
+        input->data.int8[i] = x[i] / input->params.scale + input->params.zero_point;
+    }
+}
+#endif
+
+#ifdef HK_BEAT_CASCADE_ENABLE
+static void
+beat_fill(TfLiteTensor *input, const void *ctx) {
+    /**
+     * @brief Quantize three beats (ctx, a beat_sample_t) side by side into a cascade level's input
+     */
+    const beat_sample_t *sample = (const beat_sample_t *)ctx;
+    uint32_t xIdx = 0;
+    for (int i = 0; i < input->dims->data[2]; i++) {
+        input->data.int8[xIdx++] = sample->pBeat[i] / input->params.scale + input->params.zero_point;
+        input->data.int8[xIdx++] = sample->beat[i] / input->params.scale + input->params.zero_point;
+        input->data.int8[xIdx++] = sample->nBeat[i] / input->params.scale + input->params.zero_point;
+    }
+}
+#endif
+
 uint32_t
 init_models() {
     /**
@@ -63,7 +444,19 @@ init_models() {
      */
     size_t bytesUsed;
     TfLiteStatus allocateStatus;
-    static tflite::AllOpsResolver opResolver;
+    static tflite::AllOpsResolver allOpsResolver;
+    // Custom ops written by host/model_fuser.cc
+    add_custom_ops(allOpsResolver);
+    const tflite::MicroOpResolver *baseResolver = &allOpsResolver;
+#ifdef HK_CONV1D_ENABLE
+    static Conv1dOpResolver conv1dResolver(*baseResolver);
+    baseResolver = &conv1dResolver;
+#endif
+#ifdef HK_PROFILE_ENABLE
+    static ProfilingOpResolver profilingResolver(*baseResolver);
+    baseResolver = &profilingResolver;
+#endif
+    const tflite::MicroOpResolver &opResolver = *baseResolver;
     // ^ Use microOpResolver to reduce overhead
     static tflite::MicroErrorReporter microErrorReporter;
     errorReporter = &microErrorReporter;
@@ -71,13 +464,17 @@ init_models() {
     tflite::InitializeTarget();
 
     // Load Arrhythmia model
-#ifdef ARRHTYHMIA_ENABLE
+#ifdef HK_ARR_MODEL_ENABLE
     arrModel = tflite::GetModel(g_arrhythmia_model);
     if (arrModel->version() != TFLITE_SCHEMA_VERSION) {
         TF_LITE_REPORT_ERROR(errorReporter, "Schema mismatch: given=%d != expected=%d.", arrModel->version(), TFLITE_SCHEMA_VERSION);
         return 1;
     }
 
+#ifdef HK_PROFILE_ENABLE
+    modelProfilers[HeartModelArrhythmia].Init(arrModel);
+#endif
+
     static tflite::MicroInterpreter arr_interpreter(arrModel, opResolver, arrTensorArena, arrTensorArenaSize, errorReporter);
     arrInterpreter = &arr_interpreter;
 
@@ -94,16 +491,31 @@ init_models() {
     ns_printf("Arrhythmia needs %d bytes\n", bytesUsed);
     arrModelInput = arrInterpreter->input(0);
     arrModelOutput = arrInterpreter->output(0);
+    if (arrModelOutput->dims->data[1] != HK_ARR_CLASSES) {
+        TF_LITE_REPORT_ERROR(errorReporter, "Arrhythmia outputs: given=%d != expected=%d.", arrModelOutput->dims->data[1], HK_ARR_CLASSES);
+        return 1;
+    }
 #endif
 
     // Load Segmentation model
-#ifdef SEGMENTATION_ENABLE
+#ifdef HK_SEG_MODEL_ENABLE
     segModel = tflite::GetModel(g_segmentation_model);
     if (segModel->version() != TFLITE_SCHEMA_VERSION) {
         TF_LITE_REPORT_ERROR(errorReporter, "Schema mismatch: given=%d != expected=%d.", segModel->version(), TFLITE_SCHEMA_VERSION);
         return 1;
     }
 
+#ifdef HK_SEG_STREAM_ENABLE
+    if (segStream.Init(segModel, segStreamArena, HK_SEG_STREAM_ARENA_SIZE, HK_SEG_STREAM_STEP, HK_DATA_LEN) != kTfLiteOk) {
+        TF_LITE_REPORT_ERROR(errorReporter, "Segmentation stream Init() failed");
+        return 1;
+    }
+    ns_printf("Segmentation stream needs %d bytes (latency %d samples)\n", segStream.ArenaUsed(), segStream.Latency());
+#else
+#ifdef HK_PROFILE_ENABLE
+    modelProfilers[HeartModelSegmentation].Init(segModel);
+#endif
+
     static tflite::MicroInterpreter seg_interpreter(segModel, opResolver, segTensorArena, segTensorArenaSize, errorReporter);
     segInterpreter = &seg_interpreter;
 
@@ -121,15 +533,37 @@ init_models() {
     segModelOutput = segInterpreter->output(0);
     ns_printf("Segmentation model needs %d bytes\n", bytesUsed);
 #endif
+#endif
+
+#ifdef HK_SEG_COARSE_MODEL_ENABLE
+    const tflite::Model *segCoarseModel = load_model(g_seg_coarse_model, "Coarse segmentation");
+    if (segCoarseModel == nullptr) {
+        return 1;
+    }
+    static tflite::MicroInterpreter seg_coarse_interpreter(segCoarseModel, opResolver, segCoarseArena, sizeof(segCoarseArena), errorReporter);
+    segCoarseInterpreter = &seg_coarse_interpreter;
+    if (allocate_model(segCoarseInterpreter, sizeof(segCoarseArena), "Coarse segmentation")) {
+        return 1;
+    }
+    if (segCoarseInterpreter->input(0)->dims->data[2] != HK_SEG_COARSE_FRAME ||
+        segCoarseInterpreter->output(0)->dims->data[1] != HK_SEG_COARSE_FRAME) {
+        TF_LITE_REPORT_ERROR(errorReporter, "Coarse segmentation model does not take HK_SEG_COARSE_FRAME samples");
+        return 1;
+    }
+#endif
 
     // Load Beat interpreter
-#ifdef BEAT_ENABLE
+#ifdef HK_BEAT_MODEL_ENABLE
     beatModel = tflite::GetModel(g_beat_model);
     if (beatModel->version() != TFLITE_SCHEMA_VERSION) {
         TF_LITE_REPORT_ERROR(errorReporter, "Schema mismatch: given=%d != expected=%d.", beatModel->version(), TFLITE_SCHEMA_VERSION);
         return 1;
     }
 
+#ifdef HK_PROFILE_ENABLE
+    modelProfilers[HeartModelBeat].Init(beatModel);
+#endif
+
     static tflite::MicroInterpreter beat_interpreter(beatModel, opResolver, beatTensorArena, beatTensorArenaSize, errorReporter);
     beatInterpreter = &beat_interpreter;
 
@@ -148,27 +582,55 @@ init_models() {
     beatModelOutput = beatInterpreter->output(0);
     ns_printf("Beat model needs %d bytes\n", bytesUsed);
 #endif
+
+#ifdef HK_MULTIHEAD_ENABLE
+    if (init_multihead(opResolver)) {
+        return 1;
+    }
+#endif
+#ifdef HK_ARR_EXIT_MODEL_ENABLE
+    if (init_arr_exit(opResolver)) {
+        return 1;
+    }
+#endif
+#ifdef HK_CASCADE_ENABLE
+    if (init_cascades(opResolver)) {
+        return 1;
+    }
+#endif
     return 0;
 }
 
 int
-arrhythmia_inference(float32_t *x, float32_t threshold) {
+arrhythmia_inference(float32_t *x, float32_t threshold, float32_t *y) {
     /**
      * @brief Run arrhythmia inference
      * @param x Model inputs
-     * @param y Model outputs
+     * @param threshold Exit confidence with HK_ARR_EXIT_ENABLE (unused by the single model)
+     * @param y Dequantized model outputs [HK_ARR_CLASSES] (nullptr to skip)
      * @return Arryhythmia label index (-1 if err)
      */
     uint32_t yIdx = 0;
     float32_t yVal = 0;
     float32_t yMax = 0;
-#ifdef ARRHTYHMIA_ENABLE
+#ifdef HK_ARR_EXIT_MODEL_ENABLE
+    TfLiteTensor *input = arrExitModel.Input();
+    for (int i = 0; i < input->dims->data[2]; i++) {
+        input->data.int8[i] = x[i] / input->params.scale + input->params.zero_point;
+    }
+    return arrExitModel.Invoke(threshold, y, nullptr);
+#elif defined(HK_ARR_CASCADE_ENABLE)
+    return arrCascade.Invoke(arr_fill, x, y, nullptr);
+#elif defined(HK_ARR_MODEL_ENABLE)
     // Quantize input
     for (int i = 0; i < arrModelInput->dims->data[2]; i++) {
         arrModelInput->data.int8[i] = x[i] / arrModelInput->params.scale + arrModelInput->params.zero_point;
     }
 
     // Invoke model
+#ifdef HK_PROFILE_ENABLE
+    modelProfilers[HeartModelArrhythmia].StartInvoke();
+#endif
     TfLiteStatus invokeStatus = arrInterpreter->Invoke();
     if (invokeStatus != kTfLiteOk) {
         return -1;
@@ -177,6 +639,9 @@ arrhythmia_inference(float32_t *x, float32_t threshold) {
     // Dequantize output
     for (int i = 0; i < arrModelOutput->dims->data[1]; i++) {
         yVal = ((float32_t)arrModelOutput->data.int8[i] - arrModelOutput->params.zero_point) * arrModelOutput->params.scale;
+        if (y != nullptr) {
+            y[i] = yVal;
+        }
         if ((i == 0) || (yVal > yMax)) {
             yMax = yVal;
             yIdx = i;
@@ -186,6 +651,25 @@ arrhythmia_inference(float32_t *x, float32_t threshold) {
     return yIdx;
 }
 
+int
+arrhythmia_exits(uint32_t *exits, uint32_t *cyclesSaved) {
+    /**
+     * @brief Early-exit statistics since boot
+     * @param exits Arrhythmia blocks that stopped after each part [HK_ARR_EXIT_PARTS]
+     * @param cyclesSaved Mean cycles per block saved against running every part
+     * @return Number of parts (0 without HK_ARR_EXIT_ENABLE)
+     */
+#ifdef HK_ARR_EXIT_MODEL_ENABLE
+    for (int32_t p = 0; p < arrExitModel.NumParts(); p++) {
+        exits[p] = arrExitModel.Part(p)->exits;
+    }
+    *cyclesSaved = arrExitModel.AverageCyclesSaved();
+    return arrExitModel.NumParts();
+#else
+    return 0;
+#endif
+}
+
 int
 segmentation_inference(float32_t *data, uint8_t *segMask, uint32_t padLen) {
     /**
@@ -199,12 +683,15 @@ segmentation_inference(float32_t *data, uint8_t *segMask, uint32_t padLen) {
     uint8_t yMaxIdx = 0;
     float32_t yVal = 0;
     float32_t yMax = 0;
-#ifdef SEGMENTATION_ENABLE
+#if defined(HK_SEG_MODEL_ENABLE) && !defined(HK_SEG_STREAM_ENABLE)
     // Quantize input
     for (int i = 0; i < segModelInput->dims->data[2]; i++) {
         segModelInput->data.int8[i] = data[i] / segModelInput->params.scale + segModelInput->params.zero_point;
     }
     // Invoke model
+#ifdef HK_PROFILE_ENABLE
+    modelProfilers[HeartModelSegmentation].StartInvoke();
+#endif
     TfLiteStatus invokeStatus = segInterpreter->Invoke();
     if (invokeStatus != kTfLiteOk) {
         return -1;
@@ -226,20 +713,153 @@ segmentation_inference(float32_t *data, uint8_t *segMask, uint32_t padLen) {
     return 0;
 }
 
+#if defined(HK_SEG_MODEL_ENABLE) && defined(HK_SEG_STREAM_ENABLE)
+static void
+segmentation_stream_labels(const int8_t *rows, int32_t len, uint8_t *segMask) {
+    /**
+     * @brief Label each output row with its largest class (dequantizing preserves the order)
+     */
+    const int32_t channels = segStream.OutputChannels();
+    for (int32_t i = 0; i < len; i++) {
+        uint8_t yMaxIdx = 0;
+        for (int32_t j = 1; j < channels; j++) {
+            yMaxIdx = rows[i * channels + j] > rows[i * channels + yMaxIdx] ? j : yMaxIdx;
+        }
+        segMask[i] = yMaxIdx;
+    }
+}
+#endif
+
 int
-beat_inference(float32_t *pBeat, float32_t *beat, float32_t *nBeat) {
+segmentation_stream(float32_t *data, uint8_t *segMask, uint32_t len) {
+    /**
+     * @brief Run segmentation over a signal by streaming it through the model
+     * @param data Signal
+     * @param segMask Output segmentation mask (the last len % stream alignment samples are not labeled)
+     * @param len Signal length
+     * @return Success (-1 if err)
+     */
+#if defined(HK_SEG_MODEL_ENABLE) && defined(HK_SEG_STREAM_ENABLE)
+    int8_t x[HK_SEG_STREAM_STEP];
+    int32_t count;
+    uint32_t yIdx = 0;
+    len -= len % segStream.Align();
+    segStream.Reset();
+    hk_stream_window_reset(&segStreamWindow);
+    for (uint32_t i = 0; i < len; i += HK_SEG_STREAM_STEP) {
+        uint32_t xLen = MIN(HK_SEG_STREAM_STEP, len - i);
+        // Quantize input
+        for (uint32_t j = 0; j < xLen; j++) {
+            x[j] = data[i + j] / segStream.InputScale() + segStream.InputZeroPoint();
+        }
+        count = segStream.Push(x, xLen);
+        if (count < 0) {
+            return -1;
+        }
+        segmentation_stream_labels(segStream.Output(), count, &segMask[yIdx]);
+        yIdx += count;
+    }
+    while ((count = segStream.Finish()) > 0) {
+        segmentation_stream_labels(segStream.Output(), count, &segMask[yIdx]);
+        yIdx += count;
+    }
+    return count < 0 ? -1 : 0;
+#else
+    return -1;
+#endif
+}
+
+int
+segmentation_stream_window(float32_t *data, uint32_t start, uint8_t *segMask) {
+    /**
+     * @brief Run segmentation over a window by continuing the stream of the last one (stream_window.cc)
+     * @param data Signal [HK_DATA_LEN]
+     * @param start Absolute index of data[0]
+     * @param segMask Output segmentation mask (the positions inside the stream latency are not labeled) [HK_DATA_LEN]
+     * @return Success (-1 if err)
+     */
+#if defined(HK_SEG_MODEL_ENABLE) && defined(HK_SEG_STREAM_ENABLE)
+    return hk_stream_window_run(&segStream, &segStreamWindow, data, start, segMask);
+#else
+    return -1;
+#endif
+}
+
+void
+segmentation_stream_reset(void) {
+    /**
+     * @brief Restart the stream carried across windows on the next one
+     */
+#if defined(HK_SEG_MODEL_ENABLE) && defined(HK_SEG_STREAM_ENABLE)
+    hk_stream_window_reset(&segStreamWindow);
+#endif
+}
+
+int
+segmentation_coarse(float32_t *data, uint8_t *segMask) {
+    /**
+     * @brief Run the coarse segmentation model over a decimated window
+     * @param data Decimated signal [HK_SEG_COARSE_FRAME]
+     * @param segMask Output coarse mask [HK_SEG_COARSE_FRAME]
+     * @return Success (-1 if err)
+     */
+#ifdef HK_SEG_COARSE_MODEL_ENABLE
+    TfLiteTensor *input = segCoarseInterpreter->input(0);
+    for (int i = 0; i < HK_SEG_COARSE_FRAME; i++) {
+        input->data.int8[i] = data[i] / input->params.scale + input->params.zero_point;
+    }
+    if (segCoarseInterpreter->Invoke() != kTfLiteOk) {
+        return -1;
+    }
+    // Largest class of each row (dequantizing preserves the order)
+    const TfLiteTensor *output = segCoarseInterpreter->output(0);
+    const int32_t channels = output->dims->data[2];
+    for (int i = 0; i < HK_SEG_COARSE_FRAME; i++) {
+        uint8_t yMaxIdx = 0;
+        for (int32_t j = 1; j < channels; j++) {
+            yMaxIdx = output->data.int8[i * channels + j] > output->data.int8[i * channels + yMaxIdx] ? j : yMaxIdx;
+        }
+        segMask[i] = yMaxIdx;
+    }
+#endif
+    return 0;
+}
+
+uint32_t
+segmentation_stream_align(void) {
+    /**
+     * @brief Samples a streamed segment length should be a multiple of (segmentation_stream)
+     */
+#if defined(HK_SEG_MODEL_ENABLE) && defined(HK_SEG_STREAM_ENABLE)
+    return segStream.Align();
+#else
+    return 1;
+#endif
+}
+
+int
+beat_inference(float32_t *pBeat, float32_t *beat, float32_t *nBeat, float32_t *margin) {
     /**
      * @brief Run beat inference
      * @param pBeat Previous beat input
      * @param beat Target beat input
      * @param nBeat Next beat input
+     * @param margin Softmax top minus runner-up of the label (nullptr to skip)
      * @return Beat label index (-1 if err)
      */
     uint32_t xIdx = 0;
     uint32_t yIdx = 0;
     float32_t yVal = 0;
     float32_t yMax = 0;
-#ifdef BEAT_ENABLE
+#if defined(HK_BEAT_CASCADE_ENABLE)
+    const beat_sample_t sample = {pBeat, beat, nBeat};
+    int32_t level;
+    const int32_t label = beatCascade.Invoke(beat_fill, &sample, nullptr, &level);
+    if (label != -1 && margin != nullptr) {
+        *margin = cascade_margin(beatCascade.Level(level)->interpreter->output(0), nullptr);
+    }
+    return label;
+#elif defined(HK_BEAT_MODEL_ENABLE)
     // Quantize input
     for (int i = 0; i < beatModelInput->dims->data[2]; i++) {
         beatModelInput->data.int8[xIdx++] = pBeat[i] / beatModelInput->params.scale + beatModelInput->params.zero_point;
@@ -247,6 +867,9 @@ beat_inference(float32_t *pBeat, float32_t *beat, float32_t *nBeat) {
         beatModelInput->data.int8[xIdx++] = nBeat[i] / beatModelInput->params.scale + beatModelInput->params.zero_point;
     }
     // Invoke model
+#ifdef HK_PROFILE_ENABLE
+    modelProfilers[HeartModelBeat].StartInvoke();
+#endif
     TfLiteStatus invokeStatus = beatInterpreter->Invoke();
     if (invokeStatus != kTfLiteOk) {
         return -1;
@@ -259,6 +882,185 @@ beat_inference(float32_t *pBeat, float32_t *beat, float32_t *nBeat) {
             yIdx = i;
         }
     }
+    if (margin != nullptr) {
+        *margin = cascade_margin(beatModelOutput, nullptr);
+    }
+#endif
+    return yIdx;
+}
+
+int
+cascade_invokes(HeartModel model, uint32_t *smallInvokes, uint32_t *largeInvokes) {
+    /**
+     * @brief Invocations of each level of a model's cascade since boot
+     * @param model Arrhythmia or beat
+     * @param smallInvokes Small model invokes (every sample)
+     * @param largeInvokes Standalone model invokes (samples under the margin)
+     * @return Success (-1 if the model has no cascade)
+     */
+#ifdef HK_CASCADE_ENABLE
+    const CascadeModel *cascade = nullptr;
+#ifdef HK_ARR_CASCADE_ENABLE
+    cascade = model == HeartModelArrhythmia ? &arrCascade : cascade;
+#endif
+#ifdef HK_BEAT_CASCADE_ENABLE
+    cascade = model == HeartModelBeat ? &beatCascade : cascade;
+#endif
+    if (cascade == nullptr) {
+        return -1;
+    }
+    *smallInvokes = cascade->Level(0)->invokes;
+    *largeInvokes = cascade->Level(1)->invokes;
+    return 0;
+#else
+    return -1;
+#endif
+}
+
+int
+multihead_backbone(float32_t *data, uint32_t start) {
+    /**
+     * @brief Run the backbone on the window of HK_MH_LEN samples at start, for the heads to share
+     * @param data Signal
+     * @param start Window start, a multiple of HK_MH_BEAT_STRIDE
+     * @return Success (-1 if err)
+     */
+#ifdef HK_MULTIHEAD_ENABLE
+    TfLiteTensor *input = mhModel.Input();
+    // Quantize input
+    for (int i = 0; i < HK_MH_LEN; i++) {
+        input->data.int8[i] = data[start + i] / input->params.scale + input->params.zero_point;
+    }
+    if (mhModel.InvokeBackbone() != kTfLiteOk) {
+        return -1;
+    }
+#ifdef BEAT_ENABLE
+    // Keep the beat features past the overlap with the previous window, which saw them closer to its edge
+    const TfLiteTensor *feature = mhModel.Feature(mhBeatFeature);
+    const uint32_t first = (start > 0 ? start + HK_MH_OLP : 0) / HK_MH_BEAT_STRIDE;
+    const uint32_t end = (start + HK_MH_LEN) / HK_MH_BEAT_STRIDE;
+    memcpy(&mhBeatFeatures[first * HK_MH_BEAT_CHANNELS], &feature->data.int8[(first - start / HK_MH_BEAT_STRIDE) * HK_MH_BEAT_CHANNELS],
+           (end - first) * HK_MH_BEAT_CHANNELS);
+#endif
+    return 0;
+#else
+    return -1;
+#endif
+}
+
+int
+multihead_arrhythmia(float32_t *y) {
+    /**
+     * @brief Run the arrhythmia head on the last backbone pass
+     * @param y Dequantized head outputs [HK_ARR_CLASSES] (nullptr to skip)
+     * @return Arryhythmia label index (-1 if err)
+     */
+    uint32_t yIdx = 0;
+#if defined(HK_MULTIHEAD_ENABLE) && defined(ARRHTYHMIA_ENABLE)
+    float32_t yVal = 0;
+    float32_t yMax = 0;
+    if (mhModel.InvokeHead(mhArrHead) != kTfLiteOk) {
+        return -1;
+    }
+    // Dequantize output
+    const TfLiteTensor *output = mhModel.HeadOutput(mhArrHead);
+    for (int i = 0; i < HK_ARR_CLASSES; i++) {
+        yVal = ((float32_t)output->data.int8[i] - output->params.zero_point) * output->params.scale;
+        if (y != nullptr) {
+            y[i] = yVal;
+        }
+        if ((i == 0) || (yVal > yMax)) {
+            yMax = yVal;
+            yIdx = i;
+        }
+    }
+#endif
+    return yIdx;
+}
+
+int
+multihead_segmentation(uint8_t *segMask, uint32_t padLen) {
+    /**
+     * @brief Run the segmentation head on the last backbone pass
+     * @param segMask Output segmentation mask of the window
+     * @param padLen Samples at each window edge left unlabeled
+     * @return Success (-1 if err)
+     */
+#if defined(HK_MULTIHEAD_ENABLE) && defined(SEGMENTATION_ENABLE)
+    if (mhModel.InvokeHead(mhSegHead) != kTfLiteOk) {
+        return -1;
+    }
+    // Rows keep their order when dequantized, so label with the largest int8 output
+    const TfLiteTensor *output = mhModel.HeadOutput(mhSegHead);
+    const int32_t channels = output->dims->data[2];
+    for (int32_t i = padLen; i < HK_MH_LEN - (int32_t)padLen; i++) {
+        const int8_t *row = &output->data.int8[i * channels];
+        uint8_t yMaxIdx = 0;
+        for (int32_t j = 1; j < channels; j++) {
+            yMaxIdx = row[j] > row[yMaxIdx] ? j : yMaxIdx;
+        }
+        segMask[i] = yMaxIdx;
+    }
+#endif
+    return 0;
+}
+
+int
+multihead_beat(uint32_t pStart, uint32_t start, uint32_t nStart, float32_t *margin) {
+    /**
+     * @brief Run the beat head on the backbone features of three beats of the signal
+     * @param pStart Previous beat start
+     * @param start Target beat start
+     * @param nStart Next beat start
+     * @param margin Softmax top minus runner-up of the label (nullptr to skip)
+     * @return Beat label index (-1 if err)
+     */
+    uint32_t yIdx = 0;
+#if defined(HK_MULTIHEAD_ENABLE) && defined(BEAT_ENABLE)
+    const uint32_t starts[3] = {pStart / HK_MH_BEAT_STRIDE, start / HK_MH_BEAT_STRIDE, nStart / HK_MH_BEAT_STRIDE};
+    TfLiteTensor *input = mhModel.HeadInput(mhBeatHead, 0);
+    int8_t *x = input->data.int8;
+    for (int32_t i = 0; i < HK_BEAT_LEN / HK_MH_BEAT_STRIDE; i++) {
+        for (int32_t b = 0; b < 3; b++) {
+            mh_requant(&mhBeatRequant, &mhBeatFeatures[(starts[b] + i) * HK_MH_BEAT_CHANNELS], x, HK_MH_BEAT_CHANNELS);
+            x += HK_MH_BEAT_CHANNELS;
+        }
+    }
+    if (mhModel.InvokeHead(mhBeatHead) != kTfLiteOk) {
+        return -1;
+    }
+    const TfLiteTensor *output = mhModel.HeadOutput(mhBeatHead);
+    for (int32_t i = 1; i < output->dims->data[1]; i++) {
+        yIdx = output->data.int8[i] > output->data.int8[yIdx] ? i : yIdx;
+    }
+    if (margin != nullptr) {
+        *margin = cascade_margin(output, nullptr);
+    }
 #endif
     return yIdx;
 }
+
+#ifdef HK_PROFILE_ENABLE
+uint32_t
+model_op_profile(HeartModel model, const hk_op_profile_t **ops) {
+    /**
+     * @brief Get per-operator profile table of model
+     * @param model Model
+     * @param ops Output table
+     * @return # operators in table
+     */
+    *ops = modelProfilers[model].Ops();
+    return modelProfilers[model].NumOps();
+}
+
+void
+model_op_profile_reset(void) {
+    /**
+     * @brief Clear accumulated ticks of every model
+     *
+     */
+    for (size_t i = 0; i < HeartModelCount; i++) {
+        modelProfilers[i].Reset();
+    }
+}
+#endif
@@ -12,13 +12,47 @@
 #define __MODEL_H
 
 #include "arm_math.h"
+#include "constants.h"
+
+enum HeartModel { HeartModelArrhythmia, HeartModelSegmentation, HeartModelBeat, HeartModelCount };
+typedef enum HeartModel HeartModel;
 
 uint32_t
 init_models(void);
 int
-arrhythmia_inference(float32_t *x, float32_t threshold);
+arrhythmia_inference(float32_t *x, float32_t threshold, float32_t *y);
+int
+arrhythmia_exits(uint32_t *exits, uint32_t *cyclesSaved);
 int
 segmentation_inference(float32_t *data, uint8_t *segMask, uint32_t padLen);
 int
-beat_inference(float32_t *pBeat, float32_t *beat, float32_t *nBeat);
+segmentation_stream(float32_t *data, uint8_t *segMask, uint32_t len);
+int
+segmentation_stream_window(float32_t *data, uint32_t start, uint8_t *segMask);
+void
+segmentation_stream_reset(void);
+int
+segmentation_coarse(float32_t *data, uint8_t *segMask);
+uint32_t
+segmentation_stream_align(void);
+int
+beat_inference(float32_t *pBeat, float32_t *beat, float32_t *nBeat, float32_t *margin);
+int
+cascade_invokes(HeartModel model, uint32_t *smallInvokes, uint32_t *largeInvokes);
+int
+multihead_backbone(float32_t *data, uint32_t start);
+int
+multihead_arrhythmia(float32_t *y);
+int
+multihead_segmentation(uint8_t *segMask, uint32_t padLen);
+int
+multihead_beat(uint32_t pStart, uint32_t start, uint32_t nStart, float32_t *margin);
+
+#ifdef HK_PROFILE_ENABLE
+    #include "model_profiler.h"
+uint32_t
+model_op_profile(HeartModel model, const hk_op_profile_t **ops);
+void
+model_op_profile_reset(void);
+#endif
 #endif // __MODEL_H
@@ -0,0 +1,26 @@
+/**
+ * @file model_arena.h
+ * @brief Tensor arena sizes. GENERATED by host/arena_sizer.cc (make -C host arena), do not edit.
+ *
+ * Sizes are persistent (rescaled to 32-bit) + non-persistent usage recorded on host, plus CMSIS-NN scratch,
+ * aligned to 16 bytes with 1024 bytes headroom.
+ */
+#ifndef __MODEL_ARENA_H
+#define __MODEL_ARENA_H
+
+// persistent=21012 nonpersistent=20608 scratch=1792 target-scratch=0
+#define HK_ARR_ARENA_SIZE (42672)
+#define HK_ARR_MODEL_LEN (191600)
+
+// persistent=18196 nonpersistent=39936 scratch=0 target-scratch=0
+#define HK_SEG_ARENA_SIZE (59184)
+#define HK_SEG_MODEL_LEN (164512)
+
+// persistent=21268 nonpersistent=4608 scratch=1792 target-scratch=0
+#define HK_BEAT_ARENA_SIZE (26928)
+#define HK_BEAT_MODEL_LEN (195792)
+
+// step=16 latency=109
+#define HK_SEG_STREAM_ARENA_SIZE (21536)
+
+#endif // __MODEL_ARENA_H
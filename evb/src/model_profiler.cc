@@ -0,0 +1,222 @@
+/**
+ * @file model_profiler.cc
+ * @author Adam Page (adam.page@ambiq.com)
+ * @brief Per-operator cycle tables for TFLM models
+ * @version 1.0
+ * @date 2023-05-02
+ *
+ * @copyright Copyright (c) 2023
+ *
+ */
+#include <cstring>
+
+#include "am_mcu_apollo.h"
+
+#include "tensorflow/lite/schema/schema_utils.h"
+
+#include "concat_conv_kernels.h"
+#include "mbconv_kernels.h"
+#include "model_profiler.h"
+
+// Profiler receiving events from wrapped kernels (set by OpProfiler::StartInvoke)
+static OpProfiler *activeProfiler = nullptr;
+
+typedef struct {
+    tflite::BuiltinOperator op;
+    const char *custom; // Custom op name (nullptr for builtins)
+    const char *tag;
+    TfLiteStatus (*invoke)(TfLiteContext *context, TfLiteNode *node);
+    TfLiteRegistration registration;
+} profiled_op_t;
+
+static profiled_op_t profiledOps[HK_PROFILE_MAX_OP_TYPES];
+static uint32_t numProfiledOps = 0;
+
+template <int Slot>
+static TfLiteStatus
+profiled_invoke(TfLiteContext *context, TfLiteNode *node) {
+    if (activeProfiler == nullptr) {
+        return profiledOps[Slot].invoke(context, node);
+    }
+    uint32_t handle = activeProfiler->BeginEvent(profiledOps[Slot].tag);
+    TfLiteStatus status = profiledOps[Slot].invoke(context, node);
+    activeProfiler->EndEvent(handle);
+    return status;
+}
+
+#define PROFILED_INVOKE_4(n) profiled_invoke<n>, profiled_invoke<n + 1>, profiled_invoke<n + 2>, profiled_invoke<n + 3>
+static TfLiteStatus (*const profiledInvokes[HK_PROFILE_MAX_OP_TYPES])(TfLiteContext *, TfLiteNode *) = {
+    PROFILED_INVOKE_4(0), PROFILED_INVOKE_4(4), PROFILED_INVOKE_4(8), PROFILED_INVOKE_4(12), PROFILED_INVOKE_4(16), PROFILED_INVOKE_4(20)};
+
+static void
+copy_shape(const tflite::SubGraph *subgraph, int32_t tensorIdx, int16_t *shape) {
+    memset(shape, 0, 4 * sizeof(int16_t));
+    if (tensorIdx < 0 || subgraph->tensors()->Get(tensorIdx)->shape() == nullptr) {
+        return;
+    }
+    auto dims = subgraph->tensors()->Get(tensorIdx)->shape();
+    for (uint32_t i = 0; i < dims->size() && i < 4; i++) {
+        shape[i] = (int16_t)dims->Get(i);
+    }
+}
+
+static uint32_t
+shape_size(const int16_t *shape) {
+    uint32_t size = 1;
+    for (uint32_t i = 0; i < 4 && shape[i]; i++) {
+        size *= shape[i];
+    }
+    return size;
+}
+
+static uint32_t
+estimate_macs(tflite::BuiltinOperator op, const int16_t *inShape, const int16_t *outShape, const int16_t *wShape) {
+    /**
+     * @brief Estimate MACs of an operator from its tensor shapes
+     * @param op Builtin operator
+     * @param inShape Input shape
+     * @param outShape Output shape
+     * @param wShape Weights (input 1) shape
+     * @return MACs per invoke
+     */
+    switch (op) {
+    case tflite::BuiltinOperator_CONV_2D:
+        // Filter is [out_c, kh, kw, in_c]
+        return shape_size(outShape) * wShape[1] * wShape[2] * wShape[3];
+    case tflite::BuiltinOperator_DEPTHWISE_CONV_2D:
+        // Filter is [1, kh, kw, out_c]
+        return shape_size(outShape) * wShape[1] * wShape[2];
+    case tflite::BuiltinOperator_TRANSPOSE_CONV:
+        return shape_size(inShape) * wShape[0] * wShape[1] * wShape[2];
+    case tflite::BuiltinOperator_FULLY_CONNECTED:
+        // Weights are [out, in]
+        return shape_size(outShape) * wShape[1];
+    default:
+        return shape_size(outShape);
+    }
+}
+
+void
+OpProfiler::Init(const tflite::Model *model) {
+    /**
+     * @brief Fill op type, shapes and MAC estimates for each operator of subgraph 0
+     * @param model TFLite model
+     */
+    const tflite::SubGraph *subgraph = model->subgraphs()->Get(0);
+    int16_t wShape[4];
+    m_numOps = subgraph->operators()->size() < HK_PROFILE_MAX_OPS ? subgraph->operators()->size() : HK_PROFILE_MAX_OPS;
+    for (uint32_t i = 0; i < m_numOps; i++) {
+        const tflite::Operator *op = subgraph->operators()->Get(i);
+        tflite::BuiltinOperator code = tflite::GetBuiltinCode(model->operator_codes()->Get(op->opcode_index()));
+        hk_op_profile_t *row = &m_ops[i];
+        const char *tag = tflite::EnumNameBuiltinOperator(code);
+        if (code == tflite::BuiltinOperator_CUSTOM && model->operator_codes()->Get(op->opcode_index())->custom_code()) {
+            tag = model->operator_codes()->Get(op->opcode_index())->custom_code()->c_str();
+        }
+        strncpy(row->tag, tag, HK_PROFILE_TAG_LEN - 1);
+        row->tag[HK_PROFILE_TAG_LEN - 1] = '\0';
+        copy_shape(subgraph, op->inputs()->size() > 0 ? op->inputs()->Get(0) : -1, row->inShape);
+        copy_shape(subgraph, op->outputs()->size() > 0 ? op->outputs()->Get(0) : -1, row->outShape);
+        copy_shape(subgraph, op->inputs()->size() > 1 ? op->inputs()->Get(1) : -1, wShape);
+        row->macs = estimate_macs(code, row->inShape, row->outShape, wShape);
+        // Fused MBConv: depthwise [1, 1, K, C] over the input, plus the projection for HK_MBCONV
+        if (strcmp(tag, HK_MBCONV_SQUEEZE_OP_NAME) == 0 || strcmp(tag, HK_MBCONV_OP_NAME) == 0) {
+            row->macs = shape_size(row->inShape) * wShape[2];
+        }
+        if (strcmp(tag, HK_MBCONV_OP_NAME) == 0) {
+            row->macs += shape_size(row->outShape) * row->inShape[3];
+        }
+        // Conv over concatenated inputs: filter slices [Cout, 1, K, Ci] follow each input
+        if (strcmp(tag, HK_CONCAT_CONV_OP_NAME) == 0) {
+            int32_t window = 0;
+            for (uint32_t j = 1; j < op->inputs()->size(); j += 2) {
+                copy_shape(subgraph, op->inputs()->Get(j), wShape);
+                window += wShape[2] * wShape[3];
+            }
+            row->macs = shape_size(row->outShape) * window;
+        }
+    }
+    Reset();
+}
+
+void
+OpProfiler::StartInvoke(void) {
+    m_nextOp = 0;
+    activeProfiler = this;
+}
+
+void
+OpProfiler::Reset(void) {
+    for (uint32_t i = 0; i < m_numOps; i++) {
+        m_ops[i].ticks = 0;
+        m_ops[i].invokes = 0;
+    }
+}
+
+uint32_t
+OpProfiler::BeginEvent(const char *tag) {
+    uint32_t handle = m_nextOp++;
+    if (handle < m_numOps) {
+        m_startTicks[handle] = DWT->CYCCNT;
+    }
+    return handle;
+}
+
+void
+OpProfiler::EndEvent(uint32_t event_handle) {
+    if (event_handle < m_numOps) {
+        m_ops[event_handle].ticks += DWT->CYCCNT - m_startTicks[event_handle];
+        m_ops[event_handle].invokes += 1;
+    }
+}
+
+static const TfLiteRegistration *
+profile_op(const TfLiteRegistration *registration, tflite::BuiltinOperator op, const char *custom) {
+    /**
+     * @brief Copy registration into the next slot with its invoke wrapped
+     * @return Registration (unwrapped if out of slots)
+     */
+    if (registration == nullptr || registration->invoke == nullptr || numProfiledOps >= HK_PROFILE_MAX_OP_TYPES) {
+        return registration;
+    }
+    profiled_op_t *slot = &profiledOps[numProfiledOps];
+    slot->op = op;
+    slot->custom = custom;
+    slot->tag = custom ? custom : tflite::EnumNameBuiltinOperator(op);
+    slot->invoke = registration->invoke;
+    slot->registration = *registration;
+    slot->registration.invoke = profiledInvokes[numProfiledOps];
+    numProfiledOps++;
+    return &slot->registration;
+}
+
+const TfLiteRegistration *
+ProfilingOpResolver::FindOp(tflite::BuiltinOperator op) const {
+    /**
+     * @brief Return a copy of the kernel registration whose invoke is wrapped with profiler events
+     * @param op Builtin operator
+     * @return Registration (unwrapped if out of slots)
+     */
+    for (uint32_t i = 0; i < numProfiledOps; i++) {
+        if (profiledOps[i].custom == nullptr && profiledOps[i].op == op) {
+            return &profiledOps[i].registration;
+        }
+    }
+    return profile_op(m_resolver.FindOp(op), op, nullptr);
+}
+
+const TfLiteRegistration *
+ProfilingOpResolver::FindOp(const char *op) const {
+    /**
+     * @brief Custom op counterpart of FindOp(BuiltinOperator)
+     * @param op Custom op name
+     * @return Registration (unwrapped if out of slots)
+     */
+    for (uint32_t i = 0; i < numProfiledOps; i++) {
+        if (profiledOps[i].custom != nullptr && strcmp(profiledOps[i].custom, op) == 0) {
+            return &profiledOps[i].registration;
+        }
+    }
+    const TfLiteRegistration *registration = m_resolver.FindOp(op);
+    return profile_op(registration, tflite::BuiltinOperator_CUSTOM, registration ? registration->custom_name : nullptr);
+}
@@ -0,0 +1,92 @@
+/**
+ * @file model_profiler.h
+ * @author Adam Page (adam.page@ambiq.com)
+ * @brief Per-operator cycle tables for TFLM models
+ * @version 1.0
+ * @date 2023-05-02
+ *
+ * @copyright Copyright (c) 2023
+ *
+ */
+#ifndef __MODEL_PROFILER_H
+#define __MODEL_PROFILER_H
+
+#include <stdint.h>
+
+#include "tensorflow/lite/micro/micro_op_resolver.h"
+#include "tensorflow/lite/micro/micro_profiler.h"
+#include "tensorflow/lite/schema/schema_generated.h"
+
+#define HK_PROFILE_MAX_OPS (64)
+#define HK_PROFILE_MAX_OP_TYPES (24)
+#define HK_PROFILE_TAG_LEN (20)
+
+typedef struct {
+    char tag[HK_PROFILE_TAG_LEN]; // Builtin or custom op name
+    uint32_t ticks;               // Cycles summed over invokes
+    uint32_t invokes;             // # invokes captured
+    uint32_t macs;                // Estimated MACs per invoke
+    int16_t inShape[4];           // Input 0 shape (0 = unused dim)
+    int16_t outShape[4];          // Output 0 shape (0 = unused dim)
+} hk_op_profile_t;
+
+/**
+ * @brief MicroProfiler that keeps one row per operator of subgraph 0.
+ * Event handles are operator indices, so BeginEvent must be called in execution order
+ * after StartInvoke().
+ */
+class OpProfiler : public tflite::MicroProfiler {
+  public:
+    OpProfiler() : m_numOps(0), m_nextOp(0), m_ops() {}
+    virtual ~OpProfiler() {}
+
+    void
+    Init(const tflite::Model *model);
+    void
+    StartInvoke(void);
+    void
+    Reset(void);
+    virtual uint32_t
+    BeginEvent(const char *tag) override;
+    virtual void
+    EndEvent(uint32_t event_handle) override;
+
+    uint32_t
+    NumOps(void) const {
+        return m_numOps;
+    }
+    const hk_op_profile_t *
+    Ops(void) const {
+        return m_ops;
+    }
+
+  private:
+    uint32_t m_numOps;
+    uint32_t m_nextOp;
+    uint32_t m_startTicks[HK_PROFILE_MAX_OPS];
+    hk_op_profile_t m_ops[HK_PROFILE_MAX_OPS];
+};
+
+/**
+ * @brief Op resolver that wraps each kernel's invoke with BeginEvent/EndEvent on the active OpProfiler.
+ * Needed because the prebuilt TFLM library is built with TF_LITE_STRIP_ERROR_STRINGS, which
+ * compiles out the interpreter's own profiler events.
+ */
+class ProfilingOpResolver : public tflite::MicroOpResolver {
+  public:
+    explicit ProfilingOpResolver(const tflite::MicroOpResolver &resolver) : m_resolver(resolver) {}
+
+    virtual const TfLiteRegistration *
+    FindOp(tflite::BuiltinOperator op) const override;
+    virtual const TfLiteRegistration *
+    FindOp(const char *op) const override;
+    virtual BuiltinParseFunction
+    GetOpDataParser(tflite::BuiltinOperator op) const override {
+        return m_resolver.GetOpDataParser(op);
+    }
+
+  private:
+    const tflite::MicroOpResolver &m_resolver;
+};
+
+#endif // __MODEL_PROFILER_H
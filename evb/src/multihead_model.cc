@@ -0,0 +1,152 @@
+/**
+ * @file multihead_model.cc
+ * @author Adam Page (adam.page@ambiq.com)
+ * @brief Heads sharing the features of one backbone pass
+ * @version 1.0
+ * @date 2023-05-02
+ *
+ * @copyright Copyright (c) 2023
+ *
+ * The arrhythmia, segmentation and beat models each start with their own encoder over the same
+ * signal. The multihead export (heartkit/multihead.py) trains one encoder, the backbone, and
+ * exports it and a head per task as separate models, so hk_run encodes each window once and runs
+ * only the heads over its features. Models are split rather than exported as one graph so each head
+ * keeps running at its own rate and TFLM only ever invokes whole models.
+ *
+ * Each model is quantized with its own calibration, so a head input generally has a different range
+ * than the backbone output feeding it. Features are requantized on the copy into the head arena,
+ * which rounds once more but costs a multiply per feature, against the backbone pass it saves.
+ */
+#include <cstring>
+
+#include "tensorflow/lite/kernels/internal/common.h"
+#include "tensorflow/lite/kernels/internal/quantization_util.h"
+
+#include "multihead_model.h"
+
+//*****************************************************************************
+//*** Requantization
+TfLiteStatus
+mh_requant_init(mh_requant_t *requant, const TfLiteTensor *from, const TfLiteTensor *to) {
+    if (from->type != kTfLiteInt8 || to->type != kTfLiteInt8 || from->params.scale <= 0 || to->params.scale <= 0) {
+        return kTfLiteError;
+    }
+    requant->inputOffset = -from->params.zero_point;
+    requant->outputOffset = to->params.zero_point;
+    requant->identity = from->params.scale == to->params.scale && from->params.zero_point == to->params.zero_point;
+    tflite::QuantizeMultiplier((double)from->params.scale / to->params.scale, &requant->multiplier, &requant->shift);
+    return kTfLiteOk;
+}
+
+void
+mh_requant(const mh_requant_t *requant, const int8_t *x, int8_t *y, int32_t len) {
+    if (requant->identity) {
+        memcpy(y, x, len);
+        return;
+    }
+    for (int32_t i = 0; i < len; i++) {
+        int32_t v = tflite::MultiplyByQuantizedMultiplier(x[i] + requant->inputOffset, requant->multiplier, requant->shift);
+        v += requant->outputOffset;
+        y[i] = (int8_t)(v < -128 ? -128 : v > 127 ? 127 : v);
+    }
+}
+
+//*****************************************************************************
+//*** MultiHeadModel
+static bool
+same_shape(const TfLiteTensor *a, const TfLiteTensor *b) {
+    if (a->dims->size != b->dims->size) {
+        return false;
+    }
+    for (int i = 0; i < a->dims->size; i++) {
+        if (a->dims->data[i] != b->dims->data[i]) {
+            return false;
+        }
+    }
+    return true;
+}
+
+TfLiteStatus
+MultiHeadModel::Init(tflite::MicroInterpreter *backbone) {
+    m_backbone = backbone;
+    m_numFeatures = backbone->outputs_size();
+    m_numHeads = 0;
+    m_ready = false;
+    for (int32_t i = 0; i < m_numFeatures; i++) {
+        if (backbone->output(i)->type != kTfLiteInt8) {
+            return kTfLiteError;
+        }
+    }
+    ResetCounters();
+    return kTfLiteOk;
+}
+
+int32_t
+MultiHeadModel::AddHead(tflite::MicroInterpreter *head) {
+    if (m_numHeads >= HK_MH_MAX_HEADS || head->inputs_size() > HK_MH_MAX_INPUTS) {
+        return -1;
+    }
+    mh_head_t *entry = &m_heads[m_numHeads];
+    entry->interpreter = head;
+    entry->numRouted = 0;
+    entry->invokes = 0;
+    for (int32_t i = 0; i < (int32_t)head->inputs_size(); i++) {
+        for (int32_t f = 0; f < m_numFeatures; f++) {
+            if (!same_shape(head->input(i), m_backbone->output(f))) {
+                continue;
+            }
+            if (mh_requant_init(&entry->requant[entry->numRouted], m_backbone->output(f), head->input(i)) != kTfLiteOk) {
+                return -1;
+            }
+            entry->inputs[entry->numRouted] = i;
+            entry->features[entry->numRouted] = f;
+            entry->numRouted++;
+            break;
+        }
+    }
+    return m_numHeads++;
+}
+
+TfLiteStatus
+MultiHeadModel::InvokeBackbone(void) {
+    m_ready = false;
+    TF_LITE_ENSURE_STATUS(m_backbone->Invoke());
+    m_backboneInvokes++;
+    m_ready = true;
+    return kTfLiteOk;
+}
+
+TfLiteStatus
+MultiHeadModel::InvokeHead(int32_t head) {
+    mh_head_t *entry = &m_heads[head];
+    if (entry->numRouted > 0 && !m_ready) {
+        return kTfLiteError;
+    }
+    for (int32_t i = 0; i < entry->numRouted; i++) {
+        const TfLiteTensor *feature = m_backbone->output(entry->features[i]);
+        TfLiteTensor *input = entry->interpreter->input(entry->inputs[i]);
+        mh_requant(&entry->requant[i], feature->data.int8, input->data.int8, input->bytes);
+    }
+    entry->invokes++;
+    return entry->interpreter->Invoke();
+}
+
+int32_t
+MultiHeadModel::FindFeature(int32_t width, int32_t channels) const {
+    for (int32_t f = 0; f < m_numFeatures; f++) {
+        const TfLiteTensor *feature = m_backbone->output(f);
+        const int32_t c = feature->dims->data[feature->dims->size - 1];
+        if (c == channels && (int32_t)feature->bytes == width * channels) {
+            return f;
+        }
+    }
+    return -1;
+}
+
+void
+MultiHeadModel::ResetCounters(void) {
+    m_backboneInvokes = 0;
+    for (int32_t i = 0; i < m_numHeads; i++) {
+        m_heads[i].invokes = 0;
+    }
+}
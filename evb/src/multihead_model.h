@@ -0,0 +1,145 @@
+/**
+ * @file multihead_model.h
+ * @author Adam Page (adam.page@ambiq.com)
+ * @brief Heads sharing the features of one backbone pass
+ * @version 1.0
+ * @date 2023-05-02
+ *
+ * @copyright Copyright (c) 2023
+ *
+ */
+#ifndef __MULTIHEAD_MODEL_H
+#define __MULTIHEAD_MODEL_H
+
+#include <stdint.h>
+
+#include "tensorflow/lite/micro/micro_interpreter.h"
+
+#define HK_MH_MAX_HEADS (4)
+#define HK_MH_MAX_INPUTS (4)
+
+/**
+ * @brief int8 to int8 requantization between tensors calibrated separately
+ */
+typedef struct {
+    int32_t inputOffset;  // -input zero point
+    int32_t outputOffset; // Output zero point
+    int32_t multiplier;   // Input scale / output scale
+    int shift;
+    bool identity;        // Same scale and zero point (plain copy)
+} mh_requant_t;
+
+/**
+ * @brief Requantization from tensor from to tensor to (both per-tensor int8)
+ */
+TfLiteStatus
+mh_requant_init(mh_requant_t *requant, const TfLiteTensor *from, const TfLiteTensor *to);
+
+/**
+ * @brief Requantize len values of x into y
+ */
+void
+mh_requant(const mh_requant_t *requant, const int8_t *x, int8_t *y, int32_t len);
+
+/**
+ * @brief Head of a MultiHeadModel. Each routed input is a copy of a backbone output of the same shape.
+ */
+typedef struct {
+    tflite::MicroInterpreter *interpreter;
+    int32_t numRouted;                          // Routed inputs
+    int32_t inputs[HK_MH_MAX_INPUTS];           // Head input index
+    int32_t features[HK_MH_MAX_INPUTS];         // Backbone output index
+    mh_requant_t requant[HK_MH_MAX_INPUTS];     // Backbone output to head input
+    uint32_t invokes;                           // Invokes since ResetCounters()
+} mh_head_t;
+
+/**
+ * @brief A backbone model producing features and head models consuming them.
+ *
+ * The backbone and each head are separate models with their own interpreter and arena. The backbone
+ * runs once per window and the features it outputs stay in its arena until its next invoke, so every
+ * head invoked in between reads the same pass. A head input is routed to the backbone output of the
+ * same shape and copied into the head arena before the head runs, requantized when the two models
+ * were calibrated to different ranges. Head inputs with no backbone output of their shape (e.g. a
+ * crop of features kept across windows) are filled by the caller.
+ */
+class MultiHeadModel {
+  public:
+    /**
+     * @brief Use an allocated backbone interpreter
+     * @return kTfLiteOk, or kTfLiteError if an output is not int8
+     */
+    TfLiteStatus
+    Init(tflite::MicroInterpreter *backbone);
+
+    /**
+     * @brief Add an allocated head interpreter, routing its inputs to the backbone outputs
+     * @return Head index, or -1 if there are too many heads or an input cannot be requantized
+     */
+    int32_t
+    AddHead(tflite::MicroInterpreter *head);
+
+    /**
+     * @brief Run the backbone on its input (Input())
+     */
+    TfLiteStatus
+    InvokeBackbone(void);
+
+    /**
+     * @brief Copy the routed features of the last backbone pass into head and run it
+     * @return kTfLiteError if head has routed inputs and the backbone has not run
+     */
+    TfLiteStatus
+    InvokeHead(int32_t head);
+
+    /**
+     * @brief Index of the backbone output of width (positions) and channels, or -1
+     */
+    int32_t
+    FindFeature(int32_t width, int32_t channels) const;
+
+    TfLiteTensor *
+    Input(void) {
+        return m_backbone->input(0);
+    }
+    TfLiteTensor *
+    Feature(int32_t index) {
+        return m_backbone->output(index);
+    }
+    int32_t
+    NumFeatures(void) const {
+        return m_numFeatures;
+    }
+    TfLiteTensor *
+    HeadInput(int32_t head, int32_t index) {
+        return m_heads[head].interpreter->input(index);
+    }
+    TfLiteTensor *
+    HeadOutput(int32_t head) {
+        return m_heads[head].interpreter->output(0);
+    }
+    int32_t
+    NumRouted(int32_t head) const {
+        return m_heads[head].numRouted;
+    }
+    uint32_t
+    BackboneInvokes(void) const {
+        return m_backboneInvokes;
+    }
+    uint32_t
+    HeadInvokes(int32_t head) const {
+        return m_heads[head].invokes;
+    }
+    void
+    ResetCounters(void);
+
+  private:
+    tflite::MicroInterpreter *m_backbone;
+    int32_t m_numFeatures;
+    bool m_ready;
+    uint32_t m_backboneInvokes;
+    mh_head_t m_heads[HK_MH_MAX_HEADS];
+    int32_t m_numHeads;
+};
+
+#endif // __MULTIHEAD_MODEL_H
@@ -0,0 +1,137 @@
+/**
+ * @file ns_malloc_pool.c
+ * @author Adam Page (adam.page@ambiq.com)
+ * @brief Size-class block pools backing ns_malloc/ns_free
+ * @version 1.0
+ * @date 2023-05-02
+ *
+ * @copyright Copyright (c) 2023
+ *
+ * Defines every symbol of ns_malloc.o (ns-utils.a) so eRPC and neuralSPOT allocations are
+ * served from fixed 32/256/4096 byte blocks. Allocation and free are O(1) (intrusive free list
+ * per class) and take no locks, so they must not be called from interrupt context. Requests that
+ * do not fit any class, or find every fitting class exhausted, fall back to heap_4.
+ */
+#include "ns_malloc_pool.h"
+#include "ns_ambiqsuite_harness.h"
+#include "ns_malloc.h"
+
+// Heap used by heap_4.c (configAPPLICATION_ALLOCATED_HEAP)
+uint8_t ucHeap[NS_MALLOC_HEAP_SIZE_IN_K * 1024];
+
+typedef struct ns_pool_block {
+    struct ns_pool_block *next;
+} ns_pool_block_t;
+
+typedef struct {
+    uint8_t *start;
+    uint8_t *end;
+    ns_pool_block_t *freeList;
+    uint32_t nextUnused;
+    ns_malloc_pool_stats_t stats;
+} ns_pool_t;
+
+static uint8_t poolSmall[NS_POOL_SMALL_COUNT][NS_POOL_SMALL_SIZE] __attribute__((aligned(8)));
+static uint8_t poolMedium[NS_POOL_MEDIUM_COUNT][NS_POOL_MEDIUM_SIZE] __attribute__((aligned(8)));
+static uint8_t poolLarge[NS_POOL_LARGE_COUNT][NS_POOL_LARGE_SIZE] __attribute__((aligned(8)));
+
+static ns_pool_t pools[NS_POOL_NUM_CLASSES] = {
+    {.start = &poolSmall[0][0],
+     .end = &poolSmall[NS_POOL_SMALL_COUNT][0],
+     .stats = {.blockSize = NS_POOL_SMALL_SIZE, .numBlocks = NS_POOL_SMALL_COUNT}},
+    {.start = &poolMedium[0][0],
+     .end = &poolMedium[NS_POOL_MEDIUM_COUNT][0],
+     .stats = {.blockSize = NS_POOL_MEDIUM_SIZE, .numBlocks = NS_POOL_MEDIUM_COUNT}},
+    {.start = &poolLarge[0][0],
+     .end = &poolLarge[NS_POOL_LARGE_COUNT][0],
+     .stats = {.blockSize = NS_POOL_LARGE_SIZE, .numBlocks = NS_POOL_LARGE_COUNT}},
+};
+
+static uint32_t heapFallbacks = 0;
+
+static void *
+pool_alloc(ns_pool_t *pool) {
+    void *ptr;
+    if (pool->freeList) {
+        ptr = pool->freeList;
+        pool->freeList = pool->freeList->next;
+    } else if (pool->nextUnused < pool->stats.numBlocks) {
+        // Blocks are handed out in order the first time so no init pass is needed
+        ptr = pool->start + pool->nextUnused * pool->stats.blockSize;
+        pool->nextUnused++;
+    } else {
+        pool->stats.numFailures++;
+        return NULL;
+    }
+    pool->stats.inUse++;
+    pool->stats.numAllocs++;
+    if (pool->stats.inUse > pool->stats.highWater) {
+        pool->stats.highWater = pool->stats.inUse;
+    }
+    return ptr;
+}
+
+uint8_t
+ns_malloc_init() {
+    return 0;
+}
+
+void *
+ns_malloc(size_t size) {
+    void *ptr;
+    if (size == 0) {
+        return NULL;
+    }
+    for (uint32_t i = 0; i < NS_POOL_NUM_CLASSES; i++) {
+        if (size <= pools[i].stats.blockSize) {
+            ptr = pool_alloc(&pools[i]);
+            if (ptr) {
+                return ptr;
+            }
+        }
+    }
+    heapFallbacks++;
+    return pvTasklessPortMalloc(size);
+}
+
+void
+ns_free(void *ptr) {
+    uint8_t *p = (uint8_t *)ptr;
+    if (ptr == NULL) {
+        return;
+    }
+    for (uint32_t i = 0; i < NS_POOL_NUM_CLASSES; i++) {
+        if (p >= pools[i].start && p < pools[i].end) {
+            ns_pool_block_t *block = (ns_pool_block_t *)ptr;
+            block->next = pools[i].freeList;
+            pools[i].freeList = block;
+            pools[i].stats.inUse--;
+            return;
+        }
+    }
+    vTasklessPortFree(ptr);
+}
+
+uint32_t
+ns_malloc_pool_stats(uint32_t cls, ns_malloc_pool_stats_t *stats) {
+    if (cls >= NS_POOL_NUM_CLASSES) {
+        return 1;
+    }
+    *stats = pools[cls].stats;
+    return 0;
+}
+
+uint32_t
+ns_malloc_heap_fallbacks(void) {
+    return heapFallbacks;
+}
+
+void
+ns_malloc_pool_print(void) {
+    for (uint32_t i = 0; i < NS_POOL_NUM_CLASSES; i++) {
+        ns_malloc_pool_stats_t *s = &pools[i].stats;
+        ns_printf("pool[%lu] size=%lu used=%lu/%lu high=%lu allocs=%lu fails=%lu\n", i, s->blockSize, s->inUse, s->numBlocks,
+                  s->highWater, s->numAllocs, s->numFailures);
+    }
+    ns_printf("heap fallbacks=%lu\n", heapFallbacks);
+}
@@ -0,0 +1,72 @@
+/**
+ * @file ns_malloc_pool.h
+ * @author Adam Page (adam.page@ambiq.com)
+ * @brief Size-class block pools backing ns_malloc/ns_free
+ * @version 1.0
+ * @date 2023-05-02
+ *
+ * @copyright Copyright (c) 2023
+ *
+ */
+#ifndef __NS_MALLOC_POOL_H
+#define __NS_MALLOC_POOL_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// Blocks per class. The pools are static RAM on top of NS_MALLOC_HEAP_SIZE_IN_K: 32 x 32 + 16 x 256 +
+// 2 x 4096 bytes (13 KB) at the defaults.
+#ifndef NS_POOL_SMALL_COUNT
+    #define NS_POOL_SMALL_COUNT (32)
+#endif
+#ifndef NS_POOL_MEDIUM_COUNT
+    #define NS_POOL_MEDIUM_COUNT (16)
+#endif
+#ifndef NS_POOL_LARGE_COUNT
+    #define NS_POOL_LARGE_COUNT (2)
+#endif
+
+#define NS_POOL_SMALL_SIZE (32)
+#define NS_POOL_MEDIUM_SIZE (256)
+#define NS_POOL_LARGE_SIZE (4096)
+#define NS_POOL_NUM_CLASSES (3)
+
+typedef struct {
+    uint32_t blockSize;  ///< Block size in bytes
+    uint32_t numBlocks;  ///< Blocks in class
+    uint32_t inUse;      ///< Blocks currently allocated
+    uint32_t highWater;  ///< Max blocks allocated at once
+    uint32_t numAllocs;  ///< Successful allocations
+    uint32_t numFailures; ///< Requests that found the class exhausted
+} ns_malloc_pool_stats_t;
+
+/**
+ * @brief Get stats for a size class
+ * @param cls Class index (0 = smallest)
+ * @param stats Output stats
+ * @return 0 on success, 1 if class is invalid
+ */
+uint32_t
+ns_malloc_pool_stats(uint32_t cls, ns_malloc_pool_stats_t *stats);
+
+/**
+ * @brief # allocations that fell through to the heap_4 allocator
+ */
+uint32_t
+ns_malloc_heap_fallbacks(void);
+
+/**
+ * @brief Print per-class stats
+ */
+void
+ns_malloc_pool_print(void);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // __NS_MALLOC_POOL_H
@@ -0,0 +1,354 @@
+/**
+ * @file pan_tompkins.cc
+ * @author Adam Page (adam.page@ambiq.com)
+ * @brief Streaming integer Pan-Tompkins QRS detector for the HR-only mode
+ * @version 1.0
+ * @date 2023-05-02
+ *
+ * @copyright Copyright (c) 2023
+ *
+ * Heart rate and RR intervals only need R peaks, and the segmentation model is an expensive way to
+ * find them. With HK_HR_ONLY_ENABLE hk_run gets them from the detector of Pan and Tompkins (1985):
+ * an integer bandpass (the 12-tap low pass and 32-tap high pass of the paper, whose poles cancel
+ * exactly in integer arithmetic), five-point derivative, squaring and a 150 ms moving-window
+ * integral, all adds and shifts on scaled int16 samples. Local maxima of the integral are QRS
+ * candidates once no larger one follows within the refractory period. A candidate over THR1 =
+ * NPKI + (SPKI - NPKI) / 4 is a QRS and moves the running signal peak SPKI, any other moves the
+ * running noise peak NPKI, and when no QRS comes for 166% of the RR average the largest noise
+ * candidate over THR1 / 2 since the last QRS is taken back as one. The thresholds learn from the
+ * integral's peak and mean over the first HK_PT_LEARN_LEN samples after reset. The R peak is the
+ * largest absolute sample over the stretch of input the integral window covered, so peaks line up
+ * with the segmentation ones. The filters were designed for 200 Hz and keep their taps at
+ * SAMPLE_RATE, which only moves the passband up by a quarter.
+ *
+ * The detector runs on the signal, not on windows: pan_tompkins_peaks() feeds only the samples after
+ * the last window and keeps the R peaks the windows share, so filters, candidates and searchback
+ * carry over the seams. Windows are standardized one by one, so each one is first mapped onto the
+ * scale of the samples the detector already holds, by a least squares fit over the ones they share.
+ * A gap (hk_pt_restart()) or a window that does not overlap the last one restarts the filters.
+ */
+#include <cmath>
+#include <cstdlib>
+#include <cstring>
+
+#include "constants.h"
+#include "pan_tompkins.h"
+#include "rr_stats.h"
+
+// Filter history and delay: low pass 5, high pass 16 and derivative 2 samples
+#define PT_RING_LEN (128)
+#define PT_HP_LEN (32)
+#define PT_DERIV_LEN (8)
+#define PT_MWI_LEN (3 * SAMPLE_RATE / 20)
+#define PT_MWI_RING_LEN (64)
+#define PT_DELAY (5 + 16 + 2)
+// Squared slopes are scaled down so PT_MWI_LEN of them sum in int32
+#define PT_SQ_SHIFT (8)
+#define PT_SQ_MAX (INT32_MAX / PT_MWI_LEN)
+// R peaks are looked for this far past the integral window
+#define PT_R_SLACK (5)
+
+static_assert(PT_MWI_LEN <= PT_MWI_RING_LEN, "MWI ring too short");
+static_assert(HK_PT_REFRACTORY + PT_DELAY + PT_MWI_LEN < PT_RING_LEN, "Input ring too short for the R search");
+
+typedef struct {
+    int16_t x[PT_RING_LEN];
+    int32_t lp[PT_HP_LEN];
+    int32_t hp[PT_DERIV_LEN];
+    int32_t sq[PT_MWI_RING_LEN];
+    int32_t lp1, lp2;
+    int32_t hpSum;
+    int32_t mwiSum;
+    int32_t mwi1, mwi2;
+    int32_t n;
+    // Candidate local maximum of the integral
+    int32_t candVal, candIdx;
+    // Largest sub-threshold candidate since the last QRS, for searchback
+    int32_t sbVal, sbIdx, sbR;
+    int32_t lastIdx, lastR;
+} hk_pt_filter_t;
+
+static hk_pt_filter_t hkPt;
+static int32_t hkPtSpki = 0;
+static int32_t hkPtNpki = 0;
+static int32_t hkPtRRAvg = SAMPLE_RATE;
+static bool hkPtLearned = false;
+static uint32_t hkPtLearnLen = 0;
+static int32_t hkPtLearnMax = 0;
+static int64_t hkPtLearnSum = 0;
+// Signal fed since the filters restarted: absolute index of sample 0 and one past the last sample,
+// map of the window onto the detector scale, and the R peaks (absolute) a next window may share
+static bool hkPtOpen = false;
+static uint32_t hkPtOrigin = 0;
+static uint32_t hkPtEnd = 0;
+static float32_t hkPtGain = 1;
+static float32_t hkPtOffset = 0;
+static uint32_t hkPtPeaks[HK_PEAK_LEN];
+static uint32_t hkPtNumPeaks = 0;
+
+static int32_t
+pt_r_peak(int32_t idx) {
+    /**
+     * @brief Largest absolute input sample over the stretch the integral at idx covered
+     */
+    const int32_t lo = MAX(0, idx - PT_DELAY - PT_MWI_LEN);
+    const int32_t hi = MIN(hkPt.n, idx - PT_DELAY + PT_R_SLACK);
+    int32_t r = lo, rVal = -1;
+    for (int32_t i = lo; i <= hi; i++) {
+        const int32_t val = abs(hkPt.x[i & (PT_RING_LEN - 1)]);
+        if (val > rVal) {
+            rVal = val;
+            r = i;
+        }
+    }
+    return r;
+}
+
+static int32_t
+pt_accept(int32_t idx, int32_t r) {
+    /**
+     * @brief Record a QRS at integral index idx and R peak r
+     * @return r
+     */
+    if (hkPt.lastR >= 0) {
+        hkPtRRAvg = (r - hkPt.lastR + 7 * hkPtRRAvg) >> 3;
+    }
+    hkPt.lastIdx = idx;
+    hkPt.lastR = r;
+    hkPt.sbIdx = -1;
+    hkPt.sbVal = 0;
+    return r;
+}
+
+static int32_t
+pt_candidate(void) {
+    /**
+     * @brief Classify the candidate as QRS or noise and clear it
+     * @return R peak of a QRS, or -1
+     */
+    hk_pt_filter_t *s = &hkPt;
+    const int32_t thr1 = hkPtNpki + ((hkPtSpki - hkPtNpki) >> 2);
+    int32_t r = -1;
+    if (s->lastIdx >= 0 && s->candIdx - s->lastIdx < HK_PT_REFRACTORY) {
+        // Second hump of the last QRS
+    } else if (s->candVal > thr1) {
+        hkPtSpki = (s->candVal + 7 * hkPtSpki) >> 3;
+        r = pt_accept(s->candIdx, pt_r_peak(s->candIdx));
+    } else {
+        hkPtNpki = (s->candVal + 7 * hkPtNpki) >> 3;
+        if (s->candVal > (thr1 >> 1) && s->candVal > s->sbVal) {
+            s->sbVal = s->candVal;
+            s->sbIdx = s->candIdx;
+            s->sbR = pt_r_peak(s->candIdx);
+        }
+    }
+    s->candIdx = -1;
+    return r;
+}
+
+static int32_t
+pt_filter(int16_t x) {
+    /**
+     * @brief Bandpass, derivative, square and moving-window integral of one sample
+     * @return Integral
+     */
+    hk_pt_filter_t *s = &hkPt;
+    const int32_t n = s->n;
+    if (n == 0) {
+        // Start from a steady state at the first sample so the filters do not ring
+        for (int i = 0; i < PT_RING_LEN; i++) {
+            s->x[i] = x;
+        }
+        for (int i = 0; i < PT_HP_LEN; i++) {
+            s->lp[i] = 36 * x;
+        }
+        s->lp1 = s->lp2 = 36 * x;
+        s->hpSum = PT_HP_LEN * 36 * x;
+    }
+    s->x[n & (PT_RING_LEN - 1)] = x;
+    // y[n] = 2y[n-1] - y[n-2] + x[n] - 2x[n-6] + x[n-12]
+    const int32_t lp = 2 * s->lp1 - s->lp2 + x - 2 * s->x[(n - 6) & (PT_RING_LEN - 1)] + s->x[(n - 12) & (PT_RING_LEN - 1)];
+    s->lp2 = s->lp1;
+    s->lp1 = lp;
+    // y[n] = x[n-16] - (sum of x[n-31..n]) / 32
+    s->hpSum += lp - s->lp[n & (PT_HP_LEN - 1)];
+    s->lp[n & (PT_HP_LEN - 1)] = lp;
+    const int32_t hp = s->lp[(n - 16) & (PT_HP_LEN - 1)] - s->hpSum / PT_HP_LEN;
+    // y[n] = (2x[n] + x[n-1] - x[n-3] - 2x[n-4]) / 8
+    s->hp[n & (PT_DERIV_LEN - 1)] = hp;
+    int32_t d = (2 * hp + s->hp[(n - 1) & (PT_DERIV_LEN - 1)] - s->hp[(n - 3) & (PT_DERIV_LEN - 1)] -
+                 2 * s->hp[(n - 4) & (PT_DERIV_LEN - 1)]) >>
+                3;
+    d = MIN(abs(d), 46340);
+    const int32_t sq = MIN((d * d) >> PT_SQ_SHIFT, PT_SQ_MAX);
+    s->mwiSum += sq - s->sq[(n - PT_MWI_LEN) & (PT_MWI_RING_LEN - 1)];
+    s->sq[n & (PT_MWI_RING_LEN - 1)] = sq;
+    return s->mwiSum / PT_MWI_LEN;
+}
+
+int32_t
+hk_pt_step(int16_t x) {
+    hk_pt_filter_t *s = &hkPt;
+    const int32_t mwi = pt_filter(x);
+    const int32_t n = s->n++;
+    int32_t r = -1;
+    if (!hkPtLearned) {
+        hkPtLearnMax = MAX(hkPtLearnMax, mwi);
+        hkPtLearnSum += mwi;
+        if (++hkPtLearnLen >= HK_PT_LEARN_LEN) {
+            hkPtSpki = hkPtLearnMax / 3;
+            hkPtNpki = (int32_t)(hkPtLearnSum / hkPtLearnLen) / 2;
+            hkPtLearned = true;
+        }
+        return -1;
+    }
+    // Integral at n - 1 is a local maximum
+    if (n >= 2 && s->mwi1 > s->mwi2 && s->mwi1 >= mwi && (s->candIdx < 0 || s->mwi1 > s->candVal)) {
+        s->candVal = s->mwi1;
+        s->candIdx = n - 1;
+    }
+    s->mwi2 = s->mwi1;
+    s->mwi1 = mwi;
+    if (s->candIdx >= 0 && n - s->candIdx >= HK_PT_REFRACTORY) {
+        r = pt_candidate();
+    }
+    if (r < 0 && s->sbIdx >= 0 && s->lastIdx >= 0 && 100 * (n - s->lastIdx) > 166 * hkPtRRAvg) {
+        hkPtSpki = (s->sbVal + 3 * hkPtSpki) >> 2;
+        r = pt_accept(s->sbIdx, s->sbR);
+    }
+    return r;
+}
+
+int32_t
+hk_pt_pending(void) {
+    const hk_pt_filter_t *s = &hkPt;
+    const int32_t thr1 = hkPtNpki + ((hkPtSpki - hkPtNpki) >> 2);
+    if (!hkPtLearned || s->candIdx < 0 || (s->lastIdx >= 0 && s->candIdx - s->lastIdx < HK_PT_REFRACTORY) || s->candVal <= thr1) {
+        return -1;
+    }
+    return pt_r_peak(s->candIdx);
+}
+
+void
+hk_pt_restart(void) {
+    memset(&hkPt, 0, sizeof(hkPt));
+    hkPt.candIdx = -1;
+    hkPt.sbIdx = -1;
+    hkPt.lastIdx = -1;
+    hkPt.lastR = -1;
+    hkPtOpen = false;
+    hkPtNumPeaks = 0;
+}
+
+void
+hk_pt_reset(void) {
+    hk_pt_restart();
+    hkPtSpki = 0;
+    hkPtNpki = 0;
+    hkPtRRAvg = SAMPLE_RATE;
+    hkPtLearned = false;
+    hkPtLearnLen = 0;
+    hkPtLearnMax = 0;
+    hkPtLearnSum = 0;
+}
+
+bool
+hk_pt_learned(void) {
+    return hkPtLearned;
+}
+
+static int16_t
+pt_sample(float32_t x) {
+    /**
+     * @brief Window sample on the detector scale
+     */
+    const int32_t val = (int32_t)roundf((hkPtGain * x + hkPtOffset) * HK_PT_SCALE);
+    return (int16_t)MAX(INT16_MIN, MIN(INT16_MAX, val));
+}
+
+static void
+pt_fit_scale(const float32_t *data, uint32_t start) {
+    /**
+     * @brief Map the window onto the samples the detector holds of [start, hkPtEnd), by least squares
+     */
+    const uint32_t len = MIN(hkPtEnd - start, MIN(PT_RING_LEN, hkPtEnd - hkPtOrigin));
+    const uint32_t first = hkPtEnd - len;
+    float32_t sx = 0, sy = 0, sxx = 0, sxy = 0;
+    for (uint32_t i = first; i < hkPtEnd; i++) {
+        const float32_t x = data[i - start];
+        const float32_t y = (float32_t)hkPt.x[(i - hkPtOrigin) & (PT_RING_LEN - 1)] / HK_PT_SCALE;
+        sx += x;
+        sy += y;
+        sxx += x * x;
+        sxy += x * y;
+    }
+    const float32_t var = len * sxx - sx * sx;
+    // Too few or flat samples: keep the gain and match the mean
+    if (len >= 2 && var > 1e-6f * len * len) {
+        hkPtGain = (len * sxy - sx * sy) / var;
+    }
+    hkPtOffset = (sy - hkPtGain * sx) / len;
+}
+
+uint32_t
+pan_tompkins_peaks(const float32_t *data, uint32_t start, uint32_t len, int32_t *peaks, uint32_t maxPeaks) {
+    const uint32_t end = start + len;
+    if (!hkPtOpen || start >= hkPtEnd || start < hkPtOrigin) {
+        hk_pt_restart();
+        hkPtGain = 1;
+        hkPtOffset = 0;
+        if (!hkPtLearned) {
+            // Learn the thresholds, then run the window again from its start
+            for (uint32_t i = 0; i < len && !hkPtLearned; i++) {
+                hk_pt_step(pt_sample(data[i]));
+            }
+            hk_pt_restart();
+        }
+        hkPtOpen = true;
+        hkPtOrigin = start;
+        hkPtEnd = start;
+    } else {
+        pt_fit_scale(data, start);
+        // Peaks before the window are no longer shared
+        uint32_t kept = 0;
+        for (uint32_t i = 0; i < hkPtNumPeaks; i++) {
+            if (hkPtPeaks[i] >= start) {
+                hkPtPeaks[kept++] = hkPtPeaks[i];
+            }
+        }
+        hkPtNumPeaks = kept;
+    }
+    for (uint32_t i = hkPtEnd; i < end; i++) {
+        const int32_t r = hk_pt_step(pt_sample(data[i - start]));
+        if (r >= 0 && hkPtNumPeaks < HK_PEAK_LEN) {
+            hkPtPeaks[hkPtNumPeaks++] = hkPtOrigin + r;
+        }
+    }
+    hkPtEnd = MAX(hkPtEnd, end);
+    uint32_t numPeaks = 0;
+    for (uint32_t i = 0; i < hkPtNumPeaks && numPeaks < maxPeaks; i++) {
+        if (hkPtPeaks[i] < end) {
+            peaks[numPeaks++] = hkPtPeaks[i] - start;
+        }
+    }
+    // The candidate still inside the refractory period counts for this window, the next one confirms it
+    const int32_t r = hk_pt_pending();
+    if (r >= 0 && hkPtOrigin + r < end && numPeaks < maxPeaks) {
+        peaks[numPeaks++] = hkPtOrigin + r - start;
+    }
+    return numPeaks;
+}
+
+bool
+hk_pt_irregular(const int32_t *rrIntervals, uint32_t numPeaks) {
+    float32_t meanRR, sdRR;
+    if (hk_rr_stats(rrIntervals, numPeaks, &meanRR, &sdRR) || sdRR > HK_HR_RR_CV * meanRR) {
+        return true;
+    }
+    for (uint32_t i = 1; i < numPeaks; i++) {
+        if (fabsf(rrIntervals[i] - meanRR) > HK_HR_RR_TOL * meanRR) {
+            return true;
+        }
+    }
+    return false;
+}
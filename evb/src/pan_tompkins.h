@@ -0,0 +1,71 @@
+/**
+ * @file pan_tompkins.h
+ * @author Adam Page (adam.page@ambiq.com)
+ * @brief Streaming integer Pan-Tompkins QRS detector for the HR-only mode
+ * @version 1.0
+ * @date 2023-05-02
+ *
+ * @copyright Copyright (c) 2023
+ *
+ */
+#ifndef __PAN_TOMPKINS_H
+#define __PAN_TOMPKINS_H
+
+#include "arm_math.h"
+#include <stdint.h>
+
+/**
+ * @brief Feed one sample to the detector
+ * @param x Sample, scaled by HK_PT_SCALE
+ * @return Sample index (since hk_pt_restart) of a detected R peak, or -1
+ */
+int32_t
+hk_pt_step(int16_t x);
+
+/**
+ * @brief R peak of the last candidate if it would be a QRS now, without waiting out the refractory
+ * period or classifying it (end of a window)
+ * @return Sample index of an R peak, or -1
+ */
+int32_t
+hk_pt_pending(void);
+
+/**
+ * @brief Restart the filters and the sample count at a gap in the signal, keeping the learned
+ * thresholds and RR average
+ */
+void
+hk_pt_restart(void);
+
+/**
+ * @brief Forget the thresholds too (new patient or discontinuous signal)
+ */
+void
+hk_pt_reset(void);
+
+/**
+ * @brief Whether the detector has learned its thresholds since reset
+ */
+bool
+hk_pt_learned(void);
+
+/**
+ * @brief Detect the R peaks of a window. A window overlapping the last one only feeds its new samples
+ * and keeps the peaks they share, any other restarts the filters. Learns the thresholds over the
+ * first HK_PT_LEARN_LEN samples of a window after reset, then runs from its start.
+ * @param data Preprocessed signal [len]
+ * @param start Absolute index of data[0]
+ * @param peaks Output R peak indices in the window, ascending [maxPeaks]
+ * @return Number of peaks
+ */
+uint32_t
+pan_tompkins_peaks(const float32_t *data, uint32_t start, uint32_t len, int32_t *peaks, uint32_t maxPeaks);
+
+/**
+ * @brief Whether a window's RR intervals are too irregular for heart rate alone (or too few to tell)
+ * @param rrIntervals RR intervals of ecg_rate() [numPeaks]
+ */
+bool
+hk_pt_irregular(const int32_t *rrIntervals, uint32_t numPeaks);
+
+#endif // __PAN_TOMPKINS_H
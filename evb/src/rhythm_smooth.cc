@@ -0,0 +1,42 @@
+/**
+ * @file rhythm_smooth.cc
+ * @author Adam Page (adam.page@ambiq.com)
+ * @brief Exponential average of arrhythmia block outputs over contiguous signal
+ * @version 1.0
+ * @date 2023-05-02
+ *
+ * @copyright Copyright (c) 2023
+ *
+ * Without HK_ARR_SMOOTH_ENABLE a window is AFIB if any of its arrhythmia blocks is, so one noisy
+ * block flips the rhythm. With it, the decision is the argmax of the blocks' dequantized outputs
+ * averaged since the last gap in the signal (hk_run with no overlap), at O(classes) per block. This
+ * is post-hoc smoothing, not a recurrent head: the arrhythmia model is a feed-forward CNN that still
+ * sees one block at a time, and TFLM's LSTM and variable tensors would need a model trained with
+ * that state. The average only trades a delay at episode onset for fewer isolated false blocks, and
+ * `make -C host rhythm` shows a minute of it misses short AFIB episodes.
+ */
+#include <cstring>
+
+#include "constants.h"
+#include "rhythm_smooth.h"
+
+static float32_t hkRhythmAvg[HK_ARR_CLASSES];
+static uint32_t hkRhythmBlocks = 0;
+
+void
+hk_rhythm_reset(void) {
+    memset(hkRhythmAvg, 0, sizeof(hkRhythmAvg));
+    hkRhythmBlocks = 0;
+}
+
+int
+hk_rhythm_update(const float32_t *logits) {
+    int yIdx = 0;
+    hkRhythmBlocks = MIN(hkRhythmBlocks + 1, HK_ARR_SMOOTH_BLOCKS);
+    const float32_t alpha = 1.0f / hkRhythmBlocks;
+    for (int i = 0; i < HK_ARR_CLASSES; i++) {
+        hkRhythmAvg[i] += alpha * (logits[i] - hkRhythmAvg[i]);
+        yIdx = hkRhythmAvg[i] > hkRhythmAvg[yIdx] ? i : yIdx;
+    }
+    return yIdx;
+}
@@ -0,0 +1,32 @@
+/**
+ * @file rhythm_smooth.h
+ * @author Adam Page (adam.page@ambiq.com)
+ * @brief Exponential average of arrhythmia block outputs over contiguous signal
+ * @version 1.0
+ * @date 2023-05-02
+ *
+ * @copyright Copyright (c) 2023
+ *
+ */
+#ifndef __RHYTHM_SMOOTH_H
+#define __RHYTHM_SMOOTH_H
+
+#include "arm_math.h"
+#include <stdint.h>
+
+/**
+ * @brief Forget the averaged outputs (gap in the signal, new patient)
+ */
+void
+hk_rhythm_reset(void);
+
+/**
+ * @brief Fold a block's arrhythmia outputs into the average: the mean of the blocks since reset, then
+ * an exponential average with a time constant of HK_ARR_SMOOTH_BLOCKS blocks
+ * @param logits Dequantized arrhythmia outputs [HK_ARR_CLASSES]
+ * @return Rhythm label index of the average
+ */
+int
+hk_rhythm_update(const float32_t *logits);
+
+#endif // __RHYTHM_SMOOTH_H
@@ -0,0 +1,68 @@
+/**
+ * @file roi_segmentation.cc
+ * @author Adam Page (adam.page@ambiq.com)
+ * @brief Regions around QRS candidates that segmentation streams instead of the whole signal
+ * @version 1.0
+ * @date 2023-05-02
+ *
+ * @copyright Copyright (c) 2023
+ *
+ * Between the end of a T wave and the next P wave the signal is isoelectric, and the segmentation
+ * model labels it normal at the same cost as a beat. With HK_SEG_ROI_ENABLE the segmentation head
+ * finds QRS candidates with pan_tompkins.cc and streams the model over a region around each one
+ * only, which StreamModel allows at any length. A region spans the P wave (HK_ROI_PRE before the R
+ * peak) to the end of the T wave, bounded by a QTc of HK_ROI_QTC (Bazett) at the local RR, so it
+ * shrinks with the heart rate less than the RR does and most of the savings come at low rates.
+ * Each region streams HK_ROI_CONTEXT extra samples at each side, since the model's labels near a
+ * stream edge see its zero padding, and regions whose contexts would meet are streamed as one. The
+ * rest of the mask stays normal. The last HK_ROI_TAIL samples are always a region, as a QRS there is
+ * still inside the detector's latency. With the shipped model the P to T span plus the context
+ * covers nearly the whole cycle: `make -C host roi` streams 91% of the samples at 45 bpm and 98-99%
+ * at 65 and 90 bpm, and loses some QRS and T boundaries.
+ */
+#include <cmath>
+
+#include "constants.h"
+#include "roi_segmentation.h"
+
+uint32_t
+hk_roi_plan(const int32_t *peaks, uint32_t numPeaks, uint32_t dataLen, uint32_t context, uint32_t align, hk_roi_t *rois,
+            uint32_t maxRois) {
+    uint32_t numRois = 0;
+    if (numPeaks < 2) {
+        rois[0] = {0, dataLen, 0, dataLen};
+        return 1;
+    }
+    for (uint32_t i = 0; i < numPeaks; i++) {
+        const int32_t rr = i + 1 < numPeaks ? peaks[i + 1] - peaks[i] : peaks[i] - peaks[i - 1];
+        const int32_t post = (int32_t)(HK_ROI_QTC * sqrtf((float)rr / SAMPLE_RATE) * SAMPLE_RATE);
+        const uint32_t labelStart = (uint32_t)MAX(0, peaks[i] - HK_ROI_PRE);
+        const uint32_t labelEnd = (uint32_t)MIN((int32_t)dataLen, peaks[i] + post);
+        // Closer than both contexts (and the alignment) is cheaper streamed through
+        if (numRois > 0 && labelStart <= rois[numRois - 1].labelEnd + 2 * context + align) {
+            rois[numRois - 1].labelEnd = MAX(rois[numRois - 1].labelEnd, labelEnd);
+        } else if (numRois < maxRois) {
+            rois[numRois++] = {0, 0, labelStart, labelEnd};
+        }
+    }
+    // A QRS in the detector's latency at the end has no candidate yet
+    const uint32_t tailStart = dataLen - MIN(dataLen, HK_ROI_TAIL);
+    if (numRois > 0 && tailStart <= rois[numRois - 1].labelEnd + 2 * context + align) {
+        rois[numRois - 1].labelEnd = dataLen;
+    } else if (numRois < maxRois) {
+        rois[numRois++] = {0, 0, tailStart, dataLen};
+    }
+    hk_roi_expand(rois, numRois, dataLen, context, align);
+    return numRois;
+}
+
+void
+hk_roi_expand(hk_roi_t *rois, uint32_t numRois, uint32_t dataLen, uint32_t context, uint32_t align) {
+    for (uint32_t i = 0; i < numRois; i++) {
+        hk_roi_t *roi = &rois[i];
+        roi->start = roi->labelStart - MIN(context, roi->labelStart);
+        const uint32_t len = MIN(dataLen, (MIN(dataLen, roi->labelEnd + context) - roi->start + align - 1) / align * align);
+        roi->start = MIN(roi->start, dataLen - len);
+        roi->end = roi->start + len;
+    }
+}
@@ -0,0 +1,51 @@
+/**
+ * @file roi_segmentation.h
+ * @author Adam Page (adam.page@ambiq.com)
+ * @brief Regions around QRS candidates that segmentation streams instead of the whole signal
+ * @version 1.0
+ * @date 2023-05-02
+ *
+ * @copyright Copyright (c) 2023
+ *
+ */
+#ifndef __ROI_SEGMENTATION_H
+#define __ROI_SEGMENTATION_H
+
+#include <stdint.h>
+
+/**
+ * @brief Region of interest: the model streams [start, end), and labels outside [labelStart, labelEnd)
+ * are context that saw the stream edges
+ */
+typedef struct {
+    uint32_t start;
+    uint32_t end;
+    uint32_t labelStart;
+    uint32_t labelEnd;
+} hk_roi_t;
+
+/**
+ * @brief Plan the regions around QRS candidates: HK_ROI_PRE samples before each R peak for the P
+ * wave, a QT of HK_ROI_QTC at the local RR after it for the T wave, and context on both sides.
+ * The last HK_ROI_TAIL samples are a region too. Regions closer than their contexts are merged.
+ * Under two candidates, the whole signal is one region.
+ * @param peaks R peak candidates, ascending [numPeaks]
+ * @param dataLen Signal length
+ * @param context Samples streamed at each side of a region and not labeled
+ * @param align Streamed lengths are rounded up to a multiple of align
+ * @param rois Output regions, ascending and disjoint [maxRois]
+ * @return Number of regions
+ */
+uint32_t
+hk_roi_plan(const int32_t *peaks, uint32_t numPeaks, uint32_t dataLen, uint32_t context, uint32_t align, hk_roi_t *rois,
+            uint32_t maxRois);
+
+/**
+ * @brief Set the streamed span of planned regions: context samples at each side of the labeled span,
+ * rounded up to a multiple of align and kept inside the signal
+ * @param rois Regions with labelStart and labelEnd set [numRois]
+ */
+void
+hk_roi_expand(hk_roi_t *rois, uint32_t numRois, uint32_t dataLen, uint32_t context, uint32_t align);
+
+#endif // __ROI_SEGMENTATION_H
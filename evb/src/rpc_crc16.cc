@@ -0,0 +1,73 @@
+/**
+ * @file rpc_crc16.cc
+ * @author Adam Page (adam.page@ambiq.com)
+ * @brief Table-driven (slicing-by-4) replacement for erpc::Crc16
+ * @version 1.0
+ * @date 2023-05-02
+ *
+ * @copyright Copyright (c) 2023
+ *
+ * Defines every member of erpc::Crc16 so the linker resolves them here and never pulls
+ * erpc_crc16.o (bitwise ITU-CCITT) from erpc.a. Output is bit-identical to the library
+ * implementation (poly 0x1021, non-reflected, default start 0xEF4A) so the PC side is unaffected.
+ */
+#include "erpc_crc16.hpp"
+
+#define CRC16_POLY (0x1021)
+#define CRC16_START (0xEF4A)
+#define CRC16_SLICES (4)
+
+struct Crc16Tables {
+    uint16_t t[CRC16_SLICES][256];
+    constexpr Crc16Tables() : t() {
+        for (uint32_t i = 0; i < 256; i++) {
+            uint32_t crc = i << 8;
+            for (uint32_t b = 0; b < 8; b++) {
+                crc = (crc & 0x8000) ? (crc << 1) ^ CRC16_POLY : (crc << 1);
+            }
+            t[0][i] = (uint16_t)crc;
+        }
+        for (uint32_t s = 1; s < CRC16_SLICES; s++) {
+            for (uint32_t i = 0; i < 256; i++) {
+                t[s][i] = (uint16_t)((t[s - 1][i] << 8) ^ t[0][t[s - 1][i] >> 8]);
+            }
+        }
+    }
+};
+
+// Tables are generated at compile time and live in flash
+static constexpr Crc16Tables crcTables;
+
+using namespace erpc;
+
+Crc16::Crc16(uint32_t crcStart) : m_crcStart(crcStart) {}
+
+Crc16::Crc16(void) : m_crcStart(CRC16_START) {}
+
+Crc16::~Crc16(void) {}
+
+uint16_t
+Crc16::computeCRC16(const uint8_t *data, uint32_t lengthInBytes) {
+    /**
+     * @brief Compute ITU-CCITT CRC-16 consuming 4 bytes per step
+     * @param data Input data
+     * @param lengthInBytes Data length
+     * @return CRC-16
+     */
+    const uint16_t(*t)[256] = crcTables.t;
+    uint32_t crc = m_crcStart & 0xFFFF;
+    while (lengthInBytes >= CRC16_SLICES) {
+        crc = t[3][(crc >> 8) ^ data[0]] ^ t[2][(crc & 0xFF) ^ data[1]] ^ t[1][data[2]] ^ t[0][data[3]];
+        data += CRC16_SLICES;
+        lengthInBytes -= CRC16_SLICES;
+    }
+    while (lengthInBytes--) {
+        crc = ((crc << 8) ^ t[0][(crc >> 8) ^ *data++]) & 0xFFFF;
+    }
+    return (uint16_t)crc;
+}
+
+void
+Crc16::setCrcStart(uint32_t crcStart) {
+    m_crcStart = crcStart;
+}
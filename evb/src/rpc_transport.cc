@@ -0,0 +1,209 @@
+/**
+ * @file rpc_transport.cc
+ * @author Adam Page (adam.page@ambiq.com)
+ * @brief Static message buffer pool and scatter USB transport for the eRPC send path
+ * @version 1.0
+ * @date 2023-05-02
+ *
+ * @copyright Copyright (c) 2023
+ *
+ * Like rpc_crc16.cc, this file defines erpc_mbf_dynamic_init() and erpc_transport_usb_cdc_init()
+ * so the linker resolves the calls made by ns_rpc_genericDataOperations_init() here instead of
+ * pulling the heap-backed factory and the plain USB CDC transport from erpc.a.
+ */
+#include <cstring>
+
+#include "erpc_client_manager.h"
+#include "erpc_crc16.hpp"
+#include "erpc_manually_constructed.hpp"
+#include "erpc_mbf_setup.h"
+#include "erpc_transport_setup.h"
+#include "erpc_usb_cdc_transport.hpp"
+#include "ns_ambiqsuite_harness.h"
+
+#include "rpc_transport.h"
+
+using namespace erpc;
+
+// Set by erpc_client_init() (erpc.a)
+extern ClientManager *g_client;
+
+/**
+ * @brief Message buffer factory handing out fixed buffers from a static pool
+ *
+ */
+class PoolMessageBufferFactory : public MessageBufferFactory {
+  public:
+    PoolMessageBufferFactory(void) : m_inUse() {}
+
+    virtual ~PoolMessageBufferFactory(void) {}
+
+    virtual MessageBuffer
+    create(void) override {
+        for (uint32_t i = 0; i < RPC_MBF_POOL_COUNT; i++) {
+            if (!m_inUse[i]) {
+                m_inUse[i] = true;
+                return MessageBuffer(m_pool[i], ERPC_DEFAULT_BUFFER_SIZE);
+            }
+        }
+        return MessageBuffer();
+    }
+
+    virtual void
+    dispose(MessageBuffer *buf) override {
+        for (uint32_t i = 0; i < RPC_MBF_POOL_COUNT; i++) {
+            if (buf->get() == m_pool[i]) {
+                m_inUse[i] = false;
+            }
+        }
+        buf->set(NULL, 0);
+    }
+
+  private:
+    alignas(4) uint8_t m_pool[RPC_MBF_POOL_COUNT][ERPC_DEFAULT_BUFFER_SIZE];
+    bool m_inUse[RPC_MBF_POOL_COUNT];
+};
+
+/**
+ * @brief USB CDC framed transport that can append an external payload to a message
+ *
+ * When a payload is attached, send() frames message + payload as one eRPC message: the CRC is
+ * chained across both and the payload is written straight from the caller's memory.
+ */
+class ScatterUsbCdcTransport : public UsbCdcTransport {
+  public:
+    ScatterUsbCdcTransport(usb_handle_t usbHandle) : UsbCdcTransport(usbHandle), m_handle(usbHandle), m_payload(NULL), m_payloadLength(0) {}
+
+    virtual ~ScatterUsbCdcTransport(void) {}
+
+    void
+    setPayload(const uint8_t *data, uint32_t length) {
+        m_payload = data;
+        m_payloadLength = length;
+    }
+
+    virtual erpc_status_t
+    send(MessageBuffer *message) override {
+        if (m_payload == NULL) {
+            return FramedTransport::send(message);
+        }
+        const uint8_t *payload = m_payload;
+        uint32_t payloadLength = m_payloadLength;
+        setPayload(NULL, 0);
+#if !ERPC_THREADS_IS(NONE)
+        // Header, message and payload go out as one frame, as in FramedTransport::send()
+        Mutex::Guard lock(m_sendLock);
+#endif
+
+        uint16_t used = message->getUsed();
+        // Keep the same frame size ceiling as the copying path so the PC side is unaffected
+        if (used + payloadLength > message->getLength()) {
+            return kErpcStatus_BufferOverrun;
+        }
+        Header h;
+        h.m_messageSize = (uint16_t)(used + payloadLength);
+        Crc16 payloadCrc(m_crcImpl->computeCRC16(message->get(), used));
+        h.m_crc = payloadCrc.computeCRC16(payload, payloadLength);
+
+        erpc_status_t err = write((const uint8_t *)&h, sizeof(h));
+        if (err == kErpcStatus_Success) {
+            err = write(message->get(), used);
+        }
+        if (err == kErpcStatus_Success) {
+            err = write(payload, payloadLength);
+        }
+        return err;
+    }
+
+  private:
+    usb_handle_t m_handle;
+    const uint8_t *m_payload;
+    uint32_t m_payloadLength;
+
+    erpc_status_t
+    write(const uint8_t *data, uint32_t size) {
+        // As UsbCdcTransport::underlyingSend() (private in erpc.a), but failing once the host stops reading
+        uint32_t sent = 0;
+        uint32_t stalls = 0;
+        while (sent < size && stalls < RPC_SEND_STALL_RETRIES) {
+            const uint32_t n = ns_usb_send_data(m_handle, (void *)&data[sent], size - sent);
+            tud_cdc_n_write_flush(0);
+            if (n == 0) {
+                stalls++;
+                ns_delay_us(RPC_SEND_STALL_US);
+            } else {
+                stalls = 0;
+            }
+            sent += n;
+        }
+        return sent == size ? kErpcStatus_Success : kErpcStatus_SendFailed;
+    }
+};
+
+static ManuallyConstructed<PoolMessageBufferFactory> s_msgFactory;
+static ManuallyConstructed<ScatterUsbCdcTransport> s_usbTransport;
+
+erpc_mbf_t
+erpc_mbf_dynamic_init(void) {
+    /**
+     * @brief Replaces the heap-backed factory requested by ns-rpc with the static pool
+     * @return Message buffer factory
+     */
+    s_msgFactory.construct();
+    return reinterpret_cast<erpc_mbf_t>(s_msgFactory.get());
+}
+
+erpc_transport_t
+erpc_transport_usb_cdc_init(usb_handle_t usbHandle) {
+    /**
+     * @brief Replaces the USB CDC transport requested by ns-rpc with the scatter variant
+     * @param usbHandle USB handle
+     * @return Transport or NULL on failure
+     */
+    s_usbTransport.construct(usbHandle);
+    if (s_usbTransport->init() != kErpcStatus_Success) {
+        s_usbTransport.destroy();
+        return NULL;
+    }
+    return reinterpret_cast<erpc_transport_t>(s_usbTransport.get());
+}
+
+status
+rpc_send_block_to_pc(const dataBlock *block) {
+    /**
+     * @brief Send block to PC without copying block->buffer into the message buffer.
+     * Wire format is identical to ns_rpc_data_sendBlockToPC().
+     * @param block Block to send
+     * @return RPC status
+     */
+    erpc_status_t err = kErpcStatus_Success;
+    status result = ns_rpc_data_failure;
+    if (s_usbTransport.get() == NULL) {
+        return ns_rpc_data_sendBlockToPC(block);
+    }
+    RequestContext request = g_client->createRequest(false);
+    Codec *codec = request.getCodec();
+    if (codec == NULL) {
+        err = kErpcStatus_MemoryError;
+    } else {
+        codec->startWriteMessage(kInvocationMessage, kevb_to_pc_service_id, kevb_to_pc_ns_rpc_data_sendBlockToPC_id,
+                                 request.getSequence());
+        codec->write(block->length);
+        codec->write(static_cast<int32_t>(block->dType));
+        codec->writeString(strlen(block->description), block->description);
+        codec->write(static_cast<int32_t>(block->cmd));
+        // Binary length prefix goes in the message, the data itself is appended by the transport
+        codec->write(block->buffer.dataLength);
+        s_usbTransport->setPayload(block->buffer.data, block->buffer.dataLength);
+        g_client->performRequest(request);
+        s_usbTransport->setPayload(NULL, 0);
+
+        int32_t tmp;
+        codec->read(&tmp);
+        result = static_cast<status>(tmp);
+        err = codec->getStatus();
+    }
+    g_client->releaseRequest(request);
+    g_client->callErrorHandler(err, kevb_to_pc_ns_rpc_data_sendBlockToPC_id);
+    return err == kErpcStatus_Success ? result : ns_rpc_data_failure;
+}
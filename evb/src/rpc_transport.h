@@ -0,0 +1,25 @@
+/**
+ * @file rpc_transport.h
+ * @author Adam Page (adam.page@ambiq.com)
+ * @brief Static message buffer pool and scatter USB transport for the eRPC send path
+ * @version 1.0
+ * @date 2023-05-02
+ *
+ * @copyright Copyright (c) 2023
+ *
+ */
+#ifndef __RPC_TRANSPORT_H
+#define __RPC_TRANSPORT_H
+
+#include "ns_rpc_generic_data.h"
+
+// Message buffers held in the static pool (client only ever needs one in flight)
+#define RPC_MBF_POOL_COUNT (2)
+// Writes that make no progress (host not reading) before a send fails, and the wait between them (us)
+#define RPC_SEND_STALL_RETRIES (100)
+#define RPC_SEND_STALL_US (1000)
+
+status
+rpc_send_block_to_pc(const dataBlock *block);
+
+#endif // __RPC_TRANSPORT_H
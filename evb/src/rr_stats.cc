@@ -0,0 +1,36 @@
+/**
+ * @file rr_stats.cc
+ * @author Adam Page (adam.page@ambiq.com)
+ * @brief Statistics of a window's RR intervals
+ * @version 1.0
+ * @date 2023-05-02
+ *
+ * @copyright Copyright (c) 2023
+ *
+ * Read by the duty cycle policy (duty_cycle.cc), to tell a stable RR from a change, and by the
+ * HR-only mode (pan_tompkins.cc), to tell regular RR from RR that needs the full heads.
+ */
+#include <cmath>
+
+#include "rr_stats.h"
+
+uint32_t
+hk_rr_stats(const int32_t *rrIntervals, uint32_t numPeaks, float32_t *meanRR, float32_t *sdRR) {
+    // ecg_rate() fills rrIntervals[1, numPeaks)
+    if (numPeaks < 3) {
+        return 1;
+    }
+    const uint32_t numRR = numPeaks - 1;
+    float32_t sum = 0;
+    for (uint32_t i = 1; i < numPeaks; i++) {
+        sum += rrIntervals[i];
+    }
+    const float32_t mean = sum / numRR;
+    float32_t var = 0;
+    for (uint32_t i = 1; i < numPeaks; i++) {
+        var += (rrIntervals[i] - mean) * (rrIntervals[i] - mean);
+    }
+    *meanRR = mean;
+    *sdRR = sqrtf(var / numRR);
+    return 0;
+}
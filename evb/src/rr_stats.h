@@ -0,0 +1,25 @@
+/**
+ * @file rr_stats.h
+ * @author Adam Page (adam.page@ambiq.com)
+ * @brief Statistics of a window's RR intervals
+ * @version 1.0
+ * @date 2023-05-02
+ *
+ * @copyright Copyright (c) 2023
+ *
+ */
+#ifndef __RR_STATS_H
+#define __RR_STATS_H
+
+#include "arm_math.h"
+#include <stdint.h>
+
+/**
+ * @brief Mean and standard deviation of the RR intervals between the window's peaks
+ * @param rrIntervals RR intervals of ecg_rate() [numPeaks]
+ * @return Non-zero if there are fewer than two intervals
+ */
+uint32_t
+hk_rr_stats(const int32_t *rrIntervals, uint32_t numPeaks, float32_t *meanRR, float32_t *sdRR);
+
+#endif // __RR_STATS_H
@@ -19,6 +19,7 @@
 max86150_slot_type maxSlotsConfig[] = {Max86150SlotEcg, Max86150SlotOff, Max86150SlotOff, Max86150SlotOff};
 
 uint32_t maxFifoBuffer[MAX86150_FIFO_DEPTH * NUM_SLOTS];
+static_assert(MAX86150_FIFO_DEPTH <= SENSOR_MAX_SAMPLES, "capture_sensor_data() can overrun its callers");
 
 ns_i2c_config_t i2cConfig = {.api = &ns_i2c_V1_0_0, .iom = 1};
 
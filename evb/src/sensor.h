@@ -14,6 +14,9 @@
 #include "arm_math.h"
 #include <stdint.h>
 
+// Most samples one capture_sensor_data() returns (a full MAX86150 FIFO)
+#define SENSOR_MAX_SAMPLES (32)
+
 uint32_t
 init_sensor(void);
 void
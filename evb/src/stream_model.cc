@@ -0,0 +1,668 @@
+/**
+ * @file stream_model.cc
+ * @author Adam Page (adam.page@ambiq.com)
+ * @brief Streaming (sample by sample) execution of unit-height int8 models
+ * @version 1.0
+ * @date 2023-05-02
+ *
+ * @copyright Copyright (c) 2023
+ *
+ * The segmentation model is exported for a fixed window and hk_run slides it over the signal,
+ * recomputing the window overlap and the U-Net edges every step. Every operator of the model is
+ * local along width, so a position of any tensor only depends on a bounded run of positions of
+ * its inputs. StreamModel keeps each tensor as a run of rows and, after new samples arrive,
+ * computes each operator for the output positions whose input runs are complete, in graph order.
+ * Rows no reader needs anymore are dropped by moving the live rows to the front of the buffer
+ * when it fills up. Buffer sizes come from a dry run of the schedule in Init().
+ *
+ * The kernels are the 1-D kernels of conv1d_kernels.cc, called with absolute positions: a tensor
+ * holding rows from position base is passed as an input starting at base with base added to the
+ * left padding, so the edge clipping of the kernels only ever applies to the real stream edges.
+ */
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+
+#include "tensorflow/lite/c/builtin_op_data.h"
+#include "tensorflow/lite/kernels/internal/common.h"
+#include "tensorflow/lite/kernels/internal/cppmath.h"
+#include "tensorflow/lite/kernels/internal/quantization_util.h"
+#include "tensorflow/lite/kernels/padding.h"
+#include "tensorflow/lite/schema/schema_utils.h"
+
+#include "conv1d_kernels.h"
+#include "stream_model.h"
+
+enum { StreamOpConv, StreamOpDepthwise, StreamOpMaxPool, StreamOpAdd, StreamOpResize };
+
+//*****************************************************************************
+//*** Model helpers
+static const tflite::Tensor *
+model_tensor(const tflite::Model *model, int32_t index) {
+    return model->subgraphs()->Get(0)->tensors()->Get(index);
+}
+
+static const uint8_t *
+tensor_data(const tflite::Model *model, int32_t index) {
+    /**
+     * @brief Constant data of tensor, or nullptr
+     */
+    const flatbuffers::Vector<uint8_t> *data = model->buffers()->Get(model_tensor(model, index)->buffer())->data();
+    return data != nullptr && data->size() > 0 ? data->data() : nullptr;
+}
+
+static bool
+tensor_quant(const tflite::Tensor *tensor, float *scale, int32_t *zeroPoint) {
+    /**
+     * @brief Per-tensor int8 quantization of tensor
+     * @return false if not int8 or not quantized
+     */
+    const tflite::QuantizationParameters *quant = tensor->quantization();
+    if (tensor->type() != tflite::TensorType_INT8 || quant == nullptr || quant->scale() == nullptr || quant->scale()->size() < 1 ||
+        quant->zero_point() == nullptr || quant->zero_point()->size() < 1) {
+        return false;
+    }
+    *scale = quant->scale()->Get(0);
+    *zeroPoint = (int32_t)quant->zero_point()->Get(0);
+    return true;
+}
+
+static int32_t
+tensor_dim(const tflite::Tensor *tensor, int32_t dim) {
+    const flatbuffers::Vector<int32_t> *shape = tensor->shape();
+    return shape != nullptr && dim < (int32_t)shape->size() ? shape->Get(dim) : -1;
+}
+
+static int32_t
+num_elements(const tflite::Tensor *tensor) {
+    int32_t count = 1;
+    for (size_t i = 0; tensor->shape() != nullptr && i < tensor->shape()->size(); i++) {
+        count *= tensor->shape()->Get(i);
+    }
+    return count;
+}
+
+static bool
+activation_range(int32_t activation, float scale, int32_t zeroPoint, int32_t *actMin, int32_t *actMax) {
+    /**
+     * @brief Int8 range of a fused activation, as CalculateActivationRangeQuantized
+     * @return false if the activation is not a clamp
+     */
+    *actMin = INT8_MIN;
+    *actMax = INT8_MAX;
+    if (activation == tflite::ActivationFunctionType_RELU || activation == tflite::ActivationFunctionType_RELU6) {
+        *actMin = std::max(*actMin, zeroPoint + (int32_t)tflite::TfLiteRound(0.0f / scale));
+    }
+    if (activation == tflite::ActivationFunctionType_RELU6) {
+        *actMax = std::min(*actMax, zeroPoint + (int32_t)tflite::TfLiteRound(6.0f / scale));
+    }
+    if (activation == tflite::ActivationFunctionType_RELU_N1_TO_1) {
+        *actMin = std::max(*actMin, zeroPoint + (int32_t)tflite::TfLiteRound(-1.0f / scale));
+        *actMax = std::min(*actMax, zeroPoint + (int32_t)tflite::TfLiteRound(1.0f / scale));
+    }
+    return activation == tflite::ActivationFunctionType_NONE || activation == tflite::ActivationFunctionType_RELU ||
+           activation == tflite::ActivationFunctionType_RELU6 || activation == tflite::ActivationFunctionType_RELU_N1_TO_1;
+}
+
+static int32_t
+floor_div(int32_t a, int32_t b) {
+    return a >= 0 ? a / b : -((-a + b - 1) / b);
+}
+
+//*****************************************************************************
+//*** Graph
+void *
+StreamModel::Allocate(size_t size) {
+    /**
+     * @brief Take size bytes (4 byte aligned) from the arena
+     * @return Buffer, or nullptr if the arena is full
+     */
+    size = (size + 3) & ~(size_t)3;
+    if (m_arenaUsed + size > m_arenaSize) {
+        return nullptr;
+    }
+    void *buf = &m_arena[m_arenaUsed];
+    m_arenaUsed += size;
+    return buf;
+}
+
+int32_t
+StreamModel::FindTensor(int32_t index) const {
+    for (int32_t i = 0; i < m_numTensors; i++) {
+        if (m_tensors[i].index == index) {
+            return i;
+        }
+    }
+    return -1;
+}
+
+int32_t
+StreamModel::AddTensor(const tflite::Model *model, int32_t index) {
+    /**
+     * @brief Add model tensor index ([1, 1, W, C] int8) as a streamed tensor
+     * @return Streamed tensor, or -1
+     */
+    const tflite::Tensor *tensor = model_tensor(model, index);
+    float scale;
+    int32_t zeroPoint;
+    if (m_numTensors >= HK_STREAM_MAX_TENSORS || tensor->shape() == nullptr || tensor->shape()->size() != 4 || tensor_dim(tensor, 0) != 1 ||
+        tensor_dim(tensor, 1) != 1 || !tensor_quant(tensor, &scale, &zeroPoint)) {
+        return -1;
+    }
+    stream_tensor_t &t = m_tensors[m_numTensors];
+    memset(&t, 0, sizeof(stream_tensor_t));
+    t.index = index;
+    t.width = tensor_dim(tensor, 2);
+    t.channels = tensor_dim(tensor, 3);
+    t.period = 1;
+    t.len = -1;
+    return m_numTensors++;
+}
+
+TfLiteStatus
+StreamModel::AddOp(const tflite::Model *model, const tflite::Operator *op) {
+    /**
+     * @brief Add operator to the stream plan
+     */
+    const tflite::OperatorCode *opcode = model->operator_codes()->Get(op->opcode_index());
+    const tflite::BuiltinOperator code = tflite::GetBuiltinCode(opcode);
+    const flatbuffers::Vector<int32_t> *inputs = op->inputs();
+    const flatbuffers::Vector<int32_t> *outputs = op->outputs();
+    const int32_t graphOutput = model->subgraphs()->Get(0)->outputs()->Get(0);
+
+    // Constant shape computations
+    if (code == tflite::BuiltinOperator_SHAPE || code == tflite::BuiltinOperator_STRIDED_SLICE || code == tflite::BuiltinOperator_PACK) {
+        return kTfLiteOk;
+    }
+    // Final reshape of the streamed output
+    if (code == tflite::BuiltinOperator_RESHAPE) {
+        int32_t input = FindTensor(inputs->Get(0));
+        if (input < 0 || outputs->Get(0) != graphOutput) {
+            return kTfLiteError;
+        }
+        m_output = input;
+        return kTfLiteOk;
+    }
+    if (m_numNodes >= HK_STREAM_MAX_NODES || outputs->size() != 1) {
+        return kTfLiteError;
+    }
+    stream_node_t &node = m_nodes[m_numNodes];
+    memset(&node, 0, sizeof(stream_node_t));
+    node.stride = 1;
+    node.kLen = 1;
+    node.upsample = 1;
+    int32_t activation = tflite::ActivationFunctionType_NONE;
+    int32_t numParts = 1;
+    tflite::Padding padding = tflite::Padding_VALID;
+    bool computePadding = false;
+    const tflite::Tensor *filter = nullptr;
+    const tflite::Tensor *addTensor = nullptr;
+    int32_t parts[HK_STREAM_MAX_INPUTS] = {inputs->Get(0)};
+
+    switch (code) {
+    case tflite::BuiltinOperator_CONV_2D:
+    case tflite::BuiltinOperator_DEPTHWISE_CONV_2D: {
+        int32_t dilation;
+        if (code == tflite::BuiltinOperator_CONV_2D) {
+            const tflite::Conv2DOptions *opts = op->builtin_options_as_Conv2DOptions();
+            if (opts == nullptr) {
+                return kTfLiteError;
+            }
+            node.type = StreamOpConv;
+            node.stride = opts->stride_w();
+            padding = opts->padding();
+            activation = opts->fused_activation_function();
+            dilation = opts->dilation_w_factor();
+        } else {
+            const tflite::DepthwiseConv2DOptions *opts = op->builtin_options_as_DepthwiseConv2DOptions();
+            if (opts == nullptr) {
+                return kTfLiteError;
+            }
+            node.type = StreamOpDepthwise;
+            node.stride = opts->stride_w();
+            padding = opts->padding();
+            activation = opts->fused_activation_function();
+            dilation = opts->dilation_w_factor();
+        }
+        filter = model_tensor(model, inputs->Get(1));
+        if (dilation != 1 || inputs->size() < 3 || tensor_dim(filter, 1) != 1) {
+            return kTfLiteError;
+        }
+        node.kLen = tensor_dim(filter, 2);
+        node.filters[0] = (const int8_t *)tensor_data(model, inputs->Get(1));
+        node.bias = inputs->Get(2) >= 0 ? (const int32_t *)tensor_data(model, inputs->Get(2)) : nullptr;
+        computePadding = true;
+        break;
+    }
+    case tflite::BuiltinOperator_CUSTOM: {
+        hk_concat_conv_options_t opts;
+        if (opcode->custom_code() == nullptr || strcmp(opcode->custom_code()->c_str(), HK_CONCAT_CONV_OP_NAME) != 0 ||
+            op->custom_options() == nullptr || op->custom_options()->size() < sizeof(opts) || inputs->size() % 2 != 1) {
+            return kTfLiteError;
+        }
+        // Custom options are not aligned within the flatbuffer
+        memcpy(&opts, op->custom_options()->data(), sizeof(opts));
+        numParts = inputs->size() / 2;
+        if (opts.version != HK_CONCAT_CONV_OPTIONS_VERSION || numParts > HK_STREAM_MAX_INPUTS) {
+            return kTfLiteError;
+        }
+        filter = model_tensor(model, inputs->Get(1));
+        node.type = StreamOpConv;
+        node.stride = opts.stride;
+        node.padding = opts.padding;
+        node.kLen = tensor_dim(filter, 2);
+        activation = opts.activation;
+        for (int32_t i = 0; i < numParts; i++) {
+            parts[i] = inputs->Get(2 * i);
+            node.filters[i] = (const int8_t *)tensor_data(model, inputs->Get(2 * i + 1));
+        }
+        node.bias = (const int32_t *)tensor_data(model, inputs->Get(inputs->size() - 1));
+        break;
+    }
+    case tflite::BuiltinOperator_MAX_POOL_2D: {
+        const tflite::Pool2DOptions *opts = op->builtin_options_as_Pool2DOptions();
+        // Any filter height pools the single row of a unit-height input
+        if (opts == nullptr) {
+            return kTfLiteError;
+        }
+        node.type = StreamOpMaxPool;
+        node.stride = opts->stride_w();
+        node.kLen = opts->filter_width();
+        padding = opts->padding();
+        activation = opts->fused_activation_function();
+        computePadding = true;
+        break;
+    }
+    case tflite::BuiltinOperator_ADD: {
+        const tflite::AddOptions *opts = op->builtin_options_as_AddOptions();
+        if (opts == nullptr || inputs->size() != 2) {
+            return kTfLiteError;
+        }
+        node.type = StreamOpAdd;
+        activation = opts->fused_activation_function();
+        // A constant operand is a per channel addend and goes second
+        const bool const0 = tensor_data(model, inputs->Get(0)) != nullptr;
+        const bool const1 = tensor_data(model, inputs->Get(1)) != nullptr;
+        if (const0 && const1) {
+            return kTfLiteError;
+        }
+        parts[0] = inputs->Get(const0 ? 1 : 0);
+        parts[1] = inputs->Get(const0 ? 0 : 1);
+        addTensor = model_tensor(model, parts[1]);
+        if (const0 || const1) {
+            node.addend = (const int8_t *)tensor_data(model, parts[1]);
+        } else {
+            numParts = 2;
+        }
+        break;
+    }
+    case tflite::BuiltinOperator_RESIZE_NEAREST_NEIGHBOR: {
+        const tflite::ResizeNearestNeighborOptions *opts = op->builtin_options_as_ResizeNearestNeighborOptions();
+        if (opts != nullptr && opts->align_corners()) {
+            return kTfLiteError;
+        }
+        node.type = StreamOpResize;
+        node.upsample = 2;
+        break;
+    }
+    default:
+        return kTfLiteError;
+    }
+
+    // Streamed inputs: conv parts or ADD operands that are not constant
+    node.numInputs = numParts;
+    for (int32_t i = 0; i < numParts; i++) {
+        node.inputs[i] = FindTensor(parts[i]);
+        if (node.inputs[i] < 0 || m_tensors[node.inputs[i]].width != m_tensors[node.inputs[0]].width ||
+            m_tensors[node.inputs[i]].period != m_tensors[node.inputs[0]].period) {
+            return kTfLiteError;
+        }
+    }
+    node.output = AddTensor(model, outputs->Get(0));
+    if (node.output < 0) {
+        return kTfLiteError;
+    }
+    stream_tensor_t &in = m_tensors[node.inputs[0]];
+    stream_tensor_t &out = m_tensors[node.output];
+    const tflite::Tensor *input = model_tensor(model, parts[0]);
+    const tflite::Tensor *output = model_tensor(model, outputs->Get(0));
+
+    // Window of each output position
+    if (computePadding) {
+        int outHeight, outWidth;
+        TfLitePaddingValues values = tflite::ComputePaddingHeightWidth(
+            1, node.stride, 1, 1, 1, in.width, 1, node.kLen, padding == tflite::Padding_SAME ? kTfLitePaddingSame : kTfLitePaddingValid,
+            &outHeight, &outWidth);
+        node.padding = values.width;
+    }
+    node.rightPadding = (out.width - 1) * node.stride + node.kLen - node.padding - in.width * node.upsample;
+    if (node.stride < 1 || node.kLen < 1 || (in.period * node.stride) % node.upsample != 0 ||
+        out.width != floor_div(in.width * node.upsample + node.padding + node.rightPadding - node.kLen, node.stride) + 1) {
+        return kTfLiteError;
+    }
+    out.period = in.period * node.stride / node.upsample;
+
+    // Quantization
+    float inScale, outScale;
+    int32_t inZeroPoint, outZeroPoint;
+    if (!tensor_quant(input, &inScale, &inZeroPoint) || !tensor_quant(output, &outScale, &outZeroPoint) ||
+        !activation_range(activation, outScale, outZeroPoint, &node.conv.output_activation_min, &node.conv.output_activation_max)) {
+        return kTfLiteError;
+    }
+    node.conv.input_zero_point = inZeroPoint;
+    node.conv.output_zero_point = outZeroPoint;
+    if (node.type == StreamOpConv || node.type == StreamOpDepthwise) {
+        // Per-channel requant, as PopulateConvolutionQuantizationParams
+        const tflite::QuantizationParameters *filterQuant = filter->quantization();
+        if (filter->type() != tflite::TensorType_INT8 || filterQuant == nullptr || filterQuant->scale() == nullptr ||
+            node.filters[0] == nullptr) {
+            return kTfLiteError;
+        }
+        const int32_t channels = out.channels;
+        if (node.type == StreamOpDepthwise && channels != in.channels) {
+            return kTfLiteError;
+        }
+        node.conv.per_channel_output_multiplier = (int32_t *)Allocate(channels * sizeof(int32_t));
+        node.conv.per_channel_output_shift = (int32_t *)Allocate(channels * sizeof(int32_t));
+        if (node.conv.per_channel_output_multiplier == nullptr || node.conv.per_channel_output_shift == nullptr) {
+            return kTfLiteError;
+        }
+        for (int32_t c = 0; c < channels; c++) {
+            const float filterScale = filterQuant->scale()->Get(filterQuant->scale()->size() > 1 ? c : 0);
+            const double effectiveScale = (double)inScale * (double)filterScale / (double)outScale;
+            int shift;
+            tflite::QuantizeMultiplier(effectiveScale, &node.conv.per_channel_output_multiplier[c], &shift);
+            node.conv.per_channel_output_shift[c] = shift;
+        }
+    } else if (node.type == StreamOpAdd) {
+        // As ADD (add_common.cc)
+        float addScale;
+        int32_t addZeroPoint;
+        if (!tensor_quant(addTensor, &addScale, &addZeroPoint) || (node.addend != nullptr && num_elements(addTensor) != out.channels)) {
+            return kTfLiteError;
+        }
+        const double twiceMaxInputScale = 2 * (double)std::max(inScale, addScale);
+        node.addOffsets[0] = -inZeroPoint;
+        node.addOffsets[1] = -addZeroPoint;
+        tflite::QuantizeMultiplierSmallerThanOneExp((double)inScale / twiceMaxInputScale, &node.addMultipliers[0], &node.addShifts[0]);
+        tflite::QuantizeMultiplierSmallerThanOneExp((double)addScale / twiceMaxInputScale, &node.addMultipliers[1], &node.addShifts[1]);
+        tflite::QuantizeMultiplierSmallerThanOneExp(twiceMaxInputScale / ((1 << 20) * (double)outScale), &node.addOutputMultiplier,
+                                                    &node.addOutputShift);
+    } else if (inScale != outScale || inZeroPoint != outZeroPoint) {
+        // Max pool and resize copy values
+        return kTfLiteError;
+    }
+    m_numNodes++;
+    return kTfLiteOk;
+}
+
+TfLiteStatus
+StreamModel::Init(const tflite::Model *model, uint8_t *arena, size_t arenaSize, int32_t step, int32_t planLen) {
+    m_arena = arena;
+    m_arenaSize = arenaSize;
+    m_arenaUsed = 0;
+    m_numNodes = 0;
+    m_numTensors = 0;
+    m_output = -1;
+    m_step = step;
+    m_planning = false;
+    const tflite::SubGraph *subgraph = model->subgraphs()->Get(0);
+    if (step < 1 || subgraph->inputs()->size() != 1 || subgraph->outputs()->size() != 1 || AddTensor(model, subgraph->inputs()->Get(0)) != 0) {
+        return kTfLiteError;
+    }
+    for (size_t i = 0; i < subgraph->operators()->size(); i++) {
+        if (AddOp(model, subgraph->operators()->Get(i)) != kTfLiteOk) {
+            return kTfLiteError;
+        }
+    }
+    if (m_output < 0) {
+        m_output = FindTensor(subgraph->outputs()->Get(0));
+    }
+    if (m_output < 0) {
+        return kTfLiteError;
+    }
+    tensor_quant(model_tensor(model, m_tensors[0].index), &m_inputScale, &m_inputZeroPoint);
+    tensor_quant(model_tensor(model, m_tensors[m_output].index), &m_outputScale, &m_outputZeroPoint);
+    m_align = 1;
+    for (int32_t i = 0; i < m_numTensors; i++) {
+        m_align = std::max(m_align, m_tensors[i].period);
+    }
+
+    // Dry run of a planLen stream to find the rows each tensor needs
+    planLen -= planLen % m_align;
+    m_planning = true;
+    Reset();
+    int32_t pushed = 0;
+    m_latency = 0;
+    for (; pushed + step <= planLen; pushed += step) {
+        Push(nullptr, step);
+        m_latency = pushed + step - m_tensors[m_output].done * m_tensors[m_output].period;
+    }
+    if (pushed < planLen) {
+        Push(nullptr, planLen - pushed);
+    }
+    while (Finish() > 0) {
+    }
+    m_planning = false;
+    for (int32_t i = 0; i < m_numTensors; i++) {
+        stream_tensor_t &t = m_tensors[i];
+        t.rows = std::max(t.rows, i == 0 ? step : 1);
+        t.buf = (int8_t *)Allocate(t.rows * t.channels);
+        if (t.buf == nullptr) {
+            return kTfLiteError;
+        }
+    }
+    Reset();
+    return kTfLiteOk;
+}
+
+//*****************************************************************************
+//*** Schedule
+void
+StreamModel::Reset(void) {
+    for (int32_t i = 0; i < m_numTensors; i++) {
+        m_tensors[i].len = -1;
+        m_tensors[i].base = 0;
+        m_tensors[i].done = 0;
+    }
+    m_emitted = 0;
+}
+
+int32_t
+StreamModel::NextNeeded(int32_t tensor) const {
+    /**
+     * @brief First position of tensor still to be read (by a node or as output)
+     */
+    const stream_tensor_t &t = m_tensors[tensor];
+    int32_t needed = tensor == m_output ? m_emitted : t.done;
+    for (int32_t n = 0; n < m_numNodes; n++) {
+        const stream_node_t &node = m_nodes[n];
+        const stream_tensor_t &out = m_tensors[node.output];
+        if (out.len >= 0 && out.done >= out.len) {
+            continue;
+        }
+        for (int32_t i = 0; i < node.numInputs; i++) {
+            if (node.inputs[i] == tensor) {
+                int32_t first = floor_div(out.done * node.stride - node.padding, node.upsample);
+                needed = std::min(needed, std::max(first, 0));
+            }
+        }
+    }
+    return needed;
+}
+
+int32_t
+StreamModel::Ready(const stream_node_t &node) const {
+    /**
+     * @brief Output positions of node whose inputs are all available
+     */
+    const stream_tensor_t &out = m_tensors[node.output];
+    int32_t ready = out.len >= 0 ? out.len : INT32_MAX;
+    for (int32_t i = 0; i < node.numInputs; i++) {
+        const stream_tensor_t &in = m_tensors[node.inputs[i]];
+        if (in.len >= 0 && in.done >= in.len) {
+            continue;
+        }
+        // Last position q with floor((q * stride - padding + kLen - 1) / upsample) < done
+        int32_t last = in.done * node.upsample - node.kLen + node.padding;
+        ready = std::min(ready, last < 0 ? 0 : last / node.stride + 1);
+    }
+    return ready;
+}
+
+bool
+StreamModel::Reserve(int32_t tensor, int32_t end) {
+    /**
+     * @brief Make room in tensor for rows up to position end, dropping rows no reader needs
+     */
+    stream_tensor_t &t = m_tensors[tensor];
+    if (m_planning) {
+        t.rows = std::max(t.rows, end - NextNeeded(tensor));
+        return true;
+    }
+    if (end - t.base <= t.rows) {
+        return true;
+    }
+    int32_t needed = NextNeeded(tensor);
+    if (needed > t.base) {
+        memmove(t.buf, &t.buf[(needed - t.base) * t.channels], (t.done - needed) * t.channels);
+        t.base = needed;
+    }
+    return end - t.base <= t.rows;
+}
+
+void
+StreamModel::Compute(const stream_node_t &node, int32_t start, int32_t end) {
+    /**
+     * @brief Compute output positions [start, end) of node
+     */
+    const stream_tensor_t &in = m_tensors[node.inputs[0]];
+    const stream_tensor_t &out = m_tensors[node.output];
+    const int32_t inEnd = in.len >= 0 ? in.len : in.done;
+    int8_t *output = &out.buf[(start - out.base) * out.channels];
+
+    switch (node.type) {
+    case StreamOpConv:
+    case StreamOpDepthwise: {
+        // Parts are passed from the latest base of any part
+        int32_t base = in.base;
+        for (int32_t i = 1; i < node.numInputs; i++) {
+            base = std::max(base, (int32_t)m_tensors[node.inputs[i]].base);
+        }
+        tflite::OpDataConv conv = node.conv;
+        conv.padding.width = node.padding + base;
+        if (node.type == StreamOpDepthwise) {
+            depthwise_conv1d_s8(conv, node.stride, inEnd - base, in.channels, node.kLen, start, end,
+                                &in.buf[(base - in.base) * in.channels], node.filters[0], node.bias, output);
+            break;
+        }
+        conv1d_part_t parts[HK_STREAM_MAX_INPUTS];
+        for (int32_t i = 0; i < node.numInputs; i++) {
+            const stream_tensor_t &part = m_tensors[node.inputs[i]];
+            parts[i].input = &part.buf[(base - part.base) * part.channels];
+            parts[i].filter = node.filters[i];
+            parts[i].channels = part.channels;
+        }
+        conv1d_concat_s8(conv, node.stride, inEnd - base, node.kLen, start, end, out.channels, node.numInputs, parts, node.bias, output);
+        break;
+    }
+    case StreamOpMaxPool:
+        for (int32_t q = start; q < end; q++) {
+            int32_t ws = std::max(q * node.stride - node.padding, 0);
+            int32_t we = std::min(q * node.stride - node.padding + node.kLen, inEnd);
+            for (int32_t c = 0; c < out.channels; c++) {
+                int32_t val = INT8_MIN;
+                for (int32_t d = ws; d < we; d++) {
+                    int32_t v = in.buf[(d - in.base) * in.channels + c];
+                    val = v > val ? v : val;
+                }
+                val = std::min(std::max(val, node.conv.output_activation_min), node.conv.output_activation_max);
+                output[(q - start) * out.channels + c] = (int8_t)val;
+            }
+        }
+        break;
+    case StreamOpAdd: {
+        // As reference_integer_ops::AddFunc
+        const stream_tensor_t *other = node.numInputs > 1 ? &m_tensors[node.inputs[1]] : nullptr;
+        for (int32_t q = start; q < end; q++) {
+            const int8_t *a = &in.buf[(q - in.base) * in.channels];
+            const int8_t *b = other != nullptr ? &other->buf[(q - other->base) * other->channels] : node.addend;
+            for (int32_t c = 0; c < out.channels; c++) {
+                int32_t x = tflite::MultiplyByQuantizedMultiplierSmallerThanOneExp((a[c] + node.addOffsets[0]) * (1 << 20),
+                                                                                   node.addMultipliers[0], node.addShifts[0]);
+                int32_t y = tflite::MultiplyByQuantizedMultiplierSmallerThanOneExp((b[c] + node.addOffsets[1]) * (1 << 20),
+                                                                                   node.addMultipliers[1], node.addShifts[1]);
+                int32_t val = tflite::MultiplyByQuantizedMultiplierSmallerThanOneExp(x + y, node.addOutputMultiplier, node.addOutputShift) +
+                              node.conv.output_zero_point;
+                val = std::min(std::max(val, node.conv.output_activation_min), node.conv.output_activation_max);
+                output[(q - start) * out.channels + c] = (int8_t)val;
+            }
+        }
+        break;
+    }
+    case StreamOpResize:
+        for (int32_t q = start; q < end; q++) {
+            memcpy(&output[(q - start) * out.channels], &in.buf[(q / node.upsample - in.base) * in.channels], out.channels);
+        }
+        break;
+    }
+}
+
+int32_t
+StreamModel::Run(void) {
+    /**
+     * @brief Compute ready positions in graph order, at most a step of input samples worth per tensor
+     * @return New output positions, or -1 if a tensor ran out of rows
+     */
+    m_emitted = m_tensors[m_output].done;
+    for (int32_t n = 0; n < m_numNodes; n++) {
+        const stream_node_t &node = m_nodes[n];
+        stream_tensor_t &out = m_tensors[node.output];
+        int32_t end = std::min(Ready(node), out.done + (m_step + out.period - 1) / out.period);
+        if (end <= out.done) {
+            continue;
+        }
+        if (!Reserve(node.output, end)) {
+            return -1;
+        }
+        if (!m_planning) {
+            Compute(node, out.done, end);
+        }
+        out.done = end;
+    }
+    return m_tensors[m_output].done - m_emitted;
+}
+
+int32_t
+StreamModel::Push(const int8_t *input, int32_t len) {
+    stream_tensor_t &in = m_tensors[0];
+    if (len < 0 || len > m_step || in.len >= 0 || !Reserve(0, in.done + len)) {
+        return -1;
+    }
+    if (!m_planning) {
+        memcpy(&in.buf[(in.done - in.base) * in.channels], input, len * in.channels);
+    }
+    in.done += len;
+    return Run();
+}
+
+int32_t
+StreamModel::Finish(void) {
+    // Stream widths follow from the input length as the model widths follow from the window
+    if (m_tensors[0].len < 0) {
+        m_tensors[0].len = m_tensors[0].done;
+        for (int32_t n = 0; n < m_numNodes; n++) {
+            const stream_node_t &node = m_nodes[n];
+            const int32_t inLen = m_tensors[node.inputs[0]].len;
+            const int32_t span = inLen * node.upsample + node.padding + node.rightPadding - node.kLen;
+            m_tensors[node.output].len = span < 0 ? 0 : span / node.stride + 1;
+        }
+    }
+    return Run();
+}
+
+const int8_t *
+StreamModel::Output(void) const {
+    const stream_tensor_t &out = m_tensors[m_output];
+    return &out.buf[(m_emitted - out.base) * out.channels];
+}
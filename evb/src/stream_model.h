@@ -0,0 +1,205 @@
+/**
+ * @file stream_model.h
+ * @author Adam Page (adam.page@ambiq.com)
+ * @brief Streaming (sample by sample) execution of unit-height int8 models
+ * @version 1.0
+ * @date 2023-05-02
+ *
+ * @copyright Copyright (c) 2023
+ *
+ */
+#ifndef __STREAM_MODEL_H
+#define __STREAM_MODEL_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "tensorflow/lite/micro/kernels/conv.h"
+#include "tensorflow/lite/schema/schema_generated.h"
+
+#include "concat_conv_kernels.h"
+
+#define HK_STREAM_MAX_NODES (64)
+#define HK_STREAM_MAX_TENSORS (64)
+#define HK_STREAM_MAX_INPUTS (HK_CONCAT_CONV_MAX_PARTS)
+
+/**
+ * @brief Tensor of a streamed model. Holds rows (positions) [base, done) of its width.
+ */
+typedef struct {
+    int32_t index;    // Model tensor index
+    int32_t channels; // Row size
+    int32_t width;    // Width in the model
+    int32_t period;   // Input samples per position
+    int32_t len;      // Stream width once finished, else -1
+    int32_t base;     // Position of the first row held
+    int32_t done;     // Positions computed
+    int32_t rows;     // Capacity in rows
+    int8_t *buf;      // Rows [rows, channels]
+} stream_tensor_t;
+
+/**
+ * @brief Operator of a streamed model. Output position q reads input positions
+ * [floor((q * stride - padding) / upsample), floor((q * stride - padding + kLen - 1) / upsample) + 1).
+ */
+typedef struct {
+    uint8_t type;                           // Operator (stream_model.cc)
+    int8_t numInputs;                       // Streamed inputs
+    int16_t inputs[HK_STREAM_MAX_INPUTS];   // Streamed input tensors
+    int16_t output;                         // Streamed output tensor
+    int32_t stride;                         // Window stride
+    int32_t kLen;                           // Window width
+    int32_t padding;                        // Left padding
+    int32_t rightPadding;                   // Right padding (model widths)
+    int32_t upsample;                       // Output positions per input position
+    tflite::OpDataConv conv;                // Conv requant (activation range of every op)
+    const int8_t *filters[HK_STREAM_MAX_INPUTS];
+    const int32_t *bias;                    // Conv bias
+    const int8_t *addend;                   // Constant [C] operand of ADD
+    int32_t addOffsets[2];                  // ADD input offsets
+    int32_t addMultipliers[2];              // ADD input multipliers
+    int addShifts[2];                       // ADD input shifts
+    int32_t addOutputMultiplier;
+    int addOutputShift;
+} stream_node_t;
+
+/**
+ * @brief Runs a model exported for a fixed window on an unbounded stream.
+ *
+ * Each push appends samples and computes every tensor position whose inputs are now available, so
+ * each position of each tensor is computed once instead of once per overlapping window. Tensors
+ * only keep the rows their readers still need. Positions before the first sample and after
+ * Finish() see the zero padding of the model, so streaming a window width of samples gives exactly
+ * the windowed model output. Output positions trail the input by the right receptive field of the
+ * model (Latency()).
+ *
+ * Supported: unit-height int8 CONV_2D, DEPTHWISE_CONV_2D (multiplier 1), MAX_POOL_2D, ADD
+ * (elementwise or constant per channel), RESIZE_NEAREST_NEIGHBOR (x2), HK_CONCAT_CONV and a final
+ * RESHAPE. SHAPE, STRIDED_SLICE and PACK computing constant shapes are skipped.
+ */
+class StreamModel {
+  public:
+    /**
+     * @brief Build the stream plan of model and size the tensor buffers for pushes of up to step samples
+     * @param model Model (must outlive the stream)
+     * @param arena Buffer for tensor rows and requant params
+     * @param arenaSize Arena size in bytes
+     * @param step Max samples per Push()
+     * @param planLen Stream length the buffers are sized with, rounded down to Align() (longer streams repeat the same pattern)
+     * @return kTfLiteOk, or kTfLiteError if an operator is not supported or the arena is too small
+     */
+    TfLiteStatus
+    Init(const tflite::Model *model, uint8_t *arena, size_t arenaSize, int32_t step, int32_t planLen);
+
+    /**
+     * @brief Start a new stream
+     */
+    void
+    Reset(void);
+
+    /**
+     * @brief Append samples and compute the positions they complete
+     * @param input Quantized samples [len, input channels]
+     * @param len Samples (at most step)
+     * @return Output positions completed (read with Output()), or -1 on error
+     */
+    int32_t
+    Push(const int8_t *input, int32_t len);
+
+    /**
+     * @brief End the stream, padding it as the model pads its window, and compute remaining positions.
+     * Each call computes at most a step worth of positions; call until it returns 0.
+     * The stream length should be a multiple of Align() for the padding to match the model.
+     * @return Output positions completed (read with Output()), or -1 on error
+     */
+    int32_t
+    Finish(void);
+
+    /**
+     * @brief Output rows completed by the last Push() or Finish() [positions, OutputChannels()]
+     */
+    const int8_t *
+    Output(void) const;
+
+    float
+    InputScale(void) const {
+        return m_inputScale;
+    }
+    int32_t
+    InputZeroPoint(void) const {
+        return m_inputZeroPoint;
+    }
+    float
+    OutputScale(void) const {
+        return m_outputScale;
+    }
+    int32_t
+    OutputZeroPoint(void) const {
+        return m_outputZeroPoint;
+    }
+    int32_t
+    OutputChannels(void) const {
+        return m_tensors[m_output].channels;
+    }
+    /**
+     * @brief Input samples per position of the coarsest tensor
+     */
+    int32_t
+    Align(void) const {
+        return m_align;
+    }
+    /**
+     * @brief Input samples pushed beyond the last output position in steady state
+     */
+    int32_t
+    Latency(void) const {
+        return m_latency;
+    }
+    /**
+     * @brief Arena bytes used by Init()
+     */
+    size_t
+    ArenaUsed(void) const {
+        return m_arenaUsed;
+    }
+
+  private:
+    TfLiteStatus
+    AddOp(const tflite::Model *model, const tflite::Operator *op);
+    int32_t
+    AddTensor(const tflite::Model *model, int32_t index);
+    int32_t
+    FindTensor(int32_t index) const;
+    int32_t
+    NextNeeded(int32_t tensor) const;
+    int32_t
+    Ready(const stream_node_t &node) const;
+    bool
+    Reserve(int32_t tensor, int32_t end);
+    void
+    Compute(const stream_node_t &node, int32_t start, int32_t end);
+    int32_t
+    Run(void);
+    void *
+    Allocate(size_t size);
+
+    stream_node_t m_nodes[HK_STREAM_MAX_NODES];
+    stream_tensor_t m_tensors[HK_STREAM_MAX_TENSORS];
+    int32_t m_numNodes;
+    int32_t m_numTensors;
+    int32_t m_output;
+    int32_t m_emitted;
+    int32_t m_step;
+    int32_t m_align;
+    int32_t m_latency;
+    float m_inputScale;
+    int32_t m_inputZeroPoint;
+    float m_outputScale;
+    int32_t m_outputZeroPoint;
+    bool m_planning;
+    uint8_t *m_arena;
+    size_t m_arenaSize;
+    size_t m_arenaUsed;
+};
+
+#endif // __STREAM_MODEL_H
@@ -0,0 +1,79 @@
+/**
+ * @file stream_window.cc
+ * @author Adam Page (adam.page@ambiq.com)
+ * @brief Segmentation of overlapping windows by continuing one stream across them
+ * @version 1.0
+ * @date 2023-05-02
+ *
+ * @copyright Copyright (c) 2023
+ *
+ * segmentation_stream() restreams the whole window, so overlapping windows pay for their shared
+ * samples on every window. Here the stream is left open at the end of a window and the next one
+ * pushes only its new samples, HK_WINDOW_STEP of them when windows follow each other. The labels of
+ * the shared samples are shifted over, so segmentation costs the same per second of signal at any
+ * overlap. The samples are quantized with the standardization of the window that pushes them, which
+ * differs a little between overlapping windows. Positions still inside the stream latency at the end
+ * of a window are labeled by the next one. `make -C host stream` compares the labels with restreaming
+ * every window.
+ */
+#include <cstring>
+
+#include "arm_math.h"
+
+#include "heartkit.h"
+#include "stream_window.h"
+
+void
+hk_stream_window_reset(hk_stream_window_t *win) {
+    win->open = false;
+}
+
+int
+hk_stream_window_run(StreamModel *stream, hk_stream_window_t *win, const float32_t *data, uint32_t start, uint8_t *segMask) {
+    const uint32_t end = start + HK_DATA_LEN;
+    if (!win->open || start > win->end || end <= win->end) {
+        stream->Reset();
+        win->open = true;
+        win->end = start;
+        win->labeled = start;
+        win->pushed = 0;
+        memset(win->mask, HeartSegmentNormal, HK_DATA_LEN);
+    } else {
+        // Shift the labels of the shared samples to the new window
+        const uint32_t shift = end - win->end;
+        memmove(win->mask, &win->mask[shift], HK_DATA_LEN - shift);
+        memset(&win->mask[HK_DATA_LEN - shift], HeartSegmentNormal, shift);
+    }
+    int8_t x[HK_SEG_STREAM_STEP];
+    const int32_t channels = stream->OutputChannels();
+    uint32_t xLen;
+    for (uint32_t i = win->end - start; i < HK_DATA_LEN; i += xLen) {
+        // Pushes end on multiples of the step since reset, the pattern StreamModel sized its rows for
+        xLen = MIN(HK_SEG_STREAM_STEP - win->pushed % HK_SEG_STREAM_STEP, HK_DATA_LEN - i);
+        // Quantize input
+        for (uint32_t j = 0; j < xLen; j++) {
+            x[j] = data[i + j] / stream->InputScale() + stream->InputZeroPoint();
+        }
+        const int32_t count = stream->Push(x, xLen);
+        if (count < 0) {
+            win->open = false;
+            return -1;
+        }
+        win->pushed += xLen;
+        // Largest class of each row (dequantizing preserves the order), skipping positions before the window
+        const int8_t *rows = stream->Output();
+        for (int32_t r = 0; r < count; r++, win->labeled++) {
+            if (win->labeled < start) {
+                continue;
+            }
+            uint8_t yMaxIdx = 0;
+            for (int32_t j = 1; j < channels; j++) {
+                yMaxIdx = rows[r * channels + j] > rows[r * channels + yMaxIdx] ? j : yMaxIdx;
+            }
+            win->mask[win->labeled - start] = yMaxIdx;
+        }
+    }
+    win->end = end;
+    memcpy(segMask, win->mask, HK_DATA_LEN);
+    return 0;
+}
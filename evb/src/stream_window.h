@@ -0,0 +1,53 @@
+/**
+ * @file stream_window.h
+ * @author Adam Page (adam.page@ambiq.com)
+ * @brief Segmentation of overlapping windows by continuing one stream across them
+ * @version 1.0
+ * @date 2023-05-02
+ *
+ * @copyright Copyright (c) 2023
+ *
+ */
+#ifndef __STREAM_WINDOW_H
+#define __STREAM_WINDOW_H
+
+#include <stdint.h>
+
+#include "arm_math.h"
+
+#include "constants.h"
+#include "stream_model.h"
+
+/**
+ * @brief Stream carried across windows: what was pushed and labeled, in absolute samples, and the
+ * labels of the window ending at end
+ */
+typedef struct {
+    bool open;
+    uint32_t end;     // One past the last sample pushed
+    uint32_t labeled; // One past the last position labeled
+    uint32_t pushed;  // Samples pushed since reset
+    uint8_t mask[HK_DATA_LEN];
+} hk_stream_window_t;
+
+/**
+ * @brief Start over on the next window (gap in the signal, new patient)
+ */
+void
+hk_stream_window_reset(hk_stream_window_t *win);
+
+/**
+ * @brief Segment the window [start, start + HK_DATA_LEN) by pushing only the samples after the last
+ * window and keeping the labels of the samples they share. The last positions, within the stream
+ * latency, stay normal until the next window labels them. A window that does not follow the last one
+ * (samples missing or not advancing) restarts the stream.
+ * @param stream Initialized stream of the segmentation model
+ * @param data Signal of the window [HK_DATA_LEN]
+ * @param start Absolute index of data[0]
+ * @param segMask Output labels [HK_DATA_LEN]
+ * @return Success (-1 if err)
+ */
+int
+hk_stream_window_run(StreamModel *stream, hk_stream_window_t *win, const float32_t *data, uint32_t start, uint8_t *segMask);
+
+#endif // __STREAM_WINDOW_H
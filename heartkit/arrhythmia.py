@@ -9,22 +9,76 @@ from rich.console import Console
 from sklearn.metrics import f1_score
 from wandb.keras import WandbCallback
 
-from neuralspot.tflite.convert import convert_tflite, predict_tflite, xxd_c_dump
+from neuralspot.tflite.convert import (
+    convert_tflite,
+    predict_tflite,
+    quantize_int4_weights,
+    xxd_c_dump,
+)
 from neuralspot.tflite.metrics import get_flops
 from neuralspot.tflite.model import get_strategy, load_model
 
+from .cascade import export_small_model
 from .datasets import IcentiaDataset
 from .datasets.augmentation import lead_noise
 from .defines import HeartExportParams, HeartTask, HeartTestParams, HeartTrainParams
 from .metrics import confusion_matrix_plot, roc_auc_plot
 from .models.optimizers import Adam
 from .models.utils import get_predicted_threshold_indices
-from .tasks import create_task_model, get_class_names, get_task_shape
+from .tasks import (
+    create_task_model,
+    get_arrhythmia_model,
+    get_class_names,
+    get_num_classes,
+    get_task_shape,
+)
 from .utils import env_flag, set_random_seed, setup_logger
 
 console = Console()
 logger = setup_logger(__name__)
 
+# Early exits (params.early_exit) follow these blocks of the reference model, and the EVB stops at the
+# first whose softmax confidence reaches the threshold (HK_ARR_EXIT_THRESHOLD in evb/src/constants.h)
+ARR_EXITS = [2, 3]
+ARR_EXIT_THRESHOLD = 0.9
+
+
+def early_exit_report(
+    y_true: np.ndarray, y_probs: list[np.ndarray], part_flops: list[int], threshold: float
+) -> np.ndarray:
+    """Log the exit distribution, accuracy and FLOPs saved of stopping at the first confident exit.
+
+    Args:
+        y_true (np.ndarray): Labels
+        y_probs (list[np.ndarray]): Softmax of each exit, last one the full network's
+        part_flops (list[int]): FLOPs of each part
+        threshold (float): Exit confidence
+
+    Returns:
+        np.ndarray: Predictions with early exits
+    """
+    exit_part = np.full(len(y_true), len(y_probs) - 1)
+    for k in reversed(range(len(y_probs) - 1)):
+        exit_part[np.max(y_probs[k], axis=1) >= threshold] = k
+    # END FOR
+    y_pred = np.argmax(np.stack(y_probs)[exit_part, np.arange(len(y_true))], axis=1)
+    for k, y_prob in enumerate(y_probs):
+        exits = np.sum(exit_part == k) / len(y_true)
+        acc = np.mean(np.argmax(y_prob, axis=1) == y_true)
+        logger.info(f"[EXIT{k+1}] EXITS={exits:.2%}, ACC={acc:.2%} (all blocks), MFLOPS={part_flops[k]/1e6:0.2f}")
+    # END FOR
+    flops = np.array([sum(part_flops[: k + 1]) for k in range(len(part_flops))])
+    saved = 1 - np.mean(flops[exit_part]) / flops[-1]
+    acc = np.sum(y_pred == y_true) / len(y_true)
+    f1 = f1_score(y_true, y_pred, average="macro")
+    logger.info(f"[EARLY EXIT] ACC={acc:.2%}, F1={f1:.2%}, THRESH={threshold:0.2%}, FLOPS SAVED={saved:.2%}")
+    return y_pred
+
+
+def exit_parts(model: tf.keras.Model) -> list[tf.keras.Model]:
+    """Part models EXIT1..EXITn of an early-exit model"""
+    return [model.get_layer(f"EXIT{k+1}") for k in range(len(model.outputs))]
+
 
 def train_model(params: HeartTrainParams):
     """Train rhythm-level arrhythmia model.
@@ -65,10 +119,19 @@ def train_model(params: HeartTrainParams):
         num_workers=params.data_parallelism,
     )
 
+    early_exit = bool(getattr(params, "early_exit", False))
+
     def augment(x, y):
         x = lead_noise(x, scale=0.1)
         return x, y
 
+    def exit_labels(x, y):
+        return x, tuple(y for _ in range(len(ARR_EXITS) + 1))
+
+    if early_exit:
+        train_ds = train_ds.map(exit_labels, num_parallel_calls=tf.data.AUTOTUNE)
+        val_ds = val_ds.map(exit_labels, num_parallel_calls=tf.data.AUTOTUNE)
+
     # Shuffle and batch datasets for training
     train_ds = (
         train_ds.shuffle(
@@ -94,9 +157,14 @@ def train_model(params: HeartTrainParams):
         logger.info("Building model")
         in_shape, _ = get_task_shape(HeartTask.arrhythmia, params.frame_size)
         inputs = tf.keras.Input(in_shape, batch_size=None, dtype=tf.float32)
-        model = create_task_model(
-            inputs, HeartTask.arrhythmia, name=params.model, params=params.model_params
-        )
+        if early_exit:
+            model = get_arrhythmia_model(
+                inputs, get_num_classes(HeartTask.arrhythmia), exits=ARR_EXITS
+            )
+        else:
+            model = create_task_model(
+                inputs, HeartTask.arrhythmia, name=params.model, params=params.model_params
+            )
         flops = get_flops(model, batch_size=1)
         optimizer = Adam(
             tf.keras.optimizers.schedules.CosineDecayRestarts(
@@ -122,19 +190,21 @@ def train_model(params: HeartTrainParams):
             model.load_weights(str(params.weights_file))
         params.weights_file = str(params.job_dir / "model.weights")
 
+        # Each exit has its own accuracy, so early exits are monitored on the summed loss
+        val_metric = "loss" if early_exit else params.val_metric
         model_callbacks = [
             tf.keras.callbacks.EarlyStopping(
-                monitor=f"val_{params.val_metric}",
+                monitor=f"val_{val_metric}",
                 patience=max(int(0.25 * params.epochs), 1),
-                mode="max" if params.val_metric == "f1" else "auto",
+                mode="max" if val_metric == "f1" else "auto",
                 restore_best_weights=True,
             ),
             tf.keras.callbacks.ModelCheckpoint(
                 filepath=params.weights_file,
-                monitor=f"val_{params.val_metric}",
+                monitor=f"val_{val_metric}",
                 save_best_only=True,
                 save_weights_only=True,
-                mode="max" if params.val_metric == "f1" else "auto",
+                mode="max" if val_metric == "f1" else "auto",
                 verbose=1,
             ),
             tf.keras.callbacks.CSVLogger(str(params.job_dir / "history.csv")),
@@ -167,9 +237,15 @@ def train_model(params: HeartTrainParams):
 
         # Get full validation results
         logger.info("Performing full validation")
-        test_labels = [label.numpy() for _, label in val_ds]
+        test_labels = [label[-1].numpy() if early_exit else label.numpy() for _, label in val_ds]
         y_true = np.argmax(np.concatenate(test_labels), axis=1)
-        y_pred = np.argmax(model.predict(val_ds), axis=1)
+        if early_exit:
+            y_probs = [tf.nn.softmax(y).numpy() for y in model.predict(val_ds)]
+            part_flops = [get_flops(part, batch_size=1) for part in exit_parts(model)]
+            early_exit_report(y_true, y_probs, part_flops, ARR_EXIT_THRESHOLD)
+            y_pred = np.argmax(y_probs[-1], axis=1)
+        else:
+            y_pred = np.argmax(model.predict(val_ds), axis=1)
 
         # Summarize results
         class_names = get_class_names(task=HeartTask.arrhythmia)
@@ -224,7 +300,14 @@ def evaluate_model(params: HeartTestParams):
 
         logger.info("Performing inference")
         y_true = np.argmax(test_y, axis=1)
-        y_prob = tf.nn.softmax(model.predict(test_x)).numpy()
+        if bool(getattr(params, "early_exit", False)):
+            y_probs = [tf.nn.softmax(y).numpy() for y in model.predict(test_x)]
+            part_flops = [get_flops(part, batch_size=1) for part in exit_parts(model)]
+            threshold = getattr(params, "exit_threshold", ARR_EXIT_THRESHOLD)
+            early_exit_report(y_true, y_probs, part_flops, threshold)
+            y_prob = y_probs[-1]
+        else:
+            y_prob = tf.nn.softmax(model.predict(test_x)).numpy()
         y_pred = np.argmax(y_prob, axis=1)
 
         # Summarize results
@@ -264,6 +347,10 @@ def export_model(params: HeartExportParams):
     Args:
         params (HeartDemoParams): Deployment parameters
     """
+    if bool(getattr(params, "early_exit", False)):
+        export_early_exit_model(params)
+        return
+
     tfl_model_path = str(params.job_dir / "model.tflite")
     tflm_model_path = str(params.job_dir / "model_buffer.h")
 
@@ -333,6 +420,18 @@ def export_model(params: HeartExportParams):
     logger.info(f"[TEST SET]  TF: ACC={tf_acc:.2%}, F1={tf_f1:.2%}")
     logger.info(f"[TEST SET] TFL: ACC={tfl_acc:.2%}, F1={tfl_f1:.2%}")
 
+    if params.int4_weights:
+        weights = model.get_weights()
+        int8_bytes, int4_bytes = quantize_int4_weights(model)
+        y_pred_int4 = np.argmax(model.predict(test_x), axis=1)
+        model.set_weights(weights)
+        int4_acc = np.sum(y_pred_int4 == y_true) / len(y_true)
+        int4_f1 = f1_score(y_true, y_pred_int4, average="macro")
+        logger.info(
+            f"[TEST SET] INT4: ACC={int4_acc:.2%}, F1={int4_f1:.2%}, KERNELS={int8_bytes/1024:0.1f}KB -> {int4_bytes/1024:0.1f}KB"
+        )
+    # END IF
+
     if params.threshold is not None:
         y_thresh_idx = np.union1d(
             get_predicted_threshold_indices(y_prob_tf, y_pred_tf, params.threshold),
@@ -357,6 +456,10 @@ def export_model(params: HeartExportParams):
         )
     # END IF
 
+    if getattr(params, "small_model_file", None):
+        export_small_model(params, HeartTask.arrhythmia, test_x, test_y, flops, y_prob_tfl)
+    # END IF
+
     # Check accuracy hit
     acc_diff = tf_acc - tfl_acc
     if acc_diff > 0.5:
@@ -367,3 +470,93 @@ def export_model(params: HeartExportParams):
     if params.tflm_file and tflm_model_path != params.tflm_file:
         logger.info(f"Copying TFLM header to {params.tflm_file}")
         shutil.copyfile(tflm_model_path, params.tflm_file)
+
+
+def export_early_exit_model(params: HeartExportParams):
+    """Export the parts of an early-exit arrhythmia model as int8 TFLM models arr_exit<k>_model_buffer.h
+    (g_arr_exit<k>_model), run in turn by evb/src/early_exit_model.cc with HK_ARR_EXIT_ENABLE.
+
+    Each part is calibrated on the float features of the parts before it, and the parts are validated
+    chained on the dequantized features of the exported parts before them, as on the EVB.
+
+    Args:
+        params (HeartExportParams): Deployment parameters (tflm_file: directory to copy the headers to, e.g. evb/src)
+    """
+    model = load_model(str(params.model_file))
+    parts = exit_parts(model)
+    threshold = getattr(params, "exit_threshold", ARR_EXIT_THRESHOLD)
+
+    with console.status("[bold green] Loading test dataset..."):
+        ds = IcentiaDataset(
+            ds_path=str(params.ds_path),
+            task=HeartTask.arrhythmia,
+            frame_size=params.frame_size,
+        )
+        test_ds = ds.load_test_dataset(
+            test_pt_samples=params.samples_per_patient,
+            num_workers=params.data_parallelism,
+        )
+        test_x, test_y = next(test_ds.batch(params.test_size).as_numpy_iterator())
+    # END WITH
+    y_true = np.argmax(test_y, axis=1)
+
+    tf_x, tfl_x = test_x, test_x
+    tf_probs, tfl_probs, part_flops = [], [], []
+    for k, part in enumerate(parts):
+        name = f"arr_exit{k+1}"
+        tfl_model_path = str(params.job_dir / f"{name}_model.tflite")
+        tflm_model_path = str(params.job_dir / f"{name}_model_buffer.h")
+
+        # Fix batch size of 1
+        inputs = tf.keras.layers.Input(part.input_shape[1:], dtype=tf.float32, batch_size=1)
+        part = tf.keras.Model(inputs, part(inputs), name=part.name)
+        part_flops.append(get_flops(part, batch_size=1))
+        logger.info(f"Converting {part.name} to TFLite ({part_flops[-1]/1e6:0.2f} MFLOPS)")
+        tflite_model = convert_tflite(
+            part,
+            quantize=True,
+            test_x=tf_x[:1000],
+            input_type=tf.int8,
+            output_type=tf.int8,
+        )
+        with open(tfl_model_path, "wb") as fp:
+            fp.write(tflite_model)
+        xxd_c_dump(
+            src_path=tfl_model_path,
+            dst_path=tflm_model_path,
+            var_name=f"g_{name}_model",
+            chunk_len=20,
+            is_header=True,
+        )
+        if params.tflm_file:
+            dst_dir = params.tflm_file if params.tflm_file.is_dir() else params.tflm_file.parent
+            logger.info(f"Copying TFLM header to {dst_dir}")
+            shutil.copyfile(tflm_model_path, str(dst_dir / f"{name}_model_buffer.h"))
+
+        # Logits are rank 2, features rank 4
+        tf_y = part.predict(tf_x)
+        tf_y = tf_y if isinstance(tf_y, list) else [tf_y]
+        tf_logits = next(y for y in tf_y if y.ndim == 2)
+        tf_probs.append(tf.nn.softmax(tf_logits).numpy())
+        runner = tf.lite.Interpreter(model_content=tflite_model).get_signature_runner()
+        tfl_y = [predict_tflite(tflite_model, test_x=tfl_x, output_name=n) for n in runner.get_output_details()]
+        tfl_probs.append(tf.nn.softmax(next(y for y in tfl_y if y.ndim == 2)).numpy())
+        if k < len(parts) - 1:
+            tf_x = next(y for y in tf_y if y.ndim == 4)
+            tfl_x = next(y for y in tfl_y if y.ndim == 4)
+    # END FOR
+
+    logger.info("Validating model results")
+    tf_pred = early_exit_report(y_true, tf_probs, part_flops, threshold)
+    tfl_pred = early_exit_report(y_true, tfl_probs, part_flops, threshold)
+    tf_acc = np.sum(tf_pred == y_true) / len(y_true)
+    tfl_acc = np.sum(tfl_pred == y_true) / len(y_true)
+    logger.info(f"[TEST SET]  TF: ACC={tf_acc:.2%}")
+    logger.info(f"[TEST SET] TFL: ACC={tfl_acc:.2%}")
+
+    # Check accuracy hit
+    acc_diff = tf_acc - tfl_acc
+    if acc_diff > 0.5:
+        logger.warning(f"TFLite accuracy dropped by {100*acc_diff:0.2f}%")
+    else:
+        logger.info("Validation passed")
@@ -9,10 +9,16 @@ from rich.console import Console
 from sklearn.metrics import f1_score
 from wandb.keras import WandbCallback
 
-from neuralspot.tflite.convert import convert_tflite, predict_tflite, xxd_c_dump
+from neuralspot.tflite.convert import (
+    convert_tflite,
+    predict_tflite,
+    quantize_int4_weights,
+    xxd_c_dump,
+)
 from neuralspot.tflite.metrics import get_flops
 from neuralspot.tflite.model import get_strategy, load_model
 
+from .cascade import export_small_model
 from .datasets import IcentiaDataset
 from .defines import HeartExportParams, HeartTask, HeartTestParams, HeartTrainParams
 from .metrics import confusion_matrix_plot, roc_auc_plot
@@ -322,6 +328,18 @@ def export_model(params: HeartExportParams):
     logger.info(f"[TEST SET]  TF: ACC={tf_acc:.2%}, F1={tf_f1:.2%}")
     logger.info(f"[TEST SET] TFL: ACC={tfl_acc:.2%}, F1={tfl_f1:.2%}")
 
+    if params.int4_weights:
+        weights = model.get_weights()
+        int8_bytes, int4_bytes = quantize_int4_weights(model)
+        y_pred_int4 = np.argmax(model.predict(test_x), axis=1)
+        model.set_weights(weights)
+        int4_acc = np.sum(y_pred_int4 == y_true) / len(y_true)
+        int4_f1 = f1_score(y_true, y_pred_int4, average="macro")
+        logger.info(
+            f"[TEST SET] INT4: ACC={int4_acc:.2%}, F1={int4_f1:.2%}, KERNELS={int8_bytes/1024:0.1f}KB -> {int4_bytes/1024:0.1f}KB"
+        )
+    # END IF
+
     if params.threshold is not None:
         y_thresh_idx = np.union1d(
             get_predicted_threshold_indices(y_prob_tf, y_pred_tf, params.threshold),
@@ -346,6 +364,10 @@ def export_model(params: HeartExportParams):
         )
     # END IF
 
+    if getattr(params, "small_model_file", None):
+        export_small_model(params, HeartTask.beat, test_x, test_y, get_flops(model, batch_size=1), y_prob_tfl)
+    # END IF
+
     # Check accuracy hit
     acc_diff = tf_acc - tfl_acc
     if acc_diff > 0.5:
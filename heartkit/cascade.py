@@ -0,0 +1,132 @@
+""" Two-level cascade: a small model in front of the reference arrhythmia or beat model.
+
+The small model (tasks.get_small_model, trained with `"model": "small"`) classifies every sample on the
+EVB (evb/src/cascade_model.cc), and the reference model only runs when the small model's softmax
+margin, its top probability minus the runner-up, falls below the task's margin. Exporting a task with
+`small_model_file` set writes the small variant next to the reference one and reports the escalation
+rate, accuracy and average FLOPs the cascade would give on the test set.
+"""
+import shutil
+
+import numpy as np
+import numpy.typing as npt
+import tensorflow as tf
+from sklearn.metrics import f1_score
+
+from neuralspot.tflite.convert import convert_tflite, predict_tflite, xxd_c_dump
+from neuralspot.tflite.metrics import get_flops
+from neuralspot.tflite.model import load_model
+
+from .defines import HeartExportParams, HeartTask
+from .utils import setup_logger
+
+logger = setup_logger(__name__)
+
+# Must match HK_ARR_CASCADE_MARGIN and HK_BEAT_CASCADE_MARGIN (evb/src/constants.h)
+CASCADE_MARGINS = {HeartTask.arrhythmia: 0.5, HeartTask.beat: 0.5}
+# Header name prefix of each task's small model (<prefix>_small_model_buffer.h, g_<prefix>_small_model)
+CASCADE_PREFIXES = {HeartTask.arrhythmia: "arr", HeartTask.beat: "beat"}
+
+
+def softmax_margin(y_prob: npt.NDArray) -> npt.NDArray:
+    """Top probability minus the runner-up of each row"""
+    y_sort = np.sort(y_prob, axis=-1)
+    return y_sort[..., -1] - y_sort[..., -2]
+
+
+def cascade_report(
+    y_true: npt.NDArray,
+    small_prob: npt.NDArray,
+    large_prob: npt.NDArray,
+    margin: float,
+    small_flops: int,
+    large_flops: int,
+    name: str = "CASCADE",
+) -> npt.NDArray:
+    """Log what escalating the samples under margin to the large model gives.
+
+    Args:
+        y_true (npt.NDArray): Labels
+        small_prob (npt.NDArray): Small model softmax
+        large_prob (npt.NDArray): Large model softmax
+        margin (float): Escalation margin
+        small_flops (int): Small model FLOPs
+        large_flops (int): Large model FLOPs
+        name (str, optional): Log tag. Defaults to "CASCADE".
+
+    Returns:
+        npt.NDArray: Cascade predictions
+    """
+    escalate = softmax_margin(small_prob) < margin
+    y_pred = np.where(escalate, np.argmax(large_prob, axis=1), np.argmax(small_prob, axis=1))
+    rate = np.mean(escalate)
+    for label, y_prob in (("SMALL", small_prob), ("LARGE", large_prob)):
+        acc = np.mean(np.argmax(y_prob, axis=1) == y_true)
+        logger.info(f"[{name}] {label}: ACC={acc:.2%}")
+    # END FOR
+    acc = np.sum(y_pred == y_true) / len(y_true)
+    f1 = f1_score(y_true, y_pred, average="macro")
+    flops = small_flops + rate * large_flops
+    logger.info(
+        f"[{name}] ACC={acc:.2%}, F1={f1:.2%}, MARGIN={margin:0.2f}, ESCALATED={rate:.2%}, "
+        f"MFLOPS={flops/1e6:0.2f} ({flops/large_flops:.0%} of large)"
+    )
+    return y_pred
+
+
+def export_small_model(
+    params: HeartExportParams,
+    task: HeartTask,
+    test_x: npt.NDArray,
+    test_y: npt.NDArray,
+    large_flops: int,
+    large_prob_tfl: npt.NDArray,
+):
+    """Export params.small_model_file as the small level of the task's cascade, then report the
+    cascade with the exported large model's outputs.
+
+    Args:
+        params (HeartExportParams): Deployment parameters
+        task (HeartTask): Arrhythmia or beat
+        test_x (npt.NDArray): Test inputs
+        test_y (npt.NDArray): Test labels (one-hot)
+        large_flops (int): Large model FLOPs
+        large_prob_tfl (npt.NDArray): Exported large model softmax on test_x
+    """
+    prefix = CASCADE_PREFIXES[task]
+    tfl_model_path = str(params.job_dir / f"{prefix}_small_model.tflite")
+    tflm_model_path = str(params.job_dir / f"{prefix}_small_model_buffer.h")
+    margin = getattr(params, "cascade_margin", CASCADE_MARGINS[task])
+
+    logger.info("Loading small model")
+    model = load_model(str(params.small_model_file))
+    inputs = tf.keras.layers.Input(test_x.shape[1:], dtype=tf.float32, batch_size=1)
+    model(inputs)
+    small_flops = get_flops(model, batch_size=1)
+    logger.info(f"Small model requires {small_flops/1e6:0.2f} MFLOPS")
+
+    logger.info("Converting small model to TFLite")
+    tflite_model = convert_tflite(
+        model,
+        quantize=True,
+        test_x=test_x[:1000],
+        input_type=tf.int8,
+        output_type=tf.int8,
+    )
+    with open(tfl_model_path, "wb") as fp:
+        fp.write(tflite_model)
+    xxd_c_dump(
+        src_path=tfl_model_path,
+        dst_path=tflm_model_path,
+        var_name=f"g_{prefix}_small_model",
+        chunk_len=20,
+        is_header=True,
+    )
+    if params.tflm_file:
+        dst_dir = params.tflm_file if params.tflm_file.is_dir() else params.tflm_file.parent
+        logger.info(f"Copying TFLM header to {dst_dir}")
+        shutil.copyfile(tflm_model_path, str(dst_dir / f"{prefix}_small_model_buffer.h"))
+
+    y_true = np.argmax(test_y, axis=1)
+    small_prob_tfl = tf.nn.softmax(predict_tflite(model_content=tflite_model, test_x=test_x)).numpy()
+    cascade_report(y_true, small_prob_tfl, large_prob_tfl, margin, small_flops, large_flops)
@@ -4,7 +4,7 @@ from typing import Type, TypeVar
 import pydantic_argparse
 from pydantic import BaseModel, Field
 
-from . import arrhythmia, beat, hrv, segmentation
+from . import arrhythmia, beat, hrv, multihead, segmentation
 from .datasets import download_datasets
 from .defines import (
     HeartDemoParams,
@@ -74,6 +74,8 @@ def run(inputs: list[str] | None = None):
             task_handler = segmentation
         case HeartTask.hrv:
             task_handler = hrv
+        case HeartTask.multihead:
+            task_handler = multihead
         case _:
             raise NotImplementedError()
     # END MATCH
@@ -14,6 +14,7 @@ class HeartTask(str, Enum):
     beat = "beat"
     hrv = "hrv"
     segmentation = "segmentation"
+    multihead = "multihead"
 
 
 class HeartKitMode(str, Enum):
@@ -233,6 +234,9 @@ class HeartExportParams(BaseModel, extra=Extra.allow):
     quantization: bool | None = Field(
         None, description="Enable post training quantization (PQT)"
     )
+    int4_weights: bool = Field(
+        False, description="Report accuracy and kernel size with int4 weights (model_fuser --int4)"
+    )
     tflm_var_name: str = Field("g_model", description="TFLite Micro C variable name")
     tflm_file: Path | None = Field(
         None, description="Path to copy TFLM header file (e.g. ./model_buffer.h)"
@@ -279,6 +283,10 @@ class HeartDemoParams(BaseModel, extra=Extra.allow):
         description="VID and PID of serial device formatted as `VID:PID` in base-10",
     )
     baudrate: int = Field(115200, description="Serial baudrate")
+    transport: str | None = Field(
+        None,
+        description="RPC transport URI: `usb` (default), `pty://<link>` or `unix://<socket>`",
+    )
     data_parallelism: int = Field(
         default_factory=lambda: os.cpu_count() or 1,
         description="# of data loaders running in parallel",
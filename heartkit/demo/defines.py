@@ -14,6 +14,14 @@ class AppState(str, Enum):
     FAIL_STATE = "FAIL_STATE"
 
 
+class HKStagePerf(BaseModel):
+    """HeartKit per-stage performance counters"""
+
+    stage: str = Field(default="", description="Pipeline stage")
+    cycles: int = Field(default=0, description="CPU cycles")
+    usec: int = Field(default=0, description="Latency (us)")
+
+
 class HKResult(BaseModel, extra=Extra.allow):
     """HeartKit result"""
 
@@ -33,6 +41,30 @@ class HKResult(BaseModel, extra=Extra.allow):
         default=0, description="# PVC beats", alias="numPvcBeats"
     )
     arrhythmia: bool = Field(default=False, description="Arrhythmia present")
+    perf: list[HKStagePerf] = Field(
+        default_factory=list, description="Per-stage performance counters"
+    )
+    num_rr: int = Field(
+        default=0, description="# RR intervals in the HRV window", alias="numRR"
+    )
+    sdnn: float = Field(default=0, description="SDNN (ms)")
+    rmssd: float = Field(default=0, description="RMSSD (ms)")
+    pnn50: float = Field(default=0, description="pNN50 (%)")
+    lf_power: float = Field(default=0, description="LF power (ms^2)", alias="lfPower")
+    hf_power: float = Field(default=0, description="HF power (ms^2)", alias="hfPower")
+    lf_hf_ratio: float = Field(default=0, description="LF/HF ratio", alias="lfHfRatio")
+    pr_interval: int = Field(
+        default=-1, description="PR interval (ms), -1 if none", alias="prInterval"
+    )
+    qrs_duration: int = Field(
+        default=-1, description="QRS duration (ms), -1 if none", alias="qrsDuration"
+    )
+    qt_interval: int = Field(
+        default=-1, description="QT interval (ms), -1 if none", alias="qtInterval"
+    )
+    qtc_interval: int = Field(
+        default=-1, description="QTc interval (ms), -1 if none", alias="qtcInterval"
+    )
 
 
 class HeartKitState(BaseModel):
@@ -1,3 +1,4 @@
+import csv
 import ctypes
 import threading
 import time
@@ -8,18 +9,19 @@ import erpc
 import numpy as np
 import numpy.typing as npt
 from erpc.simple_server import ServerThread as RpcServerThread
-from erpc.transport import SerialTransport
+from erpc.transport import FramedTransport
 from serial.serialutil import SerialException
 
 from neuralspot.rpc import GenericDataOperations_EvbToPc as gen_evb2pc
 from neuralspot.rpc import GenericDataOperations_PcToEvb as gen_pc2evb
-from neuralspot.rpc.utils import get_serial_transport
+from neuralspot.rpc.utils import get_transport
 
 from ..datasets.icentia11k import IcentiaDataset
 from ..defines import HeartDemoParams
 from ..utils import setup_logger
 from .client import HKRestClient
-from .defines import AppState, HeartKitState, HKResult
+from .defines import AppState, HeartKitState, HKResult, HKStagePerf
+from .utils import StagePerfStats
 
 logger = setup_logger(__name__)
 
@@ -37,9 +39,49 @@ class RpcBlockCommands(str, Enum):
     SEND_SAMPLES = "SEND_SAMPLES"
     SEND_MASK = "SEND_MASK"
     SEND_RESULTS = "SEND_RESULTS"
+    SEND_PROFILE = "SEND_PROFILE"
     FETCH_SAMPLES = "FETCH_SAMPLES"
 
 
+HK_MODEL_NAMES = ["arrhythmia", "segmentation", "beat"]
+HK_STAGE_NAMES = ["PREPROCESS", "ARRHYTHMIA", "SEGMENTATION", "PEAKS", "HRV", "BEAT"]
+
+
+class HKStagePerfStruct(ctypes.Structure):
+    """EVB struct for storing per-stage performance counters."""
+
+    _fields_ = [
+        ("cycles", ctypes.c_uint32),
+        ("usec", ctypes.c_uint32),
+    ]
+
+
+class HKOpProfileStruct(ctypes.Structure):
+    """EVB struct for storing per-operator profile row."""
+
+    _fields_ = [
+        ("tag", ctypes.c_char * 20),
+        ("ticks", ctypes.c_uint32),
+        ("invokes", ctypes.c_uint32),
+        ("macs", ctypes.c_uint32),
+        ("in_shape", ctypes.c_int16 * 4),
+        ("out_shape", ctypes.c_int16 * 4),
+    ]
+
+    def to_dict(self) -> dict:
+        """Convert to CSV row"""
+        mean_ticks = self.ticks / max(1, self.invokes)
+        return dict(
+            op_type=self.tag.decode(),
+            in_shape="x".join(str(d) for d in self.in_shape if d),
+            out_shape="x".join(str(d) for d in self.out_shape if d),
+            macs=self.macs,
+            invokes=self.invokes,
+            mean_cycles=round(mean_ticks, 1),
+            cycles_per_mac=round(mean_ticks / self.macs, 3) if self.macs else 0,
+        )
+
+
 class HKResultStruct(ctypes.Structure):
     """EVB struct for storing results."""
 
@@ -51,6 +93,18 @@ class HKResultStruct(ctypes.Structure):
         ("num_pac_beats", ctypes.c_uint32),
         ("num_pvc_beats", ctypes.c_uint32),
         ("arrhythmia", ctypes.c_uint32),
+        ("perf", HKStagePerfStruct * len(HK_STAGE_NAMES)),
+        ("num_rr", ctypes.c_uint32),
+        ("sdnn", ctypes.c_float),
+        ("rmssd", ctypes.c_float),
+        ("pnn50", ctypes.c_float),
+        ("lf_power", ctypes.c_float),
+        ("hf_power", ctypes.c_float),
+        ("lf_hf_ratio", ctypes.c_float),
+        ("pr_interval", ctypes.c_int32),
+        ("qrs_duration", ctypes.c_int32),
+        ("qt_interval", ctypes.c_int32),
+        ("qtc_interval", ctypes.c_int32),
     ]
 
     def to_pydantic(self) -> HKResult:
@@ -62,6 +116,21 @@ class HKResultStruct(ctypes.Structure):
             num_pac_beats=self.num_pac_beats,
             num_pvc_beats=self.num_pvc_beats,
             arrhythmia=bool(self.arrhythmia),
+            perf=[
+                HKStagePerf(stage=name, cycles=p.cycles, usec=p.usec)
+                for name, p in zip(HK_STAGE_NAMES, self.perf)
+            ],
+            num_rr=self.num_rr,
+            sdnn=self.sdnn,
+            rmssd=self.rmssd,
+            pnn50=self.pnn50,
+            lf_power=self.lf_power,
+            hf_power=self.hf_power,
+            lf_hf_ratio=self.lf_hf_ratio,
+            pr_interval=self.pr_interval,
+            qrs_duration=self.qrs_duration,
+            qt_interval=self.qt_interval,
+            qtc_interval=self.qtc_interval,
         )
 
 
@@ -84,12 +153,14 @@ class EvbHandler(gen_evb2pc.interface.Ievb_to_pc):
         )
 
         self.data_gen = self.create_data_generator()
+        self.perf_stats = StagePerfStats()
+        self.op_profiles: dict[str, dict[int, dict]] = {}
         self._frame_idx = 0
         self._run = False
 
         # Internal RPC handler
         self._rpc = None
-        self._transport: SerialTransport | None = None
+        self._transport: FramedTransport | None = None
 
     def create_data_generator(self) -> Generator[npt.NDArray[np.float32], None, None]:
         """Create data generator
@@ -118,9 +189,23 @@ class EvbHandler(gen_evb2pc.interface.Ievb_to_pc):
             self._frame_idx = xs
 
         if RpcBlockCommands.SEND_RESULTS in block.description:
+            # Older firmware sends results without perf counters
+            buffer = bytes(block.buffer).ljust(ctypes.sizeof(HKResultStruct), b"\0")
             self.hk_state.results = HKResultStruct.from_buffer_copy(
-                block.buffer
+                buffer
             ).to_pydantic()
+            self.perf_stats.update(self.hk_state.results.perf)
+            logger.debug(f"[EVB] Stage perf\n{self.perf_stats}")
+
+        if RpcBlockCommands.SEND_PROFILE in block.description:
+            # Use block.length as model index (upper 16 bits) and first row (lower 16 bits)
+            model = HK_MODEL_NAMES[block.length >> 16]
+            row_offset = block.length & 0xFFFF
+            num_rows = len(block.buffer) // ctypes.sizeof(HKOpProfileStruct)
+            rows = (HKOpProfileStruct * num_rows).from_buffer_copy(block.buffer)
+            profile = self.op_profiles.setdefault(model, {})
+            for i, row in enumerate(rows):
+                profile[row_offset + i] = row.to_dict()
 
         if RpcBlockCommands.SEND_MASK in block.description:
             x: list[int] = np.frombuffer(block.buffer, dtype=np.uint8).tolist()
@@ -174,10 +259,24 @@ class EvbHandler(gen_evb2pc.interface.Ievb_to_pc):
             self.client.set_app_state(self.hk_state.app_state)
         elif self.hk_state.app_state == AppState.DISPLAY_STATE:
             self.client.set_state(self.hk_state)
+            self.write_op_profiles()
         elif self.hk_state.app_state == AppState.FAIL_STATE:
             pass  # Log error message
         # END
 
+    def write_op_profiles(self):
+        """Write per-operator profile tables received from EVB as CSV (one file per model)."""
+        for model, profile in self.op_profiles.items():
+            csv_path = self.params.job_dir / f"{model}_op_profile.csv"
+            with open(csv_path, "w", newline="", encoding="utf-8") as fp:
+                fields = ["op_index"] + list(next(iter(profile.values())).keys())
+                writer = csv.DictWriter(fp, fieldnames=fields)
+                writer.writeheader()
+                for op_index in sorted(profile):
+                    writer.writerow({"op_index": op_index, **profile[op_index]})
+            logger.debug(f"[EVB] Wrote {csv_path}")
+        self.op_profiles = {}
+
     def ns_rpc_data_remotePrintOnPC(self, msg: str):
         # If EVB app FSM updates
         state: AppState | None = next((s for s in AppState if s in msg), None)
@@ -191,8 +290,8 @@ class EvbHandler(gen_evb2pc.interface.Ievb_to_pc):
     def handle_thread_exception(self, args: threading.ExceptHookArgs):
         """Handle thread exceptions."""
         logger.exception(f"RPC Server error: {args.exc_value} {args.exc_type}")
-        # Fatal if not serial exception- otherwise we assume EVB was reset/disconnected
-        is_fatal = args.exc_type != SerialException
+        # Fatal if not serial/connection exception- otherwise we assume EVB was reset/disconnected
+        is_fatal = not issubclass(args.exc_type, (SerialException, ConnectionError))
         if is_fatal:
             self._run = False
         self.stop_rpc()
@@ -205,8 +304,10 @@ class EvbHandler(gen_evb2pc.interface.Ievb_to_pc):
             try:
                 if not self._run:
                     return
-                self._transport = get_serial_transport(
-                    vid_pid=self.params.vid_pid, baudrate=self.params.baudrate
+                self._transport = get_transport(
+                    uri=self.params.transport,
+                    vid_pid=self.params.vid_pid,
+                    baudrate=self.params.baudrate,
                 )
             except TimeoutError:
                 logger.warning("Unable to locate EVB device. Retrying in 5 secs...")
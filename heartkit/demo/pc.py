@@ -13,7 +13,7 @@ from neuralspot.tflite.model import load_model
 from ..datasets import IcentiaDataset
 from ..datasets.preprocess import preprocess_signal
 from ..defines import HeartBeat, HeartDemoParams, HeartRate
-from ..hrv import compute_hrv
+from ..hrv import compute_hrv, compute_hrv_metrics
 from ..utils import setup_logger
 from .client import HKRestClient
 from .defines import AppState, HeartKitState, HKResult
@@ -229,6 +229,7 @@ class PcHandler:
             num_pac_beats=int(np.sum(blabels == HeartBeat.pac)),
             num_pvc_beats=int(np.sum(blabels == HeartBeat.pvc)),
             arrhythmia=np.any(arr_labels),
+            **compute_hrv_metrics(rpeaks, sampling_rate=self.params.sampling_rate),
         )
         logger.debug(f"APP_STATE={self.hk_state.app_state}")
         try:
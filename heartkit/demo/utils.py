@@ -1,3 +1,5 @@
+from collections import defaultdict, deque
+
 import numpy as np
 import numpy.typing as npt
 import plotly
@@ -6,7 +8,7 @@ from plotly.subplots import make_subplots
 
 from ..defines import HeartBeat, HeartSegment, HeartTask
 from ..tasks import get_class_names
-from .defines import HKResult
+from .defines import HKResult, HKStagePerf
 
 plotly.io.json.config.default_engine = "orjson"
 
@@ -78,6 +80,10 @@ def hkresult_to_str(result: HKResult) -> str:
     rhythym_names = get_class_names(HeartTask.hrv)
     num_beats = result.num_norm_beats + result.num_pac_beats + result.num_pvc_beats
     rhythm = "ARRHYTHMIA" if result.arrhythmia else rhythym_names[result.heart_rhythm]
+
+    def interval(ms: int) -> str:
+        return f"{ms} ms" if ms >= 0 else "--"
+
     return (
         "--------------------------\n"
         "**** HeartKit Results ****\n"
@@ -89,4 +95,68 @@ def hkresult_to_str(result: HKResult) -> str:
         f"   PAC Beats: {result.num_pac_beats}\n"
         f"   PVC Beats: {result.num_pvc_beats}\n"
         f"  Arrhythmia: {'Detected' if result.arrhythmia else 'Not Detected'}\n"
+        f"   HRV Beats: {result.num_rr}\n"
+        f"        SDNN: {result.sdnn:0.1f} ms\n"
+        f"       RMSSD: {result.rmssd:0.1f} ms\n"
+        f"       pNN50: {result.pnn50:0.1f} %\n"
+        f"       LF/HF: {result.lf_hf_ratio:0.2f}\n"
+        f" PR Interval: {interval(result.pr_interval)}\n"
+        f"QRS Duration: {interval(result.qrs_duration)}\n"
+        f" QT Interval: {interval(result.qt_interval)}\n"
+        f"QTc Interval: {interval(result.qtc_interval)}\n"
     )
+
+
+class StagePerfStats:
+    """Aggregates per-stage latency reported with each HKResult as min/mean/max histograms"""
+
+    def __init__(self, window: int = 1000, bins: int = 10) -> None:
+        """
+        Args:
+            window (int, optional): # most recent results kept per stage. Defaults to 1000.
+            bins (int, optional): # histogram bins. Defaults to 10.
+        """
+        self.bins = bins
+        self.cycles: dict[str, deque[int]] = defaultdict(lambda: deque(maxlen=window))
+        self.usec: dict[str, deque[int]] = defaultdict(lambda: deque(maxlen=window))
+
+    def update(self, perf: list[HKStagePerf]):
+        """Add stage counters from a single result"""
+        for p in perf:
+            # Stages that were not run (or firmware without counters) report zero
+            if p.cycles == 0:
+                continue
+            self.cycles[p.stage].append(p.cycles)
+            self.usec[p.stage].append(p.usec)
+
+    def summary(self) -> dict[str, dict]:
+        """Get min/mean/max and histogram of cycles and latency for each stage
+
+        Returns:
+            dict[str, dict]: Stats keyed by stage name
+        """
+        stats = {}
+        for stage, cycles in self.cycles.items():
+            cyc = np.array(cycles)
+            usec = np.array(self.usec[stage])
+            counts, edges = np.histogram(cyc, bins=self.bins)
+            stats[stage] = dict(
+                count=cyc.size,
+                cycles_min=int(cyc.min()),
+                cycles_mean=float(cyc.mean()),
+                cycles_max=int(cyc.max()),
+                usec_min=int(usec.min()),
+                usec_mean=float(usec.mean()),
+                usec_max=int(usec.max()),
+                hist_counts=counts.tolist(),
+                hist_edges=edges.tolist(),
+            )
+        return stats
+
+    def __str__(self) -> str:
+        lines = [f"{'Stage':>12} {'N':>5} {'Min(us)':>10} {'Mean(us)':>10} {'Max(us)':>10}"]
+        for stage, s in self.summary().items():
+            lines.append(
+                f"{stage:>12} {s['count']:>5} {s['usec_min']:>10} {s['usec_mean']:>10.1f} {s['usec_max']:>10}"
+            )
+        return "\n".join(lines)
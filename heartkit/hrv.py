@@ -1,8 +1,27 @@
+import json
+import os
+
 import neurokit2 as nk
 import numpy as np
 import numpy.typing as npt
+import scipy.interpolate
+import tensorflow as tf
+from rich.console import Console
+
+from neuralspot.tflite.model import get_strategy, load_model
+
+from .datasets import HeartKitDataset, LudbDataset, SyntheticDataset
+from .defines import (
+    HeartExportParams,
+    HeartSegment,
+    HeartTask,
+    HeartTestParams,
+    HeartTrainParams,
+)
+from .utils import set_random_seed, setup_logger
 
-from .defines import HeartExportParams, HeartTestParams, HeartTrainParams
+console = Console()
+logger = setup_logger(__name__)
 
 
 def find_peaks_from_segments(
@@ -101,27 +120,272 @@ def compute_hrv(
     return hr_bpm, rr_lens, rpeaks
 
 
+def compute_hrv_metrics(
+    rpeaks: npt.NDArray,
+    sampling_rate: int = 1000,
+    rr_min: float = 0.3,
+    rr_max: float = 2.0,
+    rr_tol: float = 0.2,
+    nn_ms: float = 50,
+    resample_hz: int = 4,
+    fft_len: int = 256,
+    window: int = 300,
+) -> dict[str, float]:
+    """Compute HRV metrics the way the EVB's streaming HRV engine (evb/src/hrv.cc) does.
+    RR intervals out of [rr_min, rr_max] sec or off the previous RR by more than rr_tol are dropped
+    (ectopic, missed or extra beats), as is the successive difference across one. LF/HF is the band
+    power of the last fft_len points of the RR tachogram resampled at resample_hz with cubic Hermite
+    segments, mean removed and Hann windowed, and is zero while the peaks span less than that.
+
+    Args:
+        rpeaks (npt.NDArray): R peak indices, ascending
+        sampling_rate (int, optional): Sampling rate in Hz. Defaults to 1000.
+        rr_min (float, optional): Shortest RR in sec. Defaults to 0.3.
+        rr_max (float, optional): Longest RR in sec. Defaults to 2.0.
+        rr_tol (float, optional): Relative change from the previous RR that drops an RR. Defaults to 0.2.
+        nn_ms (float, optional): Successive difference pNN50 counts (ms). Defaults to 50.
+        resample_hz (int, optional): Tachogram resampling rate (Hz). Defaults to 4.
+        fft_len (int, optional): Tachogram points in the spectrum. Defaults to 256.
+        window (int, optional): Last accepted RR intervals the metrics cover. Defaults to 300.
+
+    Returns:
+        dict[str, float]: num_rr, sdnn, rmssd, pnn50 (ms, %), lf_power and hf_power (ms^2), lf_hf_ratio
+    """
+    metrics = dict(
+        num_rr=0, sdnn=0, rmssd=0, pnn50=0, lf_power=0, hf_power=0, lf_hf_ratio=0
+    )
+    rpeaks = np.asarray(rpeaks)
+    # Accepted RR: closing peak (sec), RR (sec) and difference to the previous RR (NaN without one)
+    rr_ends, rr_vals, diffs = [], [], []
+    prev_rr, prev_accepted = None, False
+    for start, end in zip(rpeaks[:-1], rpeaks[1:]):
+        rr = (end - start) / sampling_rate
+        if rr < rr_min or rr > rr_max:
+            prev_accepted = False
+            continue
+        accepted = prev_rr is None or abs(rr - prev_rr) <= rr_tol * prev_rr
+        if accepted:
+            rr_ends.append(end / sampling_rate)
+            rr_vals.append(rr)
+            diffs.append(rr - prev_rr if prev_accepted else np.nan)
+        prev_rr, prev_accepted = rr, accepted
+    # END FOR
+    rr_ms = 1000 * np.array(rr_vals[-window:])
+    diffs_ms = 1000 * np.array(diffs[-window:])
+    diffs_ms = diffs_ms[~np.isnan(diffs_ms)]
+    metrics["num_rr"] = rr_ms.size
+    if rr_ms.size > 1:
+        metrics["sdnn"] = float(np.std(rr_ms, ddof=1))
+    if diffs_ms.size:
+        metrics["rmssd"] = float(np.sqrt(np.mean(diffs_ms**2)))
+        metrics["pnn50"] = float(100 * np.mean(np.abs(diffs_ms) > nn_ms))
+
+    # LF/HF over the last fft_len tachogram points
+    t = np.array(rr_ends[-window:])
+    span = (fft_len - 1) / resample_hz
+    if t.size < 2 or t[-1] - t[0] < span:
+        return metrics
+    tangents = np.gradient(rr_ms, t)
+    tangents[1:-1] = (rr_ms[2:] - rr_ms[:-2]) / (t[2:] - t[:-2])
+    spline = scipy.interpolate.CubicHermiteSpline(t, rr_ms, tangents)
+    tacho = spline(t[-1] - span + np.arange(fft_len) / resample_hz)
+    taper = np.hanning(fft_len)
+    spec = np.fft.rfft((tacho - tacho.mean()) * taper)
+    power = 2 * np.abs(spec) ** 2 / (fft_len * np.sum(taper**2))
+    freqs = np.fft.rfftfreq(fft_len, d=1 / resample_hz)
+    valid = (freqs > 0) & (freqs < resample_hz / 2)
+    metrics["lf_power"] = float(np.sum(power[valid & (freqs >= 0.04) & (freqs < 0.15)]))
+    metrics["hf_power"] = float(np.sum(power[valid & (freqs >= 0.15) & (freqs < 0.4)]))
+    if metrics["hf_power"] > 0:
+        metrics["lf_hf_ratio"] = metrics["lf_power"] / metrics["hf_power"]
+    return metrics
+
+
+def interior_qrs_mask(qrs_mask: npt.NDArray) -> npt.NDArray:
+    """Clear the QRS segments a frame cuts at either edge. find_peaks_from_segments pairs every QRS
+    start with the next end, so a frame that starts or ends inside a QRS would leave an end without
+    a start (or a start without an end) and misalign the pairs.
+
+    Args:
+        qrs_mask (npt.NDArray): QRS binary mask
+
+    Returns:
+        npt.NDArray: QRS binary mask that is zero at both edges
+    """
+    mask = np.array(qrs_mask, dtype=int)
+    gaps = np.flatnonzero(mask == 0)
+    if gaps.size == 0:
+        return np.zeros_like(mask)
+    mask[: gaps[0]] = 0
+    mask[gaps[-1] + 1 :] = 0
+    return mask
+
+
+def compare_hrv_metrics(
+    x: npt.NDArray, y_true: npt.NDArray, y_pred: npt.NDArray, sampling_rate: int
+) -> dict[str, float]:
+    """Compare HRV metrics of the R peaks in true and predicted segmentation masks. QRS segments cut
+    by the frame edges are left out, and heart rate only counts frames with more than 3 peaks in both.
+
+    Args:
+        x (npt.NDArray): ECG frames (N, frame_size, 1)
+        y_true (npt.NDArray): True segment labels (N, frame_size)
+        y_pred (npt.NDArray): Predicted segment labels (N, frame_size)
+        sampling_rate (int): Sampling rate in Hz
+
+    Returns:
+        dict[str, float]: Mean absolute error of heart rate (BPM), SDNN, RMSSD (ms) and pNN50 (%)
+    """
+    keys = ["heart_rate", "sdnn", "rmssd", "pnn50"]
+    errors: dict[str, list[float]] = {k: [] for k in keys}
+    for i in range(x.shape[0]):
+        results = []
+        for y in (y_true[i], y_pred[i]):
+            peaks = find_peaks_from_segments(
+                x[i].squeeze(),
+                interior_qrs_mask(y == HeartSegment.qrs),
+                sampling_rate=sampling_rate,
+            )
+            metrics = compute_hrv_metrics(peaks, sampling_rate=sampling_rate)
+            # ecg_rate has no RR for 3 peaks or less, which ecg_bpm turns into an infinite rate
+            metrics["heart_rate"] = (
+                ecg_bpm(peaks, sampling_rate=sampling_rate) if peaks.size > 3 else None
+            )
+            results.append(metrics)
+        # END FOR
+        # Frames too short for an RR difference in either mask say nothing about HRV
+        if min(results[0]["num_rr"], results[1]["num_rr"]) < 2:
+            continue
+        for k in keys:
+            if results[0][k] is None or results[1][k] is None:
+                continue
+            errors[k].append(abs(results[0][k] - results[1][k]))
+    # END FOR
+    return {k: float(np.mean(v)) if v else 0.0 for k, v in errors.items()} | {
+        "num_frames": len(errors["sdnn"])
+    }
+
+
+def _predict_masks(model_file: str, x: npt.NDArray) -> npt.NDArray:
+    """Segment frames with the segmentation model"""
+    strategy = get_strategy()
+    with strategy.scope():
+        logger.info("Loading segmentation model")
+        model = load_model(model_file)
+        logger.info("Performing inference")
+        y_prob = tf.nn.softmax(model.predict(x)).numpy()
+    # END WITH
+    return np.argmax(y_prob, axis=2)
+
+
 def train_model(params: HeartTrainParams):
-    """Train HRV model.
+    """Train HRV model. HRV has no weights of its own: the R peaks come from the QRS segments of the
+    segmentation model (model_file) and the metrics from compute_hrv_metrics. This compares the HRV
+    metrics of the true and predicted masks of the validation patients and stores them in job_dir.
 
     Args:
         params (HeartTrainParams): Training parameters
     """
-    # Load segmentation datasets
-    # Load segmentation model
-    # Compute HRV metrics across true and predicted segmentation masks
-    # Routine
-    #   Identify R peak from QRS segments and compute mean and std
-    #   Remove outlier R peak regions based on confidence and std
-    #   Compute heart rate, rhythm label, RR interval, RR variation
+    dataset_names: list[str] = getattr(params, "datasets", ["ludb"])
+    model_file: str | None = getattr(params, "model_file", None)
+    num_pts = getattr(params, "num_pts", 1000)
+
+    params.seed = set_random_seed(params.seed)
+    logger.info(f"Random seed {params.seed}")
+    if model_file is None:
+        logger.error("HRV needs a segmentation model_file")
+        return
+
+    os.makedirs(str(params.job_dir), exist_ok=True)
+    logger.info(f"Creating working directory in {params.job_dir}")
+
+    datasets: list[HeartKitDataset] = []
+    if "synthetic" in dataset_names:
+        datasets.append(
+            SyntheticDataset(
+                str(params.ds_path),
+                task=HeartTask.segmentation,
+                frame_size=params.frame_size,
+                target_rate=params.sampling_rate,
+                num_pts=num_pts,
+            )
+        )
+    if "ludb" in dataset_names:
+        datasets.append(
+            LudbDataset(
+                str(params.ds_path),
+                task=HeartTask.segmentation,
+                frame_size=params.frame_size,
+                target_rate=params.sampling_rate,
+            )
+        )
+
+    with console.status("[bold green] Loading validation datasets..."):
+        val_datasets = []
+        for ds in datasets:
+            _, val_ds = ds.load_train_datasets(
+                train_patients=params.train_patients,
+                val_patients=params.val_patients,
+                train_pt_samples=params.samples_per_patient,
+                val_pt_samples=params.val_samples_per_patient,
+                val_file=params.val_file,
+                val_size=params.val_size,
+                num_workers=params.data_parallelism,
+            )
+            val_datasets.append(val_ds)
+        # END FOR
+        val_ds = val_datasets[0]
+        for ds in val_datasets[1:]:
+            val_ds = val_ds.concatenate(ds)
+        val_x, val_y = next(val_ds.batch(params.val_size or 10_000).as_numpy_iterator())
+    # END WITH
+
+    y_pred = _predict_masks(model_file, val_x)
+    errors = compare_hrv_metrics(
+        val_x, np.argmax(val_y, axis=2), y_pred, params.sampling_rate
+    )
+    logger.info(
+        f"[VAL SET] HR MAE={errors['heart_rate']:0.2f} BPM, SDNN MAE={errors['sdnn']:0.1f} ms, "
+        f"RMSSD MAE={errors['rmssd']:0.1f} ms, pNN50 MAE={errors['pnn50']:0.1f}%"
+    )
+    with open(str(params.job_dir / "hrv_metrics.json"), "w", encoding="utf-8") as fp:
+        json.dump(errors, fp, indent=2)
 
 
 def evaluate_model(params: HeartTestParams):
-    """Test HRV model.
+    """Test HRV model. Compares the HRV metrics of true and predicted segmentation masks.
 
     Args:
         params (HeartTestParams): Testing/evaluation parameters
     """
+    params.seed = set_random_seed(params.seed)
+    logger.info(f"Random seed {params.seed}")
+
+    with console.status("[bold green] Loading test dataset..."):
+        ds = SyntheticDataset(
+            str(params.ds_path),
+            task=HeartTask.segmentation,
+            frame_size=params.frame_size,
+            target_rate=params.sampling_rate,
+            num_pts=200,
+        )
+        test_ds = ds.load_test_dataset(
+            test_patients=params.test_patients,
+            test_pt_samples=params.samples_per_patient,
+            num_workers=params.data_parallelism,
+        )
+        test_x, test_y = next(test_ds.batch(params.test_size).as_numpy_iterator())
+    # END WITH
+
+    y_pred = _predict_masks(str(params.model_file), test_x)
+    errors = compare_hrv_metrics(
+        test_x, np.argmax(test_y, axis=2), y_pred, params.sampling_rate
+    )
+    logger.info(
+        f"[TEST SET] HR MAE={errors['heart_rate']:0.2f} BPM, SDNN MAE={errors['sdnn']:0.1f} ms, "
+        f"RMSSD MAE={errors['rmssd']:0.1f} ms, pNN50 MAE={errors['pnn50']:0.1f}% "
+        f"over {errors['num_frames']} frames"
+    )
 
 
 def export_model(params: HeartExportParams):
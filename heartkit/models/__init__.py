@@ -1,5 +1,10 @@
-from .efficientnet import EfficientNetParams, EfficientNetV2, MBConvParams
+from .efficientnet import (
+    EfficientNetParams,
+    EfficientNetV2,
+    EfficientNetV2EarlyExit,
+    MBConvParams,
+)
 from .resnet import ResNet, ResNetBlockParams, ResNetParams
-from .unet import UNet, UNetBlockParams, UNetParams
+from .unet import UNet, UNetBlockParams, UNetParams, unet_decoder, unet_encoder
 
 __all__ = ["EfficientNetV2", "ResNet", "UNet"]
@@ -36,25 +36,34 @@ class EfficientNetParams(BaseModel):
     dropout: float = Field(default=0.2, description="Dropout rate")
     drop_connect_rate: float = Field(default=0.2, description="Drop connect rate")
     model_name: str = Field(default="EfficientNetV2", description="Model name")
+    exits: list[int] = Field(
+        default_factory=list, description="Blocks followed by an early exit (EfficientNetV2EarlyExit)"
+    )
 
 
 def efficientnet_core(
-    blocks: list[MBConvParams], drop_connect_rate: float = 0
+    blocks: list[MBConvParams],
+    drop_connect_rate: float = 0,
+    start: int = 0,
+    stop: int | None = None,
 ) -> Callable[[KerasTensor], KerasTensor]:
     """EfficientNet core
 
     Args:
         blocks (list[MBConvParam]): MBConv params
         drop_connect_rate (float, optional): Drop connect rate. Defaults to 0.
+        start (int, optional): First block to build. Defaults to 0.
+        stop (int | None, optional): Block to stop before. Defaults to None (all).
 
     Returns:
         Callable[[KerasTensor], KerasTensor]: Core
     """
 
     def layer(x: KerasTensor) -> KerasTensor:
-        global_block_id = 0
+        # Names and drop rates are those of the whole core
+        global_block_id = sum((b.depth for b in blocks[:start]))
         total_blocks = sum((b.depth for b in blocks))
-        for i, block in enumerate(blocks):
+        for i, block in enumerate(blocks[start:stop], start=start):
             filters = make_divisible(block.filters, 8)
             for d in range(block.depth):
                 name = f"stage{i+1}.mbconv{d+1}"
@@ -76,6 +85,54 @@ def efficientnet_core(
     return layer
 
 
+def efficientnet_stem(params: EfficientNetParams) -> Callable[[KerasTensor], KerasTensor]:
+    """EfficientNet stem (identity without input filters)"""
+
+    def layer(x: KerasTensor) -> KerasTensor:
+        if params.input_filters <= 0:
+            return x
+        name = "stem"
+        filters = make_divisible(params.input_filters, 8)
+        y = conv2d(
+            filters,
+            kernel_size=params.input_kernel_size,
+            strides=params.input_strides,
+            name=name,
+        )(x)
+        y = batch_norm(name=name)(y)
+        y = relu6(name=name)(y)
+        return y
+
+    return layer
+
+
+def efficientnet_top(
+    params: EfficientNetParams, num_classes: int | None = None
+) -> Callable[[KerasTensor], KerasTensor]:
+    """EfficientNet neck and top"""
+
+    def layer(x: KerasTensor) -> KerasTensor:
+        y = x
+        if params.output_filters:
+            name = "neck"
+            filters = make_divisible(params.output_filters, 8)
+            y = conv2d(
+                filters, kernel_size=(1, 1), strides=(1, 1), padding="same", name=name
+            )(y)
+            y = batch_norm(name=name)(y)
+            y = relu6(name=name)(y)
+
+        if params.include_top:
+            name = "top"
+            y = tf.keras.layers.GlobalAveragePooling2D(name=f"{name}.pool")(y)
+            if 0 < params.dropout < 1:
+                y = tf.keras.layers.Dropout(params.dropout)(y)
+            y = tf.keras.layers.Dense(num_classes, name=name)(y)
+        return y
+
+    return layer
+
+
 def EfficientNetV2(
     x: KerasTensor,
     params: EfficientNetParams,
@@ -91,39 +148,57 @@ def EfficientNetV2(
     Returns:
         tf.keras.Model: Model
     """
-    # Stem
-    if params.input_filters > 0:
-        name = "stem"
-        filters = make_divisible(params.input_filters, 8)
-        y = conv2d(
-            filters,
-            kernel_size=params.input_kernel_size,
-            strides=params.input_strides,
-            name=name,
-        )(x)
-        y = batch_norm(name=name)(y)
-        y = relu6(name=name)(y)
-    else:
-        y = x
-
+    y = efficientnet_stem(params)(x)
     y = efficientnet_core(
         blocks=params.blocks, drop_connect_rate=params.drop_connect_rate
     )(y)
+    y = efficientnet_top(params, num_classes)(y)
+    model = tf.keras.Model(x, y, name=params.model_name)
+    return model
 
-    if params.output_filters:
-        name = "neck"
-        filters = make_divisible(params.output_filters, 8)
-        y = conv2d(
-            filters, kernel_size=(1, 1), strides=(1, 1), padding="same", name=name
-        )(y)
-        y = batch_norm(name=name)(y)
-        y = relu6(name=name)(y)
 
-    if params.include_top:
-        name = "top"
-        y = tf.keras.layers.GlobalAveragePooling2D(name=f"{name}.pool")(y)
-        if 0 < params.dropout < 1:
-            y = tf.keras.layers.Dropout(params.dropout)(y)
-        y = tf.keras.layers.Dense(num_classes, name=name)(y)
-    model = tf.keras.Model(x, y, name=params.model_name)
+def EfficientNetV2EarlyExit(
+    x: KerasTensor,
+    params: EfficientNetParams,
+    num_classes: int,
+):
+    """Create EfficientNet V2 with early exit classifiers after params.exits blocks
+
+    The network is built as a chain of part models EXIT1..EXITn (one more than exits), each its own
+    deployable model. Every part but the last outputs [exit logits, feature] and the next part reads
+    the feature. The last part ends with the top and outputs its logits.
+
+    Args:
+        x (KerasTensor): Input tensor
+        params (EfficientNetParams): Model parameters.
+        num_classes (int): # classes.
+
+    Returns:
+        tf.keras.Model: Model with the logits of every exit, last one the full network's
+    """
+    bounds = [0] + sorted(params.exits) + [len(params.blocks)]
+    y = x
+    outputs = []
+    for k in range(len(bounds) - 1):
+        part_in = tf.keras.Input(y.shape[1:], batch_size=y.shape[0], dtype=y.dtype)
+        feat = efficientnet_stem(params)(part_in) if k == 0 else part_in
+        feat = efficientnet_core(
+            blocks=params.blocks,
+            drop_connect_rate=params.drop_connect_rate,
+            start=bounds[k],
+            stop=bounds[k + 1],
+        )(feat)
+        if k == len(bounds) - 2:
+            part = tf.keras.Model(part_in, efficientnet_top(params, num_classes)(feat), name=f"EXIT{k+1}")
+            outputs.append(part(y))
+        else:
+            name = f"exit{k+1}"
+            logits = tf.keras.layers.GlobalAveragePooling2D(name=f"{name}.pool")(feat)
+            logits = tf.keras.layers.Dense(num_classes, name=name)(logits)
+            part = tf.keras.Model(part_in, [logits, feat], name=f"EXIT{k+1}")
+            logits, y = part(y)
+            outputs.append(logits)
+        # END IF
+    # END FOR
+    model = tf.keras.Model(x, outputs, name=params.model_name)
     return model
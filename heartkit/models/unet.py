@@ -31,23 +31,20 @@ class UNetParams(BaseModel):
     )
 
 
-def UNet(
-    x: KerasTensor,
-    params: UNetParams,
-    num_classes: int,
-) -> tf.keras.Model:
-    """Create UNet TF functional model
+def unet_encoder(
+    x: KerasTensor, params: UNetParams
+) -> tuple[KerasTensor, list[KerasTensor | None]]:
+    """Create UNet encoder
 
     Args:
         x (KerasTensor): Input tensor
-        params (ResNetParams): Model parameters.
-        num_classes (int, optional): # classes.
+        params (UNetParams): Model parameters.
 
     Returns:
-        tf.keras.Model: Model
+        tuple[KerasTensor, list[KerasTensor | None]]: Encoder output and skip tensor of each block (None if skip disabled)
     """
     y = x
-    skip_layers: list[tf.keras.layers.Layer | None] = []
+    skip_layers: list[KerasTensor | None] = []
     for i, block in enumerate(params.blocks):
         name = f"ENC{i+1}"
         if i == 0:
@@ -84,7 +81,26 @@ def UNet(
         # END IF
         skip_layers.append(y if block.skip else None)
     # END FOR
+    return y, skip_layers
 
+
+def unet_decoder(
+    y: KerasTensor,
+    skip_layers: list[KerasTensor | None],
+    params: UNetParams,
+    num_classes: int,
+) -> KerasTensor:
+    """Create UNet decoder
+
+    Args:
+        y (KerasTensor): Encoder output
+        skip_layers (list[KerasTensor | None]): Skip tensor of each encoder block (consumed)
+        params (UNetParams): Model parameters.
+        num_classes (int): # classes.
+
+    Returns:
+        KerasTensor: Decoder output
+    """
     for i, block in enumerate(reversed(params.blocks)):
         name = f"DEC{i+1}"
         ym = tf.keras.layers.Conv2DTranspose(
@@ -116,6 +132,26 @@ def UNet(
         # Add a per-point classification layer
         y = conv2d(num_classes, params.output_kernel_size, name="NECK.CONV1")(y)
         y = tf.keras.layers.Reshape(y.shape[2:])(y)
+    return y
+
+
+def UNet(
+    x: KerasTensor,
+    params: UNetParams,
+    num_classes: int,
+) -> tf.keras.Model:
+    """Create UNet TF functional model
+
+    Args:
+        x (KerasTensor): Input tensor
+        params (ResNetParams): Model parameters.
+        num_classes (int, optional): # classes.
+
+    Returns:
+        tf.keras.Model: Model
+    """
+    y, skip_layers = unet_encoder(x, params)
+    y = unet_decoder(y, skip_layers, params, num_classes)
 
     # Define the model
     model = tf.keras.Model(x, y, name=params.model_name)
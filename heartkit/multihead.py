@@ -0,0 +1,407 @@
+""" Multihead model: one encoder backbone shared by the segmentation, arrhythmia and beat heads.
+
+The backbone is the encoder of the reference segmentation U-Net and outputs its ENC2-4 features. Each
+head is its own model over those features, so the EVB (evb/src/multihead_model.cc) encodes a window
+once and runs only the heads it needs. Training is staged: backbone and segmentation head are trained
+together first, then the arrhythmia and beat heads are trained on the frozen backbone so they cannot
+degrade the features the others rely on.
+
+The beat head reads the ENC2 features of the previous, current and next beat side by side. The EVB
+crops them from the window feature map, while training runs the backbone on each beat crop, so the
+borders of each crop see zero padding here and signal on the EVB.
+"""
+import os
+import shutil
+from pathlib import Path
+
+import numpy as np
+import tensorflow as tf
+import tensorflow_addons as tfa
+from rich.console import Console
+
+from neuralspot.tflite.convert import convert_tflite, predict_tflite, xxd_c_dump
+from neuralspot.tflite.model import get_strategy, load_model
+
+from .datasets import IcentiaDataset, LudbDataset
+from .defines import HeartExportParams, HeartTask, HeartTestParams, HeartTrainParams
+from .metrics import compute_iou
+from .models import UNetBlockParams, UNetParams, unet_decoder, unet_encoder
+from .models.blocks import batch_norm, relu6
+from .models.optimizers import Adam
+from .tasks import get_num_classes
+from .utils import set_random_seed, setup_logger
+
+console = Console()
+logger = setup_logger(__name__)
+
+# Must match HK_MH_LEN, HK_BEAT_LEN, HK_MH_BEAT_STRIDE and HK_MH_BEAT_CHANNELS (evb/src/constants.h)
+MH_FRAME_SIZE = 1024
+MH_BEAT_FRAME_SIZE = 200
+MH_BEAT_STRIDE = 4
+MH_BEAT_FEATURE = 0  # Backbone output index of the ENC2 features
+
+MH_HEADS = ["segmentation", "arrhythmia", "beat"]
+
+
+def get_backbone_params() -> UNetParams:
+    """Reference segmentation U-Net (tasks.get_segmentation_model) whose encoder is the backbone"""
+    return UNetParams(
+        blocks=[
+            UNetBlockParams(filters=16, depth=1, kernel=(1, 3), strides=(1, 2), skip=False),
+            UNetBlockParams(filters=32, depth=1, kernel=(1, 3), strides=(1, 2), skip=True),
+            UNetBlockParams(filters=48, depth=1, kernel=(1, 3), strides=(1, 2), skip=True),
+            UNetBlockParams(filters=64, depth=1, kernel=(1, 3), strides=(1, 2), skip=True),
+        ],
+        output_kernel_size=(1, 3),
+        include_top=True,
+    )
+
+
+def create_backbone(frame_size: int | None = None) -> tf.keras.Model:
+    """Backbone model [1, frame_size, 1] -> ENC2-4 features
+
+    Args:
+        frame_size (int | None, optional): Input width (None for any multiple of 16). Defaults to None.
+
+    Returns:
+        tf.keras.Model: Backbone
+    """
+    inputs = tf.keras.Input((1, frame_size, 1), dtype=tf.float32)
+    _, skip_layers = unet_encoder(inputs, get_backbone_params())
+    return tf.keras.Model(inputs, [y for y in skip_layers if y is not None], name="BACKBONE")
+
+
+def create_heads(backbone: tf.keras.Model) -> dict[str, tf.keras.Model]:
+    """Head models over the backbone features
+
+    Args:
+        backbone (tf.keras.Model): Backbone
+
+    Returns:
+        dict[str, tf.keras.Model]: Head by name (MH_HEADS)
+    """
+    params = get_backbone_params()
+    # Feature widths of a MH_FRAME_SIZE window (stride 4, 8, 16)
+    features = [
+        tf.keras.Input((1, MH_FRAME_SIZE // 2 ** (i + 2), y.shape[-1]), dtype=tf.float32, name=f"ENC{i+2}")
+        for i, y in enumerate(backbone.outputs)
+    ]
+
+    # Segmentation: U-Net decoder
+    skip_layers = [None] + list(features)
+    y = unet_decoder(features[-1], skip_layers, params, get_num_classes(HeartTask.segmentation))
+    seg_head = tf.keras.Model(features, y, name="SEG_HEAD")
+
+    # Arrhythmia: separable conv and pooling over ENC4
+    x = tf.keras.Input(features[-1].shape[1:], dtype=tf.float32, name="ENC4")
+    y = tf.keras.layers.SeparableConv2D(96, (1, 3), strides=(1, 2), padding="same", name="ARR.CONV1")(x)
+    y = batch_norm(name="ARR.BN1")(y)
+    y = relu6(name="ARR.ACT1")(y)
+    y = tf.keras.layers.GlobalAveragePooling2D(name="ARR.POOL1")(y)
+    y = tf.keras.layers.Dropout(0.2, name="ARR.DROP1")(y)
+    y = tf.keras.layers.Dense(get_num_classes(HeartTask.arrhythmia), name="ARR.DENSE1")(y)
+    arr_head = tf.keras.Model(x, y, name="ARR_HEAD")
+
+    # Beat: ENC2 features of the previous, current and next beat side by side
+    channels = backbone.outputs[MH_BEAT_FEATURE].shape[-1]
+    x = tf.keras.Input((1, MH_BEAT_FRAME_SIZE // MH_BEAT_STRIDE, 3 * channels), dtype=tf.float32, name="BEATS")
+    y = tf.keras.layers.SeparableConv2D(64, (1, 3), strides=(1, 2), padding="same", name="BEAT.CONV1")(x)
+    y = batch_norm(name="BEAT.BN1")(y)
+    y = relu6(name="BEAT.ACT1")(y)
+    y = tf.keras.layers.SeparableConv2D(96, (1, 3), strides=(1, 2), padding="same", name="BEAT.CONV2")(y)
+    y = batch_norm(name="BEAT.BN2")(y)
+    y = relu6(name="BEAT.ACT2")(y)
+    y = tf.keras.layers.GlobalAveragePooling2D(name="BEAT.POOL1")(y)
+    y = tf.keras.layers.Dropout(0.2, name="BEAT.DROP1")(y)
+    y = tf.keras.layers.Dense(get_num_classes(HeartTask.beat), name="BEAT.DENSE1")(y)
+    beat_head = tf.keras.Model(x, y, name="BEAT_HEAD")
+
+    return {"segmentation": seg_head, "arrhythmia": arr_head, "beat": beat_head}
+
+
+def create_task_models(
+    backbone: tf.keras.Model, heads: dict[str, tf.keras.Model]
+) -> dict[str, tf.keras.Model]:
+    """End-to-end model of each head on the (shared) backbone
+
+    Args:
+        backbone (tf.keras.Model): Backbone
+        heads (dict[str, tf.keras.Model]): Head by name
+
+    Returns:
+        dict[str, tf.keras.Model]: Task model by head name
+    """
+    x = tf.keras.Input((1, MH_FRAME_SIZE, 1), dtype=tf.float32)
+    features = backbone(x)
+    models = {
+        "segmentation": tf.keras.Model(x, heads["segmentation"](features)),
+        "arrhythmia": tf.keras.Model(x, heads["arrhythmia"](features[-1])),
+    }
+    x = tf.keras.Input((1, MH_BEAT_FRAME_SIZE, 3), dtype=tf.float32)
+    beats = tf.keras.layers.concatenate(
+        [backbone(x[..., i : i + 1])[MH_BEAT_FEATURE] for i in range(3)], axis=-1
+    )
+    models["beat"] = tf.keras.Model(x, heads["beat"](beats))
+    return models
+
+
+def load_task_datasets(
+    head: str, params: HeartTrainParams | HeartTestParams | HeartExportParams
+):
+    """Dataset of a head's task (LUDB segmentation, Icentia11k arrhythmia and beat)"""
+    if head == "segmentation":
+        return LudbDataset(
+            str(params.ds_path),
+            task=HeartTask.segmentation,
+            frame_size=MH_FRAME_SIZE,
+            target_rate=params.sampling_rate,
+        )
+    return IcentiaDataset(
+        ds_path=str(params.ds_path),
+        task=HeartTask.arrhythmia if head == "arrhythmia" else HeartTask.beat,
+        frame_size=MH_FRAME_SIZE if head == "arrhythmia" else MH_BEAT_FRAME_SIZE,
+    )
+
+
+def train_model(params: HeartTrainParams):
+    """Train backbone and segmentation head, then the arrhythmia and beat heads on the frozen backbone.
+
+    Args:
+        params (HeartTrainParams): Training parameters
+    """
+    params.seed = set_random_seed(params.seed)
+    logger.info(f"Random seed {params.seed}")
+
+    os.makedirs(str(params.job_dir), exist_ok=True)
+    logger.info(f"Creating working directory in {params.job_dir}")
+    with open(str(params.job_dir / "train_config.json"), "w", encoding="utf-8") as fp:
+        fp.write(params.json(indent=2))
+
+    steps_per_epoch = params.steps_per_epoch or 1000
+    strategy = get_strategy()
+    with strategy.scope():
+        backbone = create_backbone()
+        heads = create_heads(backbone)
+        models = create_task_models(backbone, heads)
+
+        for head in MH_HEADS:
+            logger.info(f"Training {head} head")
+            backbone.trainable = head == "segmentation"
+            train_ds, val_ds = load_task_datasets(head, params).load_train_datasets(
+                train_patients=params.train_patients,
+                val_patients=params.val_patients,
+                train_pt_samples=params.samples_per_patient,
+                val_pt_samples=params.val_samples_per_patient,
+                val_file=params.val_file,
+                val_size=params.val_size,
+                num_workers=params.data_parallelism,
+            )
+            train_ds = (
+                train_ds.shuffle(buffer_size=params.buffer_size, reshuffle_each_iteration=True)
+                .batch(batch_size=params.batch_size, drop_remainder=True, num_parallel_calls=tf.data.AUTOTUNE)
+                .prefetch(buffer_size=tf.data.AUTOTUNE)
+            )
+            val_ds = val_ds.batch(
+                batch_size=params.batch_size, drop_remainder=True, num_parallel_calls=tf.data.AUTOTUNE
+            )
+
+            model = models[head]
+            optimizer = Adam(
+                tf.keras.optimizers.schedules.CosineDecayRestarts(
+                    initial_learning_rate=1e-3,
+                    first_decay_steps=int(0.1 * steps_per_epoch * params.epochs),
+                    t_mul=1.8 / (0.1 * 3 * (3 - 1)),  # 3 cycles
+                    m_mul=0.40,
+                ),
+                beta_1=0.9,
+                beta_2=0.98,
+                epsilon=1e-9,
+            )
+            loss_fn = tfa.losses.SigmoidFocalCrossEntropy(from_logits=True)
+            model.compile(
+                optimizer=optimizer,
+                loss=loss_fn,
+                metrics=[tf.keras.metrics.CategoricalAccuracy(name="acc")],
+            )
+            weights_file = str(params.job_dir / f"{head}.weights")
+            try:
+                model.fit(
+                    train_ds,
+                    steps_per_epoch=steps_per_epoch,
+                    verbose=2,
+                    epochs=params.epochs,
+                    validation_data=val_ds,
+                    callbacks=[
+                        tf.keras.callbacks.EarlyStopping(
+                            monitor="val_loss",
+                            patience=max(int(0.25 * params.epochs), 1),
+                            restore_best_weights=True,
+                        ),
+                        tf.keras.callbacks.ModelCheckpoint(
+                            filepath=weights_file,
+                            monitor="val_loss",
+                            save_best_only=True,
+                            save_weights_only=True,
+                            verbose=1,
+                        ),
+                        tf.keras.callbacks.CSVLogger(str(params.job_dir / f"history_{head}.csv")),
+                    ],
+                )
+            except KeyboardInterrupt:
+                logger.warning("Stopping training due to keyboard interrupt")
+            model.load_weights(weights_file)
+        # END FOR
+
+        # Save backbone and heads as separate models, as exported
+        backbone.save(str(params.job_dir / "backbone.tf"))
+        for head in MH_HEADS:
+            heads[head].save(str(params.job_dir / f"{head}.tf"))
+        logger.info(f"Models saved to {params.job_dir}")
+    # END WITH
+
+
+def evaluate_model(params: HeartTestParams):
+    """Test the segmentation head on the backbone.
+
+    Args:
+        params (HeartTestParams): Testing/evaluation parameters (model_file: training job directory)
+    """
+    params.seed = set_random_seed(params.seed)
+    model_dir = Path(params.model_file)
+    backbone = load_model(str(model_dir / "backbone.tf"))
+    seg_head = load_model(str(model_dir / "segmentation.tf"))
+
+    with console.status("[bold green] Loading test dataset..."):
+        test_ds = load_task_datasets("segmentation", params).load_test_dataset(
+            test_patients=params.test_patients,
+            test_pt_samples=params.samples_per_patient,
+            num_workers=params.data_parallelism,
+        )
+        test_x, test_y = next(test_ds.batch(params.test_size).as_numpy_iterator())
+    # END WITH
+
+    y_true = np.argmax(test_y, axis=2)
+    y_pred = np.argmax(seg_head.predict(backbone.predict(test_x)), axis=2)
+    test_acc = np.sum(y_pred == y_true) / y_true.size
+    test_iou = compute_iou(y_true, y_pred)
+    logger.info(f"[TEST SET] ACC={test_acc:.2%}, IOU={test_iou:.2%}")
+
+
+def export_model(params: HeartExportParams):
+    """Export backbone and heads as int8 TFLM models mh_<name>_model_buffer.h (g_mh_<name>_model).
+
+    Each model is calibrated on the features the backbone computes from its task's data, and the
+    heads are validated on the dequantized outputs of the exported backbone, as chained on the EVB.
+
+    Args:
+        params (HeartExportParams): Deployment parameters (model_file: training job directory,
+            tflm_file: directory to copy the headers to, e.g. evb/src)
+    """
+    model_dir = Path(params.model_file)
+    backbone = load_model(str(model_dir / "backbone.tf"))
+    heads = {head: load_model(str(model_dir / f"{head}.tf")) for head in MH_HEADS}
+
+    # Fix backbone width and batch size of 1
+    inputs = tf.keras.layers.Input((1, MH_FRAME_SIZE, 1), dtype=tf.float32, batch_size=1)
+    backbone = tf.keras.Model(inputs, backbone(inputs), name="BACKBONE")
+
+    test_data = {}
+    with console.status("[bold green] Loading test datasets..."):
+        for head in MH_HEADS:
+            test_ds = load_task_datasets(head, params).load_test_dataset(
+                test_pt_samples=params.samples_per_patient,
+                num_workers=params.data_parallelism,
+            )
+            test_data[head] = next(test_ds.batch(params.test_size).as_numpy_iterator())
+        # END FOR
+    # END WITH
+
+    def beat_features(model_fn, x):
+        return np.concatenate([model_fn(x[..., i : i + 1]) for i in range(3)], axis=-1)
+
+    # Features as computed in float, for calibration
+    seg_x = test_data["segmentation"][0]
+    arr_x = test_data["arrhythmia"][0]
+    beat_x = test_data["beat"][0]
+    beat_backbone = create_backbone(MH_BEAT_FRAME_SIZE)
+    beat_backbone.set_weights(backbone.get_weights())
+    calib = {
+        "backbone": seg_x[:1000],
+        "segmentation": backbone.predict(seg_x[:1000]),
+        "arrhythmia": backbone.predict(arr_x[:1000])[-1],
+        "beat": beat_features(lambda x: beat_backbone.predict(x)[MH_BEAT_FEATURE], beat_x[:1000]),
+    }
+    models = {"backbone": backbone, **heads}
+
+    contents = {}
+    for name, model in models.items():
+        tfl_model_path = str(params.job_dir / f"mh_{name}_model.tflite")
+        tflm_model_path = str(params.job_dir / f"mh_{name}_model_buffer.h")
+        logger.info(f"Converting {name} to TFLite")
+        contents[name] = convert_tflite(
+            model,
+            quantize=True,
+            test_x=calib[name],
+            input_type=tf.int8,
+            output_type=tf.int8,
+        )
+        with open(tfl_model_path, "wb") as fp:
+            fp.write(contents[name])
+        xxd_c_dump(
+            src_path=tfl_model_path,
+            dst_path=tflm_model_path,
+            var_name=f"g_mh_{name}_model",
+            chunk_len=20,
+            is_header=True,
+        )
+        if params.tflm_file:
+            dst_dir = params.tflm_file if params.tflm_file.is_dir() else params.tflm_file.parent
+            logger.info(f"Copying TFLM header to {dst_dir}")
+            shutil.copyfile(tflm_model_path, str(dst_dir / f"mh_{name}_model_buffer.h"))
+    # END FOR
+
+    # Validate the heads on the exported backbone's features, routed by width as on the EVB
+    def tfl_features(x):
+        runner = tf.lite.Interpreter(model_content=contents["backbone"]).get_signature_runner()
+        return [predict_tflite(contents["backbone"], test_x=x, output_name=n) for n in runner.get_output_details()]
+
+    def tfl_head(name, features):
+        runner = tf.lite.Interpreter(model_content=contents[name]).get_signature_runner()
+        inputs = {
+            n: next(f for f in features if f.shape[2] == d["shape"][2])
+            for n, d in runner.get_input_details().items()
+        }
+        return predict_tflite(contents[name], test_x=inputs)
+
+    seg_y = np.argmax(test_data["segmentation"][1], axis=2)
+    seg_pred_tf = np.argmax(heads["segmentation"].predict(backbone.predict(seg_x)), axis=2)
+    seg_pred_tfl = np.argmax(tfl_head("segmentation", tfl_features(seg_x)), axis=2)
+    logger.info(f"[SEGMENTATION]  TF: IOU={compute_iou(seg_y, seg_pred_tf):.2%}")
+    logger.info(f"[SEGMENTATION] TFL: IOU={compute_iou(seg_y, seg_pred_tfl):.2%}")
+
+    arr_y = np.argmax(test_data["arrhythmia"][1], axis=1)
+    arr_pred_tf = np.argmax(heads["arrhythmia"].predict(backbone.predict(arr_x)[-1]), axis=1)
+    arr_pred_tfl = np.argmax(tfl_head("arrhythmia", tfl_features(arr_x)), axis=1)
+    logger.info(f"[ARRHYTHMIA]  TF: ACC={np.mean(arr_pred_tf == arr_y):.2%}")
+    logger.info(f"[ARRHYTHMIA] TFL: ACC={np.mean(arr_pred_tfl == arr_y):.2%}")
+
+    # Exported backbone on each beat crop at the start of an otherwise empty window
+    def tfl_beat_features(x):
+        x = np.pad(x, ((0, 0), (0, 0), (0, MH_FRAME_SIZE - MH_BEAT_FRAME_SIZE), (0, 0)))
+        features = max(tfl_features(x), key=lambda f: f.shape[2])
+        return features[:, :, : MH_BEAT_FRAME_SIZE // MH_BEAT_STRIDE, :]
+
+    beat_y = np.argmax(test_data["beat"][1], axis=1)
+    beat_pred_tf = np.argmax(
+        heads["beat"].predict(beat_features(lambda x: beat_backbone.predict(x)[MH_BEAT_FEATURE], beat_x)), axis=1
+    )
+    beat_pred_tfl = np.argmax(predict_tflite(contents["beat"], test_x=beat_features(tfl_beat_features, beat_x)), axis=1)
+    logger.info(f"[BEAT]  TF: ACC={np.mean(beat_pred_tf == beat_y):.2%}")
+    logger.info(f"[BEAT] TFL: ACC={np.mean(beat_pred_tfl == beat_y):.2%}")
+
+    # Check accuracy hit
+    acc_diff = np.mean(arr_pred_tf == arr_y) - np.mean(arr_pred_tfl == arr_y)
+    if acc_diff > 0.5:
+        logger.warning(f"TFLite arrhythmia accuracy dropped by {100*acc_diff:0.2f}%")
+    else:
+        logger.info("Validation passed")
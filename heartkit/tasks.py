@@ -7,6 +7,7 @@ from .defines import HeartTask
 from .models import (
     EfficientNetParams,
     EfficientNetV2,
+    EfficientNetV2EarlyExit,
     MBConvParams,
     ResNet,
     ResNetParams,
@@ -119,6 +120,10 @@ def create_task_model(
             params=EfficientNetParams.parse_obj(params),
             num_classes=num_classes,
         )
+    if name == "small":
+        if task == HeartTask.segmentation:
+            return get_coarse_segmentation_model(inputs=inputs, num_classes=num_classes)
+        return get_small_model(inputs=inputs, num_classes=num_classes)
     if name:
         raise ValueError(f"No network architecture with name {name}")
 
@@ -187,8 +192,10 @@ def get_beat_model(inputs: KerasTensor, num_classes: int) -> tf.keras.Model:
     )
 
 
-def get_arrhythmia_model(inputs: KerasTensor, num_classes: int) -> tf.keras.Model:
-    """Reference arrhythmia model"""
+def get_arrhythmia_model(
+    inputs: KerasTensor, num_classes: int, exits: list[int] | None = None
+) -> tf.keras.Model:
+    """Reference arrhythmia model, with early exits after the given blocks (EfficientNetV2EarlyExit)"""
     blocks = [
         MBConvParams(
             filters=32,
@@ -223,17 +230,62 @@ def get_arrhythmia_model(inputs: KerasTensor, num_classes: int) -> tf.keras.Mode
             se_ratio=4,
         ),
     ]
+    params = EfficientNetParams(
+        input_filters=24,
+        input_kernel_size=(1, 7),
+        input_strides=(1, 2),
+        blocks=blocks,
+        output_filters=0,
+        include_top=True,
+        dropout=0.2,
+        drop_connect_rate=0.2,
+        exits=exits or [],
+    )
+    if exits:
+        return EfficientNetV2EarlyExit(inputs, params=params, num_classes=num_classes)
+    return EfficientNetV2(inputs, params=params, num_classes=num_classes)
+
+
+def get_small_model(inputs: KerasTensor, num_classes: int) -> tf.keras.Model:
+    """Small arrhythmia or beat model, run in front of the reference model with HK_CASCADE_ENABLE"""
+    blocks = [
+        MBConvParams(
+            filters=16,
+            depth=1,
+            ex_ratio=1,
+            kernel_size=(1, 5),
+            strides=(1, 2),
+            se_ratio=2,
+        ),
+        MBConvParams(
+            filters=24,
+            depth=1,
+            ex_ratio=1,
+            kernel_size=(1, 3),
+            strides=(1, 2),
+            se_ratio=2,
+        ),
+        MBConvParams(
+            filters=32,
+            depth=1,
+            ex_ratio=1,
+            kernel_size=(1, 3),
+            strides=(1, 2),
+            se_ratio=4,
+        ),
+    ]
     return EfficientNetV2(
         inputs,
         params=EfficientNetParams(
-            input_filters=24,
+            input_filters=16,
             input_kernel_size=(1, 7),
-            input_strides=(1, 2),
+            input_strides=(1, 4),
             blocks=blocks,
             output_filters=0,
             include_top=True,
-            dropout=0.2,
-            drop_connect_rate=0.2,
+            dropout=0.1,
+            drop_connect_rate=0.0,
+            model_name="EfficientNetV2Small",
         ),
         num_classes=num_classes,
     )
@@ -259,3 +311,26 @@ def get_segmentation_model(
         ),
         num_classes=num_classes,
     )
+
+
+def get_coarse_segmentation_model(
+    inputs: KerasTensor,
+    num_classes: int,
+) -> tf.keras.Model:
+    """Small segmentation model for the decimated signal, refined by the reference model with HK_SEG_COARSE_ENABLE"""
+    blocks = [
+        UNetBlockParams(filters=8, depth=1, kernel=(1, 3), strides=(1, 2), skip=False),
+        UNetBlockParams(filters=16, depth=1, kernel=(1, 3), strides=(1, 2), skip=True),
+        UNetBlockParams(filters=24, depth=1, kernel=(1, 3), strides=(1, 2), skip=True),
+        UNetBlockParams(filters=32, depth=1, kernel=(1, 3), strides=(1, 2), skip=True),
+    ]
+    return UNet(
+        inputs,
+        params=UNetParams(
+            blocks=blocks,
+            output_kernel_size=(1, 3),
+            include_top=True,
+            model_name="UNetCoarse",
+        ),
+        num_classes=num_classes,
+    )
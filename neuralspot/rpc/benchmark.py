@@ -0,0 +1,98 @@
+import argparse
+import threading
+import time
+
+import erpc
+from erpc.simple_server import ServerThread as RpcServerThread
+
+from . import GenericDataOperations_EvbToPc as gen_evb2pc
+from .utils import FramedTransport, PtyTransport, UnixSocketTransport
+
+
+class SinkHandler(gen_evb2pc.interface.Ievb_to_pc):
+    """PC-side handler that only counts received blocks."""
+
+    def __init__(self) -> None:
+        super().__init__()
+        self.num_blocks = 0
+        self.num_bytes = 0
+
+    def ns_rpc_data_sendBlockToPC(self, block):
+        """RPC callback handler"""
+        self.num_blocks += 1
+        self.num_bytes += len(block.buffer)
+        return 0
+
+    def ns_rpc_data_fetchBlockFromPC(self, block):
+        """RPC callback handler"""
+        return 0
+
+    def ns_rpc_data_computeOnPC(self, in_block, result_block):
+        """RPC callback handler"""
+        result_block.value = in_block
+        return 0
+
+    def ns_rpc_data_remotePrintOnPC(self, msg):
+        """RPC callback handler"""
+        return 0
+
+
+def _loopback_pair(kind: str) -> tuple[FramedTransport, FramedTransport]:
+    """Create (pc, evb) transport pair over PTY or Unix socket."""
+    if kind == "unix":
+        return UnixSocketTransport.pair()
+    if kind == "pty":
+        pc = PtyTransport()
+        return pc, pc.peer()
+    raise ValueError(f"Unsupported transport {kind}")
+
+
+def run_benchmark(kind: str = "unix", block_size: int = 200, num_blocks: int = 2000) -> dict[str, float]:
+    """Measure generic-data RPC throughput (ns_rpc_data_sendBlockToPC) over a loopback transport.
+
+    Args:
+        kind (str, optional): Loopback transport `unix` or `pty`. Defaults to "unix".
+        block_size (int, optional): Payload bytes per block. Defaults to 200 (50 float32 samples).
+        num_blocks (int, optional): # blocks to send. Defaults to 2000.
+
+    Returns:
+        dict[str, float]: Blocks per second and bytes per second
+    """
+    pc_transport, evb_transport = _loopback_pair(kind)
+    handler = SinkHandler()
+    server = RpcServerThread(pc_transport, erpc.basic_codec.BasicCodec)
+    server.add_service(gen_evb2pc.server.evb_to_pcService(handler))
+    server.start()
+
+    client = gen_evb2pc.client.evb_to_pcClient(erpc.client.ClientManager(evb_transport, erpc.basic_codec.BasicCodec))
+    payload = bytearray(block_size)
+    block = gen_evb2pc.common.dataBlock(
+        length=block_size // 4,
+        dType=gen_evb2pc.common.dataType.float32_e,
+        description="SEND_SAMPLES",
+        cmd=gen_evb2pc.common.command.generic_cmd,
+        buffer=payload,
+    )
+    tic = time.perf_counter()
+    for _ in range(num_blocks):
+        client.ns_rpc_data_sendBlockToPC(block)
+    duration = time.perf_counter() - tic
+
+    threading.Thread(target=server.stop, daemon=True).start()
+    for transport in (evb_transport, pc_transport):
+        transport.close()
+
+    return {
+        "blocks_per_sec": handler.num_blocks / duration,
+        "bytes_per_sec": handler.num_bytes / duration,
+    }
+
+
+if __name__ == "__main__":
+    parser = argparse.ArgumentParser(description="Generic data RPC loopback throughput")
+    parser.add_argument("--transport", choices=["unix", "pty"], default="unix")
+    parser.add_argument("--block-size", type=int, default=200)
+    parser.add_argument("--num-blocks", type=int, default=2000)
+    args = parser.parse_args()
+    stats = run_benchmark(kind=args.transport, block_size=args.block_size, num_blocks=args.num_blocks)
+    print(f"{args.transport}: {stats['blocks_per_sec']:0.1f} blocks/s, {stats['bytes_per_sec']/1024:0.1f} KiB/s")
@@ -1,8 +1,11 @@
 import logging
+import os
+import socket
 import time
+import tty
 from typing import Optional
 
-from erpc.transport import SerialTransport
+from erpc.transport import FramedTransport, SerialTransport
 from serial.tools.list_ports import comports as list_ports
 from serial.tools.list_ports_common import ListPortInfo
 
@@ -65,3 +68,152 @@ def get_serial_transport(
         raise TimeoutError("Unable to locate EVB serial port. Please verify connection")
     logger.info(f"Found serial device @ {port.device}")
     return SerialTransport(port.device, baudrate=baudrate)
+
+
+class PtyTransport(FramedTransport):
+    """Framed transport over the master side of a pseudo-terminal pair.
+    The slave side is exposed as a symlink at `link_path` so a host build of the
+    EVB firmware can open it just like the USB CDC port.
+    """
+
+    def __init__(self, link_path: Optional[str] = None, fd: Optional[int] = None):
+        super().__init__()
+        self.link_path = None
+        self._owner = fd is None
+        if fd is not None:
+            # Borrow an existing end (e.g. the slave side for loopback)
+            self._master_fd, self._slave_fd = fd, None
+            self.slave_name = None
+            return
+        self._master_fd, self._slave_fd = os.openpty()
+        tty.setraw(self._slave_fd)
+        self.slave_name = os.ttyname(self._slave_fd)
+        if link_path:
+            if os.path.lexists(link_path):
+                os.unlink(link_path)
+            os.symlink(self.slave_name, link_path)
+            self.link_path = link_path
+        logger.info(f"Created PTY @ {link_path or self.slave_name}")
+
+    def peer(self) -> "PtyTransport":
+        """Transport on the slave side of this PTY (loopback)."""
+        return PtyTransport(fd=self._slave_fd)
+
+    def close(self):
+        """Close PTY pair and remove link"""
+        if not self._owner:
+            return
+        for fd in (self._master_fd, self._slave_fd):
+            if fd is None:
+                continue
+            try:
+                os.close(fd)
+            except OSError:
+                pass
+        if self.link_path and os.path.islink(self.link_path):
+            os.unlink(self.link_path)
+
+    def _base_send(self, data):
+        view = memoryview(data)
+        while view:
+            view = view[os.write(self._master_fd, view) :]
+
+    def _base_receive(self, count):
+        result = bytearray()
+        while len(result) < count:
+            data = os.read(self._master_fd, count - len(result))
+            if not data:
+                raise ConnectionResetError("PTY closed")
+            result.extend(data)
+        return result
+
+
+class UnixSocketTransport(FramedTransport):
+    """Framed transport over a Unix domain stream socket.
+    As server, listens on `path` and blocks until a single peer connects.
+    """
+
+    def __init__(
+        self,
+        path: Optional[str] = None,
+        is_server: bool = True,
+        timeout: float = 10,
+        sock: Optional[socket.socket] = None,
+    ):
+        super().__init__()
+        self.path = path
+        self.is_server = is_server and sock is None
+        self._server = None
+        self._sock = sock
+        if self._sock is None and self.is_server:
+            if os.path.exists(path):
+                os.unlink(path)
+            self._server = socket.socket(socket.AF_UNIX, socket.SOCK_STREAM)
+            self._server.bind(path)
+            self._server.listen(1)
+            self._server.settimeout(timeout)
+            try:
+                self._sock, _ = self._server.accept()
+            except socket.timeout as err:
+                self.close()
+                raise TimeoutError(f"No peer connected to {path}") from err
+        elif self._sock is None:
+            self._sock = socket.socket(socket.AF_UNIX, socket.SOCK_STREAM)
+            self._sock.connect(path)
+        self._sock.settimeout(None)
+        logger.info(f"Connected Unix socket @ {path or 'loopback'}")
+
+    @classmethod
+    def pair(cls) -> tuple["UnixSocketTransport", "UnixSocketTransport"]:
+        """Create a connected pair of transports (loopback)."""
+        a, b = socket.socketpair(socket.AF_UNIX, socket.SOCK_STREAM)
+        return cls(sock=a), cls(sock=b)
+
+    def close(self):
+        """Close socket(s) and remove socket file"""
+        for sock in (self._sock, self._server):
+            if sock:
+                sock.close()
+        self._sock = None
+        self._server = None
+        if self.is_server and self.path and os.path.exists(self.path):
+            os.unlink(self.path)
+
+    def _base_send(self, data):
+        self._sock.sendall(data)
+
+    def _base_receive(self, count):
+        result = bytearray()
+        while len(result) < count:
+            data = self._sock.recv(count - len(result))
+            if not data:
+                raise ConnectionResetError("Socket closed")
+            result.extend(data)
+        return result
+
+
+def get_transport(
+    uri: Optional[str] = None,
+    vid_pid: Optional[str] = None,
+    baudrate: Optional[int] = None,
+    timeout: float = 10,
+) -> FramedTransport:
+    """Create transport to EVB from URI.
+
+    Args:
+        uri (Optional[str], optional): Transport URI. Either `usb` (default), `pty://path/to/link`
+            or `unix://path/to/socket`. Defaults to None.
+        vid_pid (Optional[str], optional): VID & PID for USB. Defaults to None.
+        baudrate (Optional[int], optional): Baudrate for USB. Defaults to None.
+        timeout (float, optional): Timeout to find/connect device. Defaults to 10.
+
+    Returns:
+        FramedTransport: Transport
+    """
+    if not uri or uri == "usb":
+        return get_serial_transport(vid_pid=vid_pid, baudrate=baudrate, timeout=timeout)
+    if uri.startswith("pty://"):
+        return PtyTransport(link_path=uri.removeprefix("pty://") or None)
+    if uri.startswith("unix://"):
+        return UnixSocketTransport(path=uri.removeprefix("unix://"), is_server=True, timeout=timeout)
+    raise ValueError(f"Unsupported transport {uri}")
@@ -41,7 +41,7 @@ def xxd_c_dump(
 def convert_tflite(
     model: tf.keras.Model,
     quantize: bool = False,
-    test_x: npt.ArrayLike | None = None,
+    test_x: npt.ArrayLike | list[npt.ArrayLike] | None = None,
     input_type: tf.DType | None = None,
     output_type: tf.DType | None = None,
 ) -> bytes:
@@ -50,7 +50,7 @@ def convert_tflite(
     Args:
         model (tf.keras.Model): TF model
         quantize (bool, optional): Enable PTQ. Defaults to False.
-        test_x (npt.ArrayLike | None, optional): Enables full integer PTQ. Defaults to None.
+        test_x (npt.ArrayLike | list[npt.ArrayLike] | None, optional): Enables full integer PTQ, one array per model input. Defaults to None.
         input_type (tf.DType | None): Input type data format. Defaults to None.
         output_type (tf.DType | None): Output type data format. Defaults to None.
 
@@ -69,9 +69,11 @@ def convert_tflite(
             converter.inference_input_type = input_type
             converter.inference_output_type = output_type
 
+            test_xs = test_x if isinstance(test_x, (list, tuple)) else [test_x]
+
             def rep_dataset():
-                for i in range(test_x.shape[0]):
-                    yield [test_x[i : i + 1]]
+                for i in range(test_xs[0].shape[0]):
+                    yield [x[i : i + 1] for x in test_xs]
 
             converter.representative_dataset = rep_dataset
         # END IF
@@ -79,9 +81,41 @@ def convert_tflite(
     return converter.convert()
 
 
+def quantize_int4_weights(model: tf.keras.Model) -> tuple[int, int]:
+    """Round the conv and dense kernels of model to int4 in place, mirroring `model_fuser --int4` (evb/host/int4_pass.cc).
+        Each output channel gets a symmetric scale max|w|/7. Depthwise kernels and kernels with fewer than
+        8 weights per output channel keep full precision. Batch norm is not folded first, so accuracy is
+        an estimate of the int4 TFLM model. Save the weights beforehand (get_weights) to restore them.
+
+    Args:
+        model (tf.keras.Model): TF model
+
+    Returns:
+        tuple[int, int]: Kernel bytes as int8 and as packed int4
+    """
+    int8_bytes, int4_bytes = 0, 0
+    for layer in model.submodules:
+        if not isinstance(layer, (tf.keras.layers.Conv1D, tf.keras.layers.Conv2D, tf.keras.layers.Dense)):
+            continue
+        if isinstance(layer, tf.keras.layers.DepthwiseConv2D) or layer.kernel is None:
+            continue
+        kernel = layer.kernel.numpy()
+        rows = kernel.reshape(-1, kernel.shape[-1])
+        int8_bytes += rows.size
+        if rows.shape[0] < 8:
+            int4_bytes += rows.size
+            continue
+        scale = np.max(np.abs(rows), axis=0) / 7
+        scale[scale == 0] = 1
+        layer.kernel.assign((np.clip(np.round(rows / scale), -7, 7) * scale).reshape(kernel.shape))
+        int4_bytes += rows.shape[1] * ((rows.shape[0] + 7) // 8) * 4
+    # END FOR
+    return int8_bytes, int4_bytes
+
+
 def predict_tflite(
     model_content: bytes,
-    test_x: npt.ArrayLike,
+    test_x: npt.ArrayLike | dict[str, npt.ArrayLike],
     input_name: str | None = None,
     output_name: str | None = None,
 ) -> npt.ArrayLike:
@@ -89,17 +123,13 @@ def predict_tflite(
 
     Args:
         model_content (bytes): TFLite model content
-        test_x (npt.ArrayLike): Input dataset w/ no batch dimension
+        test_x (npt.ArrayLike | dict[str, npt.ArrayLike]): Input dataset w/ no batch dimension, or one per input name
         input_name (str | None, optional): Input layer name. Defaults to None.
         output_name (str | None, optional): Output layer name. Defaults to None.
 
     Returns:
         npt.ArrayLike: Model outputs
     """
-    # Prepare the test data
-    inputs = test_x.copy()
-    inputs = inputs.astype(np.float32)
-
     interpreter = tf.lite.Interpreter(model_content=model_content)
     model_sig = interpreter.get_signature_runner()
     inputs_details = model_sig.get_input_details()
@@ -108,19 +138,29 @@ def predict_tflite(
         input_name = list(inputs_details.keys())[0]
     if output_name is None:
         output_name = list(outputs_details.keys())[0]
-    input_details = inputs_details[input_name]
     output_details = outputs_details[output_name]
-    input_scale: list[float] = input_details["quantization_parameters"]["scales"]
-    input_zero_point: list[int] = input_details["quantization_parameters"]["zero_points"]
     output_scale: list[float] = output_details["quantization_parameters"]["scales"]
     output_zero_point: list[int] = output_details["quantization_parameters"]["zero_points"]
 
-    if len(input_scale) and len(input_zero_point):
-        inputs = inputs / input_scale[0] + input_zero_point[0]
-        inputs = inputs.astype(input_details["dtype"])
+    # Prepare the test data
+    inputs = {}
+    for name, x in (test_x if isinstance(test_x, dict) else {input_name: test_x}).items():
+        input_details = inputs_details[name]
+        input_scale: list[float] = input_details["quantization_parameters"]["scales"]
+        input_zero_point: list[int] = input_details["quantization_parameters"]["zero_points"]
+        x = x.astype(np.float32)
+        if len(input_scale) and len(input_zero_point):
+            x = x / input_scale[0] + input_zero_point[0]
+            x = x.astype(input_details["dtype"])
+        inputs[name] = x
+    # END FOR
+    num_samples = next(iter(inputs.values())).shape[0]
 
     outputs = np.array(
-        [model_sig(**{input_name: inputs[i : i + 1]})[output_name][0] for i in range(inputs.shape[0])],
+        [
+            model_sig(**{name: x[i : i + 1] for name, x in inputs.items()})[output_name][0]
+            for i in range(num_samples)
+        ],
         dtype=output_details["dtype"],
     )
 
@@ -0,0 +1,321 @@
+import shutil
+import subprocess
+from pathlib import Path
+
+import numpy as np
+import pytest
+
+EVB_SRC = Path(__file__).parent.parent / "evb" / "src"
+CMSIS_DIR = EVB_SRC.parent / "includes" / "extern" / "CMSIS" / "CMSIS_5-5.9.0" / "CMSIS"
+CXX = shutil.which("g++") or shutil.which("c++")
+
+pytestmark = pytest.mark.skipif(CXX is None, reason="Needs a host C++ compiler")
+
+# Firmware constants (evb/src/constants.h) the checks depend on
+SAMPLE_RATE = 250
+HK_HRV_WINDOW = 300
+HK_BEAT_LEN = 200
+HK_BEAT_CACHE_LEN = 64
+HK_TEMPLATE_WARMUP = 8
+
+# Driver preamble: firmware headers need arm_math.h first, and commands are read from stdin
+PREAMBLE = r"""
+#include <cstdio>
+#include <cstring>
+#include "arm_math.h"
+#include "constants.h"
+"""
+
+# CMSIS-DSP is a prebuilt library for the EVB only, these are its reference behaviour
+CMSIS_REF = r"""
+void arm_mean_f32(const float32_t *pSrc, uint32_t blockSize, float32_t *pResult) {
+    float32_t sum = 0;
+    for (uint32_t i = 0; i < blockSize; i++) sum += pSrc[i];
+    *pResult = sum / blockSize;
+}
+void arm_offset_f32(const float32_t *pSrc, float32_t offset, float32_t *pDst, uint32_t blockSize) {
+    for (uint32_t i = 0; i < blockSize; i++) pDst[i] = pSrc[i] + offset;
+}
+void arm_scale_f32(const float32_t *pSrc, float32_t scale, float32_t *pDst, uint32_t blockSize) {
+    for (uint32_t i = 0; i < blockSize; i++) pDst[i] = pSrc[i] * scale;
+}
+void arm_add_f32(const float32_t *pSrcA, const float32_t *pSrcB, float32_t *pDst, uint32_t blockSize) {
+    for (uint32_t i = 0; i < blockSize; i++) pDst[i] = pSrcA[i] + pSrcB[i];
+}
+void arm_dot_prod_f32(const float32_t *pSrcA, const float32_t *pSrcB, uint32_t blockSize, float32_t *result) {
+    float32_t sum = 0;
+    for (uint32_t i = 0; i < blockSize; i++) sum += pSrcA[i] * pSrcB[i];
+    *result = sum;
+}
+arm_status arm_rfft_fast_init_f32(arm_rfft_fast_instance_f32 *S, uint16_t fftLen) {
+    S->fftLenRFFT = fftLen;
+    return ARM_MATH_SUCCESS;
+}
+void arm_rfft_fast_f32(const arm_rfft_fast_instance_f32 *S, float32_t *p, float32_t *pOut, uint8_t ifftFlag) {
+    memset(pOut, 0, S->fftLenRFFT * sizeof(float32_t));
+}
+"""
+
+
+def _build(tmp_path: Path, name: str, driver: str, sources: list[str]) -> Path:
+    """Build a driver against firmware sources"""
+    src = tmp_path / f"{name}.cc"
+    src.write_text(PREAMBLE + driver)
+    exe = tmp_path / name
+    cmd = [
+        CXX,
+        "-O1",
+        "-std=c++14",
+        f"-I{EVB_SRC}",
+        f"-I{CMSIS_DIR / 'DSP' / 'Include'}",
+        f"-I{CMSIS_DIR / 'Core' / 'Include'}",
+        str(src),
+        *(str(EVB_SRC / s) for s in sources),
+        "-o",
+        str(exe),
+    ]
+    out = subprocess.run(cmd, capture_output=True, text=True)
+    assert out.returncode == 0, out.stderr
+    return exe
+
+
+def _run(exe: Path, commands: list[str]) -> list[list[str]]:
+    """Feed commands one per line and split the driver's output lines"""
+    out = subprocess.run([str(exe)], input="\n".join(commands) + "\n", check=True, capture_output=True, text=True)
+    return [line.split() for line in out.stdout.splitlines()]
+
+
+HRV_DRIVER = (
+    r"""
+#include "hrv.h"
+"""
+    + CMSIS_REF
+    + r"""
+int main(void) {
+    char cmd;
+    unsigned peak;
+    hk_hrv_init();
+    while (scanf(" %c", &cmd) == 1) {
+        if (cmd == 'p' && scanf("%u", &peak) == 1) {
+            const bool accepted = hk_hrv_push(peak);
+            hk_hrv_t hrv;
+            hk_hrv_metrics(&hrv);
+            printf("%d %u %.4f %.4f %.4f\n", accepted, hrv.numRR, hrv.sdnn, hrv.rmssd, hrv.pnn50);
+        } else if (cmd == 'b') {
+            hk_hrv_break();
+        }
+    }
+    return 0;
+}
+"""
+)
+
+
+def test_hrv_ring_buffer(tmp_path):
+    """Verify the streaming HRV ring matches batch metrics once it wraps, and drops repeats, gaps and ectopic RR."""
+    exe = _build(tmp_path, "hrv", HRV_DRIVER, ["hrv.cc"])
+    rng = np.random.default_rng(0)
+    rr = 200 + rng.integers(-15, 16, size=HK_HRV_WINDOW + 100)
+    peaks = np.concatenate(([1000], 1000 + np.cumsum(rr)))
+    # Overlapping windows push the peaks they share again
+    commands = [f"p {p}" for p in peaks[:200]] + [f"p {p}" for p in peaks[190:]]
+    out = _run(exe, commands)
+    assert [row[0] for row in out[200:210]] == ["0"] * 10
+    accepted, num_rr, sdnn, rmssd, pnn50 = (float(v) for v in out[-1])
+    assert accepted == 1 and num_rr == HK_HRV_WINDOW
+    last = rr[-HK_HRV_WINDOW:] * 1000 / SAMPLE_RATE
+    diffs = np.diff(rr[-HK_HRV_WINDOW - 1 :]) * 1000 / SAMPLE_RATE
+    assert sdnn == pytest.approx(np.std(last, ddof=1), rel=1e-3)
+    assert rmssd == pytest.approx(np.sqrt(np.mean(diffs**2)), rel=1e-3)
+    assert pnn50 == pytest.approx(100 * np.mean(np.abs(diffs) > 50), abs=1e-2)
+
+    # No interval spans a gap, and an RR off the last one by more than 20% is left out with the next
+    last_peak = int(peaks[-1])
+    out = _run(
+        exe,
+        [f"p {p}" for p in peaks[-3:]]
+        + ["b", f"p {last_peak + 5000}", f"p {last_peak + 5200}", f"p {last_peak + 5300}", f"p {last_peak + 5500}"],
+    )
+    accepted = [row[0] for row in out]
+    num_rr = [row[1] for row in out]
+    assert accepted == ["0", "1", "1", "0", "1", "0", "0"]
+    assert num_rr == ["0", "1", "2", "2", "3", "3", "3"]
+
+
+BEAT_CACHE_DRIVER = r"""
+#include "beat_cache.h"
+
+int main(void) {
+    char cmd;
+    hk_beat_entry_t beat = {};
+    while (scanf(" %c", &cmd) == 1) {
+        if (cmd == 's' && scanf("%u %u %u %u %f %u", &beat.peak, &beat.prevRR, &beat.nextRR, &beat.avgRR, &beat.margin, &beat.label) == 6) {
+            hk_beat_cache_store(&beat);
+        } else if (cmd == 'l' && scanf("%u %u %u %u", &beat.peak, &beat.prevRR, &beat.nextRR, &beat.avgRR) == 4) {
+            printf("%d\n", hk_beat_cache_lookup(&beat));
+        } else if (cmd == 't') {
+            uint32_t lookups, hits;
+            hk_beat_cache_stats(&lookups, &hits);
+            printf("%u %u\n", lookups, hits);
+        } else if (cmd == 'r') {
+            hk_beat_cache_reset();
+        }
+    }
+    return 0;
+}
+"""
+
+
+def test_beat_cache(tmp_path):
+    """Verify the beat cache reuses a sure label of the same beat only, and evicts the oldest beat when full."""
+    exe = _build(tmp_path, "beat_cache", BEAT_CACHE_DRIVER, ["beat_cache.cc"])
+    out = _run(
+        exe,
+        [
+            "s 1000 200 210 205 0.9 2",
+            "s 1200 210 190 205 0.1 1",
+            # Same beat, peak moved within tolerance
+            "l 1002 200 210 205",
+            "l 998 205 205 200",
+            # Peak moved too far, RR context moved, unsure label
+            "l 1003 200 210 205",
+            "l 1000 200 230 205",
+            "l 1200 210 190 205",
+            "t",
+            "r",
+            "l 1000 200 210 205",
+            "t",
+        ],
+    )
+    assert out == [["2"], ["2"], ["-1"], ["-1"], ["-1"], ["5", "2"], ["-1"], ["1", "0"]]
+
+    commands = [f"s {1000 + 200 * i} 200 200 200 0.9 {i % 3}" for i in range(HK_BEAT_CACHE_LEN + 1)]
+    commands += ["l 1000 200 200 200", "l 1200 200 200 200", f"l {1000 + 200 * HK_BEAT_CACHE_LEN} 200 200 200"]
+    out = _run(exe, commands)
+    assert out == [["-1"], ["1"], [str(HK_BEAT_CACHE_LEN % 3)]]
+
+
+BEAT_TEMPLATE_DRIVER = (
+    r"""
+#include "beat_template.h"
+"""
+    + CMSIS_REF
+    + r"""
+int main(void) {
+    char cmd;
+    unsigned prevRR, avgRR;
+    int prevNormal;
+    float32_t beat[HK_BEAT_LEN];
+    while (scanf(" %c %u %u %d", &cmd, &prevRR, &avgRR, &prevNormal) == 4) {
+        for (int i = 0; i < HK_BEAT_LEN; i++) {
+            scanf("%f", &beat[i]);
+        }
+        if (cmd == 'u') {
+            hk_template_update(beat, prevRR, avgRR);
+        } else if (cmd == 's') {
+            printf("%d %.4f\n", hk_template_screen(beat, prevRR, avgRR, prevNormal, HK_TEMPLATE_SIMILARITY),
+                   hk_template_similarity(beat));
+        }
+    }
+    return 0;
+}
+"""
+)
+
+
+def _beat(rng: np.random.Generator, noise: float = 0.01) -> np.ndarray:
+    """Normal beat: P, QRS and T bumps around the R peak at the middle"""
+    t = np.arange(HK_BEAT_LEN) - HK_BEAT_LEN // 2
+    x = 0.15 * np.exp(-(((t + 40) / 8) ** 2)) + np.exp(-((t / 4) ** 2)) + 0.3 * np.exp(-(((t - 50) / 14) ** 2))
+    return x + noise * rng.standard_normal(HK_BEAT_LEN)
+
+
+def test_template_screen(tmp_path):
+    """Verify the template screens normal beats only after warm-up, whatever their gain and baseline,
+    and never premature, changed or post-ectopic beats."""
+    exe = _build(tmp_path, "beat_template", BEAT_TEMPLATE_DRIVER, ["beat_template.cc"])
+    rng = np.random.default_rng(0)
+
+    def line(cmd: str, beat: np.ndarray, prev_rr: int = 200, avg_rr: int = 200, prev_normal: int = 1) -> str:
+        return f"{cmd} {prev_rr} {avg_rr} {prev_normal} " + " ".join(f"{v:.5f}" for v in beat)
+
+    normal = _beat(rng)
+    commands = [line("s", normal)]
+    # Premature beats do not join the template
+    commands += [line("u", _beat(rng), prev_rr=150) for _ in range(HK_TEMPLATE_WARMUP)]
+    commands += [line("s", normal)]
+    commands += [line("u", _beat(rng)) for _ in range(HK_TEMPLATE_WARMUP)]
+    commands += [
+        line("s", 3 * normal + 2),
+        line("s", -normal),
+        line("s", normal, prev_rr=150),
+        line("s", normal, prev_normal=0),
+    ]
+    out = _run(exe, commands)
+    screened = [row[0] for row in out]
+    similarity = [float(row[1]) for row in out]
+    assert screened == ["0", "0", "1", "0", "0", "0"]
+    assert similarity[0] == similarity[1] == -1
+    assert similarity[2] > 0.99 and similarity[3] < 0
+
+
+HEAD_REGISTRY_DRIVER = r"""
+#include "head_registry.h"
+
+static char hkRan[64];
+#define HEAD(name, label) static uint32_t name(hk_context_t *ctx) { strcat(hkRan, label); return 0; }
+HEAD(seg_run, "S")
+HEAD(beat_run, "B")
+HEAD(hrv_run, "H")
+HEAD(arr_run, "A")
+HEAD(orphan_run, "O")
+
+static const hk_head_t heads[] = {
+    {"seg", nullptr, seg_run, 4, 0, HeartProductMask | HeartProductPeaks},
+    {"beat", nullptr, beat_run, 1, HeartProductPeaks, HeartProductBeats},
+    {"hrv", nullptr, hrv_run, 2, HeartProductPeaks, HeartProductRR},
+    {"arr", nullptr, arr_run, 3, 0, HeartProductRhythm},
+};
+static const hk_head_t orphan = {"orphan", nullptr, orphan_run, 1, HeartProductFeatures, 0};
+static const hk_head_t badPeriod = {"bad", nullptr, arr_run, 0, 0, 0};
+
+int main(void) {
+    char cmd;
+    unsigned arg;
+    for (const hk_head_t &head : heads) {
+        hk_head_register(&head);
+    }
+    printf("%d\n", hk_head_register(&badPeriod));
+    while (scanf(" %c", &cmd) == 1) {
+        if (cmd == 'w') {
+            hkRan[0] = 0;
+            const uint32_t err = hk_heads_run(nullptr);
+            printf("%s %u %u\n", hkRan[0] ? hkRan : "-", hk_heads_made(), err);
+        } else if (cmd == 'b' && scanf("%u", &arg) == 1) {
+            hk_heads_set_backoff(arg);
+        } else if (cmd == 'r') {
+            hk_heads_reset();
+        } else if (cmd == 'o') {
+            printf("%d\n", hk_head_register(&orphan));
+        }
+    }
+    return 0;
+}
+"""
+
+
+def test_head_registry(tmp_path):
+    """Verify heads run on their period, pull in their producers and run after them, and stretch with backoff."""
+    exe = _build(tmp_path, "head_registry", HEAD_REGISTRY_DRIVER, ["head_registry.cc"])
+    out = _run(exe, ["w"] * 7 + ["b 1"] + ["w"] * 7 + ["r", "w", "o", "w"])
+    assert out[0] == ["-1"]
+    ran = [row[0] for row in out[1:]]
+    # Beats every window keep segmentation every window, HRV every 2nd and arrhythmia every 3rd
+    assert ran[:7] == ["SBHA", "SB", "SBH", "SBA", "SBH", "SB", "SBHA"]
+    assert out[1][1:] == ["55", "0"] and out[2][1:] == ["35", "0"]
+    # Backoff doubles every period from the head's last run
+    assert ran[7:14] == ["-", "SB", "-", "SBH", "-", "SBA", "-"]
+    # Reset runs every head on the next window, and a head needing what no head makes is an error
+    assert ran[14] == "SBHA"
+    assert out[16] == ["4"]
+    assert out[17][0] == "SB" and out[17][2] == "1"
@@ -0,0 +1,76 @@
+import numpy as np
+
+from heartkit.defines import HeartSegment
+from heartkit.hrv import (
+    compare_hrv_metrics,
+    compute_hrv_metrics,
+    find_peaks_from_segments,
+    interior_qrs_mask,
+)
+
+SAMPLE_RATE = 250
+QRS_LEN = 20
+
+
+def _labels(frame_size: int, qrs_starts: list[int]) -> np.ndarray:
+    """Segment labels with a QRS of QRS_LEN samples at each start, clipped to the frame"""
+    y = np.full(frame_size, HeartSegment.normal, dtype=int)
+    for start in qrs_starts:
+        y[max(start, 0) : max(start + QRS_LEN, 0)] = HeartSegment.qrs
+    return y
+
+
+def test_interior_qrs_mask():
+    """Verify QRS segments cut by the frame edges are cleared and interior ones kept."""
+    mask = _labels(1000, [-5, 300, 600, 990]) == HeartSegment.qrs
+    interior = interior_qrs_mask(mask)
+    assert interior[0] == 0 and interior[-1] == 0
+    assert np.array_equal(interior[100:900], mask[100:900])
+    peaks = find_peaks_from_segments(np.zeros(1000), interior, sampling_rate=SAMPLE_RATE)
+    assert peaks.size == 2
+    assert np.all(np.abs(peaks - np.array([310, 610])) <= 2)
+
+
+def test_compare_hrv_metrics_frame_starts_in_qrs():
+    """Verify a frame starting and ending inside a QRS compares without error or misaligned peaks."""
+    # 12 beats at 75 BPM, the first QRS begins before the frame and the last runs past it
+    frame_size = 12 * 200
+    y = _labels(frame_size, list(range(-10, frame_size, 200)))
+    assert y[0] == HeartSegment.qrs and y[-1] == HeartSegment.qrs
+    x = np.zeros((1, frame_size, 1))
+    errors = compare_hrv_metrics(x, y[None], y[None], SAMPLE_RATE)
+    assert errors["num_frames"] == 1
+    assert errors["heart_rate"] == 0 and errors["sdnn"] == 0
+    # A prediction missing the clipped first QRS finds the same interior beats
+    y_pred = y.copy()
+    y_pred[:QRS_LEN] = HeartSegment.normal
+    errors = compare_hrv_metrics(x, y[None], y_pred[None], SAMPLE_RATE)
+    assert errors["num_frames"] == 1
+    assert errors["heart_rate"] == 0
+
+
+def test_compare_hrv_metrics_few_peaks():
+    """Verify frames with too few peaks for a heart rate keep it out of the mean."""
+    frame_size = 10 * SAMPLE_RATE
+    y = _labels(frame_size, [200, 400, 600])
+    x = np.zeros((1, frame_size, 1))
+    errors = compare_hrv_metrics(x, y[None], y[None], SAMPLE_RATE)
+    assert errors["num_frames"] == 1
+    assert np.isfinite(errors["heart_rate"])
+
+
+def test_compute_hrv_metrics():
+    """Verify time-domain metrics of alternating RR and that an ectopic RR is dropped."""
+    rr = np.tile([200, 220], 20)  # 0.8 s and 0.88 s
+    rpeaks = np.concatenate(([0], np.cumsum(rr)))
+    metrics = compute_hrv_metrics(rpeaks, sampling_rate=SAMPLE_RATE)
+    assert metrics["num_rr"] == rr.size
+    assert np.isclose(metrics["rmssd"], 80)
+    assert metrics["pnn50"] == 100
+    # A premature beat splits one RR into two short ones, both off by more than rr_tol
+    ectopic = np.sort(np.append(rpeaks, rpeaks[10] + 100))
+    metrics = compute_hrv_metrics(ectopic, sampling_rate=SAMPLE_RATE)
+    assert metrics["num_rr"] == rr.size - 1
+    assert np.isclose(metrics["rmssd"], 80)
+    # Too short for the LF/HF spectrum
+    assert metrics["lf_hf_ratio"] == 0
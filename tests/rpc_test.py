@@ -0,0 +1,78 @@
+import os
+import threading
+import time
+
+import pytest
+
+from neuralspot.rpc.utils import PtyTransport, UnixSocketTransport, get_transport
+
+MESSAGE = bytes(range(256)) * 4
+
+
+def test_unix_socket_pair():
+    """Verify a Unix socket pair carries framed messages both ways."""
+    a, b = UnixSocketTransport.pair()
+    try:
+        a.send(MESSAGE)
+        assert b.receive() == MESSAGE
+        b.send(b"ack")
+        assert a.receive() == b"ack"
+    finally:
+        a.close()
+        b.close()
+
+
+def test_unix_socket_path(tmp_path):
+    """Verify a client reaches the server on its path, and closing the server removes the socket file."""
+    path = str(tmp_path / "evb.sock")
+    clients = []
+
+    def connect():
+        while not os.path.exists(path):
+            time.sleep(0.01)
+        clients.append(UnixSocketTransport(path, is_server=False))
+
+    thread = threading.Thread(target=connect, daemon=True)
+    thread.start()
+    server = get_transport(f"unix://{path}", timeout=5)
+    thread.join()
+    client = clients[0]
+    try:
+        client.send(MESSAGE)
+        assert server.receive() == MESSAGE
+    finally:
+        client.close()
+        server.close()
+    assert not os.path.exists(path)
+
+
+def test_unix_socket_timeout(tmp_path):
+    """Verify a server nobody connects to times out and cleans up its socket file."""
+    path = str(tmp_path / "evb.sock")
+    with pytest.raises(TimeoutError):
+        UnixSocketTransport(path, timeout=0.1)
+    assert not os.path.exists(path)
+
+
+def test_pty_link(tmp_path):
+    """Verify a PTY is reachable through its link and its peer, and closing it removes the link."""
+    link = str(tmp_path / "evb")
+    pty = get_transport(f"pty://{link}")
+    assert isinstance(pty, PtyTransport)
+    assert os.path.realpath(link) == pty.slave_name
+    peer = pty.peer()
+    try:
+        pty.send(MESSAGE)
+        assert peer.receive() == MESSAGE
+        peer.send(b"ack")
+        assert pty.receive() == b"ack"
+    finally:
+        peer.close()
+        pty.close()
+    assert not os.path.lexists(link)
+
+
+def test_unsupported_transport():
+    """Verify an unknown transport URI is rejected."""
+    with pytest.raises(ValueError):
+        get_transport("tcp://localhost:5000")